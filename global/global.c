@@ -52,22 +52,9 @@
 #include "output.h"
 #include "literal.h"
 #include "convert.h"
-
-/*
- * ensure GTAGSLIBPATH compares correctly
- */
-#if defined(_WIN32) || defined(__DJGPP__)
-#define STRCMP stricmp
-#define back2slash(sb) do {		\
-	char *p = strbuf_value(sb);	\
-	for (; *p; p++) 		\
-		if (*p == '\\')         \
-			*p = '/';       \
-} while (0)
-#else
-#define STRCMP strcmp
-#define back2slash(sb)
-#endif
+#include "libpath.h"
+#include "parallel.h"
+#include "server.h"
 
 /*
  * enable [set] globbing, if available
@@ -135,6 +122,7 @@ int type;				/**< path conversion type */
 int match_part;				/**< match part only	*/
 int abslib;				/**< absolute path only in library project */
 int use_color;				/**< coloring */
+int jobs = 1;				/**< number of search processes */
 const char *cwd;			/**< current directory	*/
 const char *root;			/**< root of source tree	*/
 const char *dbpath;			/**< dbpath directory	*/
@@ -180,6 +168,9 @@ help(void)
 #define OPT_GTAGSCONF		136
 #define OPT_GTAGSLABEL		137
 #define OPT_PRINT		138
+#define OPT_SERVER		139
+#define OPT_CLIENT		140
+#define OPT_JOBS		141
 #define SORT_FILTER     1
 #define PATH_FILTER     2
 #define BOTH_FILTER     (SORT_FILTER|PATH_FILTER)
@@ -228,6 +219,7 @@ static struct option const long_options[] = {
 	{"debug", no_argument, &debug, 1},
 	{"gtagsconf", required_argument, NULL, OPT_GTAGSCONF},
 	{"gtagslabel", required_argument, NULL, OPT_GTAGSLABEL},
+	{"jobs", required_argument, NULL, OPT_JOBS},
 	{"literal", no_argument, &literal, 1},
 	{"match-part", required_argument, NULL, OPT_MATCH_PART},
 	{"path-style", required_argument, NULL, OPT_PATH_STYLE},
@@ -239,6 +231,8 @@ static struct option const long_options[] = {
 	{"result", required_argument, NULL, OPT_RESULT},
 	{"nosource", no_argument, &nosource, 1},
 	{"single-update", required_argument, NULL, OPT_SINGLE_UPDATE},
+	{"server", required_argument, NULL, OPT_SERVER},
+	{"client", required_argument, NULL, OPT_CLIENT},
 	{ 0 }
 };
 
@@ -270,7 +264,6 @@ decide_tag_by_context(const char *tag, const char *file, int lineno)
 	for (n = 0; isdigit(*p); p++)                                               \
 		n = n * 10 + (*p - '0');                                            \
 } while (0)
-	STRBUF *sb = NULL;
 	char path[MAXPATHLEN], s_fid[MAXFIDLEN];
 	const char *p;
 	GTOP *gtop;
@@ -311,17 +304,33 @@ decide_tag_by_context(const char *tag, const char *file, int lineno)
 			if (p != NULL && *p == ' ') {
 				for (p++; *p && *p != ' '; p++)
 					;
-				if (*p++ != ' ' || !isdigit(*p))
+				if (*p++ != ' ' || (gtop->format & GTAGS_BINLINE ? *p == '\0' : !isdigit(*p)))
 					die("Impossible! decide_tag_by_context(1)");
 				/*
 				 * Standard format	n <blank> <image>$
 				 * Compact format	d,d,d,d$
+				 * Binary line list	(d << 1 | r)[c]...$
 				 */
 				if (!(gtop->format & GTAGS_COMPACT)) {	/* Standard format */
 					if (atoi(p) == lineno) {
 						db = GRTAGS;
 						goto finish;
 					}
+				} else if (gtop->format & GTAGS_BINLINE) {
+					int d, cont, cur = 0;
+
+					while (*p) {
+						GET_VARINT(p, d);
+						cont = 0;
+						if (d & 1)
+							GET_VARINT(p, cont);
+						cur += d >> 1;
+						if (lineno >= cur && lineno <= cur + cont) {
+							db = GRTAGS;
+							goto finish;
+						}
+						cur += cont;
+					}
 				} else {				/* Compact format */
 					int n, cur, last = 0;
 
@@ -360,25 +369,17 @@ decide_tag_by_context(const char *tag, const char *file, int lineno)
 finish:
 	gtags_close(gtop);
 	if (db == GSYMS && getenv("GTAGSLIBPATH")) {
-		char libdbpath[MAXPATHLEN];
-		char *libdir = NULL, *nextp = NULL;
+		LIBPATH *lp = libpath_open(dbpath, GTAGS);
+		struct libtree *trees = varray_assign(lp->trees, 0, 0);
+		int i;
 
-		sb = strbuf_open(0);
-		strbuf_puts(sb, getenv("GTAGSLIBPATH"));
-		back2slash(sb);
-		for (libdir = strbuf_value(sb); db != GTAGS && libdir; libdir = nextp) {
-			if ((nextp = locatestring(libdir, PATHSEP, MATCH_FIRST)) != NULL)
-				*nextp++ = 0;
-			if (!gtagsexist(libdir, libdbpath, sizeof(libdbpath), 0))
-				continue;
-			if (!STRCMP(dbpath, libdbpath))
-				continue;
-			gtop = gtags_open(libdbpath, root, GTAGS, GTAGS_READ, 0);
+		for (i = 0; db != GTAGS && i < lp->trees->length; i++) {
+			gtop = gtags_open(trees[i].dbpath, root, GTAGS, GTAGS_READ, 0);
 			if ((gtp = gtags_first(gtop, tag, flags)) != NULL)
 				db = GTAGS;
 			gtags_close(gtop);
 		}
-		strbuf_close(sb);
+		libpath_close(lp);
 	}
 	return db;
 }
@@ -390,7 +391,17 @@ main(int argc, char **argv)
 	int optchar;
 	int option_index = 0;
 	int status = 0;
+	const char *sockpath;
 
+	/*
+	 * Query server and its client (see server.c).
+	 * The server returns only in a child process for each request.
+	 */
+	if ((sockpath = server_option(argc, argv, "--server")) != NULL)
+		global_server(sockpath, &argc, &argv);
+	else if ((sockpath = server_option(argc, argv, "--client")) != NULL
+		|| (sockpath = getenv("GTAGSSERVER")) != NULL)
+		global_client(sockpath, argc, argv);
 	/*
 	 * get path of following directories.
 	 *	o current directory
@@ -570,6 +581,15 @@ main(int argc, char **argv)
 		case OPT_GTAGSLABEL:
 			/* These options are already parsed in preparse_options() */
 			break;
+		case OPT_JOBS:
+			jobs = atoi(optarg);
+			if (jobs < 1)
+				die("--jobs: invalid number '%s'.", optarg);
+			break;
+		case OPT_SERVER:
+		case OPT_CLIENT:
+			/* These options are already parsed in server_option() */
+			break;
 		case OPT_MATCH_PART:
 			if (!strcmp(optarg, "first"))
 				match_part = MATCH_PART_FIRST;
@@ -1030,6 +1050,24 @@ completion_tags(const char *dbpath, const char *root, const char *prefix, int db
 	gtags_close(gtop);
 	return count;
 }
+/*
+ * Arguments for searching library trees.
+ */
+struct libsearch {
+	const char *pattern;
+	const char *cwd;
+	int db;
+};
+/**
+ * completion_library: search a library tree for completion_tags().
+ */
+static int
+completion_library(const struct libtree *tree, void *arg)
+{
+	struct libsearch *ls = (struct libsearch *)arg;
+
+	return completion_tags(tree->dbpath, tree->root, ls->pattern, ls->db);
+}
 /**
  * completion: print completion list of specified prefix
  *
@@ -1042,7 +1080,6 @@ void
 completion(const char *dbpath, const char *root, const char *prefix, int db)
 {
 	int count, total = 0;
-	char libdbpath[MAXPATHLEN];
 
 	if (prefix && *prefix == 0)	/* In the case global -c '' */
 		prefix = NULL;
@@ -1051,32 +1088,15 @@ completion(const char *dbpath, const char *root, const char *prefix, int db)
 	 * search in library path.
 	 */
 	if (db == GTAGS && getenv("GTAGSLIBPATH") && (count == 0 || Tflag) && !Sflag) {
-		STRBUF *sb = strbuf_open(0);
-		char *libdir, *nextp = NULL;
+		LIBPATH *lp = libpath_open(dbpath, db);
+		const struct libtree *found;
+		struct libsearch ls;
 
-		strbuf_puts(sb, getenv("GTAGSLIBPATH"));
-		back2slash(sb);
-		/*
-		 * search for each tree in the library path.
-		 */
-		for (libdir = strbuf_value(sb); libdir; libdir = nextp) {
-			if ((nextp = locatestring(libdir, PATHSEP, MATCH_FIRST)) != NULL)
-				*nextp++ = 0;
-			if (!gtagsexist(libdir, libdbpath, sizeof(libdbpath), 0))
-				continue;
-			if (!STRCMP(dbpath, libdbpath))
-				continue;
-			if (!test("f", makepath(libdbpath, dbname(db), NULL)))
-				continue;
-			/*
-			 * search again
-			 */
-			count = completion_tags(libdbpath, libdir, prefix, db);
-			total += count;
-			if (count > 0 && !Tflag)
-				break;
-		}
-		strbuf_close(sb);
+		ls.pattern = prefix;
+		ls.cwd = cwd;
+		ls.db = db;
+		total += libpath_search(lp, Tflag, jobs, completion_library, &ls, &found);
+		libpath_close(lp);
 	}
 	/* return total; */
 }
@@ -1443,6 +1463,145 @@ idutils(const char *pattern, const char *dbpath)
 		fprintf(stderr, " (using idutils index in '%s').\n", dbpath);
 	}
 }
+/**
+ * grep_candidates: select the source files which may match a pattern
+ *		using the full-text index.
+ *
+ *	@param[in]	pattern	pattern
+ *	@param[in]	dbpath	dbpath
+ *	@return		IDSET of file ids, NULL: cannot use the full-text index
+ *
+ * If it is available, GPATH is left open for grep_skip().
+ */
+static IDSET *
+grep_candidates(const char *pattern, const char *dbpath)
+{
+	STRHASH *trigrams = strhash_open(16);
+	IDSET *candidates = NULL;
+	int usable;
+
+	if (literal) {
+		/* Literal_comple() treats newlines as separators of patterns. */
+		usable = strchr(pattern, '\n') == NULL;
+		if (usable)
+			add_trigrams(trigrams, pattern, strlen(pattern));
+	} else
+		usable = required_trigrams(pattern, Gflag, trigrams);
+	if (usable && trigrams->entries > 0) {
+		if (gpath_open(dbpath, 0) < 0)
+			die("GPATH not found.");
+		if ((candidates = gpath_grep(trigrams)) == NULL)
+			gpath_close();
+		else if (debug) {
+			struct sh_entry *sh;
+
+			for (sh = strhash_first(trigrams); sh; sh = strhash_next(trigrams))
+				fprintf(stderr, "Using trigram: %s\n", sh->name);
+		}
+	}
+	strhash_close(trigrams);
+	return candidates;
+}
+/**
+ * grep_skip: whether or not a file can be skipped.
+ *
+ *	@param[in]	candidates	result of grep_candidates()
+ *	@param[in]	path	path name
+ *	@return		1: the file doesn't match the pattern, 0: should be read
+ *
+ * The full-text index is valid for a file only while it is not changed.
+ */
+static int
+grep_skip(IDSET *candidates, const char *path)
+{
+	struct stat st;
+	const char *fid = gpath_path2fid(path, NULL);
+
+	if (fid == NULL || idset_contains(candidates, atoi(fid)))
+		return 0;
+	if (stat(path, &st) < 0 || gpath_checkstat(path, fid, &st) != 0)
+		return 0;
+	return 1;
+}
+/**
+ * Output of the grep command.
+ */
+struct grep_output {
+	CONVERT *cv;
+	const char *pattern;
+	const char *fid;		/**< file id of the current file */
+	int count;
+};
+static regex_t grep_preg;
+/**
+ * grep_put: put a matched line to the output.
+ *
+ *	@param[in]	arg	struct grep_output
+ *	@param[in]	path	path name
+ *	@param[in]	lineno	line number
+ *	@param[in]	line	line image
+ *	@return		1: no more line is needed for the file, 0: continue
+ */
+static int
+grep_put(void *arg, const char *path, int lineno, const char *line)
+{
+	struct grep_output *out = (struct grep_output *)arg;
+
+	out->count++;
+	if (format == FORMAT_PATH) {
+		convert_put_path(out->cv, NULL, path);
+		return 1;
+	}
+	convert_put_using(out->cv, out->pattern, path, lineno, line, out->fid);
+	return 0;
+}
+/**
+ * grep_parallel_put: callback of parallel_grep().
+ */
+static void
+grep_parallel_put(void *arg, const char *path, const char *fid, int lineno, const char *line)
+{
+	struct grep_output *out = (struct grep_output *)arg;
+
+	out->fid = fid;
+	grep_put(arg, path, lineno, line);
+}
+/**
+ * grep_file: search a file for the pattern.
+ *
+ *	@param[in]	path	path name
+ *	@param[in]	put	callback for each matched line
+ *	@param[in]	arg	argument for the callback
+ *	@return		number of matched lines, -1: error
+ *
+ * This may be called in a worker process of parallel_grep().
+ */
+static int
+grep_file(const char *path, GREP_CALLBACK put, void *arg)
+{
+	STATIC_STRBUF(ib);
+	FILE *fp;
+	const char *buffer;
+	int linenum, count;
+
+	if (literal)
+		return literal_search(path, put, arg);
+	strbuf_clear(ib);
+	if (!(fp = fopen(path, "r")))
+		die("cannot open file '%s'.", path);
+	linenum = count = 0;
+	while ((buffer = strbuf_fgets(ib, fp, STRBUF_NOCRLF)) != NULL) {
+		int result = regexec(&grep_preg, buffer, 0, 0, 0);
+		linenum++;
+		if ((!Vflag && result == 0) || (Vflag && result != 0)) {
+			count++;
+			if ((*put)(arg, path, linenum, buffer))
+				break;
+		}
+	}
+	fclose(fp);
+	return count;
+}
 /**
  * grep: grep pattern
  *
@@ -1453,19 +1612,17 @@ idutils(const char *pattern, const char *dbpath)
 void
 grep(const char *pattern, char *const *argv, const char *dbpath)
 {
-	FILE *fp;
 	CONVERT *cv;
 	GFIND *gp = NULL;
-	STRBUF *ib = strbuf_open(MAXBUFLEN);
 	const char *path;
 	char encoded_pattern[IDENTLEN];
-	const char *buffer;
-	int linenum, count;
 	int flags = 0;
 	int target = GPATH_SOURCE;
-	regex_t	preg;
 	int user_specified = 1;
 	int gfind_flags = 0;
+	int parallel = 0;
+	IDSET *candidates = NULL;
+	struct grep_output out;
 
 	/*
 	 * convert spaces into %FF format.
@@ -1500,12 +1657,15 @@ grep(const char *pattern, char *const *argv, const char *dbpath)
 			flags |= REG_EXTENDED;
 		if (iflag)
 			flags |= REG_ICASE;
-		if (regcomp(&preg, pattern, flags) != 0)
+		if (regcomp(&grep_preg, pattern, flags) != 0)
 			die("invalid regular expression.");
 	}
 	cv = convert_open(type, format, root, cwd, dbpath, stdout, NOTAGS);
 	cv->tag_for_display = encoded_pattern;
-	count = 0;
+	out.cv = cv;
+	out.pattern = pattern;
+	out.fid = NULL;
+	out.count = 0;
 
 	if (*argv && file_list)
 		args_open_both(argv, file_list);
@@ -1516,7 +1676,11 @@ grep(const char *pattern, char *const *argv, const char *dbpath)
 	else {
 		args_open_gfind(gp = gfind_open(dbpath, localprefix, target, gfind_flags));
 		user_specified = 0;
+		if (!Vflag)
+			candidates = grep_candidates(pattern, dbpath);
 	}
+	if (jobs > 1)
+		parallel = parallel_open(jobs, format == FORMAT_PATH, grep_file, grep_parallel_put, &out);
 	while ((path = args_read()) != NULL) {
 		if (user_specified) {
 			static char buf[MAXPATHLEN];
@@ -1537,39 +1701,31 @@ grep(const char *pattern, char *const *argv, const char *dbpath)
 		}
 		if (Sflag && !locatestring(path, localprefix, MATCH_AT_FIRST))
 			continue;
-		if (literal) {
-			int n = literal_search(cv, path);
-			if (n > 0)
-				count += n;
-		} else {
-			if (!(fp = fopen(path, "r")))
-				die("cannot open file '%s'.", path);
-			linenum = 0;
-			while ((buffer = strbuf_fgets(ib, fp, STRBUF_NOCRLF)) != NULL) {
-				int result = regexec(&preg, buffer, 0, 0, 0);
-				linenum++;
-				if ((!Vflag && result == 0) || (Vflag && result != 0)) {
-					count++;
-					if (format == FORMAT_PATH) {
-						convert_put_path(cv, NULL, path);
-						break;
-					} else {
-						convert_put_using(cv, pattern, path, linenum, buffer,
-							(user_specified) ? NULL : gp->dbop->lastdat);
-					}
-				}
-			}
-			fclose(fp);
+		if (candidates && grep_skip(candidates, path))
+			continue;
+		if (parallel)
+			parallel_grep(path, user_specified ? NULL : gp->dbop->lastdat);
+		else {
+			out.fid = user_specified ? NULL : gp->dbop->lastdat;
+			grep_file(path, grep_put, &out);
 		}
 	}
+	if (parallel)
+		parallel_close();
 	args_close();
 	convert_close(cv);
-	strbuf_close(ib);
 	if (literal == 0)
-		regfree(&preg);
+		regfree(&grep_preg);
 	if (vflag) {
-		print_count(count);
-		fprintf(stderr, " (no index used).\n");
+		print_count(out.count);
+		if (candidates)
+			fprintf(stderr, " (using full-text index in '%s').\n", dbpath);
+		else
+			fprintf(stderr, " (no index used).\n");
+	}
+	if (candidates) {
+		idset_close(candidates);
+		gpath_close();
 	}
 }
 /**
@@ -1779,6 +1935,7 @@ parsefile(char *const *argv, const char *cwd, const char *root, const char *dbpa
 		data.dbop = dbop_open(makepath(dbpath, dbname(GTAGS), NULL), 0, 0, 0);
 		if (data.dbop == NULL)
 			die("%s not found.", dbname(GTAGS));
+		gpath_sync(&data.dbop, 1);
 	} else {
 		data.dbop = NULL;
 	}
@@ -1902,6 +2059,16 @@ search(const char *pattern, const char *root, const char *cwd, const char *dbpat
 	end_output();
 	return count;
 }
+/**
+ * search_library: search a library tree for tagsearch().
+ */
+static int
+search_library(const struct libtree *tree, void *arg)
+{
+	struct libsearch *ls = (struct libsearch *)arg;
+
+	return search(ls->pattern, tree->root, ls->cwd, tree->dbpath, ls->db);
+}
 /**
  * tagsearch: execute tag search
  *
@@ -1943,35 +2110,20 @@ tagsearch(const char *pattern, const char *cwd, const char *root, const char *db
 	if (abslib)
 		type = PATH_ABSOLUTE;
 	if (db == GTAGS && getenv("GTAGSLIBPATH") && (count == 0 || Tflag) && !Sflag) {
-		STRBUF *sb = strbuf_open(0);
-		char *libdir, *nextp = NULL;
+		LIBPATH *lp = libpath_open(dbpath, db);
+		const struct libtree *found;
+		struct libsearch ls;
 
-		strbuf_puts(sb, getenv("GTAGSLIBPATH"));
-		back2slash(sb);
-		/*
-		 * search for each tree in the library path.
-		 */
-		for (libdir = strbuf_value(sb); libdir; libdir = nextp) {
-			if ((nextp = locatestring(libdir, PATHSEP, MATCH_FIRST)) != NULL)
-				*nextp++ = 0;
-			if (!gtagsexist(libdir, libdbpath, sizeof(libdbpath), 0))
-				continue;
-			if (!STRCMP(dbpath, libdbpath))
-				continue;
-			if (!test("f", makepath(libdbpath, dbname(db), NULL)))
-				continue;
-			/*
-			 * search again
-			 */
-			count = search(pattern, libdir, cwd, libdbpath, db);
-			total += count;
-			if (count > 0 && !Tflag) {
-				/* for verbose message */
-				dbpath = libdbpath;
-				break;
-			}
+		ls.pattern = pattern;
+		ls.cwd = cwd;
+		ls.db = db;
+		total += libpath_search(lp, Tflag, jobs, search_library, &ls, &found);
+		/* for verbose message */
+		if (found) {
+			strlimcpy(libdbpath, found->dbpath, sizeof(libdbpath));
+			dbpath = libdbpath;
 		}
-		strbuf_close(sb);
+		libpath_close(lp);
 	}
 	if (vflag) {
 		print_count(total);
@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2018 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <sys/types.h>
+#include <errno.h>
+#include <stdio.h>
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "global.h"
+#include "libpath.h"
+
+/*
+ * Library trees (GTAGSLIBPATH).
+ *
+ * Libpath_open() resolves GTAGSLIBPATH into the list of library trees
+ * which have the tag file at once, and libpath_search() searches them
+ * in the order of GTAGSLIBPATH.
+ *
+ *	lp = libpath_open(dbpath, GTAGS);
+ *	total = libpath_search(lp, Tflag, jobs, func, arg, &found);
+ *	libpath_close(lp);
+ *
+ * If 'all' is 0, the search stops at the first tree which has output.
+ * With two or more jobs, the trees are searched by child processes in
+ * parallel. Each child writes its output and messages into temporary
+ * files, and the parent copies them to the standard output and the
+ * standard error output in the order of the trees. The files of the
+ * children which are no longer needed are thrown away. So, the output
+ * is the same as that of serial search.
+ */
+
+/**
+ * libpath_open: resolve GTAGSLIBPATH.
+ *
+ *	@param[in]	dbpath	dbpath of the current project (excluded)
+ *	@param[in]	db	GTAGS,GRTAGS,GSYMS
+ *	@return		LIBPATH structure
+ *
+ * Trees which don't have the tag file of db are excluded.
+ */
+LIBPATH *
+libpath_open(const char *dbpath, int db)
+{
+	LIBPATH *lp = (LIBPATH *)check_calloc(sizeof(LIBPATH), 1);
+	char libdbpath[MAXPATHLEN];
+	const char *env = getenv("GTAGSLIBPATH");
+
+	lp->trees = varray_open(sizeof(struct libtree), 32);
+	if (env) {
+		STRBUF *sb = strbuf_open(0);
+		char *libdir, *nextp = NULL;
+
+		strbuf_puts(sb, env);
+		back2slash(sb);
+		for (libdir = strbuf_value(sb); libdir; libdir = nextp) {
+			struct libtree *tree;
+
+			if ((nextp = locatestring(libdir, PATHSEP, MATCH_FIRST)) != NULL)
+				*nextp++ = 0;
+			if (!gtagsexist(libdir, libdbpath, sizeof(libdbpath), 0))
+				continue;
+			if (dbpath && !STRCMP(dbpath, libdbpath))
+				continue;
+			if (!test("f", makepath(libdbpath, dbname(db), NULL)))
+				continue;
+			tree = varray_append(lp->trees);
+			tree->root = check_strdup(libdir);
+			tree->dbpath = check_strdup(libdbpath);
+		}
+		strbuf_close(sb);
+	}
+	return lp;
+}
+/**
+ * search_serial: search library trees one by one.
+ */
+static int
+search_serial(LIBPATH *lp, int all, LIBPATH_FUNCTION func, void *arg, const struct libtree **found)
+{
+	const struct libtree *trees = varray_assign(lp->trees, 0, 0);
+	int i, count, total = 0;
+
+	for (i = 0; i < lp->trees->length; i++) {
+		count = (*func)(&trees[i], arg);
+		total += count;
+		if (count > 0 && !all) {
+			*found = &trees[i];
+			break;
+		}
+	}
+	return total;
+}
+#if defined(__DJGPP__) || defined(_WIN32)
+/**
+ * libpath_search: search library trees.
+ *
+ * Child processes are not available on this platform.
+ */
+int
+libpath_search(LIBPATH *lp, int all, int jobs, LIBPATH_FUNCTION func, void *arg, const struct libtree **found)
+{
+	*found = NULL;
+	return search_serial(lp, all, func, arg, found);
+}
+#else
+#include <signal.h>
+#include <sys/wait.h>
+
+struct libjob {
+	int pid;
+	int fd;				/**< read the count from the child */
+	FILE *out;			/**< output of the child */
+	FILE *err;			/**< messages of the child */
+};
+
+/**
+ * start_job: start a child process which searches a library tree.
+ */
+static void
+start_job(struct libjob *job, const struct libtree *tree, LIBPATH_FUNCTION func, void *arg)
+{
+	int fds[2];
+
+	if ((job->out = tmpfile()) == NULL || (job->err = tmpfile()) == NULL)
+		die("cannot make a temporary file.");
+	if (pipe(fds) < 0)
+		die("pipe(2) failed.");
+	/*
+	 * The child must not write out stdio buffers inherited from the parent.
+	 */
+	fflush(NULL);
+	job->pid = fork();
+	if (job->pid == 0) {
+		/* child process */
+		int count;
+
+		close(fds[0]);
+		if (dup2(fileno(job->out), STDOUT_FILENO) < 0
+		    || dup2(fileno(job->err), STDERR_FILENO) < 0)
+			die("dup2(2) failed.");
+		count = (*func)(tree, arg);
+		if (fflush(stdout) == EOF
+		    || write(fds[1], &count, sizeof(count)) != sizeof(count))
+			_exit(1);
+		_exit(0);
+	} else if (job->pid < 0)
+		die("fork(2) failed.");
+	close(fds[1]);
+	job->fd = fds[0];
+}
+/**
+ * copy_output: copy the output of a child.
+ *
+ *	@param[in]	ip	temporary file of the child
+ *	@param[in]	op	stdout or stderr
+ */
+static void
+copy_output(FILE *ip, FILE *op)
+{
+	char buf[MAXBUFLEN];
+	size_t n;
+
+	rewind(ip);
+	while ((n = fread(buf, 1, sizeof(buf), ip)) > 0)
+		if (fwrite(buf, 1, n, op) != n)
+			die("cannot write the output of a library search process.");
+}
+/**
+ * wait_job: wait for a child process.
+ *
+ *	@param[in]	job	job
+ *	@param[in]	kill_it	1: terminate the child
+ *	@return		count of output lines
+ *
+ * The messages of the child are shown only when its result is used.
+ */
+static int
+wait_job(struct libjob *job, int kill_it)
+{
+	int count = 0, ret, status;
+
+	if (kill_it)
+		kill(job->pid, SIGTERM);
+	else if (read(job->fd, &count, sizeof(count)) != sizeof(count))
+		count = -1;
+	close(job->fd);
+	while ((ret = waitpid(job->pid, &status, 0)) < 0 && errno == EINTR)
+		;
+	if (ret < 0)
+		die("waitpid(2) failed.");
+	if (!kill_it) {
+		copy_output(job->err, stderr);
+		/*
+		 * The child which died with a message ends this process as
+		 * the serial search does.
+		 */
+		if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+			fflush(stdout);
+			exit(WEXITSTATUS(status));
+		}
+		if (count < 0 || !WIFEXITED(status))
+			die("library search process terminated abnormally.");
+	}
+	fclose(job->err);
+	return count;
+}
+/**
+ * libpath_search: search library trees.
+ *
+ *	@param[in]	lp	LIBPATH structure
+ *	@param[in]	all	1: search all trees, 0: stop at the first tree which has output
+ *	@param[in]	jobs	number of processes
+ *	@param[in]	func	search function
+ *	@param[in]	arg	argument for func
+ *	@param[out]	found	the tree which stopped the search, NULL: not stopped
+ *	@return		total count of output lines
+ */
+int
+libpath_search(LIBPATH *lp, int all, int jobs, LIBPATH_FUNCTION func, void *arg, const struct libtree **found)
+{
+	const struct libtree *trees = varray_assign(lp->trees, 0, 0);
+	struct libjob *queue;
+	int n = lp->trees->length;
+	int i, next, count, total = 0;
+
+	*found = NULL;
+	if (jobs < 2 || n < 2)
+		return search_serial(lp, all, func, arg, found);
+	queue = (struct libjob *)check_calloc(sizeof(struct libjob), n);
+	for (i = next = 0; i < n; i++) {
+		for (; next < n && next < i + jobs; next++)
+			start_job(&queue[next], &trees[next], func, arg);
+		count = wait_job(&queue[i], 0);
+		copy_output(queue[i].out, stdout);
+		fclose(queue[i].out);
+		total += count;
+		if (count > 0 && !all) {
+			*found = &trees[i];
+			break;
+		}
+	}
+	/*
+	 * Abandon the searches which are no longer needed.
+	 */
+	while (++i < next) {
+		wait_job(&queue[i], 1);
+		fclose(queue[i].out);
+	}
+	free(queue);
+	return total;
+}
+#endif
+/**
+ * libpath_close: close LIBPATH structure.
+ *
+ *	@param[in]	lp	LIBPATH structure
+ */
+void
+libpath_close(LIBPATH *lp)
+{
+	struct libtree *trees = varray_assign(lp->trees, 0, 0);
+	int i;
+
+	for (i = 0; i < lp->trees->length; i++) {
+		free(trees[i].root);
+		free(trees[i].dbpath);
+	}
+	varray_close(lp->trees);
+	free(lp);
+}
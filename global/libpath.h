@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2018 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _LIBPATH_H_
+#define _LIBPATH_H_
+
+#include "varray.h"
+
+/**
+ * Library tree in GTAGSLIBPATH.
+ */
+struct libtree {
+	char *root;			/**< root directory */
+	char *dbpath;			/**< directory of the tag files */
+};
+typedef struct {
+	VARRAY *trees;			/**< struct libtree */
+} LIBPATH;
+
+/**
+ * Function which searches a library tree, like search().
+ *
+ *	@param[in]	tree	library tree
+ *	@param[in]	arg	argument given to libpath_search()
+ *	@return		number of output lines
+ */
+typedef int (*LIBPATH_FUNCTION)(const struct libtree *, void *);
+
+LIBPATH *libpath_open(const char *, int);
+int libpath_search(LIBPATH *, int, int, LIBPATH_FUNCTION, void *, const struct libtree **);
+void libpath_close(LIBPATH *);
+
+#endif /* ! _LIBPATH_H_ */
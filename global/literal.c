@@ -47,80 +47,247 @@
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
-#include "format.h"
-#include "convert.h"
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "checkalloc.h"
 #include "die.h"
+#include "gparam.h"
+#include "strbuf.h"
 #include "strlimcpy.h"
+#include "literal.h"
 
 #ifndef O_BINARY
 #define O_BINARY 0
 #endif
 
-void overflo(void);
-void cgotofn(const char *);
-void cfail(void);
-
 extern int iflag;
 extern int Vflag;
 extern void encode(char *, int, const char *);
 
-#define	MAXSIZ 6000
-#define QSIZE 400
-static struct words {
-	char 	inp;
-	char	out;
-	struct	words *nst;
-	struct	words *link;
-	struct	words *fail;
-} w[MAXSIZ], *smax, *q;
+/*
+ * Literal search:
+ *
+ * The pattern may include several words separated by newlines, and a line
+ * matches if it includes any of them. Each word is looked for by its first
+ * and last bytes, and the candidates are compared with the whole word.
+ * If SSE2 is available, 16 positions are examined at once. Otherwise,
+ * memchr(3) finds the first byte.
+ * For the -i option, the words are converted into lower case beforehand,
+ * and the bytes of files are converted using the table 'fold'.
+ */
+struct word {
+	const unsigned char *str;	/**< word (in lower case for -i) */
+	int len;			/**< length of the word */
+	const char *next;		/**< next occurrence; valid if not behind */
+};
+static struct word *words;
+static int nwords;
+static unsigned char fold[256];
 
 static char pattern[IDENTLEN];
 static char encoded_pattern[IDENTLEN];
+static char folded_pattern[IDENTLEN];
 
 /**
  * literal_comple: compile literal for search.
  *
  *	@param[in]	pat	literal string
  *
- * Literal string is treated as is.
+ * Literal string is treated as is, except that newlines separate words.
  */
 void
 literal_comple(const char *pat)
 {
+	char *p;
+	int i;
+
 	/*
 	 * convert spaces into %FF format.
 	 */
 	encode(encoded_pattern, sizeof(encoded_pattern), pat);
 	strlimcpy(pattern, pat, sizeof(pattern));
 	/*
-	 * construct a goto table.
+	 * make the table for case folding.
 	 */
-	cgotofn(pattern);
+	for (i = 0; i < 256; i++)
+		fold[i] = (iflag && i >= 'A' && i <= 'Z') ? i - 'A' + 'a' : i;
+	for (i = 0; pattern[i]; i++)
+		folded_pattern[i] = fold[(unsigned char)pattern[i]];
+	folded_pattern[i] = '\0';
 	/*
-	 * construct fail links.
+	 * split the pattern into words. Empty words are ignored.
 	 */
-	cfail();
+	if (words)
+		free(words);
+	words = (struct word *)check_calloc(sizeof(struct word), strlen(folded_pattern) / 2 + 1);
+	nwords = 0;
+	for (p = folded_pattern; *p; ) {
+		char *q = strchr(p, '\n');
+
+		if (q)
+			*q = '\0';
+		if (*p) {
+			words[nwords].str = (const unsigned char *)p;
+			words[nwords].len = strlen(p);
+			nwords++;
+		}
+		p = q ? q + 1 : p + strlen(p);
+	}
+}
+/**
+ * match_word: compare a word with a string.
+ *
+ *	@param[in]	w	word
+ *	@param[in]	s	string which has w->len bytes at least
+ *	@return		1: match, 0: not match
+ */
+static int
+match_word(const struct word *w, const unsigned char *s)
+{
+	int i;
+
+	if (!iflag)
+		return memcmp(s, w->str, w->len) == 0;
+	for (i = 0; i < w->len; i++)
+		if (fold[s[i]] != w->str[i])
+			return 0;
+	return 1;
+}
+/**
+ * search_word: search a word in a buffer.
+ *
+ *	@param[in]	w	word
+ *	@param[in]	p	start of the buffer
+ *	@param[in]	end	end of the buffer
+ *	@return		the first occurrence, NULL: not found
+ */
+static const char *
+search_word(const struct word *w, const char *p, const char *end)
+{
+	const unsigned char *s = (const unsigned char *)p;
+	const unsigned char *last;	/* the last position where w can begin */
+	int first, final, len = w->len;
+	int caseless;			/* 1: the first byte is a letter for -i */
+
+	if (len == 0)
+		return p;
+	if (end - p < len)
+		return NULL;
+	last = (const unsigned char *)end - len;
+	first = w->str[0];
+	final = w->str[len - 1];
+	caseless = iflag && first >= 'a' && first <= 'z';
+#ifdef __SSE2__
+	{
+		/*
+		 * For -i, 0x20 is set to the bytes of files which are compared
+		 * with a lower case letter, which makes upper case letters lower.
+		 */
+		const __m128i vfirst = _mm_set1_epi8(first);
+		const __m128i vfinal = _mm_set1_epi8(final);
+		const __m128i mfirst = _mm_set1_epi8(caseless ? 0x20 : 0);
+		const __m128i mfinal = _mm_set1_epi8(iflag && final >= 'a' && final <= 'z' ? 0x20 : 0);
+
+		for (; last - s >= 15; s += 16) {
+			__m128i a = _mm_loadu_si128((const __m128i *)s);
+			__m128i b = _mm_loadu_si128((const __m128i *)(s + len - 1));
+			int mask;
+
+			a = _mm_cmpeq_epi8(_mm_or_si128(a, mfirst), vfirst);
+			b = _mm_cmpeq_epi8(_mm_or_si128(b, mfinal), vfinal);
+			for (mask = _mm_movemask_epi8(_mm_and_si128(a, b)); mask; mask &= mask - 1) {
+				const unsigned char *c = s + __builtin_ctz(mask);
+
+				if (match_word(w, c))
+					return (const char *)c;
+			}
+		}
+	}
+#endif
+	for (; s <= last; s++) {
+		if (!caseless) {
+			if ((s = memchr(s, first, last - s + 1)) == NULL)
+				return NULL;
+		} else if (fold[*s] != first)
+			continue;
+		if (fold[s[len - 1]] == final && match_word(w, s))
+			return (const char *)s;
+	}
+	return NULL;
+}
+/**
+ * search_words: search the words in a buffer.
+ *
+ *	@param[in]	p	start of the buffer
+ *	@param[in]	end	end of the buffer
+ *	@return		the first occurrence of any word, NULL: not found
+ *
+ * The next occurrence of each word is remembered, since the buffer moves
+ * forward in a file. It should be reset for each file.
+ */
+static const char *
+search_words(const char *p, const char *end)
+{
+	const char *found = end;
+	int i;
+
+	for (i = 0; i < nwords; i++) {
+		struct word *w = &words[i];
+
+		if (w->next == NULL || w->next < p) {
+			w->next = search_word(w, p, end);
+			if (w->next == NULL)
+				w->next = end;
+		}
+		if (w->next < found)
+			found = w->next;
+	}
+	return found < end ? found : NULL;
+}
+/**
+ * put_line: put a line to the output.
+ *
+ *	@param[in]	put	callback
+ *	@param[in]	arg	argument for the callback
+ *	@param[in]	file	file name
+ *	@param[in]	lineno	line number
+ *	@param[in]	line	start of the line
+ *	@param[in]	end	end of the line (next to the newline)
+ *	@return		1: no more line is needed, 0: continue
+ */
+static int
+put_line(GREP_CALLBACK put, void *arg, const char *file, long lineno, const char *line, const char *end)
+{
+	STATIC_STRBUF(sb);
+
+	strbuf_clear(sb);
+	strbuf_nputs(sb, line, end - line);
+	strbuf_unputc(sb, '\n');
+	strbuf_unputc(sb, '\r');
+	return (*put)(arg, file, lineno, strbuf_value(sb));
 }
 /**
  * literal_search: execute literal search
  *
- *	@param[in]	cv	CONVERT structure
  *	@param[in]	file	file to search
- *	@return		0: normal, -1: error
+ *	@param[in]	put	callback for each matched line
+ *	@param[in]	arg	argument for the callback
+ *	@return		number of matched lines, -1: error
  */
 int
-literal_search(CONVERT *cv, const char *file)
+literal_search(const char *file, GREP_CALLBACK put, void *arg)
 {
-# define ccomp(a,b) (iflag ? lca(a)==lca(b) : a==b)
-# define lca(x) (isupper(x) ? tolower(x) : x)
-	struct words *c;
-	int ccount;
-	char *p;
+	const char *p, *end;
 	char *buf;
 	struct stat stb;
-	char *linep;
 	long lineno;
-	int f;
+	int f, i;
 	int count = 0;
 
 	if ((f = open(file, O_BINARY)) < 0) {
@@ -156,71 +323,43 @@ literal_search(CONVERT *cv, const char *file)
 	if (read(f, buf, stb.st_size) < stb.st_size)
 		die("read failed (%s).", file);
 #endif
-	linep = p = buf;
-	ccount = stb.st_size;
+	end = buf + stb.st_size;
+	for (i = 0; i < nwords; i++)
+		words[i].next = NULL;
 	lineno = 1;
-	c = w;
-	for (;;) {
-		if (--ccount < 0)
-			break;
-		nstate:
-			if (ccomp(c->inp, *p)) {
-				c = c->nst;
-			}
-			else if (c->link != 0) {
-				c = c->link;
-				goto nstate;
-			}
-			else {
-				c = c->fail;
-				if (c==0) {
-					c = w;
-					istate:
-					if (ccomp(c->inp , *p)) {
-						c = c->nst;
-					}
-					else if (c->link != 0) {
-						c = c->link;
-						goto istate;
-					}
-				}
-				else goto nstate;
-			}
-		if (c->out) {
-			while (*p++ != '\n') {
-				if (--ccount < 0)
-					break;
-			}
-			if (Vflag)
-				goto nomatch;
-	succeed:	if (cv->format == FORMAT_PATH) {
-				convert_put_path(cv, NULL, file);
-				count++;
-				goto finish;
-			} else {
-				STATIC_STRBUF(sb);
+	for (p = buf; p < end; ) {
+		const char *match = search_words(p, end);
+		const char *limit = match ? match : end;
+		const char *q;
 
-				strbuf_clear(sb);
-				strbuf_nputs(sb, linep, p - linep);
-				strbuf_unputc(sb, '\n');
-				strbuf_unputc(sb, '\r');
-				convert_put_using(cv, pattern, file, lineno, strbuf_value(sb), NULL);
+		/*
+		 * Lines before the matched line don't match.
+		 */
+		while ((q = memchr(p, '\n', limit - p)) != NULL) {
+			if (Vflag) {
 				count++;
+				if (put_line(put, arg, file, lineno, p, q + 1))
+					goto finish;
 			}
-	nomatch:	lineno++;
-			linep = p;
-			c = w;
-			continue;
+			lineno++;
+			p = q + 1;
 		}
-		if (*p++ == '\n' || ccount == 0) {
-			if (Vflag)
-				goto succeed;
-			else {
-				lineno++;
-				linep = p;
-				c = w;
+		if (match == NULL) {
+			if (Vflag && p < end) {
+				count++;
+				put_line(put, arg, file, lineno, p, end);
 			}
+			break;
+		}
+		q = memchr(match, '\n', end - match);
+		q = q ? q + 1 : end;
+		if (!Vflag) {
+			count++;
+			if (put_line(put, arg, file, lineno, p, q))
+				goto finish;
 		}
+		lineno++;
+		p = q;
 	}
 finish:
 #ifdef HAVE_MMAP
@@ -237,112 +376,3 @@ skip_empty_file:
 	close(f);
 	return count;
 }
-/**
- * make automaton.
- */
-void
-cgotofn(const char *pattern) {
-	int c;
-	struct words *s;
-
-	s = smax = w;
-nword:	for(;;) {
-		c = *pattern++;
-		if (c==0)
-			return;
-		if (c == '\n') {
-			s->out = 1;
-			s = w;
-		} else {
-		loop:	if (s->inp == c) {
-				s = s->nst;
-				continue;
-			}
-			if (s->inp == 0) goto enter;
-			if (s->link == 0) {
-				if (smax >= &w[MAXSIZ - 1])
-					overflo();
-				s->link = ++smax;
-				s = smax;
-				goto enter;
-			}
-			s = s->link;
-			goto loop;
-		}
-	}
-	enter:
-	do {
-		s->inp = c;
-		if (smax >= &w[MAXSIZ - 1])
-			overflo();
-		s->nst = ++smax;
-		s = smax;
-	} while ((c = *pattern++) != '\n' && c!=0);
-	smax->out = 1;
-	s = w;
-	if (c != 0)
-		goto nword;
-}
-
-void
-cfail(void) {
-	struct words *queue[QSIZE];
-	struct words **front, **rear;
-	struct words *state;
-	int bstart;
-	char c;
-	struct words *s;
-
-	s = w;
-	front = rear = queue;
-init:	if ((s->inp) != 0) {
-		*rear++ = s->nst;
-		if (rear >= &queue[QSIZE - 1])
-			overflo();
-	}
-	if ((s = s->link) != 0) {
-		goto init;
-	}
-
-	while (rear != front) {
-		s = *front;
-		if (front == &queue[QSIZE-1])
-			front = queue;
-		else front++;
-	cloop:	if ((c = s->inp) != 0) {
-			bstart = 0;
-			*rear = (q = s->nst);
-			if (front < rear)
-				if (rear >= &queue[QSIZE-1])
-					if (front == queue) overflo();
-					else rear = queue;
-				else rear++;
-			else
-				if (++rear == front) overflo();
-			state = s->fail;
-		floop:	if (state == 0) {
-				state = w;
-				bstart = 1;
-			}
-			if (state->inp == c) {
-			qloop:	q->fail = state->nst;
-				if ((state->nst)->out == 1)
-					q->out = 1;
-				if ((q = q->link) != 0)
-					goto qloop;
-			}
-			else if ((state = state->link) != 0)
-				goto floop;
-			else if (bstart == 0){
-				state = 0;
-				goto floop;
-			}
-		}
-		if ((s = s->link) != 0)
-			goto cloop;
-	}
-}
-void
-overflo(void) {
-	die("wordlist too large.");
-}
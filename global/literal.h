@@ -19,10 +19,19 @@
 #ifndef _LITERAL_H_
 #define _LITERAL_H_
 
-#include "convert.h"
+/**
+ * Callback for each matched line.
+ *
+ *	@param[in]	arg	argument given to the search function
+ *	@param[in]	path	path name
+ *	@param[in]	lineno	line number
+ *	@param[in]	line	line image without the newline
+ *	@return		1: no more line is needed for the file, 0: continue
+ */
+typedef int (*GREP_CALLBACK)(void *, const char *, int, const char *);
 
 void literal_comple(const char *);
-int literal_search(CONVERT *, const char *);
+int literal_search(const char *, GREP_CALLBACK, void *);
 
 #endif /* ! _LITERAL_H_ */
 
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2018 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdio.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+#include "global.h"
+#include "parallel.h"
+
+/*
+ * Parallel file scanning (global -g --jobs).
+ *
+ * The parent process (global) reads the file list, skips files using the
+ * full-text index and writes the output, as it does in serial mode. Only
+ * reading and matching of files is delegated to the worker pool
+ * (workpool.c), each worker of which runs the search function and sends
+ * the matched lines back.
+ *
+ *	Parent(global)				Worker(global)
+ *	---------------------------------------------------
+ *	request	=====> '<path>' =====> grep_job()
+ *	result  <===== matched lines <== put_line()
+ *
+ * Since the results are given in the order of the requests, the output is
+ * identical to that of serial mode, including the order given by the -N
+ * option.
+ */
+
+/**
+ * Type of the record which carries a matched line.
+ */
+#define MATCHED_LINE	1
+
+static GREP_FUNCTION search_function;
+static int first_only;
+static PARALLEL_CALLBACK put_callback;
+static void *callback_arg;
+
+/**
+ * put_line: callback function for the search function in a worker.
+ */
+static int
+put_line(void *arg, const char *path, int lineno, const char *line)
+{
+	workpool_send(MATCHED_LINE, lineno, line, strlen(line));
+	return first_only;
+}
+/**
+ * grep_job: job procedure of the worker pool.
+ */
+static void
+grep_job(void *arg, const char *path)
+{
+	if (path != NULL)
+		(*search_function)(path, put_line, NULL);
+}
+/**
+ * grep_result: result procedure of the worker pool.
+ */
+static void
+grep_result(void *arg, const char *path, const char *fid, int type, int lineno, const char *line, int len)
+{
+	if (type == MATCHED_LINE)
+		(*put_callback)(callback_arg, path, fid, lineno, line);
+}
+/**
+ * parallel_open: start worker processes.
+ *
+ *	@param[in]	jobs	number of worker processes
+ *	@param[in]	first	1: only the first matched line of each file is needed
+ *	@param[in]	search	search function
+ *	@param[in]	put	callback for each matched line
+ *	@param[in]	arg	argument for the callback
+ *	@return		1: started, 0: not supported
+ *
+ * The callback is invoked in the parent process, in the order in which
+ * files were given to parallel_grep().
+ */
+int
+parallel_open(int jobs, int first, GREP_FUNCTION search, PARALLEL_CALLBACK put, void *arg)
+{
+	search_function = search;
+	first_only = first;
+	put_callback = put;
+	callback_arg = arg;
+	return workpool_open("search", jobs, grep_job, grep_result, NULL);
+}
+/**
+ * parallel_grep: request searching of a file.
+ *
+ *	@param[in]	path	path name
+ *	@param[in]	fid	file id, NULL: unknown
+ *
+ * The callback of earlier files may be invoked in this function.
+ */
+void
+parallel_grep(const char *path, const char *fid)
+{
+	workpool_request(path, fid);
+}
+/**
+ * parallel_close: wait for all jobs and terminate worker processes.
+ */
+void
+parallel_close(void)
+{
+	workpool_close();
+}
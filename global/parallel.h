@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2018 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include "literal.h"
+
+/**
+ * Function which searches a file, like literal_search().
+ *
+ *	@param[in]	path	path name
+ *	@param[in]	put	callback for each matched line
+ *	@param[in]	arg	argument for the callback
+ *	@return		number of matched lines, -1: error
+ */
+typedef int (*GREP_FUNCTION)(const char *, GREP_CALLBACK, void *);
+
+/**
+ * Callback for each matched line delivered to the parent process.
+ *
+ *	@param[in]	arg	argument given to parallel_open()
+ *	@param[in]	path	path name
+ *	@param[in]	fid	file id given to parallel_grep()
+ *	@param[in]	lineno	line number
+ *	@param[in]	line	line image without the newline
+ */
+typedef void (*PARALLEL_CALLBACK)(void *, const char *, const char *, int, const char *);
+
+int parallel_open(int, int, GREP_FUNCTION, PARALLEL_CALLBACK, void *);
+void parallel_grep(const char *, const char *);
+void parallel_close(void);
+
+#endif /* ! _PARALLEL_H_ */
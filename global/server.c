@@ -0,0 +1,623 @@
+/*
+ * Copyright (c) 2018 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if defined(HAVE_SYS_SOCKET_H) && defined(HAVE_SYS_UN_H)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <signal.h>
+/*
+ * The server is available only where the credentials of the peer can be
+ * checked (see peer_is_owner()).
+ */
+#if defined(HAVE_GETPEEREID) || defined(SO_PEERCRED)
+#define USE_SERVER 1
+#endif
+#endif
+
+#include "global.h"
+#include "libpath.h"
+#include "server.h"
+
+/*
+
+Query server.
+
+	$ global --server=/tmp/global.sock &
+	$ global --client=/tmp/global.sock -x main
+	or
+	$ GTAGSSERVER=/tmp/global.sock; export GTAGSSERVER
+	$ global -x main
+
+The server keeps the tag files of its project open (see dbop_keep()), and
+forks a child for each request. The child changes directory to that of
+the client and runs as an usual global command with the arguments of the
+client. So any command and any output format are available, and the
+result is the same as that of global without the server.
+Each connection is processed by its own process, so the server accepts
+another request while a request is being processed. A client which does
+not send the whole request in SERVER_TIMEOUT seconds is disconnected.
+Since the request is processed with the privilege of the server, the socket
+is made accessible only by the owner of the server, and connections from
+other users are refused.
+
+Protocol (over a unix domain socket):
+
+A message is a sequence of frames. A frame is
+
+	<type> <length>\n<data>
+
+where <type> is a character and <length> is the length of <data> in decimal.
+
+	client -> server
+		'C'	current directory (required)
+		'A'	argument (repeated, the first is the command name)
+		'E'	environment variable 'NAME=value' (repeated)
+		'R'	end of the request (length 0)
+	server -> client
+		'O'	a part of the standard output
+		'E'	a part of the standard error output
+		'X'	exit status in decimal (the last frame)
+
+For example, 'global -x main' in /prj/src is requested as follows.
+
+	C 8\n/prj/srcA 6\nglobalA 2\n-xA 4\nmainR 0\n
+
+The standard input of the command is /dev/null, and the standard output
+is not a terminal. The command runs with exactly the environment variables
+given by the client; those of the server are not inherited, so that
+GTAGSROOT, GTAGSDBPATH, GTAGSLIBPATH, etc. of the server never affect it.
+*/
+#define MAXFRAME	(MAXBUFLEN * 16)
+#define SERVER_TIMEOUT	10
+
+/**
+ * server_option: get the argument of a server option.
+ *
+ *	@param[in]	argc	main()'s argc integer
+ *	@param[in]	argv	main()'s argv string array
+ *	@param[in]	name	option name (ex. "--server")
+ *	@return		argument of the option or NULL
+ *
+ * Both '--name=value' and '--name value' are accepted.
+ */
+const char *
+server_option(int argc, char *const *argv, const char *name)
+{
+	int i, len = strlen(name);
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--"))
+			break;
+		if (strncmp(argv[i], name, len))
+			continue;
+		if (argv[i][len] == '=')
+			return argv[i] + len + 1;
+		if (argv[i][len] == '\0')
+			return (i + 1 < argc) ? argv[i + 1] : NULL;
+	}
+	return NULL;
+}
+#ifdef USE_SERVER
+/**
+ * write_all: write all data.
+ *
+ *	@return		0: succeeded, -1: failed
+ */
+static int
+write_all(int fd, const char *p, int size)
+{
+	int n;
+
+	while (size > 0) {
+		if ((n = write(fd, p, size)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += n;
+		size -= n;
+	}
+	return 0;
+}
+/**
+ * put_frame: write a frame.
+ *
+ *	@param[in]	fd	descripter
+ *	@param[in]	type	frame type
+ *	@param[in]	data	data
+ *	@param[in]	size	size of data
+ *	@return		0: succeeded, -1: failed
+ */
+static int
+put_frame(int fd, int type, const char *data, int size)
+{
+	char header[32];
+
+	snprintf(header, sizeof(header), "%c %d\n", type, size);
+	if (write_all(fd, header, strlen(header)) < 0 || write_all(fd, data, size) < 0)
+		return -1;
+	return 0;
+}
+/**
+ * get_frame: read a frame.
+ *
+ *	@param[in]	ip	input stream
+ *	@param[out]	sb	data
+ *	@return		frame type, EOF: end of stream or invalid frame
+ */
+static int
+get_frame(FILE *ip, STRBUF *sb)
+{
+	int type, size = 0, c;
+
+	strbuf_reset(sb);
+	if ((type = getc(ip)) == EOF || getc(ip) != ' ')
+		return EOF;
+	while ((c = getc(ip)) != '\n') {
+		if (c < '0' || c > '9' || size > MAXFRAME)
+			return EOF;
+		size = size * 10 + c - '0';
+	}
+	while (size-- > 0) {
+		if ((c = getc(ip)) == EOF)
+			return EOF;
+		strbuf_putc(sb, c);
+	}
+	return type;
+}
+/**
+ * make_address: make the address of the socket.
+ *
+ *	@return		0: succeeded, -1: path too long
+ */
+static int
+make_address(struct sockaddr_un *addr, const char *path)
+{
+	if (strlen(path) >= sizeof(addr->sun_path))
+		return -1;
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	strlimcpy(addr->sun_path, path, sizeof(addr->sun_path));
+	return 0;
+}
+/**
+ * peer_is_owner: whether the peer of a connection is the owner of the server.
+ *
+ *	@param[in]	conn	connection
+ *	@return		1: owner, 0: another user
+ */
+static int
+peer_is_owner(int conn)
+{
+#if defined(HAVE_GETPEEREID)
+	uid_t uid;
+	gid_t gid;
+
+	if (getpeereid(conn, &uid, &gid) < 0)
+		return 0;
+	return uid == geteuid();
+#elif defined(SO_PEERCRED)
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+
+	if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0)
+		return 0;
+	return cred.uid == geteuid();
+#endif
+}
+/*
+ * Tag files kept open by the server.
+ */
+static char server_dbpath[MAXPATHLEN];
+
+/**
+ * keep_tagset: keep the tag files of a directory.
+ *
+ *	@param[in]	dbpath	directory of the tag files
+ *	@param[in]	count	number of the tag files (GPATH, GTAGS[, GRTAGS])
+ *
+ * Since the children cannot open the kept files again, the files are kept
+ * again until they are of the same generation (see gpath_sync()).
+ */
+static void
+keep_tagset(const char *dbpath, int count)
+{
+	static const int dbs[] = {GPATH, GTAGS, GRTAGS};
+	char path[MAXPATHLEN];
+	DBOP *dbop;
+	int i, retry, generation, first;
+
+	for (retry = 0; gpath_sync_wait(retry); retry++) {
+		first = -1;
+		for (i = 0; i < count; i++) {
+			strlimcpy(path, makepath(dbpath, dbname(dbs[i]), NULL), sizeof(path));
+			if (dbop_keep(path) < 0 || (dbop = dbop_open(path, 0, 0, 0)) == NULL)
+				continue;
+			generation = dbop_getgeneration(dbop);
+			dbop_close(dbop);
+			if (first < 0)
+				first = generation;
+			else if (generation != first)
+				break;
+		}
+		if (i == count)
+			break;
+	}
+}
+static void
+keep_tagfiles(void)
+{
+	LIBPATH *lp;
+	struct libtree *trees;
+	int i;
+
+	if (server_dbpath[0] == '\0')
+		return;
+	keep_tagset(server_dbpath, 3);
+	/*
+	 * Library trees are searched only with GTAGS and GPATH.
+	 */
+	lp = libpath_open(server_dbpath, GTAGS);
+	trees = varray_assign(lp->trees, 0, 0);
+	for (i = 0; i < lp->trees->length; i++)
+		keep_tagset(trees[i].dbpath, 2);
+	libpath_close(lp);
+}
+/**
+ * relay: send the output of the child to the client.
+ *
+ *	@param[in]	conn	connection to the client
+ *	@param[in]	out	standard output of the child
+ *	@param[in]	err	standard error output of the child
+ *
+ * If the client is gone, the output is thrown away.
+ */
+static void
+relay(int conn, int out, int err)
+{
+	struct pollfd fds[2];
+	char buf[MAXBUFLEN];
+	int i, n, opened = 2, alive = 1;
+
+	fds[0].fd = out;
+	fds[1].fd = err;
+	fds[0].events = fds[1].events = POLLIN;
+	while (opened > 0) {
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			die("poll failed.");
+		}
+		for (i = 0; i < 2; i++) {
+			if (fds[i].fd < 0 || fds[i].revents == 0)
+				continue;
+			if ((n = read(fds[i].fd, buf, sizeof(buf))) < 0 && errno == EINTR)
+				continue;
+			if (n <= 0) {
+				close(fds[i].fd);
+				fds[i].fd = -1;
+				opened--;
+			} else if (alive && put_frame(conn, i == 0 ? 'O' : 'E', buf, n) < 0)
+				alive = 0;
+		}
+	}
+}
+/**
+ * reap: reap the finished processes for the connections.
+ */
+static void
+reap(int signo)
+{
+	int save = errno;
+
+	while (waitpid(-1, NULL, WNOHANG) > 0)
+		;
+	errno = save;
+}
+/**
+ * get_request: read a request.
+ *
+ *	@param[in]	conn	connection to the client
+ *	@param[out]	cwd	current directory of the client
+ *	@param[out]	args	arguments (terminated by NULL)
+ *	@param[out]	envs	environment variables (terminated by NULL)
+ *	@return		0: succeeded, -1: invalid request or timeout
+ */
+static int
+get_request(int conn, STRBUF *cwd, VARRAY *args, VARRAY *envs)
+{
+	struct timeval timeout;
+	STRBUF *sb = strbuf_open(0);
+	FILE *ip;
+	int type;
+
+	/*
+	 * A stalled client should not keep the process forever.
+	 */
+	timeout.tv_sec = SERVER_TIMEOUT;
+	timeout.tv_usec = 0;
+	(void)setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	if ((ip = fdopen(dup(conn), "r")) == NULL)
+		die("fdopen failed.");
+	while ((type = get_frame(ip, sb)) != EOF && type != 'R') {
+		switch (type) {
+		case 'C':
+			strbuf_reset(cwd);
+			strbuf_puts(cwd, strbuf_value(sb));
+			break;
+		case 'A':
+			*(char **)varray_append(args) = check_strdup(strbuf_value(sb));
+			break;
+		case 'E':
+			if (strchr(strbuf_value(sb), '=') != NULL)
+				*(char **)varray_append(envs) = check_strdup(strbuf_value(sb));
+			break;
+		default:
+			break;
+		}
+	}
+	fclose(ip);
+	strbuf_close(sb);
+	if (type != 'R' || strbuf_getlen(cwd) == 0 || args->length == 0)
+		return -1;
+	*(char **)varray_append(args) = NULL;
+	*(char **)varray_append(envs) = NULL;
+	return 0;
+}
+#endif /* USE_SERVER */
+/**
+ * global_server: run as a query server.
+ *
+ *	@param[in]	path	path of the unix domain socket
+ *	@param[out]	argcp	argc of the request
+ *	@param[out]	argvp	argv of the request
+ *
+ * This function returns only in a child process which should process
+ * the request as a global command.
+ */
+void
+global_server(const char *path, int *argcp, char ***argvp)
+{
+#ifdef USE_SERVER
+	extern char **environ;
+	struct sockaddr_un addr;
+	struct stat st;
+	STRBUF *cwd = strbuf_open(0);
+	VARRAY *args = varray_open(sizeof(char *), 32);
+	VARRAY *envs = varray_open(sizeof(char *), 32);
+	char status_string[32];
+	int out[2], err[2];
+	mode_t mask;
+	int sock, conn, error, status;
+	pid_t pid;
+
+	if (make_address(&addr, path) < 0)
+		die("socket path too long '%s'.", path);
+	if (lstat(path, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode))
+			die("'%s' already exists.", path);
+		(void)unlink(path);
+	}
+	if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		die("cannot make a socket.");
+	/*
+	 * Only the owner can connect to the socket.
+	 */
+	mask = umask(077);
+	error = bind(sock, (struct sockaddr *)&addr, sizeof(addr));
+	(void)umask(mask);
+	if (error < 0)
+		die("cannot bind '%s'.", path);
+	if (listen(sock, 16) < 0)
+		die("cannot listen '%s'.", path);
+	/*
+	 * The tag files of the project of the current directory are kept open.
+	 */
+	if (setupdbpath(0) == 0)
+		strlimcpy(server_dbpath, get_dbpath(), sizeof(server_dbpath));
+	keep_tagfiles();
+	/*
+	 * The client may be gone before receiving the result.
+	 */
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGCHLD, reap);
+	/*
+	 * Each connection is processed by its own process, so that a slow
+	 * request or a stalled client does not block the others.
+	 */
+	for (;;) {
+		if ((conn = accept(sock, NULL, NULL)) < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			die("accept failed.");
+		}
+		if (!peer_is_owner(conn)) {
+			warning("connection from another user refused.");
+			close(conn);
+			continue;
+		}
+		keep_tagfiles();
+		fflush(stdout);
+		fflush(stderr);
+		if ((pid = fork()) < 0) {
+			warning("cannot fork.");
+			close(conn);
+			continue;
+		}
+		if (pid == 0)
+			break;
+		close(conn);
+	}
+	/*
+	 * The process for the connection.
+	 */
+	signal(SIGCHLD, SIG_DFL);
+	close(sock);
+	if (get_request(conn, cwd, args, envs) < 0) {
+		warning("invalid request.");
+		exit(1);
+	}
+	if (pipe(out) < 0 || pipe(err) < 0)
+		die("cannot make pipes.");
+	if ((pid = fork()) < 0)
+		die("cannot fork.");
+	if (pid == 0) {
+		int null;
+
+		/*
+		 * Become a global command of the client.
+		 */
+		signal(SIGPIPE, SIG_DFL);
+		close(conn);
+		if ((null = open("/dev/null", O_RDONLY)) < 0
+		    || dup2(null, 0) < 0 || dup2(out[1], 1) < 0 || dup2(err[1], 2) < 0)
+			_exit(1);
+		close(null);
+		close(out[0]);
+		close(out[1]);
+		close(err[0]);
+		close(err[1]);
+		/*
+		 * Replace the environment with that of the client.
+		 */
+		environ = varray_assign(envs, 0, 0);
+		if (chdir(strbuf_value(cwd)) < 0)
+			die("cannot change directory to '%s'.", strbuf_value(cwd));
+		*argcp = args->length - 1;
+		*argvp = varray_assign(args, 0, 0);
+		return;
+	}
+	close(out[1]);
+	close(err[1]);
+	relay(conn, out[0], err[0]);
+	while (waitpid(pid, &status, 0) < 0)
+		if (errno != EINTR)
+			die("waitpid failed.");
+	status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+	snprintf(status_string, sizeof(status_string), "%d", status);
+	(void)put_frame(conn, 'X', status_string, strlen(status_string));
+	close(conn);
+	exit(0);
+#else
+	die("query server is not supported on this platform.");
+#endif
+}
+/**
+ * global_client: ask the query server to process this command.
+ *
+ *	@param[in]	path	path of the unix domain socket
+ *	@param[in]	argc	main()'s argc integer
+ *	@param[in]	argv	main()'s argv string array
+ *
+ * If the server processed the command, this function exits with its
+ * exit status. Otherwise, it returns and the command should be processed
+ * by itself.
+ */
+void
+global_client(const char *path, int argc, char *const *argv)
+{
+#ifdef USE_SERVER
+	extern char **environ;
+	struct sockaddr_un addr;
+	char cwd[MAXPATHLEN];
+	STRBUF *sb;
+	FILE *ip;
+	char **e;
+	int sock, type, i;
+
+	/*
+	 * Commands which read the standard input or write to the terminal
+	 * are processed by itself.
+	 */
+	for (i = 1; i < argc; i++)
+		if (!strcmp(argv[i], "-") || locatestring(argv[i], "=-", MATCH_AT_LAST)
+		    || !strncmp(argv[i], "--path-convert", 14)
+		    || (!strncmp(argv[i], "--color", 7) && isatty(1)))
+			return;
+	if (!vgetcwd(cwd, sizeof(cwd)) || make_address(&addr, path) < 0)
+		return;
+	if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		return;
+	if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(sock);
+		return;
+	}
+	if (put_frame(sock, 'C', cwd, strlen(cwd)) < 0)
+		goto error;
+	/*
+	 * The command name is sent too, so that the messages are the same
+	 * as those of this command.
+	 */
+	for (i = 0; i < argc; i++)
+		if (put_frame(sock, 'A', argv[i], strlen(argv[i])) < 0)
+			goto error;
+	for (e = environ; *e; e++)
+		if (put_frame(sock, 'E', *e, strlen(*e)) < 0)
+			goto error;
+	if (put_frame(sock, 'R', "", 0) < 0)
+		goto error;
+	/*
+	 * After the request was sent, the command cannot be processed by
+	 * itself, because it might have been processed partially.
+	 */
+	if ((ip = fdopen(sock, "r")) == NULL)
+		die("fdopen failed.");
+	sb = strbuf_open(0);
+	while ((type = get_frame(ip, sb)) != EOF) {
+		switch (type) {
+		case 'O':
+			fwrite(strbuf_value(sb), 1, strbuf_getlen(sb), stdout);
+			break;
+		case 'E':
+			fflush(stdout);
+			fwrite(strbuf_value(sb), 1, strbuf_getlen(sb), stderr);
+			break;
+		case 'X':
+			fflush(stdout);
+			exit(atoi(strbuf_value(sb)));
+		default:
+			break;
+		}
+	}
+	die("lost connection to the server '%s'.", path);
+error:
+	close(sock);
+#endif
+}
@@ -54,6 +54,7 @@
 
 #include "global.h"
 #include "parser.h"
+#include "parallel.h"
 #include "const.h"
 
 /*
@@ -72,6 +73,7 @@ static void help(void);
 int printconf(const char *);
 int main(int, char **);
 int incremental(const char *, const char *);
+int snapshot_update(const char *, const char *);
 void updatetags(const char *, const char *, IDSET *, STRBUF *);
 void createtags(const char *, const char *);
 
@@ -97,9 +99,16 @@ const char *dump_target;
 char *single_update;
 int statistics = STATISTICS_STYLE_NONE;
 int explain;
+int jobs = 1;					/**< number of parser processes */
 #ifdef USE_SQLITE3
 int use_sqlite3;
 #endif
+int binary_lineno;
+int dedup_key;
+int grep_index;
+int icase_index;
+int trigram_index;
+int snapshot;					/**< update a copy and replace */
 
 #define GTAGSFILES "gtags.files"
 
@@ -179,15 +188,22 @@ static struct option const long_options[] = {
 #define OPT_ACCEPT_DOTFILES	133
 #define OPT_SKIP_UNREADABLE	134
 #define OPT_GTAGSSKIP_SYMLINK	135
+#define OPT_JOBS		136
 	/* flag value */
 	{"accept-dotfiles", no_argument, NULL, OPT_ACCEPT_DOTFILES},
+	{"binary-lineno", no_argument, &binary_lineno, 1},
 	{"debug", no_argument, &debug, 1},
+	{"dedup-key", no_argument, &dedup_key, 1},
 	{"explain", no_argument, &explain, 1},
+	{"grep-index", no_argument, &grep_index, 1},
+	{"icase-index", no_argument, &icase_index, 1},
 #ifdef USE_SQLITE3
 	{"sqlite3", no_argument, &use_sqlite3, 1},
 #endif
 	{"skip-unreadable", no_argument, NULL, OPT_SKIP_UNREADABLE},
+	{"snapshot", no_argument, &snapshot, 1},
 	{"statistics", no_argument, &statistics, STATISTICS_STYLE_TABLE},
+	{"trigram-index", no_argument, &trigram_index, 1},
 	{"version", no_argument, &show_version, 1},
 	{"help", no_argument, &show_help, 1},
 
@@ -195,6 +211,7 @@ static struct option const long_options[] = {
 	{"config", optional_argument, NULL, OPT_CONFIG},
 	{"gtagsconf", required_argument, NULL, OPT_GTAGSCONF},
 	{"gtagslabel", required_argument, NULL, OPT_GTAGSLABEL},
+	{"jobs", required_argument, NULL, OPT_JOBS},
 	{"skip-symlink", optional_argument, NULL, OPT_GTAGSSKIP_SYMLINK},
 	{"path", required_argument, NULL, OPT_PATH},
 	{"single-update", required_argument, NULL, OPT_SINGLE_UPDATE},
@@ -288,6 +305,11 @@ main(int argc, char **argv)
 		case OPT_SKIP_UNREADABLE:
 			skip_unreadable = 1;
 			break;
+		case OPT_JOBS:
+			jobs = atoi(optarg);
+			if (jobs < 1)
+				die("--jobs: invalid number '%s'.", optarg);
+			break;
 		case OPT_GTAGSSKIP_SYMLINK:
 			skip_symlink = SKIP_SYMLINK_FOR_ALL;
 			if (optarg) {
@@ -341,6 +363,8 @@ main(int argc, char **argv)
 	}
 	if (skip_symlink)
 		set_skip_symlink(skip_symlink);
+	if (jobs > 1)
+		set_find_jobs(jobs);
 	if (qflag) {
 		vflag = 0;
 		setquiet();
@@ -385,7 +409,8 @@ main(int argc, char **argv)
 		if (dbop_get(dbop, NEXTKEY))
 			is_gpath = 1;
 		for (dat = dbop_first(dbop, NULL, NULL, 0); dat != NULL; dat = dbop_next(dbop)) {
-			const char *flag = is_gpath ? dbop_getflag(dbop) : "";
+			/* the Bloom filter has binary data after the header */
+			const char *flag = is_gpath && strcmp(dbop->lastkey, BLOOMKEY) ? dbop_getflag(dbop) : "";
 
 			if (*flag)
 				printf("%s\t%s\t%s\n", dbop->lastkey, dat, flag);
@@ -540,6 +565,13 @@ main(int argc, char **argv)
 		 * gtagsopen() abort with error message.
 		 */
 		GTOP *gtop = gtags_open(dbpath, cwd, GTAGS, GTAGS_MODIFY, 0);
+		/*
+		 * The layout of the tag files is decided when they are made.
+		 */
+		if (binary_lineno && gtop->format_version < 7)
+			warning("--binary-lineno ignored since the tag files are not of format version 7. Please remake them.");
+		if (dedup_key && !(gtop->format & GTAGS_DUPKEY))
+			warning("--dedup-key ignored since the tag files were made without it. Please remake them.");
 		gtags_close(gtop);
 		/*
 		 * GPATH is needed for incremental updating.
@@ -548,7 +580,10 @@ main(int argc, char **argv)
 		 */
 		if (!test("f", makepath(dbpath, dbname(GPATH), NULL)))
 			die("Old version tag file found. Please remake it.");
-		(void)incremental(dbpath, cwd);
+		if (snapshot)
+			(void)snapshot_update(dbpath, cwd);
+		else
+			(void)incremental(dbpath, cwd);
 		print_statistics(statistics);
 		exit(0);
 	}
@@ -731,10 +766,21 @@ incremental(const char *dbpath, const char *root)
 				if (fid == NULL) {
 					strbuf_puts0(addlist, path);
 					total++;
-				} else if (gtags_mtime < statp.st_mtime) {
-					strbuf_puts0(addlist, path);
-					total++;
-					idset_add(deleteset, n_fid);
+				} else {
+					/*
+					 * If GPATH has the stat record of the file, the file
+					 * is updated only when its contents were changed.
+					 * Otherwise, the time stamp is compared with GTAGS.
+					 */
+					int changed = gpath_checkstat(path, fid, &statp);
+
+					if (changed < 0)
+						changed = (gtags_mtime < statp.st_mtime);
+					if (changed) {
+						strbuf_puts0(addlist, path);
+						total++;
+						idset_add(deleteset, n_fid);
+					}
 				}
 			}
 		}
@@ -829,6 +875,95 @@ exit:
 
 	return updated;
 }
+/*
+ * Snapshot updating (--snapshot)
+ *
+ * The tag files are copied into a working directory in dbpath, and
+ * incremental() updates the copies. They are given a new generation number
+ * (dbop_putgeneration()), and replace the tag files by rename(2), GPATH
+ * last. Processes which have opened the tag files keep reading the old ones,
+ * and gpath_sync() makes the others open the files of one generation.
+ */
+static char snapshot_dir[MAXPATHLEN];
+/**
+ * snapshot_cleanup: remove the working directory.
+ */
+static void
+snapshot_cleanup(void)
+{
+	int db;
+
+	if (snapshot_dir[0] == '\0')
+		return;
+	for (db = GPATH; db < GTAGLIM; db++)
+		(void)unlink(makepath(snapshot_dir, dbname(db), NULL));
+	(void)rmdir(snapshot_dir);
+	snapshot_dir[0] = '\0';
+}
+/**
+ * snapshot_update: incremental update without disturbing readers
+ *
+ *	@param[in]	dbpath	dbpath directory
+ *	@param[in]	root	root directory of source tree
+ *	@return		0: not updated, 1: updated
+ */
+int
+snapshot_update(const char *dbpath, const char *root)
+{
+	/* in the order of replacement */
+	static const int dbs[] = {GTAGS, GRTAGS, GPATH};
+	char src[MAXPATHLEN], dist[MAXPATHLEN];
+	struct stat st;
+	struct utimbuf times;
+	DBOP *dbop;
+	int i, generation, updated;
+
+	snprintf(snapshot_dir, sizeof(snapshot_dir), "%s/.gtags-snapshot.%d", dbpath, (int)getpid());
+	if (mkdir(snapshot_dir, 0700) < 0)
+		die("cannot make directory '%s'.", snapshot_dir);
+	atexit(snapshot_cleanup);
+	for (i = 0; i < 3; i++) {
+		strlimcpy(src, makepath(dbpath, dbname(dbs[i]), NULL), sizeof(src));
+		strlimcpy(dist, makepath(snapshot_dir, dbname(dbs[i]), NULL), sizeof(dist));
+		if (stat(src, &st) < 0)
+			die("stat failed '%s'.", src);
+		copyfile(src, dist);
+		/*
+		 * incremental() compares the modification time of GTAGS
+		 * with those of source files.
+		 */
+		times.actime = st.st_atime;
+		times.modtime = st.st_mtime;
+		if (chmod(dist, st.st_mode & 07777) < 0 || utime(dist, &times) < 0)
+			die("cannot copy '%s'.", src);
+	}
+	updated = incremental(snapshot_dir, root);
+	if (updated) {
+		dbop = dbop_open(makepath(snapshot_dir, dbname(GPATH), NULL), 0, 0, 0);
+		if (dbop == NULL)
+			die("GPATH not found.");
+		generation = dbop_getgeneration(dbop) + 1;
+		dbop_close(dbop);
+		for (i = 0; i < 3; i++) {
+			dbop = dbop_open(makepath(snapshot_dir, dbname(dbs[i]), NULL), 2, 0, 0);
+			if (dbop == NULL)
+				die("%s not found.", dbname(dbs[i]));
+			dbop_putgeneration(dbop, generation);
+			dbop_close(dbop);
+		}
+		for (i = 0; i < 3; i++) {
+			strlimcpy(src, makepath(snapshot_dir, dbname(dbs[i]), NULL), sizeof(src));
+			strlimcpy(dist, makepath(dbpath, dbname(dbs[i]), NULL), sizeof(dist));
+#if _WIN32 || __DJGPP__
+			(void)unlink(dist);	/* rename(2) cannot replace a file */
+#endif
+			if (rename(src, dist) < 0)
+				die("cannot replace '%s'.", dist);
+		}
+	}
+	snapshot_cleanup();
+	return updated;
+}
 /**
  * static void put_syms(int type, const char *tag, int lno, const char *path, const char *line_image, void *arg)
  *
@@ -881,6 +1016,42 @@ put_syms(int type, const char *tag, int lno, const char *path, const char *line_
 	}
 	gtags_put_using(gtop, tag, lno, data->fid, line_image);
 }
+/**
+ * begin_file, end_file: callback functions called around the tags of a file
+ */
+static void
+begin_file(const char *path, const char *fid, void *arg)
+{
+	struct put_func_data *data = arg;
+
+	data->fid = fid;
+}
+static void
+end_file(const char *path, const char *fid, void *arg)
+{
+	const struct put_func_data *data = arg;
+
+	gtags_flush(data->gtop[GTAGS], fid);
+	if (data->gtop[GRTAGS] != NULL)
+		gtags_flush(data->gtop[GRTAGS], fid);
+}
+/**
+ * put_hash: record the hash value of the file which has just been parsed.
+ *
+ * This should be called after end_file(), since it invalidates the file id
+ * got by gpath_path2fid().
+ */
+static void
+put_hash(const char *path)
+{
+	unsigned long long hash;
+	struct stat st;
+
+	if (tokenfilestat(path, &st, &hash) == 0)
+		gpath_puthash(path, &st, &hash);
+	else
+		gpath_puthash(path, NULL, NULL);
+}
 /**
  * updatetags: update tag file.
  *
@@ -893,7 +1064,7 @@ void
 updatetags(const char *dbpath, const char *root, IDSET *deleteset, STRBUF *addlist)
 {
 	struct put_func_data data;
-	int seqno, flags;
+	int seqno, flags, parallel = 0;
 	const char *path, *start, *end;
 
 	if (vflag)
@@ -956,19 +1127,27 @@ updatetags(const char *dbpath, const char *root, IDSET *deleteset, STRBUF *addli
 	 */
 	start = strbuf_value(addlist);
 	end = start + strbuf_getlen(addlist);
+	if (jobs > 1 && total > 1)
+		parallel = parallel_open(jobs, flags, put_syms, begin_file, end_file, &data);
 	seqno = 0;
 	for (path = start; path < end; path += strlen(path) + 1) {
 		gpath_put(path, GPATH_SOURCE);
+		gpath_putstat(path);
 		data.fid = gpath_path2fid(path, NULL);
 		if (data.fid == NULL)
 			die("GPATH is corrupted.('%s' not found)", path);
 		if (vflag)
 			fprintf(stderr, " [%d/%d] extracting tags of %s\n", ++seqno, total, path + 2);
+		if (parallel) {
+			parallel_parse(path, data.fid);
+			continue;
+		}
 		parse_file(path, flags, put_syms, &data);
-		gtags_flush(data.gtop[GTAGS], data.fid);
-		if (data.gtop[GRTAGS] != NULL)
-			gtags_flush(data.gtop[GRTAGS], data.fid);
+		end_file(path, data.fid, &data);
+		put_hash(path);
 	}
+	if (parallel)
+		parallel_close();
 	parser_exit();
 	gtags_close(data.gtop[GTAGS]);
 	if (data.gtop[GRTAGS] != NULL)
@@ -986,18 +1165,39 @@ createtags(const char *dbpath, const char *root)
 	STATISTICS_TIME *tim;
 	STRBUF *sb = strbuf_open(0);
 	struct put_func_data data;
-	int openflags, flags, seqno;
+	int openflags, flags, seqno, parallel = 0;
 	const char *path;
 
 	tim = statistics_time_start("Time of creating %s and %s.", dbname(GTAGS), dbname(GRTAGS));
 	if (vflag)
 		fprintf(stderr, "[%s] Creating '%s' and '%s'.\n", now(), dbname(GTAGS), dbname(GRTAGS));
 	openflags = cflag ? GTAGS_COMPACT : 0;
+	if (binary_lineno)
+		openflags |= GTAGS_BINLINE;
+	if (dedup_key)
+		openflags |= GTAGS_DUPKEY;
+	if (icase_index)
+		openflags |= GTAGS_FOLDINDEX;
+	if (trigram_index)
+		openflags |= GTAGS_TRIGRAM;
 #ifdef USE_SQLITE3
-	if (use_sqlite3)
+	if (use_sqlite3) {
+		/*
+		 * Dbop_put_tag() trims a trailing newline of each record
+		 * for Sqlite3, which may be a byte of a binary line number.
+		 */
+		if (binary_lineno)
+			die("--binary-lineno cannot be used with --sqlite3.");
+		if (grep_index)
+			die("--grep-index cannot be used with --sqlite3.");
+		if (dedup_key)
+			die("--dedup-key cannot be used with --sqlite3.");
 		openflags |= GTAGS_SQLITE3;
+	}
 #endif
 	data.gtop[GTAGS] = gtags_open(dbpath, root, GTAGS, GTAGS_CREATE, openflags);
+	if (grep_index)
+		gpath_grepindex();
 	data.gtop[GTAGS]->flags = 0;
 	if (extractmethod)
 		data.gtop[GTAGS]->flags |= GTAGS_EXTRACTMETHOD;
@@ -1017,6 +1217,11 @@ createtags(const char *dbpath, const char *root)
 	/*
 	 * Add tags to GTAGS and GRTAGS.
 	 */
+	/*
+	 * Parser processes should be forked before find_open() starts threads.
+	 */
+	if (jobs > 1)
+		parallel = parallel_open(jobs, flags, put_syms, begin_file, end_file, &data);
 	if (file_list)
 		find_open_filelist(file_list, root, explain);
 	else
@@ -1030,17 +1235,24 @@ createtags(const char *dbpath, const char *root)
 			continue;
 		}
 		gpath_put(path, GPATH_SOURCE);
+		gpath_putstat(path);
 		data.fid = gpath_path2fid(path, NULL);
 		if (data.fid == NULL)
 			die("GPATH is corrupted.('%s' not found)", path);
 		seqno++;
 		if (vflag)
 			fprintf(stderr, " [%d] extracting tags of %s\n", seqno, path + 2);
+		if (parallel) {
+			parallel_parse(path, data.fid);
+			continue;
+		}
 		parse_file(path, flags, put_syms, &data);
-		gtags_flush(data.gtop[GTAGS], data.fid);
-		gtags_flush(data.gtop[GRTAGS], data.fid);
+		end_file(path, data.fid, &data);
+		put_hash(path);
 	}
 	total = seqno;
+	if (parallel)
+		parallel_close();
 	parser_exit();
 	find_close();
 	statistics_time_end(tim);
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2018 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+#include "global.h"
+#include "parser.h"
+#include "parallel.h"
+
+/*
+ * Parallel tag extraction (gtags --jobs).
+ *
+ * The parent process (gtags) reads the file list, assigns file ids in GPATH
+ * and writes the tag files, as it does in serial mode. Only parsing is
+ * delegated to the worker pool (workpool.c), each worker of which runs
+ * parse_file() and sends the tag records back.
+ *
+ *	Parent(gtags)				Worker(gtags)
+ *	---------------------------------------------------
+ *	request	=====> '<path>' =====> parse_job()
+ *	result  <===== tag records, file stat <== put_record()
+ *
+ * A tag record is sent with the type and the line number of the tag, and
+ * the tag name and the line image, which is omitted if it is NULL.
+ */
+
+/**
+ * Type of the record which carries the stat and the hash value of the file
+ * read by the tokenizer. See gpath_puthash().
+ */
+#define FILESTAT	-1
+
+struct filestat {
+	struct stat st;
+	unsigned long long hash;
+};
+
+static int parse_flags;
+static PARSER_CALLBACK put_callback;
+static PARALLEL_CALLBACK begin_callback;
+static PARALLEL_CALLBACK end_callback;
+static void *callback_arg;
+static int begun;			/**< begin_callback has been called */
+static int stat_given;			/**< filestat has been received */
+static struct filestat filestat;
+
+/**
+ * put_record: callback function for parse_file() in a worker.
+ */
+static void
+put_record(int type, const char *tag, int lno, const char *path, const char *line_image, void *arg)
+{
+	STRBUF *sb = (STRBUF *)arg;
+
+	strbuf_reset(sb);
+	strbuf_puts(sb, tag);
+	if (line_image) {
+		strbuf_putc(sb, '\0');
+		strbuf_puts(sb, line_image);
+	}
+	workpool_send(type, lno, strbuf_value(sb), strbuf_getlen(sb));
+}
+/**
+ * parse_job: job procedure of the worker pool.
+ */
+static void
+parse_job(void *arg, const char *path)
+{
+	static STRBUF *sb;
+	struct filestat fs;
+
+	if (path == NULL) {
+		parser_exit();
+		return;
+	}
+	if (sb == NULL)
+		sb = strbuf_open(0);
+	parse_file(path, parse_flags, put_record, sb);
+	if (tokenfilestat(path, &fs.st, &fs.hash) == 0)
+		workpool_send(FILESTAT, 0, &fs, sizeof(fs));
+}
+/**
+ * parse_result: result procedure of the worker pool.
+ */
+static void
+parse_result(void *arg, const char *path, const char *fid, int type, int lno, const char *buf, int len)
+{
+	if (!begun) {
+		(*begin_callback)(path, fid, callback_arg);
+		begun = 1;
+	}
+	if (type == 0) {
+		(*end_callback)(path, fid, callback_arg);
+		if (stat_given)
+			gpath_puthash(path, &filestat.st, &filestat.hash);
+		else
+			gpath_puthash(path, NULL, NULL);
+		begun = stat_given = 0;
+	} else if (type == FILESTAT) {
+		if (len != sizeof(filestat))
+			die("invalid record from parser process.");
+		memcpy(&filestat, buf, sizeof(filestat));
+		stat_given = 1;
+	} else {
+		const char *img = memchr(buf, '\0', len);
+
+		(*put_callback)(type, buf, lno, path, img ? img + 1 : NULL, callback_arg);
+	}
+}
+/**
+ * parallel_open: start worker processes.
+ *
+ *	@param[in]	jobs	number of worker processes
+ *	@param[in]	flags	flags for parse_file()
+ *	@param[in]	put	callback for each tag, same as parse_file()
+ *	@param[in]	begin	callback called before the tags of a file
+ *	@param[in]	end	callback called after the tags of a file
+ *	@param[in]	arg	argument for callbacks
+ *	@return		1: started, 0: not supported
+ *
+ * Callbacks are invoked in the parent process, in the order in which
+ * files were given to parallel_parse().
+ */
+int
+parallel_open(int jobs, int flags, PARSER_CALLBACK put, PARALLEL_CALLBACK begin, PARALLEL_CALLBACK end, void *arg)
+{
+	parse_flags = flags;
+	put_callback = put;
+	begin_callback = begin;
+	end_callback = end;
+	callback_arg = arg;
+	begun = stat_given = 0;
+	return workpool_open("parser", jobs, parse_job, parse_result, NULL);
+}
+/**
+ * parallel_parse: request parsing of a file.
+ *
+ *	@param[in]	path	path name
+ *	@param[in]	fid	file id
+ *
+ * The callbacks of earlier files may be invoked in this function.
+ */
+void
+parallel_parse(const char *path, const char *fid)
+{
+	workpool_request(path, fid);
+}
+/**
+ * parallel_close: wait for all jobs and terminate worker processes.
+ */
+void
+parallel_close(void)
+{
+	workpool_close();
+}
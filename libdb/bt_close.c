@@ -80,6 +80,10 @@ __bt_close(dbp, abandon)
 		t->bt_pinned = NULL;
 	}
 
+	/* Finish bulk loading, if any. */
+	if (t->bt_load != NULL && __bt_bulkclose(dbp) == RET_ERROR)
+		return (RET_ERROR);
+
 	/* Sync the tree. */
 	/*
 	 * If abandon flag is set, omit writing to the disk.
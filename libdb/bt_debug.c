@@ -80,6 +80,7 @@ __bt_dump(dbp)
 		X(R_FIXLEN,	"FIXLEN");
 		X(B_INMEM,	"INMEM");
 		X(B_NODUPS,	"NODUPS");
+		X(B_DUPKEY,	"DUPKEY");
 		X(B_RDONLY,	"RDONLY");
 		X(R_RECNO,	"RECNO");
 		X(B_METADIRTY,"METADIRTY");
@@ -121,6 +122,7 @@ __bt_dmpage(h)
 	if (m->flags) {
 		sep = " (";
 		X(B_NODUPS,	"NODUPS");
+		X(B_DUPKEY,	"DUPKEY");
 		X(R_RECNO,	"RECNO");
 		(void)fprintf(stderr, ")");
 	}
@@ -212,6 +214,8 @@ __bt_dpage(h)
 				    "big key page %lu size %u/",
 				    (long unsigned int)*(pgno_t *)bl->bytes,
 				    (unsigned int)*(u_int32_t *)(bl->bytes + sizeof(pgno_t)));
+			else if (bl->flags & P_DUPKEY)
+				(void)fprintf(stderr, "=/");
 			else if (bl->ksize)
 				(void)fprintf(stderr, "%s/", bl->bytes);
 			if (bl->flags & P_BIGDATA)
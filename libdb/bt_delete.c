@@ -41,6 +41,9 @@ static char sccsid[] = "@(#)bt_delete.c	8.13 (Berkeley) 7/28/94";
 
 #include <errno.h>
 #include <stdio.h>
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
 #ifdef HAVE_STRING_H
 #include <string.h>
 #else
@@ -55,6 +58,7 @@ static int __bt_curdel(BTREE *, const DBT *, PAGE *, u_int);
 static int __bt_pdelete(BTREE *, PAGE *);
 static int __bt_relink(BTREE *, PAGE *);
 static int __bt_stkacq(BTREE *, PAGE **, CURSOR *);
+static void bt_lremove(PAGE *, u_int);
 
 /**
  * __bt_delete
@@ -471,11 +475,9 @@ __bt_dleaf(t, key, h, index)
 	PAGE *h;
 	u_int index;
 {
-	BLEAF *bl;
-	indx_t cnt, *ip, offset;
+	BLEAF *bl, *il, *nl;
 	u_int32_t nbytes;
-	void *to;
-	char *from;
+	char *item;
 
 	/* If this record is referenced by the cursor, delete the cursor. */
 	if (F_ISSET(&t->bt_cursor, CURS_INIT) &&
@@ -484,18 +486,80 @@ __bt_dleaf(t, key, h, index)
 	    __bt_curdel(t, key, h, index))
 		return (RET_ERROR);
 
+	/*
+	 * If the next record leaves out its key (P_DUPKEY), it takes over
+	 * the key of this record, including any overflow pages.  The new
+	 * item is never larger than the two items it replaces.
+	 */
+	item = NULL;
+	bl = GETBLEAF(h, index);
+	if (!(bl->flags & P_DUPKEY) && index + 1 < NEXTINDEX(h) &&
+	    (nl = GETBLEAF(h, index + 1))->flags & P_DUPKEY) {
+		nbytes = NBLEAFDBT(bl->ksize, nl->dsize);
+		if ((item = malloc(nbytes)) == NULL)
+			return (RET_ERROR);
+		il = (BLEAF *)item;
+		il->ksize = bl->ksize;
+		il->dsize = nl->dsize;
+		il->flags = (bl->flags & P_BIGKEY) | (nl->flags & P_BIGDATA);
+		memmove(il->bytes, bl->bytes, bl->ksize);
+		memmove(il->bytes + bl->ksize, nl->bytes, nl->dsize);
+	}
+
 	/* If the entry uses overflow pages, make them available for reuse. */
-	to = bl = GETBLEAF(h, index);
-	if (bl->flags & P_BIGKEY && __ovfl_delete(t, bl->bytes) == RET_ERROR)
-		return (RET_ERROR);
+	if (bl->flags & P_BIGKEY && item == NULL &&
+	    __ovfl_delete(t, bl->bytes) == RET_ERROR)
+		goto err;
 	if (bl->flags & P_BIGDATA &&
 	    __ovfl_delete(t, bl->bytes + bl->ksize) == RET_ERROR)
-		return (RET_ERROR);
+		goto err;
+
+	bt_lremove(h, index);
+	if (item != NULL) {
+		bt_lremove(h, index);
+		memmove(h->linp + index + 1, h->linp + index,
+		    (NEXTINDEX(h) - index) * sizeof(indx_t));
+		h->lower += sizeof(indx_t);
+		h->linp[index] = h->upper -= nbytes;
+		memmove((char *)h + h->upper, item, nbytes);
+		free(item);
+	}
+
+	/* If the cursor is on this page, adjust it as necessary. */
+	if (F_ISSET(&t->bt_cursor, CURS_INIT) &&
+	    !F_ISSET(&t->bt_cursor, CURS_ACQUIRE) &&
+	    t->bt_cursor.pg.pgno == h->pgno && t->bt_cursor.pg.index > index)
+		--t->bt_cursor.pg.index;
+
+	return (RET_SUCCESS);
+err:
+	if (item != NULL)
+		free(item);
+	return (RET_ERROR);
+}
 
-	/* Pack the remaining key/data items at the end of the page. */
+/**
+ * bt_lremove --
+ *	Remove an item from a leaf page, and pack the remaining items at
+ *	the end of the page.
+ *
+ *	@param h	page
+ *	@param index	index on page to remove
+ */
+static void
+bt_lremove(h, index)
+	PAGE *h;
+	u_int index;
+{
+	BLEAF *bl;
+	indx_t cnt, *ip, offset;
+	u_int32_t nbytes;
+	char *from;
+
+	bl = GETBLEAF(h, index);
 	nbytes = NBLEAF(bl);
 	from = (char *)h + h->upper;
-	memmove(from + nbytes, from, (char *)to - from);
+	memmove(from + nbytes, from, (char *)bl - from);
 	h->upper += nbytes;
 
 	/* Adjust the indices' offsets, shift the indices down. */
@@ -506,14 +570,6 @@ __bt_dleaf(t, key, h, index)
 	for (cnt = NEXTINDEX(h) - index; --cnt; ++ip)
 		ip[0] = ip[1] < offset ? ip[1] + nbytes : ip[1];
 	h->lower -= sizeof(indx_t);
-
-	/* If the cursor is on this page, adjust it as necessary. */
-	if (F_ISSET(&t->bt_cursor, CURS_INIT) &&
-	    !F_ISSET(&t->bt_cursor, CURS_ACQUIRE) &&
-	    t->bt_cursor.pg.pgno == h->pgno && t->bt_cursor.pg.index > index)
-		--t->bt_cursor.pg.index;
-
-	return (RET_SUCCESS);
 }
 
 /**
@@ -0,0 +1,462 @@
+/*-
+ * Copyright (c) 2018 Tama Communications Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <sys/types.h>
+
+#include <errno.h>
+#include <stdio.h>
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+#include "db.h"
+#include "btree.h"
+
+/*
+ * Bulk loading of a btree.
+ *
+ * When the records are given in sorted order to an empty tree, we need
+ * neither searching nor splitting.  The leaf pages are filled from left to
+ * right up to the fill factor, and each time a page is started, its first
+ * key is added to the rightmost page of the level above it, which is built
+ * in the same way.  Only the rightmost page of each level is pinned.
+ *
+ *	__bt_bulkopen(dbp, 100);
+ *	while (there are records in sorted order)
+ *		__bt_bulkput(dbp, &key, &data);
+ *	__bt_bulkclose(dbp);
+ *
+ * Since the root of a btree must be P_ROOT, the top page is copied to it
+ * at the end.  The other access routines must not be used in the meantime.
+ */
+static int	 bt_lnew(BTREE *, int, PAGE **);
+static int	 bt_lroom(BTREE *, PAGE *, u_int32_t);
+static int	 bt_linternal(BTREE *, int, PAGE *, PAGE *);
+
+/**
+ * __BT_BULKOPEN -- Start bulk loading.
+ *
+ *	@param dbp	pointer to access method
+ *	@param fill	fill factor of pages in percent (50 - 100)
+ *
+ * @return
+ *	RET_ERROR, RET_SUCCESS and RET_SPECIAL if the tree is not empty.
+ */
+int
+__bt_bulkopen(dbp, fill)
+	DB *dbp;
+	int fill;
+{
+	BTREE *t;
+	PAGE *h;
+	int empty;
+
+	t = dbp->internal;
+
+	/* Toss any page pinned across calls. */
+	if (t->bt_pinned != NULL) {
+		mpool_put(t->bt_mp, t->bt_pinned, 0);
+		t->bt_pinned = NULL;
+	}
+
+	/* Check for change to a read-only tree. */
+	if (F_ISSET(t, B_RDONLY)) {
+		errno = EPERM;
+		return (RET_ERROR);
+	}
+	if (F_ISSET(t, R_RECNO) || t->bt_load != NULL ||
+	    fill < 50 || fill > 100) {
+		errno = EINVAL;
+		return (RET_ERROR);
+	}
+
+	/* Bulk loading is possible only for an empty tree. */
+	if ((h = mpool_get(t->bt_mp, P_ROOT, 0)) == NULL)
+		return (RET_ERROR);
+	empty = (h->flags & P_TYPE) == P_BLEAF && NEXTINDEX(h) == 0;
+	mpool_put(t->bt_mp, h, 0);
+	if (!empty)
+		return (RET_SPECIAL);
+
+	if ((t->bt_load = (BTLOAD *)malloc(sizeof(BTLOAD))) == NULL)
+		return (RET_ERROR);
+	t->bt_load->fill = fill;
+	t->bt_load->nlevel = 0;
+	return (RET_SUCCESS);
+}
+
+/**
+ * __BT_BULKPUT -- Append a record to the tree being loaded.
+ *
+ *	@param dbp	pointer to access method
+ *	@param key	key
+ *	@param data	data
+ *
+ * @return RET_ERROR, RET_SUCCESS
+ *
+ * Records must be given in ascending order of the key.  If duplicate keys
+ * are not permitted, a record replaces the last one which has the same key.
+ */
+int
+__bt_bulkput(dbp, key, data)
+	DB *dbp;
+	const DBT *key, *data;
+{
+	BTREE *t;
+	BTLOAD *ld;
+	DBT tkey, tdata, nokey;
+	EPG e;
+	PAGE *h, *r;
+	pgno_t pg;
+	u_int32_t nbytes;
+	int cmp, dflags;
+	char *dest, db[NOVFLSIZE], kb[NOVFLSIZE];
+
+	t = dbp->internal;
+	if ((ld = t->bt_load) == NULL) {
+		errno = EINVAL;
+		return (RET_ERROR);
+	}
+
+	/* The first leaf page. */
+	if (ld->nlevel == 0) {
+		if (bt_lnew(t, P_BLEAF, &h) == RET_ERROR)
+			return (RET_ERROR);
+		ld->page[0] = h;
+		ld->nlevel = 1;
+	}
+	h = ld->page[0];
+
+	/* Check the order, and replace the last record if required. */
+	if (NEXTINDEX(h) > 0) {
+		e.page = h;
+		e.index = NEXTINDEX(h) - 1;
+		if ((cmp = __bt_cmp(t, key, &e)) < 0) {
+			errno = EINVAL;
+			return (RET_ERROR);
+		}
+		if (cmp == 0 && F_ISSET(t, B_NODUPS) &&
+		    __bt_dleaf(t, key, h, e.index) == RET_ERROR)
+			return (RET_ERROR);
+	}
+
+	/* Store big key/data pairs on overflow pages as __bt_put does. */
+	dflags = 0;
+	if (key->size + data->size > t->bt_ovflsize) {
+		if (key->size > t->bt_ovflsize) {
+storekey:		if (__ovfl_put(t, key, &pg) == RET_ERROR)
+				return (RET_ERROR);
+			tkey.data = kb;
+			tkey.size = NOVFLSIZE;
+			memmove(kb, &pg, sizeof(pgno_t));
+			memmove(kb + sizeof(pgno_t),
+			    &key->size, sizeof(u_int32_t));
+			dflags |= P_BIGKEY;
+			key = &tkey;
+		}
+		if (key->size + data->size > t->bt_ovflsize) {
+			if (__ovfl_put(t, data, &pg) == RET_ERROR)
+				return (RET_ERROR);
+			tdata.data = db;
+			tdata.size = NOVFLSIZE;
+			memmove(db, &pg, sizeof(pgno_t));
+			memmove(db + sizeof(pgno_t),
+			    &data->size, sizeof(u_int32_t));
+			dflags |= P_BIGDATA;
+			data = &tdata;
+		}
+		if (key->size + data->size > t->bt_ovflsize)
+			goto storekey;
+	}
+
+	/*
+	 * If the leaf page is full, start a new one on its right, and
+	 * register it to the parent level.  On the same page, a duplicate
+	 * key is left out as __bt_put does.
+	 */
+	nbytes = NBLEAFDBT(key->size, data->size);
+	if (F_ISSET(t, B_DUPKEY) &&
+	    bt_lroom(t, h, NBLEAFDBT(0, data->size)) &&
+	    __bt_dupkey(t, key, dflags, h, NEXTINDEX(h))) {
+		nokey.data = NULL;
+		nokey.size = 0;
+		key = &nokey;
+		dflags |= P_DUPKEY;
+		nbytes = NBLEAFDBT(0, data->size);
+	}
+	if (!bt_lroom(t, h, nbytes)) {
+		if (bt_lnew(t, P_BLEAF, &r) == RET_ERROR)
+			return (RET_ERROR);
+		h->nextpg = r->pgno;
+		r->prevpg = h->pgno;
+		ld->page[0] = r;
+		r->linp[0] = r->upper -= nbytes;
+		r->lower += sizeof(indx_t);
+		dest = (char *)r + r->upper;
+		WR_BLEAF(dest, key, data, dflags);
+		if (bt_linternal(t, 1, h, r) == RET_ERROR)
+			return (RET_ERROR);
+		mpool_put(t->bt_mp, h, MPOOL_DIRTY);
+	} else {
+		h->linp[NEXTINDEX(h)] = h->upper -= nbytes;
+		h->lower += sizeof(indx_t);
+		dest = (char *)h + h->upper;
+		WR_BLEAF(dest, key, data, dflags);
+	}
+	F_SET(t, B_MODIFIED);
+	return (RET_SUCCESS);
+}
+
+/**
+ * __BT_BULKCLOSE -- Finish bulk loading.
+ *
+ *	@param dbp	pointer to access method
+ *
+ * @return RET_ERROR, RET_SUCCESS
+ */
+int
+__bt_bulkclose(dbp)
+	DB *dbp;
+{
+	BTREE *t;
+	BTLOAD *ld;
+	PAGE *root, *top;
+	int level, status;
+
+	t = dbp->internal;
+	if ((ld = t->bt_load) == NULL) {
+		errno = EINVAL;
+		return (RET_ERROR);
+	}
+	t->bt_load = NULL;
+	status = RET_SUCCESS;
+
+	/* Unpin the rightmost pages except for the top one. */
+	for (level = 0; level < ld->nlevel - 1; level++)
+		mpool_put(t->bt_mp, ld->page[level], MPOOL_DIRTY);
+
+	/* Move the top page to the root, and release it. */
+	if (ld->nlevel > 0) {
+		top = ld->page[ld->nlevel - 1];
+		if ((root = mpool_get(t->bt_mp, P_ROOT, 0)) == NULL) {
+			mpool_put(t->bt_mp, top, 0);
+			status = RET_ERROR;
+		} else {
+			memmove(root, top, t->bt_psize);
+			root->pgno = P_ROOT;
+			mpool_put(t->bt_mp, root, MPOOL_DIRTY);
+			if (__bt_free(t, top) == RET_ERROR)
+				status = RET_ERROR;
+		}
+	}
+	free(ld);
+	t->bt_order = NOT;
+	return (status);
+}
+
+/**
+ * BT_LNEW -- Get a new empty page for bulk loading.
+ *
+ *	@param t	tree
+ *	@param type	P_BLEAF or P_BINTERNAL
+ *	@param hp	storage for the (pinned) page
+ *
+ * @return RET_ERROR, RET_SUCCESS
+ */
+static int
+bt_lnew(t, type, hp)
+	BTREE *t;
+	int type;
+	PAGE **hp;
+{
+	PAGE *h;
+	pgno_t npg;
+
+	if ((h = __bt_new(t, &npg)) == NULL)
+		return (RET_ERROR);
+	h->pgno = npg;
+	h->prevpg = h->nextpg = P_INVALID;
+	h->lower = BTDATAOFF;
+	h->upper = t->bt_psize;
+	h->flags = type;
+	*hp = h;
+	return (RET_SUCCESS);
+}
+
+/**
+ * BT_LROOM -- Check whether an item can be added to a page being loaded.
+ *
+ *	@param t	tree
+ *	@param h	page
+ *	@param nbytes	size of the item
+ *
+ * @return
+ *	1 if the item fits within the fill factor, else 0.
+ *	An empty page always accepts an item.
+ */
+static int
+bt_lroom(t, h, nbytes)
+	BTREE *t;
+	PAGE *h;
+	u_int32_t nbytes;
+{
+	u_int32_t need;
+
+	if (NEXTINDEX(h) == 0)
+		return (1);
+	need = nbytes + sizeof(indx_t);
+	if (h->upper - h->lower < need)
+		return (0);
+	return (t->bt_psize - (h->upper - h->lower) + need <=
+	    t->bt_psize * t->bt_load->fill / 100);
+}
+
+/**
+ * BT_LINTERNAL -- Register a new page to the level above it.
+ *
+ *	@param t	tree
+ *	@param level	level of the parent (the leaf level is 0)
+ *	@param l	page on the left of the new page
+ *	@param r	new page
+ *
+ * @return RET_ERROR, RET_SUCCESS
+ *
+ * The key is the first key of the new page.  As __bt_split does, keys
+ * from leaf pages are shortened by the prefix function if possible.
+ */
+static int
+bt_linternal(t, level, l, r)
+	BTREE *t;
+	int level;
+	PAGE *l, *r;
+{
+	BTLOAD *ld;
+	BINTERNAL *bi;
+	BLEAF *bl, *tbl;
+	DBT a, b;
+	PAGE *h, *nh, *p;
+	u_int32_t nbytes, nksize;
+	char *dest;
+
+	ld = t->bt_load;
+	if (level >= (int)(sizeof(ld->page) / sizeof(ld->page[0]))) {
+		errno = EINVAL;
+		return (RET_ERROR);
+	}
+
+	/*
+	 * Make a new top level.  The left-most key on any level is never
+	 * used, so it doesn't need to be filled in (see bt_broot()).
+	 */
+	if (level == ld->nlevel) {
+		if (bt_lnew(t, P_BINTERNAL, &h) == RET_ERROR)
+			return (RET_ERROR);
+		nbytes = NBINTERNAL(0);
+		h->linp[0] = h->upper -= nbytes;
+		h->lower += sizeof(indx_t);
+		dest = (char *)h + h->upper;
+		WR_BINTERNAL(dest, 0, l->pgno, 0);
+		ld->page[level] = h;
+		ld->nlevel++;
+	}
+	h = ld->page[level];
+
+	/* Calculate the space needed, as __bt_split does. */
+	bi = NULL;
+	bl = NULL;
+	nksize = 0;
+	if ((r->flags & P_TYPE) == P_BINTERNAL) {
+		bi = GETBINTERNAL(r, 0);
+		nbytes = NBINTERNAL(bi->ksize);
+	} else {
+		bl = GETBLEAF(r, 0);
+		nbytes = NBINTERNAL(bl->ksize);
+		if (t->bt_pfx && !(bl->flags & P_BIGKEY) &&
+		    (h->prevpg != P_INVALID || NEXTINDEX(h) > 1)) {
+			tbl = __bt_leafkey(l, NEXTINDEX(l) - 1);
+			a.size = tbl->ksize;
+			a.data = tbl->bytes;
+			b.size = bl->ksize;
+			b.data = bl->bytes;
+			nksize = t->bt_pfx(&a, &b);
+			if (NBINTERNAL(nksize) < nbytes)
+				nbytes = NBINTERNAL(nksize);
+			else
+				nksize = 0;
+		}
+	}
+
+	/* If the page is full, start a new one and go up. */
+	if (!bt_lroom(t, h, nbytes)) {
+		if (bt_lnew(t, P_BINTERNAL, &nh) == RET_ERROR)
+			return (RET_ERROR);
+		h->nextpg = nh->pgno;
+		nh->prevpg = h->pgno;
+		ld->page[level] = nh;
+		p = nh;
+	} else
+		p = h;
+
+	p->linp[NEXTINDEX(p)] = p->upper -= nbytes;
+	p->lower += sizeof(indx_t);
+	dest = (char *)p + p->upper;
+	if (bi != NULL) {
+		memmove(dest, bi, nbytes);
+		((BINTERNAL *)dest)->pgno = r->pgno;
+	} else {
+		WR_BINTERNAL(dest, nksize ? nksize : bl->ksize,
+		    r->pgno, bl->flags & P_BIGKEY);
+		memmove(dest, bl->bytes, nksize ? nksize : bl->ksize);
+
+		/*
+		 * If the key is on an overflow page, mark the overflow chain
+		 * so it isn't deleted when the leaf copy of the key is deleted.
+		 */
+		if (bl->flags & P_BIGKEY) {
+			PAGE *oh;
+
+			if ((oh = mpool_get(t->bt_mp,
+			    *(pgno_t *)bl->bytes, 0)) == NULL)
+				return (RET_ERROR);
+			oh->flags |= P_PRESERVE;
+			mpool_put(t->bt_mp, oh, MPOOL_DIRTY);
+		}
+	}
+
+	if (p != h) {
+		if (bt_linternal(t, level + 1, h, p) == RET_ERROR)
+			return (RET_ERROR);
+		mpool_put(t->bt_mp, h, MPOOL_DIRTY);
+	}
+	return (RET_SUCCESS);
+}
@@ -126,8 +126,8 @@ __bt_open(fname, flags, mode, openinfo, dflags)
 	if (openinfo) {
 		b = *openinfo;
 
-		/* Flags: R_DUP. */
-		if (b.flags & ~(R_DUP))
+		/* Flags: R_DUP, R_DUPKEY. */
+		if (b.flags & ~(R_DUP | R_DUPKEY))
 			goto einval;
 
 		/*
@@ -284,9 +284,15 @@ __bt_open(fname, flags, mode, openinfo, dflags)
 #endif
 		}
 
-		/* Set flag if duplicates permitted. */
+		/*
+		 * Set flag if duplicates permitted.  Duplicate keys are
+		 * stored only once on each leaf page only when requested,
+		 * because older versions cannot read such a tree.
+		 */
 		if (!(b.flags & R_DUP))
 			F_SET(t, B_NODUPS);
+		else if (b.flags & R_DUPKEY)
+			F_SET(t, B_DUPKEY);
 
 		t->bt_free = P_INVALID;
 		t->bt_nrecs = 0;
@@ -328,6 +334,14 @@ __bt_open(fname, flags, mode, openinfo, dflags)
 	if (!F_ISSET(t, B_INMEM))
 		mpool_filter(t->bt_mp, __bt_pgin, __bt_pgout, t);
 
+	/*
+	 * A read-only tree in the native byte order is mapped into memory,
+	 * and its pages are used in place.  If it cannot be mapped, pages
+	 * are read into the buffer pool as usual.
+	 */
+	if (F_ISSET(t, B_RDONLY) && !F_ISSET(t, B_NEEDSWAP | B_INMEM))
+		(void)mpool_map(t->bt_mp);
+
 	/* Create a root page if new tree. */
 	if (nroot(t) == RET_ERROR)
 		goto err;
@@ -75,7 +75,7 @@ __bt_put(dbp, key, data, flags)
 	u_int flags;
 {
 	BTREE *t;
-	DBT tkey, tdata;
+	DBT tkey, tdata, nokey;
 	EPG *e = NULL;
 	PAGE *h;
 	indx_t index, nxtindex;
@@ -198,13 +198,28 @@ delete:		if (__bt_dleaf(t, key, h, index) == RET_ERROR) {
 		break;
 	}
 
+	/*
+	 * If the key is the same as that of the previous item, leave it out.
+	 * This is done only when the item fits in the page without the key,
+	 * since the split code may put the new item first on a page.
+	 */
+	nbytes = NBLEAFDBT(key->size, data->size);
+	if (F_ISSET(t, B_DUPKEY) &&
+	    h->upper - h->lower >= NBLEAFDBT(0, data->size) + sizeof(indx_t) &&
+	    __bt_dupkey(t, key, dflags, h, index)) {
+		nokey.data = NULL;
+		nokey.size = 0;
+		key = &nokey;
+		dflags |= P_DUPKEY;
+		nbytes = NBLEAFDBT(0, data->size);
+	}
+
 	/*
 	 * If not enough room, or the user has put a ceiling on the number of
 	 * keys permitted in the page, split the page.  The split code will
 	 * insert the key and data and unpin the current page.  If inserting
 	 * into the offset array, shift the pointers up.
 	 */
-	nbytes = NBLEAFDBT(key->size, data->size);
 	if (h->upper - h->lower < nbytes + sizeof(indx_t)) {
 		if ((status = __bt_split(t, h, key,
 		    data, dflags, nbytes, index)) != RET_SUCCESS)
@@ -46,6 +46,7 @@ static char sccsid[] = "@(#)bt_search.c	8.8 (Berkeley) 7/31/94";
 
 static int __bt_snext(BTREE *, PAGE *, const DBT *, int *);
 static int __bt_sprev(BTREE *, PAGE *, const DBT *, int *);
+static int __bt_sadjust(BTREE *, int);
 
 /**
  * __bt_search --
@@ -160,7 +161,7 @@ __bt_snext(t, h, key, exactp)
 	if ((e.page = mpool_get(t->bt_mp, h->nextpg, 0)) == NULL)
 		return (0);
 	e.index = 0;
-	if (__bt_cmp(t, key, &e) == 0) {
+	if (__bt_cmp(t, key, &e) == 0 && __bt_sadjust(t, 1) == RET_SUCCESS) {
 		mpool_put(t->bt_mp, h, 0);
 		t->bt_cur = e;
 		*exactp = 1;
@@ -198,7 +199,7 @@ __bt_sprev(t, h, key, exactp)
 	if ((e.page = mpool_get(t->bt_mp, h->prevpg, 0)) == NULL)
 		return (0);
 	e.index = NEXTINDEX(e.page) - 1;
-	if (__bt_cmp(t, key, &e) == 0) {
+	if (__bt_cmp(t, key, &e) == 0 && __bt_sadjust(t, -1) == RET_SUCCESS) {
 		mpool_put(t->bt_mp, h, 0);
 		t->bt_cur = e;
 		*exactp = 1;
@@ -207,3 +208,52 @@ __bt_sprev(t, h, key, exactp)
 	mpool_put(t->bt_mp, e.page, 0);
 	return (0);
 }
+
+/**
+ * __bt_sadjust --
+ *	Fix the parent page stack after moving to an adjacent leaf page.
+ *
+ *	@param[in] t	tree
+ *	@param[in] dir	-1: moved to the previous page, 1: moved to the next page
+ *
+ * @return RET_ERROR, RET_SUCCESS.
+ *
+ * The split and delete code inserts or deletes the key of the parent page
+ * recorded in the stack, so the stack must lead to the page we moved to.
+ * The adjacent page may have a different parent, when we have to go up
+ * until we can move to the sibling entry, and go down along the edge of it.
+ */
+static int
+__bt_sadjust(t, dir)
+	BTREE *t;
+	int dir;
+{
+	EPGNO *e;
+	PAGE *h;
+	pgno_t pg;
+	indx_t last;
+
+	for (e = t->bt_sp; e > t->bt_stack;) {
+		--e;
+		if ((h = mpool_get(t->bt_mp, e->pgno, 0)) == NULL)
+			return (RET_ERROR);
+		last = NEXTINDEX(h) - 1;
+		mpool_put(t->bt_mp, h, 0);
+		if (dir < 0 ? e->index > 0 : e->index < last) {
+			e->index += dir;
+			for (; e + 1 < t->bt_sp; ++e) {
+				if ((h = mpool_get(t->bt_mp, e->pgno, 0)) == NULL)
+					return (RET_ERROR);
+				pg = GETBINTERNAL(h, e->index)->pgno;
+				mpool_put(t->bt_mp, h, 0);
+				if ((h = mpool_get(t->bt_mp, pg, 0)) == NULL)
+					return (RET_ERROR);
+				e[1].pgno = pg;
+				e[1].index = dir < 0 ? NEXTINDEX(h) - 1 : 0;
+				mpool_put(t->bt_mp, h, 0);
+			}
+			return (RET_SUCCESS);
+		}
+	}
+	return (RET_ERROR);
+}
@@ -61,6 +61,7 @@ static PAGE	*bt_psplit(BTREE *, PAGE *, PAGE *, PAGE *, indx_t *, size_t);
 static PAGE	*bt_root(BTREE *, PAGE *, PAGE **, PAGE **, indx_t *, size_t);
 static int	 bt_rroot(BTREE *, PAGE *, PAGE *, PAGE *);
 static recno_t	 rec_total(PAGE *);
+static u_int32_t bt_dupkeysize(PAGE *, indx_t);
 
 u_long	bt_rootsplit, bt_split, bt_sortsplit, bt_pfxsaved;
 
@@ -189,7 +190,8 @@ __bt_split(t, sp, key, data, flags, ilen, argskip)
 			nbytes = NBINTERNAL(bl->ksize);
 			if (t->bt_pfx && !(bl->flags & P_BIGKEY) &&
 			    (h->prevpg != P_INVALID || skip > 1)) {
-				tbl = GETBLEAF(lchild, NEXTINDEX(lchild) - 1);
+				tbl = __bt_leafkey(lchild,
+				    NEXTINDEX(lchild) - 1);
 				a.size = tbl->ksize;
 				a.data = tbl->bytes;
 				b.size = bl->ksize;
@@ -612,13 +614,13 @@ bt_psplit(t, h, l, r, pskip, ilen)
 	size_t ilen;
 {
 	BINTERNAL *bi;
-	BLEAF *bl;
+	BLEAF *bl, *kl, *tbl;
 	CURSOR *c;
 	RLEAF *rl;
 	PAGE *rval;
 	void *src = NULL;
 	indx_t full, half, nxt, off, skip, top, used;
-	u_int32_t nbytes;
+	u_int32_t grow, nbytes, total;
 	int bigkeycnt, isbigkey;
 
 	/*
@@ -626,12 +628,15 @@ bt_psplit(t, h, l, r, pskip, ilen)
 	 * open.  Additionally, make some effort not to split on an overflow
 	 * key.  This makes internal page processing faster and can save
 	 * space as overflow keys used by internal pages are never deleted.
+	 * The item that becomes the first one on the right page may have to
+	 * get back its key (see P_DUPKEY), so keep room for it there.
 	 */
 	bigkeycnt = 0;
 	skip = *pskip;
 	full = t->bt_psize - BTDATAOFF;
 	half = full / 2;
 	used = 0;
+	total = full - (h->upper - h->lower) + ilen + sizeof(indx_t);
 	for (nxt = off = 0, top = NEXTINDEX(h); nxt < top; ++off) {
 		if (skip == off) {
 			nbytes = ilen;
@@ -684,10 +689,12 @@ bt_psplit(t, h, l, r, pskip, ilen)
 
 		used += nbytes + sizeof(indx_t);
 		if (used >= half) {
-			if (!isbigkey || bigkeycnt == 3)
-				break;
-			else
+			if (isbigkey && bigkeycnt < 3)
 				++bigkeycnt;
+			else if (skip == off + 1 ||
+			    (grow = bt_dupkeysize(h, nxt)) == 0 ||
+			    total - used + grow <= full)
+				break;
 		}
 	}
 
@@ -742,6 +749,23 @@ bt_psplit(t, h, l, r, pskip, ilen)
 		case P_BLEAF:
 			src = bl = GETBLEAF(h, nxt);
 			nbytes = NBLEAF(bl);
+
+			/* The first item on a page must have its own key. */
+			if (off == 0 && bl->flags & P_DUPKEY) {
+				kl = __bt_leafkey(h, nxt);
+				nbytes = NBLEAFDBT(kl->ksize, bl->dsize);
+				r->linp[off] = r->upper -= nbytes;
+				tbl = GETBLEAF(r, off);
+				tbl->ksize = kl->ksize;
+				tbl->dsize = bl->dsize;
+				tbl->flags = (kl->flags & P_BIGKEY) |
+				    (bl->flags & P_BIGDATA);
+				memmove(tbl->bytes, kl->bytes, kl->ksize);
+				memmove(tbl->bytes + kl->ksize,
+				    bl->bytes, bl->dsize);
+				++nxt;
+				continue;
+			}
 			break;
 		case P_RINTERNAL:
 			src = GETRINTERNAL(h, nxt);
@@ -767,6 +791,32 @@ bt_psplit(t, h, l, r, pskip, ilen)
 	return (rval);
 }
 
+/**
+ * BT_DUPKEYSIZE -- Return the number of bytes an item grows by when it
+ * becomes the first item on a page.
+ *
+ *	@param h	page
+ *	@param index	index of the item
+ *
+ * @return
+ *	The size of the key that the item leaves out (see P_DUPKEY), or 0.
+ */
+static u_int32_t
+bt_dupkeysize(h, index)
+	PAGE *h;
+	indx_t index;
+{
+	BLEAF *bl, *kl;
+
+	if ((h->flags & P_TYPE) != P_BLEAF || index >= NEXTINDEX(h))
+		return (0);
+	bl = GETBLEAF(h, index);
+	if (!(bl->flags & P_DUPKEY))
+		return (0);
+	kl = __bt_leafkey(h, index);
+	return (NBLEAFDBT(kl->ksize, bl->dsize) - NBLEAF(bl));
+}
+
 /**
  * BT_PRESERVE -- Mark a chain of pages as used by an internal node.
  *
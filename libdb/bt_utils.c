@@ -72,10 +72,11 @@ __bt_ret(t, e, key, rkey, data, rdata, copy)
 	DBT *key, *rkey, *data, *rdata;
 	int copy;
 {
-	BLEAF *bl;
+	BLEAF *bl, *kl;
 	void *p;
 
 	bl = GETBLEAF(e->page, e->index);
+	kl = __bt_leafkey(e->page, e->index);
 
 	/*
 	 * We must copy big keys/data to make them contigous.  Otherwise,
@@ -85,26 +86,26 @@ __bt_ret(t, e, key, rkey, data, rdata, copy)
 	if (key == NULL)
 		goto dataonly;
 
-	if (bl->flags & P_BIGKEY) {
-		if (__ovfl_get(t, bl->bytes,
+	if (kl->flags & P_BIGKEY) {
+		if (__ovfl_get(t, kl->bytes,
 		    &key->size, &rkey->data, &rkey->size))
 			return (RET_ERROR);
 		key->data = rkey->data;
 	} else if (copy || F_ISSET(t, B_DB_LOCK)) {
-		if (bl->ksize > rkey->size) {
+		if (kl->ksize > rkey->size) {
 			p = (void *)(rkey->data == NULL ?
-			    malloc(bl->ksize) : realloc(rkey->data, bl->ksize));
+			    malloc(kl->ksize) : realloc(rkey->data, kl->ksize));
 			if (p == NULL)
 				return (RET_ERROR);
 			rkey->data = p;
-			rkey->size = bl->ksize;
+			rkey->size = kl->ksize;
 		}
-		memmove(rkey->data, bl->bytes, bl->ksize);
-		key->size = bl->ksize;
+		memmove(rkey->data, kl->bytes, kl->ksize);
+		key->size = kl->ksize;
 		key->data = rkey->data;
 	} else {
-		key->size = bl->ksize;
-		key->data = bl->bytes;
+		key->size = kl->ksize;
+		key->data = kl->bytes;
 	}
 
 dataonly:
@@ -138,6 +139,69 @@ dataonly:
 	return (RET_SUCCESS);
 }
 
+/**
+ * __BT_LEAFKEY -- Get the leaf item which holds the key of a record.
+ *
+ *	@param h	leaf page
+ *	@param index	index of the record on the page
+ *
+ * @return
+ *	The record itself, or the nearest record before it that has its
+ *	own key if the record has P_DUPKEY set.
+ */
+BLEAF *
+__bt_leafkey(h, index)
+	PAGE *h;
+	u_int index;
+{
+	BLEAF *bl;
+
+	while ((bl = GETBLEAF(h, index))->flags & P_DUPKEY)
+		--index;
+	return (bl);
+}
+
+/**
+ * __BT_DUPKEY -- Check whether a new item can leave out its key.
+ *
+ *	@param t	tree
+ *	@param key	key to insert
+ *	@param flags	P_BIGKEY/P_BIGDATA flags of the new item
+ *	@param h	leaf page
+ *	@param index	index at which the item is inserted
+ *
+ * @return
+ *	1 if the key is the same as that of the previous item, and the run
+ *	of items sharing the key stays within NDUPKEY items; otherwise 0.
+ *
+ * The limit keeps __bt_leafkey() cheap while scanning a long run.
+ */
+int
+__bt_dupkey(t, key, flags, h, index)
+	BTREE *t;
+	const DBT *key;
+	int flags;
+	PAGE *h;
+	u_int index;
+{
+	EPG e;
+	u_int i, n, top;
+
+	if (index == 0 || flags & P_BIGKEY)
+		return (0);
+	n = 2;
+	for (i = index - 1; GETBLEAF(h, i)->flags & P_DUPKEY; --i)
+		if (++n > NDUPKEY)
+			return (0);
+	for (i = index, top = NEXTINDEX(h);
+	    i < top && GETBLEAF(h, i)->flags & P_DUPKEY; ++i)
+		if (++n > NDUPKEY)
+			return (0);
+	e.page = h;
+	e.index = index - 1;
+	return (__bt_cmp(t, key, &e) == 0);
+}
+
 /*
  * __BT_CMP -- Compare a key to a given record.
  *
@@ -175,7 +239,7 @@ __bt_cmp(t, k1, e)
 
 	bigkey = NULL;
 	if (h->flags & P_BLEAF) {
-		bl = GETBLEAF(h, e->index);
+		bl = __bt_leafkey(h, e->index);
 		if (bl->flags & P_BIGKEY)
 			bigkey = bl->bytes;
 		else {
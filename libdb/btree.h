@@ -182,14 +182,28 @@ typedef struct _rinternal {
 	*(pgno_t *)p = pgno;						\
 }
 
-/** For the btree leaf pages, the item is a key and data pair. */
+/**
+ * For the btree leaf pages, the item is a key and data pair.
+ *
+ * In a tree with B_DUPKEY set, an item whose key is the same as that of the
+ * previous item on the page may leave out the key.  Such an item has P_DUPKEY
+ * set and a ksize of 0, and its key is found by going back to the nearest item
+ * without P_DUPKEY (see __bt_leafkey()).  Thus a run of duplicate keys is
+ * stored once for every NDUPKEY items on each page.  The first item on a
+ * page always has its own key, and an item with P_DUPKEY never has P_BIGKEY.
+ */
 typedef struct _bleaf {
 	u_int32_t	ksize;		/**< size of key */
 	u_int32_t	dsize;		/**< size of data */
-	u_char	flags;			/**< P_BIGDATA, P_BIGKEY */
+		/** key is that of the previous item */
+#define	P_DUPKEY	0x04
+	u_char	flags;			/**< P_BIGDATA, P_BIGKEY, P_DUPKEY */
 	char	bytes[1];		/**< data */
 } BLEAF;
 
+/** Maximum number of items sharing a key stored once. */
+#define	NDUPKEY		16
+
 /** Get the page's BLEAF structure at index indx. */
 #define	GETBLEAF(pg, indx)						\
 	((BLEAF *)((char *)(pg) + (pg)->linp[indx]))
@@ -316,10 +330,17 @@ typedef struct _btmeta {
 	u_int32_t	free;		/**< page number of first free page */
 	u_int32_t	nrecs;		/**< R: number of records */
 
-#define	SAVEMETA	(B_NODUPS | R_RECNO)
+#define	SAVEMETA	(B_NODUPS | R_RECNO | B_DUPKEY)
 	u_int32_t	flags;		/**< bt_flags & SAVEMETA */
 } BTMETA;
 
+/** The state of bulk loading (see bt_load.c). */
+typedef struct _btload {
+	int	  fill;			/**< fill factor in percent */
+	int	  nlevel;		/**< number of levels */
+	PAGE	 *page[50];		/**< rightmost (pinned) page of each level */
+} BTLOAD;
+
 /** The in-memory btree/recno data structure. */
 typedef struct _btree {
 	MPOOL	 *bt_mp;		/**< memory pool cookie */
@@ -353,6 +374,7 @@ typedef struct _btree {
 					/** sorted order */
 	enum { NOT, BACK, FORWARD } bt_order;
 	EPGNO	  bt_last;		/**< last insert */
+	BTLOAD	 *bt_load;		/**< bulk loading or NULL */
 
 					/** B: key comparison function */
 	int	(*bt_cmp)(const DBT *, const DBT *);
@@ -375,7 +397,7 @@ typedef struct _btree {
 
 /*
  * NB:
- * B_NODUPS and R_RECNO are stored on disk, and may not be changed.
+ * B_NODUPS, R_RECNO and B_DUPKEY are stored on disk, and may not be changed.
  */
 		/** in-memory tree */
 #define	B_INMEM		0x00001
@@ -417,6 +439,10 @@ typedef struct _btree {
 #define	B_DB_SHMEM	0x08000
 		/** DB_TXN specified. */
 #define	B_DB_TXN	0x10000
+
+/** duplicate keys may be left out of leaf items (P_DUPKEY).
+    [Note] B_DUPKEY is stored on disk, and may not be changed. */
+#define	B_DUPKEY	0x20000
 	u_int32_t flags;
 } BTREE;
 
@@ -141,6 +141,8 @@ typedef struct __db {
 #define	BTREEVERSION	3
 		/** duplicate keys */
 #define	R_DUP		0x01
+		/** store duplicate keys once on each leaf page (with R_DUP) */
+#define	R_DUPKEY	0x02
 
 /** Structure used to pass parameters to the btree routines. */
 typedef struct {
@@ -241,5 +243,8 @@ DB	*dbopen(const char *, int, int, DBTYPE, const void *);
 DB	*__bt_open(const char *, int, int, const BTREEINFO *, int);
 DB	*__hash_open(const char *, int, int, const HASHINFO *, int);
 DB	*__rec_open(const char *, int, int, const RECNOINFO *, int);
+int	 __bt_bulkopen(DB *, int);
+int	 __bt_bulkput(DB *, const DBT *, const DBT *);
+int	 __bt_bulkclose(DB *);
 void	 __dbpanic(DB *dbp);
 #endif /* !_DB_H_ */
@@ -27,6 +27,7 @@
  * SUCH DAMAGE.
  */
 
+
 #if defined(LIBC_SCCS) && !defined(lint)
 static char sccsid[] = "@(#)mpool.c	8.5 (Berkeley) 7/26/94";
 #endif /* LIBC_SCCS and not lint */
@@ -35,8 +36,12 @@ static char sccsid[] = "@(#)mpool.c	8.5 (Berkeley) 7/26/94";
 #include <config.h>
 #endif
 #include <sys/stat.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #ifdef STDC_HEADERS
 #include <stdlib.h>
@@ -61,7 +66,11 @@ static char sccsid[] = "@(#)mpool.c	8.5 (Berkeley) 7/26/94";
 #include "mpool.h"
 
 static BKT *mpool_bkt(MPOOL *);
+static BKT *mpool_find(MPOOL *, pgno_t);
 static BKT *mpool_look(MPOOL *, pgno_t);
+static int  mpool_read(MPOOL *, pgno_t, void *, pgno_t);
+static int  mpool_readahead(MPOOL *, pgno_t);
+static int  mpool_rehash(MPOOL *, pgno_t);
 static int  mpool_write(MPOOL *, BKT *);
 
 /**
@@ -81,7 +90,6 @@ mpool_open(key, fd, pagesize, maxcache)
 {
 	struct stat sb;
 	MPOOL *mp;
-	int entry;
 
 	/*
 	 * Get information about the file.
@@ -100,8 +108,10 @@ mpool_open(key, fd, pagesize, maxcache)
 	if ((mp = (MPOOL *)calloc(1, sizeof(MPOOL))) == NULL)
 		return (NULL);
 	CIRCLEQ_INIT(&mp->lqh);
-	for (entry = 0; entry < HASHSIZE; ++entry)
-		CIRCLEQ_INIT(&mp->hqh[entry]);
+	if (mpool_rehash(mp, HASHSIZE) == RET_ERROR) {
+		free(mp);
+		return (NULL);
+	}
 	mp->maxcache = maxcache;
 	mp->npages = sb.st_size / pagesize;
 	mp->pagesize = pagesize;
@@ -129,6 +139,45 @@ mpool_filter(mp, pgin, pgout, pgcookie)
 	mp->pgout = pgout;
 	mp->pgcookie = pgcookie;
 }
+
+/**
+ * mpool_map --
+ *	Map the whole file into memory for reading.
+ *
+ *	@param mp
+ *
+ * It must be called before any page is cached, and the file must not be
+ * written through the pool.  The filters are not applied to mapped pages.
+ */
+int
+mpool_map(mp)
+	MPOOL *mp;
+{
+#ifdef HAVE_MMAP
+	void *map;
+	size_t size;
+
+	if (mp->npages == 0 || mp->curcache > 0 || mp->map != NULL) {
+		errno = EINVAL;
+		return (RET_ERROR);
+	}
+	/* Give up if the file doesn't fit in the address space. */
+	size = mp->pagesize * (size_t)mp->npages;
+	if (size / mp->pagesize != mp->npages) {
+		errno = EFBIG;
+		return (RET_ERROR);
+	}
+	map = mmap(NULL, size, PROT_READ, MAP_SHARED, mp->fd, 0);
+	if (map == MAP_FAILED)
+		return (RET_ERROR);
+	mp->map = (char *)map;
+	mp->mapsize = size;
+	return (RET_SUCCESS);
+#else
+	errno = ENOSYS;
+	return (RET_ERROR);
+#endif
+}
 	
 /**
  * mpool_new --
@@ -145,6 +194,10 @@ mpool_new(mp, pgnoaddr)
 	struct _hqh *head;
 	BKT *bp;
 
+	if (mp->map != NULL) {
+		errno = EPERM;
+		return (NULL);
+	}
 	if (mp->npages == MAX_PAGE_NUMBER) {
 		(void)fprintf(stderr, "mpool_new: page allocation overflow.\n");
 		abort();
@@ -154,17 +207,20 @@ mpool_new(mp, pgnoaddr)
 #endif
 	/*
 	 * Get a BKT from the cache.  Assign a new page number, attach
-	 * it to the head of the hash chain, the tail of the lru chain,
+	 * it to the head of the hash chain, behind the hand of the clock,
 	 * and return.
 	 */
 	if ((bp = mpool_bkt(mp)) == NULL)
 		return (NULL);
 	*pgnoaddr = bp->pgno = mp->npages++;
-	bp->flags = MPOOL_PINNED;
+	bp->flags = MPOOL_PINNED | MPOOL_REFERENCED;
 
-	head = &mp->hqh[HASHKEY(bp->pgno)];
+	head = &mp->hqh[HASHKEY(mp, bp->pgno)];
 	CIRCLEQ_INSERT_HEAD(head, bp, hq);
-	CIRCLEQ_INSERT_TAIL(&mp->lqh, bp, q);
+	if (mp->hand)
+		CIRCLEQ_INSERT_BEFORE(&mp->lqh, mp->hand, bp, q);
+	else
+		CIRCLEQ_INSERT_TAIL(&mp->lqh, bp, q);
 	return (bp->page);
 }
 
@@ -184,8 +240,6 @@ mpool_get(mp, pgno, flags)
 {
 	struct _hqh *head;
 	BKT *bp;
-	off_t off;
-	int nr;
 
 	/* Check for attempt to retrieve a non-existent page. */
 	if (pgno >= mp->npages) {
@@ -197,6 +251,14 @@ mpool_get(mp, pgno, flags)
 	++mp->pageget;
 #endif
 
+	/* A mapped page is used in place. */
+	if (mp->map != NULL) {
+#ifdef STATISTICS
+		++mp->cachehit;
+#endif
+		return (mp->map + mp->pagesize * (size_t)pgno);
+	}
+
 	/* Check for a page that is cached. */
 	if ((bp = mpool_look(mp, pgno)) != NULL) {
 #ifdef DEBUG
@@ -207,20 +269,22 @@ mpool_get(mp, pgno, flags)
 		}
 #endif
 		/*
-		 * Move the page to the head of the hash chain and the tail
-		 * of the lru chain.
+		 * Give the page a second chance.  The queues are not
+		 * touched on a hit.
 		 */
-		head = &mp->hqh[HASHKEY(bp->pgno)];
-		CIRCLEQ_REMOVE(head, bp, hq);
-		CIRCLEQ_INSERT_HEAD(head, bp, hq);
-		CIRCLEQ_REMOVE(&mp->lqh, bp, q);
-		CIRCLEQ_INSERT_TAIL(&mp->lqh, bp, q);
-
-		/* Return a pinned page. */
-		bp->flags |= MPOOL_PINNED;
+		bp->flags |= MPOOL_PINNED | MPOOL_REFERENCED;
 		return (bp->page);
 	}
 
+	/*
+	 * Detect ascending misses, which are typical of sequential
+	 * scans of leaf pages.
+	 */
+	if (pgno == mp->lastread + 1)
+		++mp->seqread;
+	else
+		mp->seqread = 0;
+
 	/* Get a page from the cache. */
 	if ((bp = mpool_bkt(mp)) == NULL)
 		return (NULL);
@@ -229,57 +293,39 @@ mpool_get(mp, pgno, flags)
 #ifdef STATISTICS
 	++mp->pageread;
 #endif
-
-	/*
-	 * If both of `off_t' and `long' are 32 bits, the right operand
-	 * of the multiplication is converted to `unsigned long',
-	 * and the multiplication is done with unsigned 32 bits.
-	 * It is equivalent to the case without cast.
-	 *
-	 * If `off_t' is 64 bits and `long' is 32 bits, the left operand
-	 * of the multiplication is converted to `off_t',
-	 * and the multiplication is done with signed 64 bits.
-	 * Adding cast avoids integer overflow.
-	 *
-	 * If both of `off_t' and `long' are 64 bits, the right operand
-	 * of the multiplication is converted to `unsigned long',
-	 * and the multiplication is done with unsigned 64 bits.
-	 * It is equivalent to the case without cast.
-	 */
-	off = mp->pagesize * (off_t)pgno;
-
-#ifdef HAVE_PREAD
-	if ((nr = pread(mp->fd, bp->page, mp->pagesize, off)) != mp->pagesize) {
-		if (nr >= 0)
-			errno = EFTYPE;
-		return (NULL);
-	}
-#else
-	if (lseek(mp->fd, off, SEEK_SET) != off)
-		return (NULL);
-	if ((nr = read(mp->fd, bp->page, mp->pagesize)) != mp->pagesize) {
-		if (nr >= 0)
-			errno = EFTYPE;
+	if (mpool_read(mp, pgno, bp->page, 1) == RET_ERROR) {
+		free(bp);
+		--mp->curcache;
 		return (NULL);
 	}
-#endif
 
 	/* Set the page number, pin the page. */
 	bp->pgno = pgno;
-	bp->flags = MPOOL_PINNED;
+	bp->flags = MPOOL_PINNED | MPOOL_REFERENCED;
+	mp->lastread = pgno;
 
 	/*
-	 * Add the page to the head of the hash chain and the tail
-	 * of the lru chain.
+	 * Add the page to the head of the hash chain and behind
+	 * the hand of the clock.
 	 */
-	head = &mp->hqh[HASHKEY(bp->pgno)];
+	head = &mp->hqh[HASHKEY(mp, bp->pgno)];
 	CIRCLEQ_INSERT_HEAD(head, bp, hq);
-	CIRCLEQ_INSERT_TAIL(&mp->lqh, bp, q);
+	if (mp->hand)
+		CIRCLEQ_INSERT_BEFORE(&mp->lqh, mp->hand, bp, q);
+	else
+		CIRCLEQ_INSERT_TAIL(&mp->lqh, bp, q);
 
 	/* Run through the user's filter. */
 	if (mp->pgin != NULL)
 		(mp->pgin)(mp->pgcookie, bp->pgno, bp->page);
 
+	/*
+	 * Read the following pages ahead.  A failure is not an error
+	 * of this request.
+	 */
+	if (mp->seqread >= READAHEAD_TRIGGER)
+		(void)mpool_readahead(mp, pgno + 1);
+
 	return (bp->page);
 }
 
@@ -302,6 +348,13 @@ mpool_put(mp, page, flags)
 #ifdef STATISTICS
 	++mp->pageput;
 #endif
+	if (mp->map != NULL) {
+		if (flags & MPOOL_DIRTY) {
+			errno = EPERM;
+			return (RET_ERROR);
+		}
+		return (RET_SUCCESS);
+	}
 	bp = (BKT *)((char *)page - sizeof(BKT));
 #ifdef DEBUG
 	if (!(bp->flags & MPOOL_PINNED)) {
@@ -327,13 +380,21 @@ mpool_close(mp)
 {
 	BKT *bp;
 
-	/* Free up any space allocated to the lru pages. */
+	/* Free up any space allocated to the cached pages. */
 	while ((bp = mp->lqh.cqh_first) != (void *)&mp->lqh) {
 		CIRCLEQ_REMOVE(&mp->lqh, mp->lqh.cqh_first, q);
 		free(bp);
 	}
 
+#ifdef HAVE_MMAP
+	if (mp->map != NULL)
+		(void)munmap(mp->map, mp->mapsize);
+#endif
+
 	/* Free the MPOOL cookie. */
+	free(mp->hqh);
+	if (mp->rabuf)
+		free(mp->rabuf);
 	free(mp);
 	return (RET_SUCCESS);
 }
@@ -350,7 +411,7 @@ mpool_sync(mp)
 {
 	BKT *bp;
 
-	/* Walk the lru chain, flushing any dirty pages to disk. */
+	/* Walk the clock ring, flushing any dirty pages to disk. */
 	for (bp = mp->lqh.cqh_first;
 	    bp != (void *)&mp->lqh; bp = bp->q.cqe_next)
 		if (bp->flags & MPOOL_DIRTY &&
@@ -372,41 +433,57 @@ mpool_bkt(mp)
 	MPOOL *mp;
 {
 	struct _hqh *head;
-	BKT *bp;
+	BKT *bp, *next;
+	pgno_t n;
 
 	/* If under the max cached, always create a new page. */
 	if (mp->curcache < mp->maxcache)
 		goto new;
 
 	/*
-	 * If the cache is max'd out, walk the lru list for a buffer we
-	 * can flush.  If we find one, write it (if necessary) and take it
-	 * off any lists.  If we don't find anything we grow the cache anyway.
-	 * The cache never shrinks.
+	 * If the cache is max'd out, advance the hand of the clock for
+	 * a buffer we can flush.  A referenced buffer is given a second
+	 * chance.  If we find one, write it (if necessary) and take it off
+	 * any lists.  If we don't find anything in two rounds we grow the
+	 * cache anyway.  The cache never shrinks.
 	 */
-	for (bp = mp->lqh.cqh_first;
-	    bp != (void *)&mp->lqh; bp = bp->q.cqe_next)
-		if (!(bp->flags & MPOOL_PINNED)) {
-			/* Flush if dirty. */
-			if (bp->flags & MPOOL_DIRTY &&
-			    mpool_write(mp, bp) == RET_ERROR)
-				return (NULL);
+	for (n = 0; n < mp->curcache * 2; n++) {
+		if ((bp = mp->hand) == NULL &&
+		    (bp = mp->lqh.cqh_first) == (void *)&mp->lqh)
+			break;
+		next = bp->q.cqe_next;
+		if (next == (void *)&mp->lqh)
+			next = NULL;
+		if (bp->flags & MPOOL_PINNED) {
+			mp->hand = next;
+			continue;
+		}
+		if (bp->flags & MPOOL_REFERENCED) {
+			bp->flags &= ~MPOOL_REFERENCED;
+			mp->hand = next;
+			continue;
+		}
+		/* Flush if dirty. */
+		if (bp->flags & MPOOL_DIRTY &&
+		    mpool_write(mp, bp) == RET_ERROR)
+			return (NULL);
 #ifdef STATISTICS
-			++mp->pageflush;
+		++mp->pageflush;
 #endif
-			/* Remove from the hash and lru queues. */
-			head = &mp->hqh[HASHKEY(bp->pgno)];
-			CIRCLEQ_REMOVE(head, bp, hq);
-			CIRCLEQ_REMOVE(&mp->lqh, bp, q);
+		/* Remove from the hash chain and the clock ring. */
+		head = &mp->hqh[HASHKEY(mp, bp->pgno)];
+		CIRCLEQ_REMOVE(head, bp, hq);
+		CIRCLEQ_REMOVE(&mp->lqh, bp, q);
+		mp->hand = next;
 #ifdef DEBUG
-			{ void *spage;
-				spage = bp->page;
-				memset(bp, 0xff, sizeof(BKT) + mp->pagesize);
-				bp->page = spage;
-			}
-#endif
-			return (bp);
+		{ void *spage;
+			spage = bp->page;
+			memset(bp, 0xff, sizeof(BKT) + mp->pagesize);
+			bp->page = spage;
 		}
+#endif
+		return (bp);
+	}
 
 new:	if ((bp = (BKT *)malloc(sizeof(BKT) + mp->pagesize)) == NULL)
 		return (NULL);
@@ -418,9 +495,161 @@ new:	if ((bp = (BKT *)malloc(sizeof(BKT) + mp->pagesize)) == NULL)
 #endif
 	bp->page = (char *)bp + sizeof(BKT);
 	++mp->curcache;
+	/* Keep the hash chains short. */
+	if (mp->curcache > mp->hashmask + 1)
+		(void)mpool_rehash(mp, (mp->hashmask + 1) * 2);
 	return (bp);
 }
 
+/**
+ * mpool_rehash
+ *	Resize the hash table.
+ *
+ *	@param mp
+ *	@param size	number of hash chains (power of 2)
+ *
+ * The cached pages are moved into the new hash chains.
+ * If memory is short, the old table is left as is.
+ */
+static int
+mpool_rehash(mp, size)
+	MPOOL *mp;
+	pgno_t size;
+{
+	struct _hqh *hqh;
+	BKT *bp;
+	pgno_t entry;
+
+	if ((hqh = (struct _hqh *)malloc(sizeof(struct _hqh) * size)) == NULL)
+		return (RET_ERROR);
+	for (entry = 0; entry < size; ++entry)
+		CIRCLEQ_INIT(&hqh[entry]);
+	if (mp->hqh != NULL)
+		free(mp->hqh);
+	mp->hqh = hqh;
+	mp->hashmask = size - 1;
+	for (bp = mp->lqh.cqh_first;
+	    bp != (void *)&mp->lqh; bp = bp->q.cqe_next)
+		CIRCLEQ_INSERT_HEAD(&hqh[HASHKEY(mp, bp->pgno)], bp, hq);
+	return (RET_SUCCESS);
+}
+
+/**
+ * mpool_read
+ *	Read pages from disk.
+ *
+ *	@param mp
+ *	@param pgno	first page number
+ *	@param buf	buffer
+ *	@param n	number of pages
+ */
+static int
+mpool_read(mp, pgno, buf, n)
+	MPOOL *mp;
+	pgno_t pgno;
+	void *buf;
+	pgno_t n;
+{
+	size_t size = mp->pagesize * n;
+	off_t off;
+	ssize_t nr;
+
+	/*
+	 * If both of `off_t' and `long' are 32 bits, the right operand
+	 * of the multiplication is converted to `unsigned long',
+	 * and the multiplication is done with unsigned 32 bits.
+	 * It is equivalent to the case without cast.
+	 *
+	 * If `off_t' is 64 bits and `long' is 32 bits, the left operand
+	 * of the multiplication is converted to `off_t',
+	 * and the multiplication is done with signed 64 bits.
+	 * Adding cast avoids integer overflow.
+	 *
+	 * If both of `off_t' and `long' are 64 bits, the right operand
+	 * of the multiplication is converted to `unsigned long',
+	 * and the multiplication is done with unsigned 64 bits.
+	 * It is equivalent to the case without cast.
+	 */
+	off = mp->pagesize * (off_t)pgno;
+
+#ifdef HAVE_PREAD
+	if ((nr = pread(mp->fd, buf, size, off)) != size) {
+		if (nr >= 0)
+			errno = EFTYPE;
+		return (RET_ERROR);
+	}
+#else
+	if (lseek(mp->fd, off, SEEK_SET) != off)
+		return (RET_ERROR);
+	if ((nr = read(mp->fd, buf, size)) != size) {
+		if (nr >= 0)
+			errno = EFTYPE;
+		return (RET_ERROR);
+	}
+#endif
+	return (RET_SUCCESS);
+}
+
+/**
+ * mpool_readahead
+ *	Read the following pages into the cache with a single read.
+ *
+ *	@param mp
+ *	@param pgno	first page number
+ *
+ * Reading stops at a page which is already cached.  At most 1/8 of
+ * the cache is used, not to push out the pages in use.
+ */
+static int
+mpool_readahead(mp, pgno)
+	MPOOL *mp;
+	pgno_t pgno;
+{
+	struct _hqh *head;
+	BKT *bp;
+	pgno_t i, n, max;
+
+	max = mp->maxcache / 8;
+	if (max > READAHEAD_PAGES)
+		max = READAHEAD_PAGES;
+	for (n = 0; n < max && pgno + n < mp->npages; n++)
+		if (mpool_find(mp, pgno + n) != NULL)
+			break;
+	if (n == 0)
+		return (RET_SUCCESS);
+	if (mp->rabuf == NULL &&
+	    (mp->rabuf = malloc(mp->pagesize * READAHEAD_PAGES)) == NULL)
+		return (RET_ERROR);
+	if (mpool_read(mp, pgno, mp->rabuf, n) == RET_ERROR)
+		return (RET_ERROR);
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+	/* Let the system prepare the next chunk while we use this one. */
+	(void)posix_fadvise(mp->fd, mp->pagesize * (off_t)(pgno + n),
+	    mp->pagesize * (off_t)n, POSIX_FADV_WILLNEED);
+#endif
+	for (i = 0; i < n; i++) {
+		if ((bp = mpool_bkt(mp)) == NULL)
+			return (RET_ERROR);
+#ifdef STATISTICS
+		++mp->pagereadahead;
+#endif
+		memcpy(bp->page, mp->rabuf + mp->pagesize * i, mp->pagesize);
+		bp->pgno = pgno + i;
+		/* Not referenced, so that it is evicted first if not used. */
+		bp->flags = 0;
+		head = &mp->hqh[HASHKEY(mp, bp->pgno)];
+		CIRCLEQ_INSERT_HEAD(head, bp, hq);
+		if (mp->hand)
+			CIRCLEQ_INSERT_BEFORE(&mp->lqh, mp->hand, bp, q);
+		else
+			CIRCLEQ_INSERT_TAIL(&mp->lqh, bp, q);
+		if (mp->pgin != NULL)
+			(mp->pgin)(mp->pgcookie, bp->pgno, bp->page);
+		mp->lastread = bp->pgno;
+	}
+	return (RET_SUCCESS);
+}
+
 /**
  * mpool_write
  *	Write a page to disk.
@@ -443,7 +672,7 @@ mpool_write(mp, bp)
 	if (mp->pgout)
 		(mp->pgout)(mp->pgcookie, bp->pgno, bp->page);
 
-	/* See the comment in mpool_get for cast addition. */
+	/* See the comment in mpool_read for cast addition. */
 	off = mp->pagesize * (off_t)bp->pgno;
 
 #ifdef HAVE_PWRITE
@@ -460,6 +689,28 @@ mpool_write(mp, bp)
 	return (RET_SUCCESS);
 }
 
+/**
+ * mpool_find
+ *	Find a page in the cache.
+ *
+ *	@param mp
+ *	@param pgno
+ */
+static BKT *
+mpool_find(mp, pgno)
+	MPOOL *mp;
+	pgno_t pgno;
+{
+	struct _hqh *head;
+	BKT *bp;
+
+	head = &mp->hqh[HASHKEY(mp, pgno)];
+	for (bp = head->cqh_first; bp != (void *)head; bp = bp->hq.cqe_next)
+		if (bp->pgno == pgno)
+			return (bp);
+	return (NULL);
+}
+
 /**
  * mpool_look
  *	Lookup a page in the cache.
@@ -472,17 +723,14 @@ mpool_look(mp, pgno)
 	MPOOL *mp;
 	pgno_t pgno;
 {
-	struct _hqh *head;
 	BKT *bp;
 
-	head = &mp->hqh[HASHKEY(pgno)];
-	for (bp = head->cqh_first; bp != (void *)head; bp = bp->hq.cqe_next)
-		if (bp->pgno == pgno) {
+	if ((bp = mpool_find(mp, pgno)) != NULL) {
 #ifdef STATISTICS
-			++mp->cachehit;
+		++mp->cachehit;
 #endif
-			return (bp);
-		}
+		return (bp);
+	}
 #ifdef STATISTICS
 	++mp->cachemiss;
 #endif
@@ -517,8 +765,13 @@ mpool_stat(mp)
 		    "%.0f%% cache hit rate (%lu hits, %lu misses)\n", 
 		    ((double)mp->cachehit / (mp->cachehit + mp->cachemiss))
 		    * 100, mp->cachehit, mp->cachemiss);
-	(void)fprintf(stderr, "%lu page reads, %lu page writes\n",
-	    mp->pageread, mp->pagewrite);
+	(void)fprintf(stderr, "%lu page reads, %lu pages read ahead, %lu page writes\n",
+	    mp->pageread, mp->pagereadahead, mp->pagewrite);
+	(void)fprintf(stderr, "%lu hash chains\n",
+	    (long unsigned int)mp->hashmask + 1);
+	if (mp->map != NULL)
+		(void)fprintf(stderr, "mapped %lu bytes\n",
+		    (long unsigned int)mp->mapsize);
 
 	sep = "";
 	cnt = 0;
@@ -529,6 +782,8 @@ mpool_stat(mp)
 			(void)fprintf(stderr, "d");
 		if (bp->flags & MPOOL_PINNED)
 			(void)fprintf(stderr, "P");
+		if (bp->flags & MPOOL_REFERENCED)
+			(void)fprintf(stderr, "r");
 		if (++cnt == 10) {
 			sep = "\n";
 			cnt = 0;
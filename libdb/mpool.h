@@ -33,18 +33,41 @@
 
 /**
  * The memory pool scheme is a simple one.  Each in-memory page is referenced
- * by a bucket which is threaded in up to two of three ways.  All active pages
- * are threaded on a hash chain (hashed by page number) and an lru chain.
- * Inactive pages are threaded on a free chain.  Each reference to a memory
- * pool is handed an opaque MPOOL cookie which stores all of this information.
+ * by a bucket which is threaded in two ways.  All active pages are threaded
+ * on a hash chain (hashed by page number) and a clock ring.  Each reference
+ * to a memory pool is handed an opaque MPOOL cookie which stores all of this
+ * information.
+ *
+ * The hash table starts with HASHSIZE chains and is doubled whenever the
+ * number of cached pages exceeds the number of chains, so that chains stay
+ * short for a large cache.
+ *
+ * A page is evicted by the CLOCK (second chance) algorithm.  A cache hit
+ * only sets MPOOL_REFERENCED of the bucket, and the hand of the clock clears
+ * it when passing the bucket.  A bucket which the hand finds unpinned and
+ * unreferenced is reused.
+ *
+ * When pages are missed in ascending order, the following pages are read
+ * Pages read ahead are not referenced
+ * and are evicted first if they are not used.
+ *
+ * A read-only file can be mapped into memory by mpool_map().  Then no page
+ * is cached; mpool_get() returns the address of the page in the mapping,
+ * and the pages are shared with other processes through the page cache of
+ * the system.
  */
 #define	HASHSIZE	128
-#define	HASHKEY(pgno)	((pgno - 1) % HASHSIZE)
+#define	HASHKEY(mp, pgno)	((pgno) & (mp)->hashmask)
+
+/** Number of sequential misses to start reading ahead. */
+#define	READAHEAD_TRIGGER	2
+/** Max number of pages read at once. */
+#define	READAHEAD_PAGES		16
 
 /** The BKT structures are the elements of the queues. */
 typedef struct _bkt {
 	CIRCLEQ_ENTRY(_bkt) hq;		/**< hash queue */
-	CIRCLEQ_ENTRY(_bkt) q;		/**< lru queue */
+	CIRCLEQ_ENTRY(_bkt) q;		/**< clock ring */
 	void    *page;			/**< page */
 	pgno_t   pgno;			/**< page number */
 
@@ -52,25 +75,34 @@ typedef struct _bkt {
 #define	MPOOL_DIRTY	0x01
 			/** page is pinned into memory */
 #define	MPOOL_PINNED	0x02
+			/** page was used since the hand passed */
+#define	MPOOL_REFERENCED	0x04
 	u_int8_t flags;			/**< flags */
 } BKT;
 
 typedef struct MPOOL {
 
 #ifndef IS__DOXYGEN_
-	CIRCLEQ_HEAD(_lqh, _bkt) lqh;	/**< lru queue head */
+	CIRCLEQ_HEAD(_lqh, _bkt) lqh;	/**< clock ring head */
 					/** hash queue array */
-	CIRCLEQ_HEAD(_hqh, _bkt) hqh[HASHSIZE];
+	CIRCLEQ_HEAD(_hqh, _bkt) *hqh;
 #else
 	struct _lqh {
 		struct _bkt *cqh_first;
 		struct _bkt *cqh_last;
-	} lqh;							/**< lru queue head */
+	} lqh;							/**< clock ring head */
 	struct _hqh {
 		struct _bkt *cqh_first;
 		struct _bkt *cqh_last;
-	} hqh[HASHSIZE];				/**< hash queue array */
+	} *hqh;							/**< hash queue array */
 #endif
+	pgno_t	hashmask;		/**< number of hash chains - 1 */
+	BKT	*hand;			/**< hand of the clock, NULL: first */
+	pgno_t	lastread;		/**< page number read last */
+	int	seqread;		/**< number of sequential misses */
+	char	*rabuf;			/**< buffer for reading ahead */
+	char	*map;			/**< mapped file, NULL: not mapped */
+	size_t	mapsize;		/**< size of the mapping */
 	pgno_t	curcache;		/**< current number of cached pages */
 	pgno_t	maxcache;		/**< max number of cached pages */
 	pgno_t	npages;			/**< number of pages in the file */
@@ -90,6 +122,7 @@ typedef struct MPOOL {
 	u_long	pagenew;
 	u_long	pageput;
 	u_long	pageread;
+	u_long	pagereadahead;
 	u_long	pagewrite;
 #endif
 } MPOOL;
@@ -97,6 +130,7 @@ typedef struct MPOOL {
 MPOOL	*mpool_open(void *, int, pgno_t, pgno_t);
 void	 mpool_filter(MPOOL *, void (*)(void *, pgno_t, void *),
 	    void (*)(void *, pgno_t, void *), void *);
+int	 mpool_map(MPOOL *);
 void	*mpool_new(MPOOL *, pgno_t *);
 void	*mpool_get(MPOOL *, pgno_t, u_int);
 int	 mpool_put(MPOOL *, void *, u_int);
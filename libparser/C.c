@@ -51,20 +51,6 @@ static int enumerator_list(const struct parser_param *);
 #define TYPE_LEX	1
 #define TYPE_YACC	2
 
-#define MAXPIFSTACK	100
-
-/*
- * #ifdef stack.
- */
-static struct {
-	short start;		/* level when '#if' block started */
-	short end;		/* level when '#if' block end */
-	short if0only;		/* '#if 0' or notdef only */
-} stack[MAXPIFSTACK], *cur;
-static int piflevel;		/* condition macro level */
-static int level;		/* brace level */
-static int externclevel;	/* 'extern "C"' block level */
-
 /**
  * yacc: read yacc file and pickup tag entries.
  */
@@ -88,6 +74,8 @@ C(const struct parser_param *param)
 static void
 C_family(const struct parser_param *param, int type)
 {
+	struct parser_ctx *ctx = param->ctx;
+	TOKEN *tk;
 	int c, cc;
 	int savelevel;
 	int startmacro, startsharp;
@@ -106,32 +94,32 @@ C_family(const struct parser_param *param, int type)
 	int yaccstatus = (type == TYPE_YACC) ? DECLARATIONS : PROGRAMS;
 	int inC = (type == TYPE_YACC) ? 0 : 1;	/* 1 while C source */
 
-	level = piflevel = externclevel = 0;
+	ctx->level = ctx->piflevel = ctx->externclevel = 0;
 	savelevel = -1;
 	startmacro = startsharp = 0;
 
-	if (!opentoken(param->file))
+	if ((tk = ctx->tk = opentoken(param->file)) == NULL)
 		die("'%s' cannot open.", param->file);
-	cmode = 1;			/* allow token like '#xxx' */
-	crflag = 1;			/* require '\n' as a token */
+	tk->cmode = 1;			/* allow token like '#xxx' */
+	tk->crflag = 1;			/* require '\n' as a token */
 	if (type == TYPE_YACC)
-		ymode = 1;		/* allow token like '%xxx' */
+		tk->ymode = 1;		/* allow token like '%xxx' */
 
-	while ((cc = nexttoken(interested, c_reserved_word)) != EOF) {
+	while ((cc = nexttoken(tk, interested, c_reserved_word)) != EOF) {
 		switch (cc) {
 		case SYMBOL:		/* symbol	*/
-			if (inC && peekc(0) == '('/* ) */) {
-				if (param->isnotfunction(token)) {
-					PUT(PARSER_REF_SYM, token, lineno, sp);
-				} else if (level > 0 || startmacro) {
-					PUT(PARSER_REF_SYM, token, lineno, sp);
-				} else if (level == 0 && !startmacro && !startsharp) {
+			if (inC && peekc(tk, 0) == '('/* ) */) {
+				if (param->isnotfunction(tk->token)) {
+					PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
+				} else if (ctx->level > 0 || startmacro) {
+					PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
+				} else if (ctx->level == 0 && !startmacro && !startsharp) {
 					char arg1[MAXTOKEN], savetok[MAXTOKEN], *saveline;
-					int savelineno = lineno;
+					int savelineno = tk->lineno;
 
-					strlimcpy(savetok, token, sizeof(savetok));
+					strlimcpy(savetok, tk->token, sizeof(savetok));
 					strbuf_reset(sb);
-					strbuf_puts(sb, sp);
+					strbuf_puts(sb, lineimage(tk));
 					saveline = strbuf_value(sb);
 					arg1[0] = '\0';
 					/*
@@ -157,83 +145,83 @@ C_family(const struct parser_param *param, int type)
 					}
 				}
 			} else {
-				PUT(PARSER_REF_SYM, token, lineno, sp);
+				PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 			}
 			break;
 		case '{':  /* } */
-			DBG_PRINT(level, "{"); /* } */
-			if (yaccstatus == RULES && level == 0)
+			DBG_PRINT(ctx->level, "{"); /* } */
+			if (yaccstatus == RULES && ctx->level == 0)
 				inC = 1;
-			++level;
-			if ((param->flags & PARSER_BEGIN_BLOCK) && atfirst) {
-				if ((param->flags & PARSER_WARNING) && level != 1)
-					warning("forced level 1 block start by '{' at column 0 [+%d %s].", lineno, curfile); /* } */
-				level = 1;
+			++ctx->level;
+			if ((param->flags & PARSER_BEGIN_BLOCK) && atfirst(tk)) {
+				if ((param->flags & PARSER_WARNING) && ctx->level != 1)
+					warning("forced level 1 block start by '{' at column 0 [+%d %s].", tk->lineno, tk->curfile); /* } */
+				ctx->level = 1;
 			}
 			break;
 			/* { */
 		case '}':
-			if (--level < 0) {
-				if (externclevel > 0)
-					externclevel--;
+			if (--ctx->level < 0) {
+				if (ctx->externclevel > 0)
+					ctx->externclevel--;
 				else if (param->flags & PARSER_WARNING)
-					warning("missing left '{' [+%d %s].", lineno, curfile); /* } */
-				level = 0;
+					warning("missing left '{' [+%d %s].", tk->lineno, tk->curfile); /* } */
+				ctx->level = 0;
 			}
-			if ((param->flags & PARSER_END_BLOCK) && atfirst) {
-				if ((param->flags & PARSER_WARNING) && level != 0) /* { */
-					warning("forced level 0 block end by '}' at column 0 [+%d %s].", lineno, curfile);
-				level = 0;
+			if ((param->flags & PARSER_END_BLOCK) && atfirst(tk)) {
+				if ((param->flags & PARSER_WARNING) && ctx->level != 0) /* { */
+					warning("forced level 0 block end by '}' at column 0 [+%d %s].", tk->lineno, tk->curfile);
+				ctx->level = 0;
 			}
-			if (yaccstatus == RULES && level == 0)
+			if (yaccstatus == RULES && ctx->level == 0)
 				inC = 0;
 			/* { */
-			DBG_PRINT(level, "}");
+			DBG_PRINT(ctx->level, "}");
 			break;
 		case '\n':
-			if (startmacro && level != savelevel) {
+			if (startmacro && ctx->level != savelevel) {
 				if (param->flags & PARSER_WARNING)
-					warning("different level before and after #define macro. reseted. [+%d %s].", lineno, curfile);
-				level = savelevel;
+					warning("different level before and after #define macro. reseted. [+%d %s].", tk->lineno, tk->curfile);
+				ctx->level = savelevel;
 			}
 			startmacro = startsharp = 0;
 			break;
 		case YACC_SEP:		/* %% */
-			if (level != 0) {
+			if (ctx->level != 0) {
 				if (param->flags & PARSER_WARNING)
-					warning("forced level 0 block end by '%%' [+%d %s].", lineno, curfile);
-				level = 0;
+					warning("forced level 0 block end by '%%' [+%d %s].", tk->lineno, tk->curfile);
+				ctx->level = 0;
 			}
 			if (yaccstatus == DECLARATIONS) {
-				PUT(PARSER_DEF, "yyparse", lineno, sp);
+				PUT(PARSER_DEF, "yyparse", tk->lineno, lineimage(tk));
 				yaccstatus = RULES;
 			} else if (yaccstatus == RULES)
 				yaccstatus = PROGRAMS;
 			inC = (yaccstatus == PROGRAMS) ? 1 : 0;
 			break;
 		case YACC_BEGIN:	/* %{ */
-			if (level != 0) {
+			if (ctx->level != 0) {
 				if (param->flags & PARSER_WARNING)
-					warning("forced level 0 block end by '%%{' [+%d %s].", lineno, curfile);
-				level = 0;
+					warning("forced level 0 block end by '%%{' [+%d %s].", tk->lineno, tk->curfile);
+				ctx->level = 0;
 			}
 			if (inC == 1 && (param->flags & PARSER_WARNING))
-				warning("'%%{' appeared in C mode. [+%d %s].", lineno, curfile);
+				warning("'%%{' appeared in C mode. [+%d %s].", tk->lineno, tk->curfile);
 			inC = 1;
 			break;
 		case YACC_END:		/* %} */
-			if (level != 0) {
+			if (ctx->level != 0) {
 				if (param->flags & PARSER_WARNING)
-					warning("forced level 0 block end by '%%}' [+%d %s].", lineno, curfile);
-				level = 0;
+					warning("forced level 0 block end by '%%}' [+%d %s].", tk->lineno, tk->curfile);
+				ctx->level = 0;
 			}
 			if (inC == 0 && (param->flags & PARSER_WARNING))
-				warning("'%%}' appeared in Yacc mode. [+%d %s].", lineno, curfile);
+				warning("'%%}' appeared in Yacc mode. [+%d %s].", tk->lineno, tk->curfile);
 			inC = 0;
 			break;
 		case YACC_UNION:	/* %union {...} */
 			if (yaccstatus == DECLARATIONS)
-				PUT(PARSER_DEF, "YYSTYPE", lineno, sp);
+				PUT(PARSER_DEF, "YYSTYPE", tk->lineno, lineimage(tk));
 			break;
 		/*
 		 * #xxx
@@ -241,20 +229,20 @@ C_family(const struct parser_param *param, int type)
 		case SHARP_DEFINE:
 		case SHARP_UNDEF:
 			startmacro = 1;
-			savelevel = level;
-			if ((c = nexttoken(interested, c_reserved_word)) != SYMBOL) {
-				pushbacktoken();
+			savelevel = ctx->level;
+			if ((c = nexttoken(tk, interested, c_reserved_word)) != SYMBOL) {
+				pushbacktoken(tk);
 				break;
 			}
-			if (peekc(1) == '('/* ) */) {
-				PUT(PARSER_DEF, token, lineno, sp);
-				while ((c = nexttoken("()", c_reserved_word)) != EOF && c != '\n' && c != /* ( */ ')')
+			if (peekc(tk, 1) == '('/* ) */) {
+				PUT(PARSER_DEF, tk->token, tk->lineno, lineimage(tk));
+				while ((c = nexttoken(tk, "()", c_reserved_word)) != EOF && c != '\n' && c != /* ( */ ')')
 					if (c == SYMBOL)
-						PUT(PARSER_REF_SYM, token, lineno, sp);
+						PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 				if (c == '\n')
-					pushbacktoken();
+					pushbacktoken(tk);
 			} else {
-				PUT(PARSER_DEF, token, lineno, sp);
+				PUT(PARSER_DEF, tk->token, tk->lineno, lineimage(tk));
 			}
 			break;
 		case SHARP_IMPORT:
@@ -266,7 +254,7 @@ C_family(const struct parser_param *param, int type)
 		case SHARP_WARNING:
 		case SHARP_IDENT:
 		case SHARP_SCCS:
-			while ((c = nexttoken(interested, c_reserved_word)) != EOF && c != '\n')
+			while ((c = nexttoken(tk, interested, c_reserved_word)) != EOF && c != '\n')
 				;
 			break;
 		case SHARP_IFDEF:
@@ -278,43 +266,43 @@ C_family(const struct parser_param *param, int type)
 			condition_macro(param, cc);
 			break;
 		case SHARP_SHARP:		/* ## */
-			(void)nexttoken(interested, c_reserved_word);
+			(void)nexttoken(tk, interested, c_reserved_word);
 			break;
 		case C_EXTERN: /* for 'extern "C"/"C++"' */
-			if (peekc(0) != '"') /* " */
+			if (peekc(tk, 0) != '"') /* " */
 				continue; /* If does not start with '"', continue. */
-			while ((c = nexttoken(interested, c_reserved_word)) == '\n')
+			while ((c = nexttoken(tk, interested, c_reserved_word)) == '\n')
 				;
 			/*
 			 * 'extern "C"/"C++"' block is a kind of namespace block.
 			 * (It doesn't have any influence on level.)
 			 */
 			if (c == '{') /* } */
-				externclevel++;
+				ctx->externclevel++;
 			else
-				pushbacktoken();
+				pushbacktoken(tk);
 			break;
 		case C_STRUCT:
 		case C_ENUM:
 		case C_UNION:
-			while ((c = nexttoken(interested, c_reserved_word)) == C___ATTRIBUTE__)
+			while ((c = nexttoken(tk, interested, c_reserved_word)) == C___ATTRIBUTE__)
 				process_attribute(param);
 			while (c == '\n')
-				c = nexttoken(interested, c_reserved_word);
+				c = nexttoken(tk, interested, c_reserved_word);
 			if (c == SYMBOL) {
-				if (peekc(0) == '{') /* } */ {
-					PUT(PARSER_DEF, token, lineno, sp);
+				if (peekc(tk, 0) == '{') /* } */ {
+					PUT(PARSER_DEF, tk->token, tk->lineno, lineimage(tk));
 				} else {
-					PUT(PARSER_REF_SYM, token, lineno, sp);
+					PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 				}
-				c = nexttoken(interested, c_reserved_word);
+				c = nexttoken(tk, interested, c_reserved_word);
 			}
 			while (c == '\n')
-				c = nexttoken(interested, c_reserved_word);
+				c = nexttoken(tk, interested, c_reserved_word);
 			if (c == '{' /* } */ && cc == C_ENUM) {
 				enumerator_list(param);
 			} else {
-				pushbacktoken();
+				pushbacktoken(tk);
 			}
 			break;
 		/* control statement check */
@@ -330,8 +318,8 @@ C_family(const struct parser_param *param, int type)
 		case C_RETURN:
 		case C_SWITCH:
 		case C_WHILE:
-			if ((param->flags & PARSER_WARNING) && !startmacro && level == 0)
-				warning("Out of function. %8s [+%d %s]", token, lineno, curfile);
+			if ((param->flags & PARSER_WARNING) && !startmacro && ctx->level == 0)
+				warning("Out of function. %8s [+%d %s]", tk->token, tk->lineno, tk->curfile);
 			break;
 		case C_TYPEDEF:
 			{
@@ -341,44 +329,44 @@ C_family(const struct parser_param *param, int type)
 				 */
 				char savetok[MAXTOKEN];
 				int savelineno = 0;
-				int typedef_savelevel = level;
+				int typedef_savelevel = ctx->level;
 
 				savetok[0] = 0;
 
 				/* skip type qualifiers */
 				do {
-					c = nexttoken("{}(),;", c_reserved_word);
+					c = nexttoken(tk, "{}(),;", c_reserved_word);
 				} while (IS_TYPE_QUALIFIER(c) || c == '\n');
 
 				if ((param->flags & PARSER_WARNING) && c == EOF) {
-					warning("unexpected eof. [+%d %s]", lineno, curfile);
+					warning("unexpected eof. [+%d %s]", tk->lineno, tk->curfile);
 					break;
 				} else if (c == C_ENUM || c == C_STRUCT || c == C_UNION) {
 					char *interest_enum = "{},;";
 					int c_ = c;
 
-					while ((c = nexttoken(interest_enum, c_reserved_word)) == C___ATTRIBUTE__)
+					while ((c = nexttoken(tk, interest_enum, c_reserved_word)) == C___ATTRIBUTE__)
 						process_attribute(param);
 					while (c == '\n')
-						c = nexttoken(interest_enum, c_reserved_word);
+						c = nexttoken(tk, interest_enum, c_reserved_word);
 					/* read tag name if exist */
 					if (c == SYMBOL) {
-						if (peekc(0) == '{') /* } */ {
-							PUT(PARSER_DEF, token, lineno, sp);
+						if (peekc(tk, 0) == '{') /* } */ {
+							PUT(PARSER_DEF, tk->token, tk->lineno, lineimage(tk));
 						} else {
-							PUT(PARSER_REF_SYM, token, lineno, sp);
+							PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 						}
-						c = nexttoken(interest_enum, c_reserved_word);
+						c = nexttoken(tk, interest_enum, c_reserved_word);
 					}
 					while (c == '\n')
-						c = nexttoken(interest_enum, c_reserved_word);
+						c = nexttoken(tk, interest_enum, c_reserved_word);
 					if (c_ == C_ENUM) {
 						if (c == '{') /* } */
 							c = enumerator_list(param);
 						else
-							pushbacktoken();
+							pushbacktoken(tk);
 					} else {
-						for (; c != EOF; c = nexttoken(interest_enum, c_reserved_word)) {
+						for (; c != EOF; c = nexttoken(tk, interest_enum, c_reserved_word)) {
 							switch (c) {
 							case SHARP_IFDEF:
 							case SHARP_IFNDEF:
@@ -391,38 +379,38 @@ C_family(const struct parser_param *param, int type)
 							default:
 								break;
 							}
-							if (c == ';' && level == typedef_savelevel) {
+							if (c == ';' && ctx->level == typedef_savelevel) {
 								if (savetok[0]) {
-									PUT(PARSER_DEF, savetok, savelineno, sp);
+									PUT(PARSER_DEF, savetok, savelineno, lineimage(tk));
 									savetok[0] = 0;
 								}
 								break;
 							} else if (c == '{')
-								level++;
+								ctx->level++;
 							else if (c == '}') {
 								savetok[0] = 0;
-								if (--level == typedef_savelevel)
+								if (--ctx->level == typedef_savelevel)
 									break;
 							} else if (c == SYMBOL) {
-								if (level > typedef_savelevel)
-									PUT(PARSER_REF_SYM, token, lineno, sp);
+								if (ctx->level > typedef_savelevel)
+									PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 								/* save lastest token */
-								strlimcpy(savetok, token, sizeof(savetok));
-								savelineno = lineno;
+								strlimcpy(savetok, tk->token, sizeof(savetok));
+								savelineno = tk->lineno;
 							}
 						}
 						if (c == ';')
 							break;
 					}
 					if ((param->flags & PARSER_WARNING) && c == EOF) {
-						warning("unexpected eof. [+%d %s]", lineno, curfile);
+						warning("unexpected eof. [+%d %s]", tk->lineno, tk->curfile);
 						break;
 					}
 				} else if (c == SYMBOL) {
-					PUT(PARSER_REF_SYM, token, lineno, sp);
+					PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 				}
 				savetok[0] = 0;
-				while ((c = nexttoken("(),;", c_reserved_word)) != EOF) {
+				while ((c = nexttoken(tk, "(),;", c_reserved_word)) != EOF) {
 					switch (c) {
 					case SHARP_IFDEF:
 					case SHARP_IFNDEF:
@@ -436,35 +424,35 @@ C_family(const struct parser_param *param, int type)
 						break;
 					}
 					if (c == '(')
-						level++;
+						ctx->level++;
 					else if (c == ')')
-						level--;
+						ctx->level--;
 					else if (c == SYMBOL) {
-						if (level > typedef_savelevel) {
-							PUT(PARSER_REF_SYM, token, lineno, sp);
+						if (ctx->level > typedef_savelevel) {
+							PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 						} else {
 							/* put latest token if any */
 							if (savetok[0]) {
-								PUT(PARSER_REF_SYM, savetok, savelineno, sp);
+								PUT(PARSER_REF_SYM, savetok, savelineno, lineimage(tk));
 							}
 							/* save lastest token */
-							strlimcpy(savetok, token, sizeof(savetok));
-							savelineno = lineno;
+							strlimcpy(savetok, tk->token, sizeof(savetok));
+							savelineno = tk->lineno;
 						}
 					} else if (c == ',' || c == ';') {
 						if (savetok[0]) {
-							PUT(PARSER_DEF, savetok, lineno, sp);
+							PUT(PARSER_DEF, savetok, tk->lineno, lineimage(tk));
 							savetok[0] = 0;
 						}
 					}
-					if (level == typedef_savelevel && c == ';')
+					if (ctx->level == typedef_savelevel && c == ';')
 						break;
 				}
 				if (param->flags & PARSER_WARNING) {
 					if (c == EOF)
-						warning("unexpected eof. [+%d %s]", lineno, curfile);
-					else if (level != typedef_savelevel)
-						warning("unmatched () block. (last at level %d.)[+%d %s]", level, lineno, curfile);
+						warning("unexpected eof. [+%d %s]", tk->lineno, tk->curfile);
+					else if (ctx->level != typedef_savelevel)
+						warning("unmatched () block. (last at level %d.)[+%d %s]", ctx->level, tk->lineno, tk->curfile);
 				}
 			}
 			break;
@@ -477,12 +465,12 @@ C_family(const struct parser_param *param, int type)
 	}
 	strbuf_close(sb);
 	if (param->flags & PARSER_WARNING) {
-		if (level != 0)
-			warning("unmatched {} block. (last at level %d.)[+%d %s]", level, lineno, curfile);
-		if (piflevel != 0)
-			warning("unmatched #if block. (last at level %d.)[+%d %s]", piflevel, lineno, curfile);
+		if (ctx->level != 0)
+			warning("unmatched {} block. (last at level %d.)[+%d %s]", ctx->level, tk->lineno, tk->curfile);
+		if (ctx->piflevel != 0)
+			warning("unmatched #if block. (last at level %d.)[+%d %s]", ctx->piflevel, tk->lineno, tk->curfile);
 	}
-	closetoken();
+	closetoken(tk);
 }
 /**
  * process_attribute: skip attributes in '__attribute__((...))'.
@@ -490,19 +478,20 @@ C_family(const struct parser_param *param, int type)
 static void
 process_attribute(const struct parser_param *param)
 {
+	TOKEN *tk = param->ctx->tk;
 	int brace = 0;
 	int c;
 	/*
 	 * Skip '...' in __attribute__((...))
 	 * but pick up symbols in it.
 	 */
-	while ((c = nexttoken("()", c_reserved_word)) != EOF) {
+	while ((c = nexttoken(tk, "()", c_reserved_word)) != EOF) {
 		if (c == '(')
 			brace++;
 		else if (c == ')')
 			brace--;
 		else if (c == SYMBOL) {
-			PUT(PARSER_REF_SYM, token, lineno, sp);
+			PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 		}
 		if (brace == 0)
 			break;
@@ -518,12 +507,13 @@ process_attribute(const struct parser_param *param)
 static int
 function_definition(const struct parser_param *param, char arg1[MAXTOKEN])
 {
+	TOKEN *tk = param->ctx->tk;
 	int c;
 	int brace_level, isdefine;
 	int accept_arg1 = 0;
 
 	brace_level = isdefine = 0;
-	while ((c = nexttoken("()", c_reserved_word)) != EOF) {
+	while ((c = nexttoken(tk, "()", c_reserved_word)) != EOF) {
 		switch (c) {
 		case SHARP_IFDEF:
 		case SHARP_IFNDEF:
@@ -546,15 +536,15 @@ function_definition(const struct parser_param *param, char arg1[MAXTOKEN])
 		if (c == SYMBOL) {
 			if (accept_arg1 == 0) {
 				accept_arg1 = 1;
-				strlimcpy(arg1, token, MAXTOKEN);
+				strlimcpy(arg1, tk->token, MAXTOKEN);
 			}
-			PUT(PARSER_REF_SYM, token, lineno, sp);
+			PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 		}
 	}
 	if (c == EOF)
 		return 0;
 	brace_level = 0;
-	while ((c = nexttoken(",;[](){}=", c_reserved_word)) != EOF) {
+	while ((c = nexttoken(tk, ",;[](){}=", c_reserved_word)) != EOF) {
 		switch (c) {
 		case SHARP_IFDEF:
 		case SHARP_IFNDEF:
@@ -568,7 +558,7 @@ function_definition(const struct parser_param *param, char arg1[MAXTOKEN])
 			process_attribute(param);
 			continue;
 		case SHARP_DEFINE:
-			pushbacktoken();
+			pushbacktoken(tk);
 			return 0;
 		default:
 			break;
@@ -578,13 +568,13 @@ function_definition(const struct parser_param *param, char arg1[MAXTOKEN])
 		else if (c == /* ( */')' || c == ']')
 			brace_level--;
 		else if (brace_level == 0
-		    && ((c == SYMBOL && strcmp(token, "__THROW")) || IS_RESERVED_WORD(c)))
+		    && ((c == SYMBOL && strcmp(tk->token, "__THROW")) || IS_RESERVED_WORD(c)))
 			isdefine = 1;
 		else if (c == ';' || c == ',') {
 			if (!isdefine)
 				break;
 		} else if (c == '{' /* } */) {
-			pushbacktoken();
+			pushbacktoken(tk);
 			return 1;
 		} else if (c == /* { */'}')
 			break;
@@ -593,7 +583,7 @@ function_definition(const struct parser_param *param, char arg1[MAXTOKEN])
 
 		/* pick up symbol */
 		if (c == SYMBOL)
-			PUT(PARSER_REF_SYM, token, lineno, sp);
+			PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 	}
 	return 0;
 }
@@ -607,54 +597,56 @@ function_definition(const struct parser_param *param, char arg1[MAXTOKEN])
 static void
 condition_macro(const struct parser_param *param, int cc)
 {
-	cur = &stack[piflevel];
+	struct parser_ctx *ctx = param->ctx;
+	TOKEN *tk = ctx->tk;
+	ctx->cur = &ctx->pifstack[ctx->piflevel];
 	if (cc == SHARP_IFDEF || cc == SHARP_IFNDEF || cc == SHARP_IF) {
-		DBG_PRINT(piflevel, "#if");
-		if (++piflevel >= MAXPIFSTACK)
-			die("#if stack over flow. [%s]", curfile);
-		++cur;
-		cur->start = level;
-		cur->end = -1;
-		cur->if0only = 0;
-		if (peekc(0) == '0')
-			cur->if0only = 1;
-		else if ((cc = nexttoken(NULL, c_reserved_word)) == SYMBOL && !strcmp(token, "notdef"))
-			cur->if0only = 1;
+		DBG_PRINT(ctx->piflevel, "#if");
+		if (++ctx->piflevel >= MAXPIFSTACK)
+			die("#if stack over flow. [%s]", tk->curfile);
+		++ctx->cur;
+		ctx->cur->start = ctx->level;
+		ctx->cur->end = -1;
+		ctx->cur->if0only = 0;
+		if (peekc(tk, 0) == '0')
+			ctx->cur->if0only = 1;
+		else if ((cc = nexttoken(tk, NULL, c_reserved_word)) == SYMBOL && !strcmp(tk->token, "notdef"))
+			ctx->cur->if0only = 1;
 		else
-			pushbacktoken();
+			pushbacktoken(tk);
 	} else if (cc == SHARP_ELIF || cc == SHARP_ELSE) {
-		DBG_PRINT(piflevel - 1, "#else");
-		if (cur->end == -1)
-			cur->end = level;
-		else if (cur->end != level && (param->flags & PARSER_WARNING))
-			warning("uneven level. [+%d %s]", lineno, curfile);
-		level = cur->start;
-		cur->if0only = 0;
+		DBG_PRINT(ctx->piflevel - 1, "#else");
+		if (ctx->cur->end == -1)
+			ctx->cur->end = ctx->level;
+		else if (ctx->cur->end != ctx->level && (param->flags & PARSER_WARNING))
+			warning("uneven level. [+%d %s]", tk->lineno, tk->curfile);
+		ctx->level = ctx->cur->start;
+		ctx->cur->if0only = 0;
 	} else if (cc == SHARP_ENDIF) {
 		int minus = 0;
 
-		--piflevel;
-		if (piflevel < 0) {
+		--ctx->piflevel;
+		if (ctx->piflevel < 0) {
 			minus = 1;
-			piflevel = 0;
+			ctx->piflevel = 0;
 		}
-		DBG_PRINT(piflevel, "#endif");
+		DBG_PRINT(ctx->piflevel, "#endif");
 		if (minus) {
 			if (param->flags & PARSER_WARNING)
-				warning("unmatched #if block. reseted. [+%d %s]", lineno, curfile);
+				warning("unmatched #if block. reseted. [+%d %s]", tk->lineno, tk->curfile);
 		} else {
-			if (cur->if0only)
-				level = cur->start;
-			else if (cur->end != -1) {
-				if (cur->end != level && (param->flags & PARSER_WARNING))
-					warning("uneven level. [+%d %s]", lineno, curfile);
-				level = cur->end;
+			if (ctx->cur->if0only)
+				ctx->level = ctx->cur->start;
+			else if (ctx->cur->end != -1) {
+				if (ctx->cur->end != ctx->level && (param->flags & PARSER_WARNING))
+					warning("uneven level. [+%d %s]", tk->lineno, tk->curfile);
+				ctx->level = ctx->cur->end;
 			}
 		}
 	}
-	while ((cc = nexttoken(NULL, c_reserved_word)) != EOF && cc != '\n') {
-		if (cc == SYMBOL && strcmp(token, "defined") != 0)
-			PUT(PARSER_REF_SYM, token, lineno, sp);
+	while ((cc = nexttoken(tk, NULL, c_reserved_word)) != EOF && cc != '\n') {
+		if (cc == SYMBOL && strcmp(tk->token, "defined") != 0)
+			PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 	}
 }
 
@@ -664,11 +656,13 @@ condition_macro(const struct parser_param *param, int cc)
 static int
 enumerator_list(const struct parser_param *param)
 {
-	int savelevel = level;
+	struct parser_ctx *ctx = param->ctx;
+	TOKEN *tk = ctx->tk;
+	int savelevel = ctx->level;
 	int in_expression = 0;
 	int c = '{';
 
-	for (; c != EOF; c = nexttoken("{}(),=", c_reserved_word)) {
+	for (; c != EOF; c = nexttoken(tk, "{}(),=", c_reserved_word)) {
 		switch (c) {
 		case SHARP_IFDEF:
 		case SHARP_IFNDEF:
@@ -680,21 +674,21 @@ enumerator_list(const struct parser_param *param)
 			break;
 		case SYMBOL:
 			if (in_expression)
-				PUT(PARSER_REF_SYM, token, lineno, sp);
+				PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 			else
-				PUT(PARSER_DEF, token, lineno, sp);
+				PUT(PARSER_DEF, tk->token, tk->lineno, lineimage(tk));
 			break;
 		case '{':
 		case '(':
-			level++;
+			ctx->level++;
 			break;
 		case '}':
 		case ')':
-			if (--level == savelevel)
+			if (--ctx->level == savelevel)
 				return c;
 			break;
 		case ',':
-			if (level == savelevel + 1)
+			if (ctx->level == savelevel + 1)
 				in_expression = 0;
 			break;
 		case '=':
@@ -46,27 +46,14 @@ static int enumerator_list(const struct parser_param *);
 #define MAXCLASSSTACK   100
 #define IS_CV_QUALIFIER(c)      ((c) == CPP_CONST || (c) == CPP_VOLATILE)
 
-#define MAXPIFSTACK	100
-
-/*
- * #ifdef stack.
- */
-
-static struct {
-	short start;		/**< level when '#if' block started */
-	short end;		/**< level when '#if' block end */
-	short if0only;		/**< '#if 0' or notdef only */
-} pifstack[MAXPIFSTACK], *cur;
-static int piflevel;		/**< condition macro level */
-static int level;		/**< brace level */
-static int namespacelevel;	/**< namespace block level */
-
 /**
  * Cpp: read C++ file and pickup tag entries.
  */
 void
 Cpp(const struct parser_param *param)
 {
+	struct parser_ctx *ctx = param->ctx;
+	TOKEN *tk;
 	int c, cc;
 	int savelevel;
 	int startclass, startthrow, startmacro, startsharp, startequal;
@@ -86,35 +73,35 @@ Cpp(const struct parser_param *param)
 	stack[0].classname = completename;
 	stack[0].terminate = completename;
 	stack[0].level = 0;
-	level = classlevel = piflevel = namespacelevel = 0;
+	ctx->level = classlevel = ctx->piflevel = ctx->namespacelevel = 0;
 	savelevel = -1;
 	startclass = startthrow = startmacro = startsharp = startequal = 0;
 
-	if (!opentoken(param->file))
+	if ((tk = ctx->tk = opentoken(param->file)) == NULL)
 		die("'%s' cannot open.", param->file);
-	cmode = 1;			/* allow token like '#xxx' */
-	crflag = 1;			/* require '\n' as a token */
-	cppmode = 1;			/* treat '::' as a token */
+	tk->cmode = 1;			/* allow token like '#xxx' */
+	tk->crflag = 1;			/* require '\n' as a token */
+	tk->cppmode = 1;			/* treat '::' as a token */
 
-	while ((cc = nexttoken(interested, cpp_reserved_word)) != EOF) {
-		if (cc == '~' && level == stack[classlevel].level)
+	while ((cc = nexttoken(tk, interested, cpp_reserved_word)) != EOF) {
+		if (cc == '~' && ctx->level == stack[classlevel].level)
 			continue;
 		switch (cc) {
 		case SYMBOL:		/* symbol	*/
 			if (startclass || startthrow) {
-				PUT(PARSER_REF_SYM, token, lineno, sp);
-			} else if (peekc(0) == '('/* ) */) {
-				if (param->isnotfunction(token)) {
-					PUT(PARSER_REF_SYM, token, lineno, sp);
-				} else if (level > stack[classlevel].level || startequal || startmacro) {
-					PUT(PARSER_REF_SYM, token, lineno, sp);
-				} else if (level == stack[classlevel].level && !startmacro && !startsharp && !startequal) {
+				PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
+			} else if (peekc(tk, 0) == '('/* ) */) {
+				if (param->isnotfunction(tk->token)) {
+					PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
+				} else if (ctx->level > stack[classlevel].level || startequal || startmacro) {
+					PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
+				} else if (ctx->level == stack[classlevel].level && !startmacro && !startsharp && !startequal) {
 					char savetok[MAXTOKEN], *saveline;
-					int savelineno = lineno;
+					int savelineno = tk->lineno;
 
-					strlimcpy(savetok, token, sizeof(savetok));
+					strlimcpy(savetok, tk->token, sizeof(savetok));
 					strbuf_reset(sb);
-					strbuf_puts(sb, sp);
+					strbuf_puts(sb, lineimage(tk));
 					saveline = strbuf_value(sb);
 					if (function_definition(param)) {
 						/* ignore constructor */
@@ -125,55 +112,55 @@ Cpp(const struct parser_param *param)
 					}
 				}
 			} else {
-				PUT(PARSER_REF_SYM, token, lineno, sp);
+				PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 			}
 			break;
 		case CPP_USING:
-			crflag = 0;
+			tk->crflag = 0;
 			/*
 			 * using namespace name;
 			 * using ...;
 			 */
-			if ((c = nexttoken(interested, cpp_reserved_word)) == CPP_NAMESPACE) {
-				if ((c = nexttoken(interested, cpp_reserved_word)) == SYMBOL) {
-					PUT(PARSER_REF_SYM, token, lineno, sp);
+			if ((c = nexttoken(tk, interested, cpp_reserved_word)) == CPP_NAMESPACE) {
+				if ((c = nexttoken(tk, interested, cpp_reserved_word)) == SYMBOL) {
+					PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 				} else {
 					if (param->flags & PARSER_WARNING)
-						warning("missing namespace name. [+%d %s].", lineno, curfile);
-					pushbacktoken();
+						warning("missing namespace name. [+%d %s].", tk->lineno, tk->curfile);
+					pushbacktoken(tk);
 				}
 			} else if (c  == SYMBOL) {
 				char savetok[MAXTOKEN], *saveline;
-				int savelineno = lineno;
+				int savelineno = tk->lineno;
 
-				strlimcpy(savetok, token, sizeof(savetok));
+				strlimcpy(savetok, tk->token, sizeof(savetok));
 				strbuf_reset(sb);
-				strbuf_puts(sb, sp);
+				strbuf_puts(sb, lineimage(tk));
 				saveline = strbuf_value(sb);
-				if ((c = nexttoken(interested, cpp_reserved_word)) == '=') {
+				if ((c = nexttoken(tk, interested, cpp_reserved_word)) == '=') {
 					PUT(PARSER_DEF, savetok, savelineno, saveline);
 				} else {
 					PUT(PARSER_REF_SYM, savetok, savelineno, saveline);
 					while (c == SYMBOL) {
-						PUT(PARSER_REF_SYM, token, lineno, sp);
-						c = nexttoken(interested, cpp_reserved_word);
+						PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
+						c = nexttoken(tk, interested, cpp_reserved_word);
 					}
 				}
 			} else {
-				pushbacktoken();
+				pushbacktoken(tk);
 			}
-			crflag = 1;
+			tk->crflag = 1;
 			break;
 		case CPP_NAMESPACE:
-			crflag = 0;
+			tk->crflag = 0;
 			/*
 			 * namespace name = ...;
 			 * namespace [name] { ... }
 			 */
-			if ((c = nexttoken(interested, cpp_reserved_word)) == SYMBOL) {
-				PUT(PARSER_DEF, token, lineno, sp);
-				if ((c = nexttoken(interested, cpp_reserved_word)) == '=') {
-					crflag = 1;
+			if ((c = nexttoken(tk, interested, cpp_reserved_word)) == SYMBOL) {
+				PUT(PARSER_DEF, tk->token, tk->lineno, lineimage(tk));
+				if ((c = nexttoken(tk, interested, cpp_reserved_word)) == '=') {
+					tk->crflag = 1;
 					break;
 				}
 			}
@@ -181,31 +168,31 @@ Cpp(const struct parser_param *param)
 			 * Namespace block doesn't have any influence on level.
 			 */
 			if (c == '{') /* } */ {
-				namespacelevel++;
+				ctx->namespacelevel++;
 			} else {
 				if (param->flags & PARSER_WARNING)
-					warning("missing namespace block. [+%d %s](0x%x).", lineno, curfile, c);
+					warning("missing namespace block. [+%d %s](0x%x).", tk->lineno, tk->curfile, c);
 			}
-			crflag = 1;
+			tk->crflag = 1;
 			break;
 		case CPP_EXTERN: /* for 'extern "C"/"C++"' */
-			if (peekc(0) != '"') /* " */
+			if (peekc(tk, 0) != '"') /* " */
 				continue; /* If does not start with '"', continue. */
-			while ((c = nexttoken(interested, cpp_reserved_word)) == '\n')
+			while ((c = nexttoken(tk, interested, cpp_reserved_word)) == '\n')
 				;
 			/*
 			 * 'extern "C"/"C++"' block is a kind of namespace block.
 			 * (It doesn't have any influence on level.)
 			 */
 			if (c == '{') /* } */
-				namespacelevel++;
+				ctx->namespacelevel++;
 			else
-				pushbacktoken();
+				pushbacktoken(tk);
 			break;
 		case CPP_STRUCT:
 		case CPP_CLASS:
-			DBG_PRINT(level, cc == CPP_CLASS ? "class" : "struct");
-			while ((c = nexttoken(NULL, cpp_reserved_word)) == CPP___ATTRIBUTE__ || c == '\n')
+			DBG_PRINT(ctx->level, cc == CPP_CLASS ? "class" : "struct");
+			while ((c = nexttoken(tk, NULL, cpp_reserved_word)) == CPP___ATTRIBUTE__ || c == '\n')
 				if (c == CPP___ATTRIBUTE__)
 					process_attribute(param);
 			if (c == SYMBOL) {
@@ -213,24 +200,24 @@ Cpp(const struct parser_param *param)
 				int savelineno;
 				do {
 					if (c == SYMBOL) {
-						savelineno = lineno;
+						savelineno = tk->lineno;
 						strbuf_reset(sb);
-						strbuf_puts(sb, sp);
+						strbuf_puts(sb, lineimage(tk));
 						saveline = strbuf_value(sb);
-						strlimcpy(classname, token, sizeof(classname));
+						strlimcpy(classname, tk->token, sizeof(classname));
 					}
-					c = nexttoken(NULL, cpp_reserved_word);
+					c = nexttoken(tk, NULL, cpp_reserved_word);
 					if (c == SYMBOL)
 						PUT(PARSER_REF_SYM, classname, savelineno, saveline);
 					else if (c == '<') {
 						int templates = 1;
 						for (;;) {
-							c = nexttoken(NULL, cpp_reserved_word);
+							c = nexttoken(tk, NULL, cpp_reserved_word);
 							if (c == SYMBOL)
-								PUT(PARSER_REF_SYM, token, lineno, sp);
+								PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 							if (c == '<') {
-								if (peekc(1) == '<')
-									throwaway_nextchar();
+								if (peekc(tk, 1) == '<')
+									throwaway_nextchar(tk);
 								else
 									++templates;
 							} else if (c == '>') {
@@ -238,11 +225,11 @@ Cpp(const struct parser_param *param)
 									break;
 							} else if (c == EOF) {
 								if (param->flags & PARSER_WARNING) 
-									warning("failed to parse template [+%d %s].", savelineno, curfile);
+									warning("failed to parse template [+%d %s].", savelineno, tk->curfile);
 								goto finish;
 							}
 						}
-						c = nexttoken(NULL, cpp_reserved_word);
+						c = nexttoken(tk, NULL, cpp_reserved_word);
 					}
 				} while (c == SYMBOL || c == '\n');
 				if (c == ':' || c == '{') /* } */ {
@@ -251,57 +238,57 @@ Cpp(const struct parser_param *param)
 				} else
 					PUT(PARSER_REF_SYM, classname, savelineno, saveline);
 			}
-			pushbacktoken();
+			pushbacktoken(tk);
 			break;
 		case '{':  /* } */
-			DBG_PRINT(level, "{"); /* } */
-			++level;
-			if ((param->flags & PARSER_BEGIN_BLOCK) && atfirst) {
-				if ((param->flags & PARSER_WARNING) && level != 1)
-					warning("forced level 1 block start by '{' at column 0 [+%d %s].", lineno, curfile); /* } */
-				level = 1;
+			DBG_PRINT(ctx->level, "{"); /* } */
+			++ctx->level;
+			if ((param->flags & PARSER_BEGIN_BLOCK) && atfirst(tk)) {
+				if ((param->flags & PARSER_WARNING) && ctx->level != 1)
+					warning("forced level 1 block start by '{' at column 0 [+%d %s].", tk->lineno, tk->curfile); /* } */
+				ctx->level = 1;
 			}
 			if (startclass) {
 				char *p = stack[classlevel].terminate;
 				char *q = classname;
 
 				if (++classlevel >= MAXCLASSSTACK)
-					die("class stack over flow.[%s]", curfile);
+					die("class stack over flow.[%s]", tk->curfile);
 				if (classlevel > 1 && p < completename_limit)
 					*p++ = '.';
 				stack[classlevel].classname = p;
 				while (*q && p < completename_limit)
 					*p++ = *q++;
 				stack[classlevel].terminate = p;
-				stack[classlevel].level = level;
+				stack[classlevel].level = ctx->level;
 				*p++ = 0;
 			}
 			startclass = startthrow = 0;
 			break;
 			/* { */
 		case '}':
-			if (--level < 0) {
-				if (namespacelevel > 0)
-					namespacelevel--;
+			if (--ctx->level < 0) {
+				if (ctx->namespacelevel > 0)
+					ctx->namespacelevel--;
 				else if (param->flags & PARSER_WARNING)
-					warning("missing left '{' [+%d %s].", lineno, curfile); /* } */
-				level = 0;
+					warning("missing left '{' [+%d %s].", tk->lineno, tk->curfile); /* } */
+				ctx->level = 0;
 			}
-			if ((param->flags & PARSER_END_BLOCK) && atfirst) {
-				if ((param->flags & PARSER_WARNING) && level != 0)
+			if ((param->flags & PARSER_END_BLOCK) && atfirst(tk)) {
+				if ((param->flags & PARSER_WARNING) && ctx->level != 0)
 					/* { */
-					warning("forced level 0 block end by '}' at column 0 [+%d %s].", lineno, curfile);
-				level = 0;
+					warning("forced level 0 block end by '}' at column 0 [+%d %s].", tk->lineno, tk->curfile);
+				ctx->level = 0;
 			}
-			if (level < stack[classlevel].level)
+			if (ctx->level < stack[classlevel].level)
 				*(stack[--classlevel].terminate) = 0;
 			/* { */
-			DBG_PRINT(level, "}");
+			DBG_PRINT(ctx->level, "}");
 			break;
 		case '=':
 			/* dirty hack. Don't mimic this. */
-			if (peekc(0) == '=') {
-				throwaway_nextchar();
+			if (peekc(tk, 0) == '=') {
+				throwaway_nextchar(tk);
 			} else {
 				startequal = 1;
 			}
@@ -310,10 +297,10 @@ Cpp(const struct parser_param *param)
 			startthrow = startequal = 0;
 			break;
 		case '\n':
-			if (startmacro && level != savelevel) {
+			if (startmacro && ctx->level != savelevel) {
 				if (param->flags & PARSER_WARNING)
-					warning("different level before and after #define macro. reseted. [+%d %s].", lineno, curfile);
-				level = savelevel;
+					warning("different level before and after #define macro. reseted. [+%d %s].", tk->lineno, tk->curfile);
+				ctx->level = savelevel;
 			}
 			startmacro = startsharp = 0;
 			break;
@@ -323,20 +310,20 @@ Cpp(const struct parser_param *param)
 		case SHARP_DEFINE:
 		case SHARP_UNDEF:
 			startmacro = 1;
-			savelevel = level;
-			if ((c = nexttoken(interested, cpp_reserved_word)) != SYMBOL) {
-				pushbacktoken();
+			savelevel = ctx->level;
+			if ((c = nexttoken(tk, interested, cpp_reserved_word)) != SYMBOL) {
+				pushbacktoken(tk);
 				break;
 			}
-			if (peekc(1) == '('/* ) */) {
-				PUT(PARSER_DEF, token, lineno, sp);
-				while ((c = nexttoken("()", cpp_reserved_word)) != EOF && c != '\n' && c != /* ( */ ')')
+			if (peekc(tk, 1) == '('/* ) */) {
+				PUT(PARSER_DEF, tk->token, tk->lineno, lineimage(tk));
+				while ((c = nexttoken(tk, "()", cpp_reserved_word)) != EOF && c != '\n' && c != /* ( */ ')')
 					if (c == SYMBOL)
-						PUT(PARSER_REF_SYM, token, lineno, sp);
+						PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 				if (c == '\n')
-					pushbacktoken();
+					pushbacktoken(tk);
 			}  else {
-				PUT(PARSER_DEF, token, lineno, sp);
+				PUT(PARSER_DEF, tk->token, tk->lineno, lineimage(tk));
 			}
 			break;
 		case SHARP_IMPORT:
@@ -348,7 +335,7 @@ Cpp(const struct parser_param *param)
 		case SHARP_WARNING:
 		case SHARP_IDENT:
 		case SHARP_SCCS:
-			while ((c = nexttoken(interested, cpp_reserved_word)) != EOF && c != '\n')
+			while ((c = nexttoken(tk, interested, cpp_reserved_word)) != EOF && c != '\n')
 				;
 			break;
 		case SHARP_IFDEF:
@@ -360,65 +347,65 @@ Cpp(const struct parser_param *param)
 			condition_macro(param, cc);
 			break;
 		case SHARP_SHARP:		/* ## */
-			(void)nexttoken(interested, cpp_reserved_word);
+			(void)nexttoken(tk, interested, cpp_reserved_word);
 			break;
 		case CPP_NEW:
-			if ((c = nexttoken(interested, cpp_reserved_word)) == SYMBOL)
-				PUT(PARSER_REF_SYM, token, lineno, sp);
+			if ((c = nexttoken(tk, interested, cpp_reserved_word)) == SYMBOL)
+				PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 			break;
 		case CPP_ENUM:
 		case CPP_UNION:
-			while ((c = nexttoken(interested, cpp_reserved_word)) == CPP___ATTRIBUTE__)
+			while ((c = nexttoken(tk, interested, cpp_reserved_word)) == CPP___ATTRIBUTE__)
 				process_attribute(param);
 			while (c == '\n')
-				c = nexttoken(interested, cpp_reserved_word);
+				c = nexttoken(tk, interested, cpp_reserved_word);
 			if (c == SYMBOL) {
-				if (peekc(0) == '{') /* } */ {
-					PUT(PARSER_DEF, token, lineno, sp);
+				if (peekc(tk, 0) == '{') /* } */ {
+					PUT(PARSER_DEF, tk->token, tk->lineno, lineimage(tk));
 				} else {
-					PUT(PARSER_REF_SYM, token, lineno, sp);
+					PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 				}
-				c = nexttoken(interested, cpp_reserved_word);
+				c = nexttoken(tk, interested, cpp_reserved_word);
 			}
 			while (c == '\n')
-				c = nexttoken(interested, cpp_reserved_word);
+				c = nexttoken(tk, interested, cpp_reserved_word);
 			if (c == '{' /* } */ && cc == CPP_ENUM) {
 				enumerator_list(param);
 			} else {
-				pushbacktoken();
+				pushbacktoken(tk);
 			}
 			break;
 		case CPP_TEMPLATE:
 			{
 				int level = 0;
 
-				while ((c = nexttoken("<>", cpp_reserved_word)) != EOF) {
+				while ((c = nexttoken(tk, "<>", cpp_reserved_word)) != EOF) {
 					if (c == '<')
 						++level;
 					else if (c == '>') {
 						if (--level == 0)
 							break;
 					} else if (c == SYMBOL) {
-						PUT(PARSER_REF_SYM, token, lineno, sp);
+						PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 					}
 				}
 				if (c == EOF && (param->flags & PARSER_WARNING))
-					warning("template <...> isn't closed. [+%d %s].", lineno, curfile);
+					warning("template <...> isn't closed. [+%d %s].", tk->lineno, tk->curfile);
 			}
 			break;
 		case CPP_OPERATOR:
-			while ((c = nexttoken(";{", /* } */ cpp_reserved_word)) != EOF) {
+			while ((c = nexttoken(tk, ";{", /* } */ cpp_reserved_word)) != EOF) {
 				if (c == '{') /* } */ {
-					pushbacktoken();
+					pushbacktoken(tk);
 					break;
 				} else if (c == ';') {
 					break;
 				} else if (c == SYMBOL) {
-					PUT(PARSER_REF_SYM, token, lineno, sp);
+					PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 				}
 			}
 			if (c == EOF && (param->flags & PARSER_WARNING))
-				warning("'{' doesn't exist after 'operator'. [+%d %s].", lineno, curfile); /* } */
+				warning("'{' doesn't exist after 'operator'. [+%d %s].", tk->lineno, tk->curfile); /* } */
 			break;
 		/* control statement check */
 		case CPP_THROW:
@@ -438,8 +425,8 @@ Cpp(const struct parser_param *param)
 		case CPP_SWITCH:
 		case CPP_TRY:
 		case CPP_WHILE:
-			if ((param->flags & PARSER_WARNING) && !startmacro && level == 0)
-				warning("Out of function. %8s [+%d %s]", token, lineno, curfile);
+			if ((param->flags & PARSER_WARNING) && !startmacro && ctx->level == 0)
+				warning("Out of function. %8s [+%d %s]", tk->token, tk->lineno, tk->curfile);
 			break;
 		case CPP_TYPEDEF:
 			{
@@ -449,45 +436,45 @@ Cpp(const struct parser_param *param)
 				 */
 				char savetok[MAXTOKEN];
 				int savelineno = 0;
-				int typedef_savelevel = level;
+				int typedef_savelevel = ctx->level;
 				int templates = 0;
 
 				savetok[0] = 0;
 
 				/* skip CV qualifiers */
 				do {
-					c = nexttoken("{}(),;", cpp_reserved_word);
+					c = nexttoken(tk, "{}(),;", cpp_reserved_word);
 				} while (IS_CV_QUALIFIER(c) || c == '\n');
 
 				if ((param->flags & PARSER_WARNING) && c == EOF) {
-					warning("unexpected eof. [+%d %s]", lineno, curfile);
+					warning("unexpected eof. [+%d %s]", tk->lineno, tk->curfile);
 					break;
 				} else if (c == CPP_ENUM || c == CPP_STRUCT || c == CPP_UNION) {
 					char *interest_enum = "{},;";
 					int c_ = c;
 
-					while ((c = nexttoken(interest_enum, cpp_reserved_word)) == CPP___ATTRIBUTE__)
+					while ((c = nexttoken(tk, interest_enum, cpp_reserved_word)) == CPP___ATTRIBUTE__)
 						process_attribute(param);
 					while (c == '\n')
-						c = nexttoken(interest_enum, cpp_reserved_word);
+						c = nexttoken(tk, interest_enum, cpp_reserved_word);
 					/* read tag name if exist */
 					if (c == SYMBOL) {
-						if (peekc(0) == '{') /* } */ {
-							PUT(PARSER_DEF, token, lineno, sp);
+						if (peekc(tk, 0) == '{') /* } */ {
+							PUT(PARSER_DEF, tk->token, tk->lineno, lineimage(tk));
 						} else {
-							PUT(PARSER_REF_SYM, token, lineno, sp);
+							PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 						}
-						c = nexttoken(interest_enum, cpp_reserved_word);
+						c = nexttoken(tk, interest_enum, cpp_reserved_word);
 					}
 					while (c == '\n')
-						c = nexttoken(interest_enum, cpp_reserved_word);
+						c = nexttoken(tk, interest_enum, cpp_reserved_word);
 					if (c_ == CPP_ENUM) {
 						if (c == '{') /* } */
 							c = enumerator_list(param);
 						else
-							pushbacktoken();
+							pushbacktoken(tk);
 					} else {
-						for (; c != EOF; c = nexttoken(interest_enum, cpp_reserved_word)) {
+						for (; c != EOF; c = nexttoken(tk, interest_enum, cpp_reserved_word)) {
 							switch (c) {
 							case SHARP_IFDEF:
 							case SHARP_IFNDEF:
@@ -500,38 +487,38 @@ Cpp(const struct parser_param *param)
 							default:
 								break;
 							}
-							if (c == ';' && level == typedef_savelevel) {
+							if (c == ';' && ctx->level == typedef_savelevel) {
 								if (savetok[0]) {
-									PUT(PARSER_DEF, savetok, savelineno, sp);
+									PUT(PARSER_DEF, savetok, savelineno, lineimage(tk));
 									savetok[0] = 0;
 								}
 								break;
 							} else if (c == '{')
-								level++;
+								ctx->level++;
 							else if (c == '}') {
 								savetok[0] = 0;
-								if (--level == typedef_savelevel)
+								if (--ctx->level == typedef_savelevel)
 									break;
 							} else if (c == SYMBOL) {
-								if (level > typedef_savelevel)
-									PUT(PARSER_REF_SYM, token, lineno, sp);
+								if (ctx->level > typedef_savelevel)
+									PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 								/* save lastest token */
-								strlimcpy(savetok, token, sizeof(savetok));
-								savelineno = lineno;
+								strlimcpy(savetok, tk->token, sizeof(savetok));
+								savelineno = tk->lineno;
 							}
 						}
 						if (c == ';')
 							break;
 					}
 					if ((param->flags & PARSER_WARNING) && c == EOF) {
-						warning("unexpected eof. [+%d %s]", lineno, curfile);
+						warning("unexpected eof. [+%d %s]", tk->lineno, tk->curfile);
 						break;
 					}
 				} else if (c == SYMBOL) {
-					PUT(PARSER_REF_SYM, token, lineno, sp);
+					PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 				}
 				savetok[0] = 0;
-				while ((c = nexttoken("()<>,;", cpp_reserved_word)) != EOF) {
+				while ((c = nexttoken(tk, "()<>,;", cpp_reserved_word)) != EOF) {
 					switch (c) {
 					case SHARP_IFDEF:
 					case SHARP_IFNDEF:
@@ -545,39 +532,39 @@ Cpp(const struct parser_param *param)
 						break;
 					}
 					if (c == '(')
-						level++;
+						ctx->level++;
 					else if (c == ')')
-						level--;
+						ctx->level--;
 					else if (c == '<')
 						templates++;
 					else if (c == '>')
 						templates--;
 					else if (c == SYMBOL) {
-						if (level > typedef_savelevel) {
-							PUT(PARSER_REF_SYM, token, lineno, sp);
+						if (ctx->level > typedef_savelevel) {
+							PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 						} else {
 							/* put latest token if any */
 							if (savetok[0]) {
-								PUT(PARSER_REF_SYM, savetok, savelineno, sp);
+								PUT(PARSER_REF_SYM, savetok, savelineno, lineimage(tk));
 							}
 							/* save lastest token */
-							strlimcpy(savetok, token, sizeof(savetok));
-							savelineno = lineno;
+							strlimcpy(savetok, tk->token, sizeof(savetok));
+							savelineno = tk->lineno;
 						}
 					} else if (c == ',' || c == ';') {
 						if (savetok[0]) {
-							PUT(templates ? PARSER_REF_SYM : PARSER_DEF, savetok, lineno, sp);
+							PUT(templates ? PARSER_REF_SYM : PARSER_DEF, savetok, tk->lineno, lineimage(tk));
 							savetok[0] = 0;
 						}
 					}
-					if (level == typedef_savelevel && c == ';')
+					if (ctx->level == typedef_savelevel && c == ';')
 						break;
 				}
 				if (param->flags & PARSER_WARNING) {
 					if (c == EOF)
-						warning("unexpected eof. [+%d %s]", lineno, curfile);
-					else if (level != typedef_savelevel)
-						warning("unmatched () block. (last at level %d.)[+%d %s]", level, lineno, curfile);
+						warning("unexpected eof. [+%d %s]", tk->lineno, tk->curfile);
+					else if (ctx->level != typedef_savelevel)
+						warning("unmatched () block. (last at level %d.)[+%d %s]", ctx->level, tk->lineno, tk->curfile);
 				}
 			}
 			break;
@@ -591,12 +578,12 @@ Cpp(const struct parser_param *param)
 finish:
 	strbuf_close(sb);
 	if (param->flags & PARSER_WARNING) {
-		if (level != 0)
-			warning("unmatched {} block. (last at level %d.)[+%d %s]", level, lineno, curfile);
-		if (piflevel != 0)
-			warning("unmatched #if block. (last at level %d.)[+%d %s]", piflevel, lineno, curfile);
+		if (ctx->level != 0)
+			warning("unmatched {} block. (last at level %d.)[+%d %s]", ctx->level, tk->lineno, tk->curfile);
+		if (ctx->piflevel != 0)
+			warning("unmatched #if block. (last at level %d.)[+%d %s]", ctx->piflevel, tk->lineno, tk->curfile);
 	}
-	closetoken();
+	closetoken(tk);
 }
 /**
  * process_attribute: skip attributes in '__attribute__((...))'.
@@ -604,19 +591,20 @@ finish:
 static void
 process_attribute(const struct parser_param *param)
 {
+	TOKEN *tk = param->ctx->tk;
 	int brace = 0;
 	int c;
 	/*
 	 * Skip '...' in __attribute__((...))
 	 * but pick up symbols in it.
 	 */
-	while ((c = nexttoken("()", cpp_reserved_word)) != EOF) {
+	while ((c = nexttoken(tk, "()", cpp_reserved_word)) != EOF) {
 		if (c == '(')
 			brace++;
 		else if (c == ')')
 			brace--;
 		else if (c == SYMBOL) {
-			PUT(PARSER_REF_SYM, token, lineno, sp);
+			PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 		}
 		if (brace == 0)
 			break;
@@ -630,11 +618,12 @@ process_attribute(const struct parser_param *param)
 static int
 function_definition(const struct parser_param *param)
 {
+	TOKEN *tk = param->ctx->tk;
 	int c;
 	int brace_level;
 
 	brace_level = 0;
-	while ((c = nexttoken("()", cpp_reserved_word)) != EOF) {
+	while ((c = nexttoken(tk, "()", cpp_reserved_word)) != EOF) {
 		switch (c) {
 		case SHARP_IFDEF:
 		case SHARP_IFNDEF:
@@ -655,16 +644,16 @@ function_definition(const struct parser_param *param)
 		}
 		/* pick up symbol */
 		if (c == SYMBOL)
-			PUT(PARSER_REF_SYM, token, lineno, sp);
+			PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 	}
 	if (c == EOF)
 		return 0;
-	if (peekc(0) == ';') {
-		(void)nexttoken(";", NULL);
+	if (peekc(tk, 0) == ';') {
+		(void)nexttoken(tk, ";", NULL);
 		return 0;
 	}
 	brace_level = 0;
-	while ((c = nexttoken(",;[](){}=", cpp_reserved_word)) != EOF) {
+	while ((c = nexttoken(tk, ",;[](){}=", cpp_reserved_word)) != EOF) {
 		switch (c) {
 		case SHARP_IFDEF:
 		case SHARP_IFNDEF:
@@ -678,7 +667,7 @@ function_definition(const struct parser_param *param)
 			process_attribute(param);
 			continue;
 		case SHARP_DEFINE:
-			pushbacktoken();
+			pushbacktoken(tk);
 			return 0;
 		default:
 			break;
@@ -690,16 +679,16 @@ function_definition(const struct parser_param *param)
 		else if (brace_level == 0 && (c == ';' || c == ','))
 			break;
 		else if (c == '{' /* } */) {
-			pushbacktoken();
+			pushbacktoken(tk);
 			return 1;
 		} else if (c == /* { */'}') {
-			pushbacktoken();
+			pushbacktoken(tk);
 			break;
 		} else if (c == '=')
 			break;
 		/* pick up symbol */
 		if (c == SYMBOL)
-			PUT(PARSER_REF_SYM, token, lineno, sp);
+			PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 	}
 	return 0;
 }
@@ -713,54 +702,56 @@ function_definition(const struct parser_param *param)
 static void
 condition_macro(const struct parser_param *param, int cc)
 {
-	cur = &pifstack[piflevel];
+	struct parser_ctx *ctx = param->ctx;
+	TOKEN *tk = ctx->tk;
+	ctx->cur = &ctx->pifstack[ctx->piflevel];
 	if (cc == SHARP_IFDEF || cc == SHARP_IFNDEF || cc == SHARP_IF) {
-		DBG_PRINT(piflevel, "#if");
-		if (++piflevel >= MAXPIFSTACK)
-			die("#if pifstack over flow. [%s]", curfile);
-		++cur;
-		cur->start = level;
-		cur->end = -1;
-		cur->if0only = 0;
-		if (peekc(0) == '0')
-			cur->if0only = 1;
-		else if ((cc = nexttoken(NULL, cpp_reserved_word)) == SYMBOL && !strcmp(token, "notdef"))
-			cur->if0only = 1;
+		DBG_PRINT(ctx->piflevel, "#if");
+		if (++ctx->piflevel >= MAXPIFSTACK)
+			die("#if pifstack over flow. [%s]", tk->curfile);
+		++ctx->cur;
+		ctx->cur->start = ctx->level;
+		ctx->cur->end = -1;
+		ctx->cur->if0only = 0;
+		if (peekc(tk, 0) == '0')
+			ctx->cur->if0only = 1;
+		else if ((cc = nexttoken(tk, NULL, cpp_reserved_word)) == SYMBOL && !strcmp(tk->token, "notdef"))
+			ctx->cur->if0only = 1;
 		else
-			pushbacktoken();
+			pushbacktoken(tk);
 	} else if (cc == SHARP_ELIF || cc == SHARP_ELSE) {
-		DBG_PRINT(piflevel - 1, "#else");
-		if (cur->end == -1)
-			cur->end = level;
-		else if (cur->end != level && (param->flags & PARSER_WARNING))
-			warning("uneven level. [+%d %s]", lineno, curfile);
-		level = cur->start;
-		cur->if0only = 0;
+		DBG_PRINT(ctx->piflevel - 1, "#else");
+		if (ctx->cur->end == -1)
+			ctx->cur->end = ctx->level;
+		else if (ctx->cur->end != ctx->level && (param->flags & PARSER_WARNING))
+			warning("uneven level. [+%d %s]", tk->lineno, tk->curfile);
+		ctx->level = ctx->cur->start;
+		ctx->cur->if0only = 0;
 	} else if (cc == SHARP_ENDIF) {
 		int minus = 0;
 
-		--piflevel;
-		if (piflevel < 0) {
+		--ctx->piflevel;
+		if (ctx->piflevel < 0) {
 			minus = 1;
-			piflevel = 0;
+			ctx->piflevel = 0;
 		}
-		DBG_PRINT(piflevel, "#endif");
+		DBG_PRINT(ctx->piflevel, "#endif");
 		if (minus) {
 			if (param->flags & PARSER_WARNING)
-				warning("unmatched #if block. reseted. [+%d %s]", lineno, curfile);
+				warning("unmatched #if block. reseted. [+%d %s]", tk->lineno, tk->curfile);
 		} else {
-			if (cur->if0only)
-				level = cur->start;
-			else if (cur->end != -1) {
-				if (cur->end != level && (param->flags & PARSER_WARNING))
-					warning("uneven level. [+%d %s]", lineno, curfile);
-				level = cur->end;
+			if (ctx->cur->if0only)
+				ctx->level = ctx->cur->start;
+			else if (ctx->cur->end != -1) {
+				if (ctx->cur->end != ctx->level && (param->flags & PARSER_WARNING))
+					warning("uneven level. [+%d %s]", tk->lineno, tk->curfile);
+				ctx->level = ctx->cur->end;
 			}
 		}
 	}
-	while ((cc = nexttoken(NULL, cpp_reserved_word)) != EOF && cc != '\n') {
-                if (cc == SYMBOL && strcmp(token, "defined") != 0) {
-			PUT(PARSER_REF_SYM, token, lineno, sp);
+	while ((cc = nexttoken(tk, NULL, cpp_reserved_word)) != EOF && cc != '\n') {
+                if (cc == SYMBOL && strcmp(tk->token, "defined") != 0) {
+			PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 		}
 	}
 }
@@ -771,11 +762,13 @@ condition_macro(const struct parser_param *param, int cc)
 static int
 enumerator_list(const struct parser_param *param)
 {
-	int savelevel = level;
+	struct parser_ctx *ctx = param->ctx;
+	TOKEN *tk = ctx->tk;
+	int savelevel = ctx->level;
 	int in_expression = 0;
 	int c = '{';
 
-	for (; c != EOF; c = nexttoken("{}(),=", cpp_reserved_word)) {
+	for (; c != EOF; c = nexttoken(tk, "{}(),=", cpp_reserved_word)) {
 		switch (c) {
 		case SHARP_IFDEF:
 		case SHARP_IFNDEF:
@@ -787,21 +780,21 @@ enumerator_list(const struct parser_param *param)
 			break;
 		case SYMBOL:
 			if (in_expression)
-				PUT(PARSER_REF_SYM, token, lineno, sp);
+				PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 			else
-				PUT(PARSER_DEF, token, lineno, sp);
+				PUT(PARSER_DEF, tk->token, tk->lineno, lineimage(tk));
 			break;
 		case '{':
 		case '(':
-			level++;
+			ctx->level++;
 			break;
 		case '}':
 		case ')':
-			if (--level == savelevel)
+			if (--ctx->level == savelevel)
 				return c;
 			break;
 		case ',':
-			if (level == savelevel + 1)
+			if (ctx->level == savelevel + 1)
 				in_expression = 0;
 			break;
 		case '=':
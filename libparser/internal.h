@@ -25,15 +25,38 @@
 #include "strbuf.h"
 #include "token.h"
 
+#define MAXPIFSTACK	100
+
+/**
+ * Context of a built-in parser.
+ * It is given through parser_param, and every state of parsing a file
+ * is kept in it, so that several files can be parsed at the same time.
+ */
+struct parser_ctx {
+	TOKEN *tk;			/**< tokenizer */
+	int level;			/**< brace level */
+	int piflevel;			/**< condition macro level */
+	int externclevel;		/**< 'extern "C"' block level (C) */
+	int namespacelevel;		/**< namespace block level (C++) */
+	/**
+	 * #ifdef stack.
+	 */
+	struct {
+		short start;		/**< level when '#if' block started */
+		short end;		/**< level when '#if' block end */
+		short if0only;		/**< '#if 0' or notdef only */
+	} pifstack[MAXPIFSTACK], *cur;
+};
+
 #define PUT(type, tag, lno, line) do {					\
-	DBG_PRINT(level, line);						\
-	param->put(type, tag, lno, curfile, line, param->arg);		\
+	DBG_PRINT(param->ctx->level, line);				\
+	param->put(type, tag, lno, param->ctx->tk->curfile, line, param->arg);\
 } while (0)
 
 #ifdef DEBUG
 #define DBG_PRINT(level, a) do {					\
 	if (param->flags & PARSER_DEBUG)				\
-		dbg_print(level, a);					\
+		dbg_print(param, level, a);				\
 } while (0)
 #else
 #define DBG_PRINT(level, a) do {} while (0)
@@ -47,7 +70,7 @@ void java(const struct parser_param *);
 void php(const struct parser_param *);
 void assembly(const struct parser_param *);
 
-void dbg_print(int, const char *);
+void dbg_print(const struct parser_param *, int, const char *);
 
 extern STRBUF *asm_symtable;
 void asm_initscan(void);
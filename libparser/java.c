@@ -42,8 +42,9 @@
 void
 java(const struct parser_param *param)
 {
+	struct parser_ctx *ctx = param->ctx;
+	TOKEN *tk;
 	int c;
-	int level;					/* brace level */
 	int startclass, startthrows, startequal;
 	char classname[MAXTOKEN];
 	char completename[MAXCOMPLETENAME];
@@ -59,64 +60,64 @@ java(const struct parser_param *param)
 	stack[0].classname = completename;
 	stack[0].terminate = completename;
 	stack[0].level = 0;
-	level = classlevel = 0;
+	ctx->level = classlevel = 0;
 	startclass = startthrows = startequal = 0;
 
-	if (!opentoken(param->file))
+	if ((tk = ctx->tk = opentoken(param->file)) == NULL)
 		die("'%s' cannot open.", param->file);
-	while ((c = nexttoken(interested, java_reserved_word)) != EOF) {
+	while ((c = nexttoken(tk, interested, java_reserved_word)) != EOF) {
 		switch (c) {
 		case SYMBOL:					/* symbol */
-			for (; c == SYMBOL && peekc(1) == '.'; c = nexttoken(interested, java_reserved_word)) {
-				PUT(PARSER_REF_SYM, token, lineno, sp);
+			for (; c == SYMBOL && peekc(tk, 1) == '.'; c = nexttoken(tk, interested, java_reserved_word)) {
+				PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 			}
 			if (c != SYMBOL)
 				break;
 			if (startclass || startthrows) {
-				PUT(PARSER_REF_SYM, token, lineno, sp);
-			} else if (peekc(0) == '('/* ) */) {
-				if (level == stack[classlevel].level && !startequal)
+				PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
+			} else if (peekc(tk, 0) == '('/* ) */) {
+				if (ctx->level == stack[classlevel].level && !startequal)
 					/* ignore constructor */
-					if (strcmp(stack[classlevel].classname, token))
-						PUT(PARSER_DEF, token, lineno, sp);
-				if (level > stack[classlevel].level || startequal)
-					PUT(PARSER_REF_SYM, token, lineno, sp);
+					if (strcmp(stack[classlevel].classname, tk->token))
+						PUT(PARSER_DEF, tk->token, tk->lineno, lineimage(tk));
+				if (ctx->level > stack[classlevel].level || startequal)
+					PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 			} else {
-				PUT(PARSER_REF_SYM, token, lineno, sp);
+				PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 			}
 			break;
 		case '{': /* } */
-			DBG_PRINT(level, "{");	/* } */
+			DBG_PRINT(ctx->level, "{");	/* } */
 
-			++level;
+			++ctx->level;
 			if (startclass) {
 				char *p = stack[classlevel].terminate;
 				char *q = classname;
 
 				if (++classlevel >= MAXCLASSSTACK)
-					die("class stack over flow.[%s]", curfile);
+					die("class stack over flow.[%s]", tk->curfile);
 				if (classlevel > 1)
 					*p++ = '.';
 				stack[classlevel].classname = p;
 				while (*q)
 					*p++ = *q++;
 				stack[classlevel].terminate = p;
-				stack[classlevel].level = level;
+				stack[classlevel].level = ctx->level;
 				*p++ = 0;
 			}
 			startclass = startthrows = 0;
 			break;
 			/* { */
 		case '}':
-			if (--level < 0) {
+			if (--ctx->level < 0) {
 				if (param->flags & PARSER_WARNING)
-					warning("missing left '{' (at %d).", lineno); /* } */
-				level = 0;
+					warning("missing left '{' (at %d).", tk->lineno); /* } */
+				ctx->level = 0;
 			}
-			if (level < stack[classlevel].level)
+			if (ctx->level < stack[classlevel].level)
 				*(stack[--classlevel].terminate) = 0;
 			/* { */
-			DBG_PRINT(level, "}");
+			DBG_PRINT(ctx->level, "}");
 			break;
 		case '=':
 			startequal = 1;
@@ -127,18 +128,18 @@ java(const struct parser_param *param)
 		case JAVA_CLASS:
 		case JAVA_INTERFACE:
 		case JAVA_ENUM:
-			if ((c = nexttoken(interested, java_reserved_word)) == SYMBOL) {
-				strlimcpy(classname, token, sizeof(classname));
+			if ((c = nexttoken(tk, interested, java_reserved_word)) == SYMBOL) {
+				strlimcpy(classname, tk->token, sizeof(classname));
 				startclass = 1;
-				PUT(PARSER_DEF, token, lineno, sp);
+				PUT(PARSER_DEF, tk->token, tk->lineno, lineimage(tk));
 			}
 			break;
 		case JAVA_NEW:
 		case JAVA_INSTANCEOF:
-			while ((c = nexttoken(interested, java_reserved_word)) == SYMBOL && peekc(1) == '.')
-				PUT(PARSER_REF_SYM, token, lineno, sp);
+			while ((c = nexttoken(tk, interested, java_reserved_word)) == SYMBOL && peekc(tk, 1) == '.')
+				PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 			if (c == SYMBOL)
-				PUT(PARSER_REF_SYM, token, lineno, sp);
+				PUT(PARSER_REF_SYM, tk->token, tk->lineno, lineimage(tk));
 			break;
 		case JAVA_THROWS:
 			startthrows = 1;
@@ -152,12 +153,12 @@ java(const struct parser_param *param)
 		case JAVA_LONG:
 		case JAVA_SHORT:
 		case JAVA_VOID:
-			if (peekc(1) == '.' && (c = nexttoken(interested, java_reserved_word)) != JAVA_CLASS)
-				pushbacktoken();
+			if (peekc(tk, 1) == '.' && (c = nexttoken(tk, interested, java_reserved_word)) != JAVA_CLASS)
+				pushbacktoken(tk);
 			break;
 		default:
 			break;
 		}
 	}
-	closetoken();
+	closetoken(tk);
 }
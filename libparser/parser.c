@@ -438,6 +438,7 @@ void
 execute_parser(const struct lang_entry *ent, const char *path, int flags, PARSER_CALLBACK put, void *arg)
 {
 	struct parser_param param;
+	struct parser_ctx ctx;
 	/*
 	 * call language specific parser.
 	 */
@@ -452,6 +453,8 @@ execute_parser(const struct lang_entry *ent, const char *path, int flags, PARSER
 	param.die = die;
 	param.warning = warning;
 	param.message = message;
+	memset(&ctx, 0, sizeof(ctx));
+	param.ctx = &ctx;
 	ent->parser(&param);
 }
 /**
@@ -471,9 +474,9 @@ get_explain(const char *path, const struct lang_entry *ent)
 	return strbuf_value(sb);
 }
 void
-dbg_print(int level, const char *s)
+dbg_print(const struct parser_param *param, int level, const char *s)
 {
-	fprintf(stderr, "[%04d]", lineno);
+	fprintf(stderr, "[%04d]", param->ctx->tk->lineno);
 	for (; level > 0; level--)
 		fprintf(stderr, "    ");
 	fprintf(stderr, "%s\n", s);
@@ -50,6 +50,8 @@ void parser_exit(void);
 
 typedef void (*PARSER_CALLBACK)(int, const char *, int, const char *, const char *, void *);
 
+struct parser_ctx;
+
 struct parser_param {
 	int size;		/**< size of this structure */
 	int flags;
@@ -62,6 +64,7 @@ struct parser_param {
 	void (*die)(const char *, ...);
 	void (*warning)(const char *, ...);
 	void (*message)(const char *, ...);
+	struct parser_ctx *ctx;	/**< context for built-in parsers */
 };
 
 typedef void (*PARSER)(const struct parser_param *);
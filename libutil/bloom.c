@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2018 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdio.h>
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+#include "bloom.h"
+#include "checkalloc.h"
+#include "strbuf.h"
+
+/*
+Bloom filter: usage
+
+bloom = bloom_open(1000, 10);		// for 1000 keys, 10 bits per key
+bloom_add(bloom, bloom_hash("main"));
+if (!bloom_test(bloom, bloom_hash("func")))
+	// "func" is surely not added.
+bloom_dump(bloom, sb);			// make the image of the filter.
+bloom_close(bloom);
+bloom = bloom_undump(strbuf_value(sb), strbuf_getlen(sb));
+
+bloom_test() may answer 'added' for a key which is not added (false
+positive), but never answers 'not added' for an added key. With 10 bits
+per key, the rate of false positive is about 1%, and it increases when
+more keys than the capacity are added.
+
+The image is a header line "<nbits> <nhash> <capacity> <count>" followed
+by a '\0' and the bit array. It is independent of the byte order.
+*/
+#define MAXNHASH	16
+
+/**
+ * bloom_hash: hash value of a key.
+ *
+ *	@param[in]	key	key
+ *	@return		hash value (FNV-1a)
+ *
+ * The positions of the bits for a key are derived from this value.
+ */
+unsigned int
+bloom_hash(const char *key)
+{
+	const unsigned char *p = (const unsigned char *)key;
+	unsigned int h = 2166136261U;
+
+	while (*p) {
+		h ^= *p++;
+		h *= 16777619U;
+	}
+	return h;
+}
+/**
+ * second_hash: the step of double hashing.
+ */
+static unsigned int
+second_hash(unsigned int h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6bU;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35U;
+	h ^= h >> 16;
+	return h | 1;
+}
+/**
+ * bloom_open: open a Bloom filter.
+ *
+ *	@param[in]	capacity	number of keys to be added
+ *	@param[in]	bits	number of bits per key
+ *	@return		Bloom filter
+ */
+BLOOM *
+bloom_open(unsigned int capacity, int bits)
+{
+	BLOOM *bloom = (BLOOM *)check_calloc(sizeof(BLOOM), 1);
+	unsigned int bytes;
+
+	if (capacity < 64)
+		capacity = 64;
+	bytes = (capacity / 8) * bits + bits;
+	bloom->bits = (unsigned char *)check_calloc(bytes, 1);
+	bloom->nbits = bytes * 8;
+	/*
+	 * The optimal number of hash functions is bits * ln(2).
+	 */
+	bloom->nhash = (bits * 69 + 50) / 100;
+	if (bloom->nhash < 1)
+		bloom->nhash = 1;
+	if (bloom->nhash > MAXNHASH)
+		bloom->nhash = MAXNHASH;
+	bloom->capacity = capacity;
+	bloom->count = 0;
+	return bloom;
+}
+/**
+ * bloom_add: add a key.
+ *
+ *	@param[in]	bloom	Bloom filter
+ *	@param[in]	h	hash value of the key (bloom_hash())
+ */
+void
+bloom_add(BLOOM *bloom, unsigned int h)
+{
+	unsigned int step = second_hash(h);
+	unsigned int pos;
+	int i;
+
+	for (i = 0; i < bloom->nhash; i++, h += step) {
+		pos = h % bloom->nbits;
+		bloom->bits[pos / 8] |= 1 << (pos % 8);
+	}
+	bloom->count++;
+}
+/**
+ * bloom_test: test whether a key may have been added.
+ *
+ *	@param[in]	bloom	Bloom filter
+ *	@param[in]	h	hash value of the key (bloom_hash())
+ *	@return		0: not added, 1: may be added
+ */
+int
+bloom_test(BLOOM *bloom, unsigned int h)
+{
+	unsigned int step = second_hash(h);
+	unsigned int pos;
+	int i;
+
+	for (i = 0; i < bloom->nhash; i++, h += step) {
+		pos = h % bloom->nbits;
+		if (!(bloom->bits[pos / 8] & (1 << (pos % 8))))
+			return 0;
+	}
+	return 1;
+}
+/**
+ * bloom_dump: make the image of a Bloom filter.
+ *
+ *	@param[in]	bloom	Bloom filter
+ *	@param[out]	sb	the image is appended
+ */
+void
+bloom_dump(BLOOM *bloom, STRBUF *sb)
+{
+	char header[64];
+
+	snprintf(header, sizeof(header), "%u %d %u %u",
+		bloom->nbits, bloom->nhash, bloom->capacity, bloom->count);
+	strbuf_puts0(sb, header);
+	strbuf_nputs(sb, (const char *)bloom->bits, bloom->nbits / 8);
+}
+/**
+ * bloom_undump: load a Bloom filter from the image.
+ *
+ *	@param[in]	image	image made by bloom_dump()
+ *	@param[in]	size	size of the image
+ *	@return		Bloom filter, NULL: invalid image
+ */
+BLOOM *
+bloom_undump(const char *image, int size)
+{
+	BLOOM *bloom;
+	const char *bits = memchr(image, '\0', size);
+	unsigned int nbits, capacity, count;
+	int nhash;
+
+	if (bits == NULL)
+		return NULL;
+	bits++;
+	if (sscanf(image, "%u %d %u %u", &nbits, &nhash, &capacity, &count) != 4)
+		return NULL;
+	if (nbits == 0 || nbits % 8 != 0 || nhash < 1 || nhash > MAXNHASH)
+		return NULL;
+	if (image + size - bits != nbits / 8)
+		return NULL;
+	bloom = (BLOOM *)check_calloc(sizeof(BLOOM), 1);
+	bloom->bits = (unsigned char *)check_malloc(nbits / 8);
+	memcpy(bloom->bits, bits, nbits / 8);
+	bloom->nbits = nbits;
+	bloom->nhash = nhash;
+	bloom->capacity = capacity;
+	bloom->count = count;
+	return bloom;
+}
+/**
+ * bloom_close: close a Bloom filter.
+ *
+ *	@param[in]	bloom	Bloom filter
+ */
+void
+bloom_close(BLOOM *bloom)
+{
+	free(bloom->bits);
+	free(bloom);
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2018 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _BLOOM_H_
+#define _BLOOM_H_
+
+#include "strbuf.h"
+
+typedef struct {
+	unsigned char *bits;		/**< bit array */
+	unsigned int nbits;		/**< number of bits */
+	int nhash;			/**< number of hash functions */
+	unsigned int capacity;		/**< number of keys designed for */
+	unsigned int count;		/**< number of added keys */
+} BLOOM;
+
+unsigned int bloom_hash(const char *);
+BLOOM *bloom_open(unsigned int, int);
+void bloom_add(BLOOM *, unsigned int);
+int bloom_test(BLOOM *, unsigned int);
+void bloom_dump(BLOOM *, STRBUF *);
+BLOOM *bloom_undump(const char *, int);
+void bloom_close(BLOOM *);
+
+#endif /* ! _BLOOM_H_ */
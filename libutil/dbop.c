@@ -40,15 +40,18 @@
 #endif
 #include <errno.h>
 
+#include "bloom.h"
 #include "char.h"
 #include "checkalloc.h"
 #include "dbop.h"
 #include "die.h"
 #include "env.h"
+#include "extsort.h"
 #include "locatestring.h"
 #include "strbuf.h"
 #include "strlimcpy.h"
 #include "test.h"
+#include "varray.h"
 
 #ifdef USE_SQLITE3
 int is_sqlite3(const char *);
@@ -72,122 +75,150 @@ void dbop3_close(DBOP *);
 
 /**
  * Stuff for DBOP_SORTED_WRITE
+ *
+ * Sorted writing is done by the built-in external merge sort (extsort.c).
+ * Records are kept in the memory while they fit in the budget, and are
+ * spilled into temporary files as sorted runs when exceeding it.
+ * The budget is GTAGSSORTBUF bytes. See libutil/gparam.h for the details.
  */
-#define SORT_SEP '\t'
+static long
+sort_budget(void)
+{
+	long budget = GTAGSSORTBUF;
 
-/**
- * Two functions required for sorted writing.
- *
- * static void start_sort_process(DBOP *dbop)
- * (1) start_sort_process: start sort process for sorted writing
+	if (getenv("GTAGSSORTBUF") != NULL)
+		budget = atol(getenv("GTAGSSORTBUF"));
+	if (budget < GTAGSMINSORTBUF)
+		budget = GTAGSMINSORTBUF;
+	return budget;
+}
+/*
+ * Stuff for the Bloom filter of the keys
  *
- *	@param[in]	dbop	DBOP descriptor
+ * A tag file has a Bloom filter (bloom.c) of all the keys except for those
+ * of meta records, so that dbop_get() and dbop_first() can answer most
+ * lookups of absent keys without descending the btree.
  *
- * static void terminate_sort_process(DBOP *dbop)
- * (2) terminate_sort_process: terminate sort process
+ *      key             data
+ *      --------------------
+ *      " __.BLOOM"\0   " __.BLOOM <nbits> <nhash> <capacity> <count>"\0<bit array>
  *
- *	@param[in]	dbop	DBOP descriptor
- */
-static void start_sort_process(DBOP *);
-static void terminate_sort_process(DBOP *);
-static char *sortnotfound = "POSIX sort program not found. If available, the program will be speed up.\nPlease see ./configure --help.";
-/*
- * 1. DJGPP/Windows
+ * When creating, the hash values of the written keys are collected, and
+ * dbop_close() makes the filter for 25% more keys than them. Updating adds
+ * new keys to the filter; when they exceed the capacity, dbop_close() remakes
+ * it from all the keys in the tag file. Removed keys are left in the filter,
+ * which only makes a false positive. Reading loads the filter after
+ * DBOP_BLOOMLOAD lookups, so that commands which look up only a few keys
+ * do not pay for it.
  */
-#if defined(__DJGPP__) || defined(_WIN32)
-/*
- * Just ignored. DJGPP version doesn't use sorted writing; Windows (including
- * Cygwin) is slightly quicker without it.
+/**
+ * load_bloom: load the Bloom filter from the tag file.
+ *
+ *	@param[in]	dbop	dbop descripter
  */
 static void
-start_sort_process(DBOP *dbop) {
-	return;
+load_bloom(DBOP *dbop)
+{
+	DB *db = dbop->db;
+	DBT key, dat;
+	int len = strlen(BLOOMKEY);
+
+	dbop->bloomstate = -1;
+	key.data = (char *)BLOOMKEY;
+	key.size = len + 1;
+	if ((*db->get)(db, &key, &dat, 0) != RET_SUCCESS)
+		return;
+	if (dat.size <= len + 1 || strncmp((char *)dat.data, BLOOMKEY " ", len + 1))
+		return;
+	dbop->bloom = bloom_undump((char *)dat.data + len + 1, dat.size - len - 1);
+	if (dbop->bloom != NULL)
+		dbop->bloomstate = 1;
 }
+/**
+ * write_bloom: write the Bloom filter to the tag file.
+ *
+ *	@param[in]	dbop	dbop descripter
+ */
 static void
-terminate_sort_process(DBOP *dbop) {
-	return;
+write_bloom(DBOP *dbop)
+{
+	STRBUF *sb = strbuf_open(0);
+	DB *db = dbop->db;
+	DBT key, dat;
+
+	strbuf_puts(sb, BLOOMKEY);
+	strbuf_putc(sb, ' ');
+	bloom_dump(dbop->bloom, sb);
+	key.data = (char *)BLOOMKEY;
+	key.size = strlen(BLOOMKEY) + 1;
+	dat.data = strbuf_value(sb);
+	dat.size = strbuf_getlen(sb);
+	if ((*db->del)(db, &key, 0) == RET_ERROR
+	    || (*db->put)(db, &key, &dat, 0) != RET_SUCCESS)
+		die("cannot write the Bloom filter.");
+	strbuf_close(sb);
 }
-/*
- * 2. UNIX
- */
-#else
-#include <sys/wait.h>
-/*
- * Though it doesn't understand why, GNU sort with no option is faster
- * than 'sort -k 1,1'. But we should use '-k 1,1' here not to rely on
- * a specific command.
+/**
+ * note_key: record a key written to the tag file.
+ *
+ *	@param[in]	dbop	dbop descripter
+ *	@param[in]	name	key
  */
-static char *argv[] = {
-	POSIX_SORT,
-	"-k",
-	"1,1",
-	NULL
-};
 static void
-start_sort_process(DBOP *dbop) {
-	int opipe[2], ipipe[2];
-
-	if (!strcmp(POSIX_SORT, "no"))
-		return;
-	if (!test("fx", POSIX_SORT)) {
-		static int informed;
+note_key(DBOP *dbop, const char *name)
+{
+	VARRAY *vb = dbop->bloomkeys;
+	unsigned int h;
 
-		if (!informed) {
-			warning("%s", sortnotfound);
-			informed = 1;
-		}
+	if (ismeta(name))
 		return;
+	h = bloom_hash(name);
+	if (vb != NULL) {
+		/* successive records often have the same key */
+		if (vb->length > 0 && *(unsigned int *)varray_assign(vb, vb->length - 1, 0) == h)
+			return;
+		*(unsigned int *)varray_append(vb) = h;
+	} else if (dbop->bloom != NULL && !bloom_test(dbop->bloom, h)) {
+		bloom_add(dbop->bloom, h);
+		dbop->bloomdirty = 1;
 	}
-	/*
-	 * Setup pipe for two way communication
-	 *
-	 *	Parent(gtags)				Child(sort)
-	 *	---------------------------------------------------
-	 *	(dbop->sortout) opipe[1] =====> opipe[0] (stdin)
-	 *	(dbop->sortin)  ipipe[0] <===== ipipe[1] (stdout)
-	 */
-	if (pipe(opipe) < 0 || pipe(ipipe) < 0)
-		die("pipe(2) failed.");
-	dbop->pid = fork();
-	if (dbop->pid == 0) {
-		/* child process */
-		close(opipe[1]);
-		close(ipipe[0]);
-		if (dup2(opipe[0], 0) < 0 || dup2(ipipe[1], 1) < 0)
-			die("dup2(2) failed.");
-		close(opipe[0]);
-		close(ipipe[1]);
-		/*
-		 * Use C locale in order to avoid the degradation of performance 	 
-		 * by internationalized sort command. 	 
-		 */
-		set_env("LC_ALL", "C");
-		execvp(POSIX_SORT, argv);
-		die("cannot execute '%s'. (execvp failed)", POSIX_SORT);
-	} else if (dbop->pid < 0)
-		die("fork(2) failed.");
-	/* parent process */
-	close(opipe[0]);
-	close(ipipe[1]);
-	fcntl(ipipe[0], F_SETFD, FD_CLOEXEC);
-	fcntl(opipe[1], F_SETFD, FD_CLOEXEC);
-	dbop->sortout = fdopen(opipe[1], "w");
-	dbop->sortin = fdopen(ipipe[0], "r");
-	if (dbop->sortout == NULL || dbop->sortin == NULL)
-		die("fdopen(3) failed.");
 }
+/**
+ * absent_key: whether or not a key is surely absent.
+ *
+ *	@param[in]	dbop	dbop descripter
+ *	@param[in]	name	key
+ *	@return		1: absent, 0: may be present
+ */
+static int
+absent_key(DBOP *dbop, const char *name)
+{
+	if (dbop->bloomstate == 0 && ++dbop->lookups >= DBOP_BLOOMLOAD)
+		load_bloom(dbop);
+	if (dbop->bloom == NULL || ismeta(name))
+		return 0;
+	return !bloom_test(dbop->bloom, bloom_hash(name));
+}
+/**
+ * make_bloom: make the Bloom filter from the collected keys.
+ *
+ *	@param[in]	dbop	dbop descripter
+ */
 static void
-terminate_sort_process(DBOP *dbop) {
-	int ret, status;
+make_bloom(DBOP *dbop)
+{
+	VARRAY *vb = dbop->bloomkeys;
+	int i;
 
-	while ((ret = waitpid(dbop->pid, &status, 0)) < 0 && errno == EINTR)
-		;
-	if (ret < 0)
-		die("waitpid(2) failed.");
-	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
-		die("terminated abnormally. '%s'", POSIX_SORT);
+	if (dbop->bloom != NULL)
+		bloom_close(dbop->bloom);
+	dbop->bloom = bloom_open(vb->length + vb->length / 4, DBOP_BLOOMBITS);
+	for (i = 0; i < vb->length; i++)
+		bloom_add(dbop->bloom, *(unsigned int *)varray_assign(vb, i, 0));
+	dbop->bloomdirty = 1;
+	varray_close(vb);
+	dbop->bloomkeys = NULL;
 }
-#endif
 
 #ifdef USE_SQLITE3
 static const char *sqlite_header = "SQLite format 3";
@@ -207,6 +238,97 @@ is_sqlite3(const char *path) {
 	return sqlite3;
 }
 #endif
+/*
+ * Kept databases.
+ *
+ * A long-lived process (global --server) keeps tag files open with
+ * dbop_keep(), and its children forked for each request use them through
+ * dbop_open() without opening the files again. The pages which the
+ * process has read are inherited too. Besides the tag files of the project,
+ * those of the library trees in GTAGSLIBPATH are kept.
+ */
+#define MAXKEPT	64
+static struct kept {
+	char path[MAXPATHLEN];
+	DB *db;
+	dev_t dev;
+	ino_t ino;
+	time_t mtime;
+	off_t size;
+	BLOOM *bloom;
+} kept[MAXKEPT];
+static int kept_count;
+
+/**
+ * lookup_kept: lookup kept database.
+ *
+ *	@param[in]	path	database name
+ *	@param[in]	db	DB descripter (used if path == NULL)
+ *	@return		kept entry or NULL
+ */
+static struct kept *
+lookup_kept(const char *path, DB *db)
+{
+	int i;
+
+	for (i = 0; i < kept_count; i++)
+		if (path ? !strcmp(kept[i].path, path) : kept[i].db == db)
+			return &kept[i];
+	return NULL;
+}
+/**
+ * dbop_keep: keep a database open for reading.
+ *
+ *	@param[in]	path	database name
+ *	@return		0: kept, -1: not kept
+ *
+ * If the database is already kept, it is reopened only when the file
+ * has been replaced or modified since then. A database which does not
+ * exist any longer is released.
+ */
+int
+dbop_keep(const char *path)
+{
+	struct kept *k = lookup_kept(path, NULL);
+	struct stat st;
+	DBOP *dbop;
+
+	if (stat(path, &st) == 0 && k != NULL
+	    && k->dev == st.st_dev && k->ino == st.st_ino
+	    && k->mtime == st.st_mtime && k->size == st.st_size)
+		return 0;
+	if (k != NULL) {
+#ifdef USE_DB185_COMPAT
+		(void)k->db->close(k->db);
+#else
+		(void)k->db->close(k->db, 0);
+#endif
+		if (k->bloom != NULL)
+			bloom_close(k->bloom);
+		*k = kept[--kept_count];
+	}
+	if (kept_count >= MAXKEPT || stat(path, &st) < 0)
+		return -1;
+	if ((dbop = dbop_open(path, 0, 0, 0)) == NULL)
+		return -1;
+#ifdef USE_SQLITE3
+	if (dbop->openflags & DBOP_SQLITE3) {
+		dbop_close(dbop);
+		return -1;
+	}
+#endif
+	load_bloom(dbop);
+	k = &kept[kept_count++];
+	strlimcpy(k->path, path, sizeof(k->path));
+	k->db = dbop->db;
+	k->bloom = dbop->bloom;
+	k->dev = st.st_dev;
+	k->ino = st.st_ino;
+	k->mtime = st.st_mtime;
+	k->size = st.st_size;
+	(void)free(dbop);
+	return 0;
+}
 /**
  * dbop_open: open db database.
  *
@@ -215,7 +337,9 @@ is_sqlite3(const char *path) {
  *	@param[in]	perm	file permission
  *	@param[in]	flags
  *			DBOP_DUP: allow duplicate records.
- *			DBOP_SORTED_WRITE: use sorted writing. This requires POSIX sort.
+ *			DBOP_SORTED_WRITE: use sorted writing.
+ *			DBOP_DUPKEY: store duplicate keys once on each leaf
+ *			page (with DBOP_DUP, only when creating).
  *	@return		descripter for dbop_xxx() or NULL
  *
  * Sorted wirting is fast because all writing is done by not insertion but addition.
@@ -227,6 +351,7 @@ dbop_open(const char *path, int mode, int perm, int flags)
 	int rw = 0;
 	DBOP *dbop;
 	BTREEINFO info;
+	struct kept *k = NULL;
 
 #ifdef USE_SQLITE3
 	if (mode != 1 && is_sqlite3(path))
@@ -255,6 +380,8 @@ dbop_open(const char *path, int mode, int perm, int flags)
 	memset(&info, 0, sizeof(info));
 	if (flags & DBOP_DUP)
 		info.flags |= R_DUP;
+	if (flags & DBOP_DUP && flags & DBOP_DUPKEY)
+		info.flags |= R_DUPKEY;
 	info.psize = DBOP_PAGESIZE;
 	/*
 	 * Decide cache size. The default value is 5MB.
@@ -272,7 +399,10 @@ dbop_open(const char *path, int mode, int perm, int flags)
 	 */
 	if (path != NULL && mode == 1 && test("f", path))
 		(void)unlink(path);
-	db = dbopen(path, rw, 0600, DB_BTREE, &info);
+	if (path != NULL && mode == 0 && (k = lookup_kept(path, NULL)) != NULL)
+		db = k->db;
+	else
+		db = dbopen(path, rw, 0600, DB_BTREE, &info);
 	if (!db)
 		return NULL;
 	/*
@@ -299,13 +429,25 @@ dbop_open(const char *path, int mode, int perm, int flags)
 	dbop->perm	= (mode == 1) ? perm : 0;
 	dbop->lastdat	= NULL;
 	dbop->lastsize	= 0;
-	dbop->sortout	= NULL;
-	dbop->sortin	= NULL;
+	dbop->sort	= NULL;
 	/*
 	 * Setup sorted writing.
 	 */
 	if (mode != 0 && dbop->openflags & DBOP_SORTED_WRITE)
-		start_sort_process(dbop);
+		dbop->sort = extsort_open(sort_budget());
+	/*
+	 * Setup the Bloom filter.
+	 */
+	if (path == NULL || mode == 1) {
+		dbop->bloomstate = -1;
+		if (path != NULL)
+			dbop->bloomkeys = varray_open(sizeof(unsigned int), 65536);
+	} else if (mode == 2) {
+		load_bloom(dbop);
+	} else if (k != NULL) {
+		dbop->bloom = k->bloom;
+		dbop->bloomstate = k->bloom ? 1 : -1;
+	}
 #ifdef USE_SQLITE3
 finish:
 #endif
@@ -329,6 +471,11 @@ dbop_get(DBOP *dbop, const char *name)
 	if (dbop->openflags & DBOP_SQLITE3)
 		return dbop3_get(dbop, name);
 #endif
+	if (absent_key(dbop, name)) {
+		dbop->lastdat = NULL;
+		dbop->lastsize = 0;
+		return NULL;
+	}
 	key.data = (char *)name;
 	key.size = strlen(name)+1;
 
@@ -371,13 +518,11 @@ dbop_put(DBOP *dbop, const char *name, const char *data)
 	if (len > MAXKEYLEN)
 		die("primary key too long.");
 	/* sorted writing */
-	if (dbop->sortout != NULL) {
-		fputs(name, dbop->sortout);
-		putc(SORT_SEP, dbop->sortout);
-		fputs(data, dbop->sortout);
-		putc('\n', dbop->sortout);
+	if (dbop->sort != NULL) {
+		extsort_put(dbop->sort, name, data);
 		return;
 	}
+	note_key(dbop, name);
 	key.data = (char *)name;
 	key.size = len+1;
 	dat.data = (char *)data;
@@ -465,6 +610,7 @@ dbop_put_path(DBOP *dbop, const char *name, const char *data, const char *flag)
 	strbuf_puts0(sb, data);
 	if (flag)
 		strbuf_puts0(sb, flag);
+	note_key(dbop, name);
 	key.data = (char *)name;
 	key.size = len+1;
 	dat.data = strbuf_value(sb);
@@ -534,6 +680,7 @@ dbop_update(DBOP *dbop, const char *key, const char *dat)
  *	@param[in]	flags	following dbop_next call take over this.
  *			DBOP_KEY:	read key part,
  *			DBOP_PREFIX:	prefix read; only valid when sequential read
+ *			DBOP_META:	don't skip meta records; only valid with name
  *	@return		data or NULL
  */
 const char *
@@ -564,6 +711,13 @@ dbop_first(DBOP *dbop, const char *name, regex_t *preg, int flags)
 		if (!(flags & DBOP_PREFIX))
 			key.size++;
 		dbop->keylen = key.size;
+		if (!(flags & DBOP_PREFIX) && absent_key(dbop, name)) {
+			dbop->lastdat = NULL;
+			dbop->lastsize = 0;
+			dbop->lastkey = NULL;
+			dbop->lastkeysize = 0;
+			return NULL;
+		}
 		for (status = (*db->seq)(db, &key, &dat, R_CURSOR);
 			status == RET_SUCCESS;
 			status = (*db->seq)(db, &key, &dat, R_NEXT)) {
@@ -617,7 +771,7 @@ dbop_first(DBOP *dbop, const char *name, regex_t *preg, int flags)
  *	@param[in]	dbop	dbop descripter
  *	@return		data or NULL
  *
- * [Note] dbop_next() always skip meta records.
+ * [Note] dbop_next() always skip meta records unless DBOP_META is specified.
  */
 const char *
 dbop_next(DBOP *dbop)
@@ -639,7 +793,7 @@ dbop_next(DBOP *dbop)
 		dbop->readcount++;
 		assert(dat.data != NULL);
 		/* skip meta records */
-		if (!(dbop->openflags & DBOP_RAW)) {
+		if (!(dbop->openflags & DBOP_RAW) && !(flags & DBOP_META)) {
 			if (flags & DBOP_KEY && ismeta(key.data))
 				continue;
 			else if (ismeta(dat.data))
@@ -785,6 +939,36 @@ dbop_putversion(DBOP *dbop, int version)
 	snprintf(number, sizeof(number), "%d", version);
 	dbop_putoption(dbop, VERSIONKEY, number);
 }
+/**
+ * dbop_getgeneration: get generation number
+ *
+ * The generation number is increased by each snapshot updating
+ * (gtags --snapshot). The tag files of a tag set have the same number.
+ * Tag files without it are of the generation 0.
+ */
+int
+dbop_getgeneration(DBOP *dbop)
+{
+	const char *p;
+
+	if ((p = dbop_getoption(dbop, GENERATIONKEY)) != NULL)
+		return atoi(p);
+	return 0;
+}
+/**
+ * dbop_putgeneration: put generation number
+ *
+ * [Note] The old record is removed, since the tag file may allow duplicate records.
+ */
+void
+dbop_putgeneration(DBOP *dbop, int generation)
+{
+	char number[32];
+
+	snprintf(number, sizeof(number), "%d", generation);
+	dbop_delete(dbop, GENERATIONKEY);
+	dbop_putoption(dbop, GENERATIONKEY, number);
+}
 /**
  * dbop_close: close db
  * 
@@ -798,33 +982,40 @@ dbop_close(DBOP *dbop)
 	/*
 	 * Load sorted tag records and write them to the tag file.
 	 */
-	if (dbop->sortout != NULL) {
-		STRBUF *sb = strbuf_open(256);
-		char *p;
+	if (dbop->sort != NULL) {
+		EXTSORT *sort = dbop->sort;
+		const char *key, *dat;
 
 		/*
 		 * End of the former stage of sorted writing.
-		 * fclose() and sortout = NULL is important.
-		 *
-		 * fclose(): enables reading from sortin descriptor.
-		 * sortout = NULL: makes the following dbop_put write to the tag file directly.
+		 * sort = NULL makes the following dbop_put write to the tag file directly.
 		 */
-		fclose(dbop->sortout);
-		dbop->sortout = NULL;
+		dbop->sort = NULL;
 		/*
 		 * The last stage of sorted writing.
+		 * A new tag file is built bottom-up by the bulk loader of
+		 * the btree, which needs neither searching nor splitting.
 		 */
-		while (strbuf_fgets(sb, dbop->sortin, STRBUF_NOCRLF)) {
-			for (p = strbuf_value(sb); *p && *p != SORT_SEP; p++)
-				;
-			if (!*p)
-				die("unexpected end of record.");
-			*p++ = '\0';
-			dbop_put(dbop, strbuf_value(sb), p);
-		}
-		fclose(dbop->sortin);
-		strbuf_close(sb);
-		terminate_sort_process(dbop);
+#ifndef USE_DB185_COMPAT
+		if (__bt_bulkopen(db, DBOP_FILLFACTOR) == RET_SUCCESS) {
+			DBT k, d;
+
+			while ((key = extsort_read(sort, &dat)) != NULL) {
+				k.data = (char *)key;
+				k.size = strlen(key)+1;
+				d.data = (char *)dat;
+				d.size = strlen(dat)+1;
+				note_key(dbop, key);
+				if (__bt_bulkput(db, &k, &d) != RET_SUCCESS)
+					die("%s", dbop->put_errmsg ? dbop->put_errmsg : "dbop_put failed.");
+			}
+			if (__bt_bulkclose(db) != RET_SUCCESS)
+				die("dbop_close failed.");
+		} else
+#endif
+		while ((key = extsort_read(sort, &dat)) != NULL)
+			dbop_put(dbop, key, dat);
+		extsort_close(sort);
 	}
 #ifdef USE_SQLITE3
 	if (dbop->openflags & DBOP_SQLITE3) {
@@ -832,14 +1023,41 @@ dbop_close(DBOP *dbop)
 		return;
 	}
 #endif
-#ifdef USE_DB185_COMPAT
-	(void)db->close(db);
-#else
 	/*
-	 * If dbname = NULL, omit writing to the disk in __bt_close().
+	 * Write the Bloom filter. If the keys have exceeded the capacity,
+	 * it is remade from all the keys.
 	 */
-	(void)db->close(db, dbop->dbname[0] == '\0' ? 1 : 0);
+	if (dbop->bloomdirty && dbop->bloom->count > dbop->bloom->capacity) {
+		DBT key, dat;
+		int status;
+
+		dbop->bloomkeys = varray_open(sizeof(unsigned int), 65536);
+		for (status = (*db->seq)(db, &key, &dat, R_FIRST);
+			status == RET_SUCCESS;
+			status = (*db->seq)(db, &key, &dat, R_NEXT))
+			note_key(dbop, (char *)key.data);
+		if (status == RET_ERROR)
+			die("dbop_close failed.");
+	}
+	if (dbop->bloomkeys != NULL)
+		make_bloom(dbop);
+	if (dbop->bloomdirty)
+		write_bloom(dbop);
+	/*
+	 * A kept database is left open for the next use.
+	 */
+	if (lookup_kept(NULL, db) == NULL) {
+		if (dbop->bloom != NULL)
+			bloom_close(dbop->bloom);
+#ifdef USE_DB185_COMPAT
+		(void)db->close(db);
+#else
+		/*
+		 * If dbname = NULL, omit writing to the disk in __bt_close().
+		 */
+		(void)db->close(db, dbop->dbname[0] == '\0' ? 1 : 0);
 #endif
+	}
 	if (dbop->dbname[0] != '\0') {
 		if (dbop->perm && chmod(dbop->dbname, dbop->perm) < 0)
 			die("chmod(2) failed.");
@@ -912,8 +1130,7 @@ dbop3_open(const char *path, int mode, int perm, int flags) {
 	dbop->lastdat	= NULL;
 	dbop->lastflag	= NULL;
 	dbop->lastsize	= 0;
-	dbop->sortout	= NULL;
-	dbop->sortin	= NULL;
+	dbop->sort	= NULL;
 	dbop->stmt      = NULL;
 	dbop->tblname   = check_strdup(tblname);
 	/*
@@ -30,18 +30,22 @@
 #ifdef USE_SQLITE3
 #include <sqlite3.h>
 #endif
+#include "bloom.h"
+#include "extsort.h"
 #include "regex.h"
 #include "strbuf.h"
-
-#if defined(_WIN32) && !defined(__CYGWIN__)
-typedef void* HANDLE;
-#endif
+#include "varray.h"
 
 #define DBOP_PAGESIZE	8192
+#define DBOP_FILLFACTOR	100	/**< fill factor of pages made by bulk loading */
 #ifdef USE_SQLITE3
 #define DBOP_COMMIT_THRESHOLD	800
 #endif
+#define DBOP_BLOOMBITS	10	/**< bits per key of the Bloom filter */
+#define DBOP_BLOOMLOAD	64	/**< lookups before loading the Bloom filter */
 #define VERSIONKEY	" __.VERSION"
+#define BLOOMKEY	" __.BLOOM"
+#define GENERATIONKEY	" __.GENERATION"
 
 typedef	struct {
 	/*
@@ -67,17 +71,16 @@ typedef	struct {
 	int keylen;			/**< key length */
 	char prev[MAXKEYLEN];		/**< previous key value */
 	int perm;			/**< file permission */
+	BLOOM *bloom;			/**< Bloom filter of the keys */
+	int bloomstate;			/**< 0: not loaded yet, 1: loaded, -1: none */
+	int bloomdirty;			/**< Bloom filter should be written */
+	VARRAY *bloomkeys;		/**< hash values of the written keys */
+	int lookups;			/**< number of lookups by a key */
 
 	/*
 	 * (3) sorted write
 	 */
-	FILE *sortout;			/**< write to sort command */
-	FILE *sortin;			/**< read from sort command */
-#if defined(_WIN32) && !defined(__CYGWIN__)
-	HANDLE pid;
-#else
-	int pid;			/**< sort process id */
-#endif
+	EXTSORT *sort;			/**< external sort for sorted writing */
 #ifdef USE_SQLITE3
 	/*
 	 * (4) sqlite3 part
@@ -112,6 +115,8 @@ typedef	struct {
 #define DBOP_RAW		4
 			/** sorted write */
 #define DBOP_SORTED_WRITE	8
+			/** store duplicate keys once on each leaf page */
+#define DBOP_DUPKEY		16
 
 /*
  * ioflags
@@ -120,7 +125,10 @@ typedef	struct {
 #define DBOP_KEY		1
 			/** prefixed read */
 #define DBOP_PREFIX		2
+			/** don't skip meta records */
+#define DBOP_META		4
 
+int dbop_keep(const char *);
 DBOP *dbop_open(const char *, int, int, int);
 const char *dbop_get(DBOP *, const char *);
 void dbop_put(DBOP *, const char *, const char *);
@@ -137,6 +145,8 @@ const char *dbop_getoption(DBOP *, const char *);
 void dbop_putoption(DBOP *, const char *, const char *);
 int dbop_getversion(DBOP *);
 void dbop_putversion(DBOP *, int);
+int dbop_getgeneration(DBOP *);
+void dbop_putgeneration(DBOP *, int);
 void dbop_close(DBOP *);
 
 #endif /* _DBOP_H_ */
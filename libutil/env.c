@@ -112,6 +112,7 @@ static const char *envname[] = {
 	/*"GTAGSROOT",*/
 	"GTAGSOBJDIR",
 	"GTAGSOBJDIRPREFIX",
+	"GTAGSSORTBUF",
 	"GTAGSTHROUGH",
 	"GTAGS_OPTIONS",
 	"HTAGS_OPTIONS",
@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2018 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdio.h>
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+#include "checkalloc.h"
+#include "die.h"
+#include "extsort.h"
+
+/*
+
+Extsort: external merge sort of (key, data) records.
+
+Records are sorted by key, and records which have the same key are sorted
+by data. The order is the same as that of 'LC_ALL=C sort -k 1,1' applied
+to 'key<TAB>data' lines, which was used for sorted writing formerly.
+
+es = extsort_open(budget);
+extsort_put(es, "b", "2");		memory: (b,2)
+extsort_put(es, "a", "1");		memory: (b,2)(a,1)
+					When the memory exceeds the budget,
+					the records are sorted and spilled
+					into a temporary file as a 'run'.
+key = extsort_read(es, &dat);		key == "a", dat == "1"
+key = extsort_read(es, &dat);		key == "b", dat == "2"
+key = extsort_read(es, &dat);		key == NULL
+extsort_close(es);
+
+If no run was spilled, records are read directly from memory.
+Otherwise, all runs are merged using a heap.
+
+A run is a file of the following records, sorted in the above order.
+
+	<key length><data length><key>\0<data>\0
+
+Since a run can be made by extsort_spill() on any file, other processes
+may make runs independently, which are merged by extsort_addrun().
+*/
+
+/**
+ * Rough overhead per record in the memory (pointer and pool header).
+ */
+#define RECORD_OVERHEAD	(sizeof(char *) * 2)
+
+/**
+ * new_run: make a temporary file for a run.
+ */
+static FILE *
+new_run(void)
+{
+	FILE *fp = tmpfile();
+
+	if (fp == NULL)
+		die("extsort: cannot make a temporary file.");
+	return fp;
+}
+/**
+ * compare_record: compare function for sorting records in the memory.
+ */
+static int
+compare_record(const void *v1, const void *v2)
+{
+	const char *r1 = *(const char **)v1;
+	const char *r2 = *(const char **)v2;
+	int ret;
+
+	if ((ret = strcmp(r1, r2)) != 0)
+		return ret;
+	return strcmp(r1 + strlen(r1) + 1, r2 + strlen(r2) + 1);
+}
+/**
+ * compare_run: compare the current records of two runs.
+ */
+static int
+compare_run(const struct extsort_run *run1, const struct extsort_run *run2)
+{
+	int ret;
+
+	if ((ret = strcmp(run1->buf, run2->buf)) != 0)
+		return ret;
+	return strcmp(run1->dat, run2->dat);
+}
+/**
+ * read_run: read the next record of a run.
+ *
+ *	@param[in]	run	run
+ *	@return		0: end of run, 1: read
+ */
+static int
+read_run(struct extsort_run *run)
+{
+	int len[2], size;
+
+	if (fread(len, sizeof(int), 2, run->fp) != 2)
+		return 0;
+	size = len[0] + len[1] + 2;
+	if (run->bufsize < size) {
+		run->bufsize = size;
+		run->buf = (char *)check_realloc(run->buf, run->bufsize);
+	}
+	if (fread(run->buf, 1, size, run->fp) != size)
+		die("extsort: unexpected end of run.");
+	run->dat = run->buf + len[0] + 1;
+	return 1;
+}
+/**
+ * write_record: write a record to a run.
+ */
+static void
+write_record(FILE *fp, const char *key, const char *dat)
+{
+	int len[2];
+
+	len[0] = strlen(key);
+	len[1] = strlen(dat);
+	if (fwrite(len, sizeof(int), 2, fp) != 2
+	    || fwrite(key, 1, len[0] + 1, fp) != len[0] + 1
+	    || fwrite(dat, 1, len[1] + 1, fp) != len[1] + 1)
+		die("extsort: cannot write a run.");
+}
+/**
+ * heap_down: restore the heap property from the node i.
+ */
+static void
+heap_down(EXTSORT *es, int i)
+{
+	struct extsort_run **heap = es->heap;
+	struct extsort_run *run = heap[i];
+
+	for (;;) {
+		int child = i * 2 + 1;
+
+		if (child >= es->heapsize)
+			break;
+		if (child + 1 < es->heapsize && compare_run(heap[child + 1], heap[child]) < 0)
+			child++;
+		if (compare_run(run, heap[child]) <= 0)
+			break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = run;
+}
+/**
+ * extsort_open: open external sort.
+ *
+ *	@param[in]	budget	memory budget in bytes
+ *	@return		EXTSORT structure
+ */
+EXTSORT *
+extsort_open(long budget)
+{
+	EXTSORT *es = (EXTSORT *)check_calloc(sizeof(EXTSORT), 1);
+
+	es->budget = budget;
+	es->pool = pool_open();
+	es->records = varray_open(sizeof(char *), 10000);
+	es->runs = varray_open(sizeof(struct extsort_run), 10);
+	return es;
+}
+/**
+ * extsort_put: put a record.
+ *
+ *	@param[in]	es	EXTSORT structure
+ *	@param[in]	key	key
+ *	@param[in]	dat	data
+ */
+void
+extsort_put(EXTSORT *es, const char *key, const char *dat)
+{
+	int keylen = strlen(key);
+	int datlen = strlen(dat);
+	char *record;
+
+	if (es->reading)
+		die("extsort_put: already reading.");
+	record = pool_malloc(es->pool, keylen + datlen + 2);
+	memcpy(record, key, keylen + 1);
+	memcpy(record + keylen + 1, dat, datlen + 1);
+	*(char **)varray_append(es->records) = record;
+	es->used += keylen + datlen + 2 + RECORD_OVERHEAD;
+	if (es->used > es->budget) {
+		FILE *fp = new_run();
+
+		extsort_spill(es, fp);
+		extsort_addrun(es, fp);
+	}
+}
+/**
+ * extsort_spill: write records in the memory to a file as a sorted run.
+ *
+ *	@param[in]	es	EXTSORT structure
+ *	@param[in]	fp	output file
+ *
+ * The memory is released. The file can be given to extsort_addrun()
+ * of this or another EXTSORT structure.
+ */
+void
+extsort_spill(EXTSORT *es, FILE *fp)
+{
+	char **records = varray_assign(es->records, 0, 0);
+	int i, count = es->records->length;
+
+	qsort(records, count, sizeof(char *), compare_record);
+	for (i = 0; i < count; i++)
+		write_record(fp, records[i], records[i] + strlen(records[i]) + 1);
+	if (fflush(fp) == EOF)
+		die("extsort: cannot write a run.");
+	varray_reset(es->records);
+	pool_reset(es->pool);
+	es->used = 0;
+}
+/**
+ * extsort_addrun: add a sorted run.
+ *
+ *	@param[in]	es	EXTSORT structure
+ *	@param[in]	fp	file made by extsort_spill()
+ *
+ * The file is closed by extsort_close().
+ */
+void
+extsort_addrun(EXTSORT *es, FILE *fp)
+{
+	struct extsort_run *run;
+
+	if (es->reading)
+		die("extsort_addrun: already reading.");
+	rewind(fp);
+	run = varray_append(es->runs);
+	memset(run, 0, sizeof(*run));
+	run->fp = fp;
+}
+/**
+ * extsort_read: read the next record in sorted order.
+ *
+ *	@param[in]	es	EXTSORT structure
+ *	@param[out]	dat	data
+ *	@return		key, NULL: end of records
+ *
+ * The returned values are valid until the next call.
+ */
+const char *
+extsort_read(EXTSORT *es, const char **dat)
+{
+	struct extsort_run *run;
+
+	if (!es->reading) {
+		int i;
+
+		if (es->runs->length == 0) {
+			qsort(varray_assign(es->records, 0, 0), es->records->length,
+				sizeof(char *), compare_record);
+		} else {
+			/*
+			 * Spill the rest and merge all runs.
+			 */
+			if (es->records->length > 0) {
+				FILE *fp = new_run();
+
+				extsort_spill(es, fp);
+				extsort_addrun(es, fp);
+			}
+			run = varray_assign(es->runs, 0, 0);
+			es->heap = (struct extsort_run **)check_malloc(sizeof(struct extsort_run *) * es->runs->length);
+			es->heapsize = 0;
+			for (i = 0; i < es->runs->length; i++)
+				if (read_run(&run[i]))
+					es->heap[es->heapsize++] = &run[i];
+			for (i = es->heapsize / 2 - 1; i >= 0; i--)
+				heap_down(es, i);
+		}
+		es->reading = 1;
+	}
+	/*
+	 * Read from the memory.
+	 */
+	if (es->heap == NULL) {
+		char *record;
+
+		if (es->index >= es->records->length)
+			return NULL;
+		record = *(char **)varray_assign(es->records, es->index++, 0);
+		*dat = record + strlen(record) + 1;
+		return record;
+	}
+	/*
+	 * Merge runs. The run read last is advanced before selecting
+	 * the next record, because its buffer was returned to the caller.
+	 */
+	if (es->last) {
+		if (read_run(es->last))
+			heap_down(es, 0);
+		else if (--es->heapsize > 0) {
+			es->heap[0] = es->heap[es->heapsize];
+			heap_down(es, 0);
+		}
+		es->last = NULL;
+	}
+	if (es->heapsize == 0)
+		return NULL;
+	run = es->last = es->heap[0];
+	*dat = run->dat;
+	return run->buf;
+}
+/**
+ * extsort_close: close external sort.
+ *
+ *	@param[in]	es	EXTSORT structure
+ */
+void
+extsort_close(EXTSORT *es)
+{
+	struct extsort_run *run = varray_assign(es->runs, 0, 0);
+	int i;
+
+	for (i = 0; i < es->runs->length; i++) {
+		fclose(run[i].fp);
+		if (run[i].buf)
+			free(run[i].buf);
+	}
+	if (es->heap)
+		free(es->heap);
+	varray_close(es->runs);
+	varray_close(es->records);
+	pool_close(es->pool);
+	free(es);
+}
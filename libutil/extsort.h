@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2018 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _EXTSORT_H_
+#define _EXTSORT_H_
+
+#include <stdio.h>
+
+#include "pool.h"
+#include "varray.h"
+
+/**
+ * A sorted run in a file.
+ */
+struct extsort_run {
+	FILE *fp;
+	char *buf;			/**< current record 'key\0dat\0' */
+	int bufsize;			/**< size of buf */
+	const char *dat;		/**< data part of the current record */
+};
+
+typedef struct {
+	long budget;			/**< memory budget for in-memory records */
+	long used;			/**< memory used by in-memory records */
+	POOL *pool;			/**< in-memory records 'key\0dat\0' */
+	VARRAY *records;		/**< pointers to in-memory records */
+	VARRAY *runs;			/**< sorted runs (struct extsort_run) */
+
+	/*
+	 * Stuff for reading.
+	 */
+	int reading;			/**< 1: sorted, reading records */
+	int index;			/**< next in-memory record */
+	struct extsort_run **heap;	/**< heap of runs for k-way merge */
+	int heapsize;			/**< number of runs in the heap */
+	struct extsort_run *last;	/**< run which was read last */
+} EXTSORT;
+
+EXTSORT *extsort_open(long);
+void extsort_put(EXTSORT *, const char *, const char *);
+void extsort_spill(EXTSORT *, FILE *);
+void extsort_addrun(EXTSORT *, FILE *);
+const char *extsort_read(EXTSORT *, const char **);
+void extsort_close(EXTSORT *);
+
+#endif /* ! _EXTSORT_H_ */
@@ -44,6 +44,9 @@
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
 #if defined(_WIN32) && !defined(__CYGWIN__)
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -51,7 +54,6 @@
 #endif
 
 #include "gparam.h"
-#include "regex.h"
 
 #include "abs2rel.h"
 #include "char.h"
@@ -66,22 +68,19 @@
 #include "locatestring.h"
 #include "makepath.h"
 #include "path.h"
+#include "pathmatch.h"
 #include "strbuf.h"
 #include "strlimcpy.h"
 #include "test.h"
 #include "varray.h"
 
 /*
- * use an appropriate string comparison for the file system; define the position of the root slash.
+ * define the position of the root slash.
  */
 #if defined(_WIN32) || defined(__DJGPP__)
-#define STRCMP stricmp
-#define STRNCMP strnicmp
 #define ROOT 2
 #define S_ISSOCK(mode) (0)
 #else
-#define STRCMP strcmp
-#define STRNCMP strncmp
 #define ROOT 0
 #endif
 /*
@@ -94,8 +93,8 @@
  *	find_close();
  *
  */
-static regex_t *skip;			/**< regex for skipping units */
-static regex_t *suff;			/**< regex for suffixes */
+static PATHMATCH *skip;			/**< patterns for skipping units */
+static PATHMATCH *suff;			/**< patterns for suffixes */
 static FILE *ip;
 static FILE *temp;
 static char *rootdir;
@@ -150,28 +149,32 @@ getreason(const char *path)
 	return is_directory << 8 | type;
 }
 /**
- * prepare_source: preparing regular expression.
+ * prepare_source: preparing patterns for source files.
+ *
+ *	@return	patterns for source files.
  *
- *	@return	compiled regular expression for source files.
+ * The equivalent regular expression is made only for the debug message.
  */
-static regex_t *
+static PATHMATCH *
 prepare_source(void)
 {
-	static regex_t suff_area;
+	PATHMATCH *pm;
 	STRBUF *sb = strbuf_open(0);
+	STRBUF *pat = strbuf_open(0);
 	char *default_langmap = DEFAULTLANGMAP;
 	char *langmap = default_langmap;
 	char *p;
-	int flags = REG_EXTENDED;
+	int icase = 0;
 
 	/*
 	 * load icase_path option.
 	 */
 	if (getconfb("icase_path"))
-		flags |= REG_ICASE;
+		icase = 1;
 #if defined(_WIN32) || defined(__DJGPP__)
-	flags |= REG_ICASE;
+	icase = 1;
 #endif
+	pm = pathmatch_open(icase);
 	/*
 	 * make suffix list.
 	 */
@@ -192,38 +195,54 @@ prepare_source(void)
 		p++;
 		/* pick up a suffix or a glob pattern */
 		while (*p == '.' || *p == '(') {
+			strbuf_reset(pat);
 			if (*p == '.') {	/* suffix */
 				strbuf_puts(sb, "[^/]+\\.");
 				for (p++; *p && *p != '.' && *p != '(' && *p != ','; p++) {
 					if (!isalnum(*p))
 						strbuf_putc(sb, '\\');
 					strbuf_putc(sb, *p);
+					strbuf_putc(pat, *p);
 				}
+				pathmatch_suffix(pm, strbuf_value(pat));
 			} else if (*p == '(') {	/* glob pattern */
 				for (p++; *p && *p != ')'; p++) {
-					if (*p == '.')
+					if (*p == '.') {
 						strbuf_puts(sb, "\\.");
-					else if (*p == '*')
+						strbuf_putc(pat, '.');
+					} else if (*p == '*') {
 						strbuf_puts(sb, "[^/]*");
-					else if (*p == '?')
+						strbuf_putc(pat, '*');
+					} else if (*p == '?') {
 						strbuf_puts(sb, "[^/]");
-					else if (*p == '[') {
+						strbuf_putc(pat, '?');
+					} else if (*p == '[') {
 						strbuf_putc(sb, '[');
-						if (*++p == '!') {
+						strbuf_putc(pat, '[');
+						if (*++p == '!' || *p == '^') {
 							strbuf_putc(sb, '^');
+							strbuf_putc(pat, '!');
 							p++;
 						}
-						for (; *p && *p != ']'; p++)
+						for (; *p && *p != ']'; p++) {
 							strbuf_putc(sb, *p);
+							strbuf_putc(pat, *p);
+						}
 						if (*p == 0)
 							die_with_code(2, "syntax error in the langmap '%s'.", langmap);
 						strbuf_putc(sb, ']');
-					} else
+						strbuf_putc(pat, ']');
+					} else {
 						strbuf_putc(sb, *p);
+						if (*p == '\\')
+							strbuf_putc(pat, '\\');
+						strbuf_putc(pat, *p);
+					}
 				}
 				if (*p == 0)
 					die_with_code(2, "syntax error in the langmap '%s'.", langmap);
 				p++;
+				pathmatch_add(pm, strbuf_value(pat), 0);
 			}
 			strbuf_putc(sb, '|');
 		}
@@ -234,46 +253,46 @@ prepare_source(void)
 	strbuf_puts(sb, ")$");
 	if (debug)
 		fprintf(stderr, "prepare_source: %s\n", strbuf_value(sb));
-	if (regcomp(&suff_area, strbuf_value(sb), flags) != 0)
-		die("cannot compile regular expression.");
+	strbuf_close(pat);
 	strbuf_close(sb);
 	if (langmap != default_langmap)
 		free(langmap);
-	return &suff_area;
+	return pm;
 }
 /**
  * prepare_skip: prepare skipping files.
  *
- *	Globals used (output):
- *		listarray[]: 	skip list.
- *		list_count:	 count of skip list.
+ *	@return	patterns for skip files.
  *
- *	@return	compiled regular expression for skip files.
+ * The equivalent regular expression is made only for the debug message.
  */
-static regex_t *
+static PATHMATCH *
 prepare_skip(void)
 {
-	static regex_t skip_area;
+	PATHMATCH *pm;
 	char *skiplist;
 	STRBUF *reg = strbuf_open(0);
+	STRBUF *pat = strbuf_open(0);
 	char *p, *q;
-	int flags = REG_EXTENDED|REG_NEWLINE;
+	int icase = 0;
 
 	/*
 	 * load icase_path option.
 	 */
 	if (getconfb("icase_path"))
-		flags |= REG_ICASE;
+		icase = 1;
 #if defined(_WIN32) || defined(__DJGPP__)
-	flags |= REG_ICASE;
+	icase = 1;
 #endif
 	/*
 	 * load skip data.
 	 */
 	if (!getconfs("skip", reg)) {
+		strbuf_close(pat);
 		strbuf_close(reg);
 		return NULL;
 	}
+	pm = pathmatch_open(icase);
 	skiplist = check_strdup(strbuf_value(reg));
 	if (debug)
 		fprintf(stderr, "DBG: Original skip list:\n%s\n", skiplist);
@@ -291,14 +310,21 @@ prepare_skip(void)
 	if (!accept_dotfiles) {
 		strbuf_puts(reg, "/\\.[^/]+$|");
 		strbuf_puts(reg, "/\\.[^/]+/|");
+		pathmatch_add(pm, ".?*", 0);
+		pathmatch_add(pm, ".?*/", PATHMATCH_PREFIX);
 	}
 	/* skip tag files */
 	strbuf_puts(reg, "/GTAGS$|");
 	strbuf_puts(reg, "/GRTAGS$|");
 	strbuf_puts(reg, "/GSYMS$|");
 	strbuf_puts(reg, "/GPATH$|");
+	pathmatch_add(pm, "GTAGS", 0);
+	pathmatch_add(pm, "GRTAGS", 0);
+	pathmatch_add(pm, "GSYMS", 0);
+	pathmatch_add(pm, "GPATH", 0);
 	for (p = skiplist; *p; ) {
 		char *skipf;
+		int flags = 0;
 		STATIC_STRBUF(sb);
 		strbuf_clear(sb);
 
@@ -314,10 +340,12 @@ prepare_skip(void)
 			strbuf_putc(sb, *p);
 		}
 		skipf = strbuf_value(sb);
+		strbuf_reset(pat);
 		/* '/' means project root directory */
 		if (*skipf == '/') {
 			strbuf_puts(reg, "^\\./");
 			skipf++;
+			flags |= PATHMATCH_ROOT;
 		} else {
 			strbuf_putc(reg, '/');
 		}
@@ -355,48 +383,65 @@ prepare_skip(void)
 						isclass = 0;
 				}
 				if (isclass) {
-					strbuf_puts(reg, strbuf_value(class));
+					char *v = strbuf_value(class);
+
+					strbuf_puts(reg, v);
+					/* '[^...]' -> '[!...]' */
+					strbuf_putc(pat, *v++);
+					if (*v == '^') {
+						strbuf_putc(pat, '!');
+						v++;
+					}
+					strbuf_puts(pat, v);
 					q = c;
 				} else {
 					/* 'class' is thrown away */
 					strbuf_putc(reg, '\\');
 					strbuf_putc(reg, *q);
+					strbuf_putc(pat, '\\');
+					strbuf_putc(pat, *q);
 				}
-			} else if (*q == '*')
+			} else if (*q == '*') {
 				strbuf_puts(reg, "[^/]*");
-			else if (*q == '?')
+				strbuf_putc(pat, '*');
+			} else if (*q == '?') {
 				strbuf_puts(reg, "[^/]");
-			else if (*q == '\\' && *(q + 1) == ',')
+				strbuf_putc(pat, '?');
+			} else if (*q == '\\' && *(q + 1) == ',') {
 				strbuf_putc(reg, *++q);
-			else if (isregexchar(*q)) {
+				strbuf_putc(pat, *q);
+			} else if (isregexchar(*q)) {
 				strbuf_putc(reg, '\\');
 				strbuf_putc(reg, *q);
+				if (*q == '\\')
+					strbuf_putc(pat, '\\');
+				strbuf_putc(pat, *q);
 			} else {
 				if (*q == '\\' && *(q + 1) != '\0') {
 					strbuf_putc(reg, *q++);
 					strbuf_putc(reg, *q);
 				} else
 					strbuf_putc(reg, *q);
+				strbuf_putc(pat, *q);
 			}
 		}
 		if (*(q - 1) != '/')
 			strbuf_putc(reg, '$');
+		else
+			flags |= PATHMATCH_PREFIX;
+		pathmatch_add(pm, strbuf_value(pat), flags);
 		if (*p == ',')
 			strbuf_putc(reg, '|');
 	}
 	strbuf_unputc(reg, '|');
 	strbuf_putc(reg, ')');
-	/*
-	 * compile regular expression.
-	 */
 	if (debug)
 		fprintf(stderr, "DBG: Regular expression of the skip list:\n%s\n", strbuf_value(reg));
-	if (regcomp(&skip_area, strbuf_value(reg), flags) != 0)
-		die("cannot compile regular expression.");
+	strbuf_close(pat);
 	strbuf_close(reg);
 	free(skiplist);
 
-	return &skip_area;
+	return pm;
 }
 /**
  * issourcefile: check whether or not a source file.
@@ -412,7 +457,7 @@ issourcefile(const char *path)
 		if (suff == NULL)
 			die("prepare_source failed.");
 	}
-	if (regexec(suff, path, 0, 0, 0) == 0)
+	if (pathmatch_exec(suff, path, NULL, NULL))
 		return 1;
 	return 0;
 }
@@ -430,8 +475,7 @@ issourcefile(const char *path)
 int
 skipthisfile(const char *path)
 {
-	regmatch_t m;
-	int i;
+	int i, so, eo;
 
 	/*
 	 * unit check.
@@ -441,18 +485,18 @@ skipthisfile(const char *path)
 		if (skip == NULL)
 			die("prepare_skip failed.");
 	}
-	if (regexec(skip, path, 1, &m, 0) == 0) {
+	if (pathmatch_exec(skip, path, &so, &eo)) {
 		if (debug) {
 			int len = strlen(path);
 			fprintf(stderr, "DBG: ");
 			for (i = 0; i < len; i++) {
-				if (m.rm_so == i)
+				if (so == i)
 					fputc('[', stderr);
-				if (m.rm_eo == i)
+				if (eo == i)
 					fputc(']', stderr);
 				fputc(path[i], stderr);
 			}
-			if (m.rm_eo == len)
+			if (eo == len)
 				fputc(']', stderr);
 			fprintf(stderr, " => SKIPPED\n");
 		}
@@ -482,76 +526,162 @@ skipthisfile(const char *path)
 }
 
 /*
- * Directory Stack
+ * Directory scanner
+ *
+ * A directory is read into a dirscan structure, which has the list of the
+ * entries in the order of readdir(3) and the messages to be printed when
+ * the directory is visited.
+ *
+ * When scanner threads are used (see set_find_jobs()), the subdirectories
+ * of a scanned directory are queued, and the threads read them ahead.
+ * find_read_traverse() still visits directories depth-first in the order
+ * of the lists, and the messages are printed by find_read_traverse() itself.
+ * So the sequence of path names, on which the file id assignment in GPATH
+ * depends, is the same as that without threads.
  */
-static char dir[MAXPATHLEN];			/**< directory path */
-static VARRAY *stack;				/**< dynamic allocated array */
-struct stack_entry {
-	STRBUF *sb;
+#if defined(_WIN32) || defined(__DJGPP__)
+/* st_ino is not available. */
+#define USE_REALPATH_ID
+#elif defined(HAVE_PTHREAD_H) && defined(HAVE_PTHREAD_CREATE)
+#define USE_SCANNER_THREADS
+#endif
+#if defined(HAVE_FSTATAT) && defined(HAVE_FACCESSAT) && defined(HAVE_DIRFD)
+#define USE_AT_FUNCTIONS
+#endif
+/**
+ * Identifier of a directory for detecting symbolic link loops.
+ */
+struct fileid {
+#ifdef USE_REALPATH_ID
 	char *real;
-	char *dirp, *start, *end, *p;
+#else
+	dev_t dev;
+	ino_t ino;
+#endif
 };
-static int current_entry;			/**< current entry of the stack */
+struct dirscan {
+	char *path;			/**< directory (ends with "/") */
+	struct fileid id;		/**< id of the directory */
+	struct fileid *ancestors;	/**< ids of the ancestor directories */
+	int depth;			/**< number of the ancestors */
+	int status;			/**< -1: ignored, 0: normal */
+	STRBUF *list;			/**< |ddir1\0ffile1\0| */
+	STRBUF *msg;			/**< |wwarning\0eexplanation\0dfatal error\0| */
+	VARRAY *child;			/**< queued job for each directory in the list */
+	/*
+	 * Stuff for scanner threads.
+	 */
+	int state;			/**< SCAN_QUEUED, SCAN_RUNNING, SCAN_DONE */
+	int orphan;			/**< 1: nobody takes the result */
+	struct dirscan *prev, *next;	/**< link of the job queue */
+};
+#define SCAN_QUEUED	0
+#define SCAN_RUNNING	1
+#define SCAN_DONE	2
+/**
+ * Upper limit of directories which are read ahead.
+ */
+#define MAXPREFETCH	1024
+
+static VARRAY *rootids;			/**< ids of the root directory and its ancestors */
+static int find_jobs = 1;		/**< number of scanner threads */
+#ifdef USE_SCANNER_THREADS
+#include <pthread.h>
+
+static pthread_mutex_t scan_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t scan_queued = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t scan_done = PTHREAD_COND_INITIALIZER;
+static pthread_t *scanners;
+static int nscanners;			/**< number of running scanner threads */
+static int scan_quit;			/**< 1: scanner threads should exit */
+static struct dirscan *queue;		/**< job queue (LIFO) */
+static int prefetched;			/**< queued jobs not taken yet */
+#endif
+
+/**
+ * get_fileid: get the id of a directory.
+ *
+ *	@param[in]	dir	directory
+ *	@param[out]	id	id
+ *	@return		0: normal, -1: error
+ */
+static int
+get_fileid(const char *dir, struct fileid *id)
+{
+#ifdef USE_REALPATH_ID
+	if ((id->real = realpath(dir, NULL)) == NULL)
+		return -1;
+#else
+	struct stat st;
 
+	if (stat(dir, &st) < 0)
+		return -1;
+	id->dev = st.st_dev;
+	id->ino = st.st_ino;
+#endif
+	return 0;
+}
+static int
+same_fileid(const struct fileid *id1, const struct fileid *id2)
+{
+#ifdef USE_REALPATH_ID
+	return !strcmp(id1->real, id2->real);
+#else
+	return id1->dev == id2->dev && id1->ino == id2->ino;
+#endif
+}
 /**
- * getrealpath: return a real path of dir using allocated area.
+ * prepare_rootids: get the ids of the root directory and its ancestors.
+ *
+ *	@param[in]	root	real path of the root directory
  */
-static char *
-getrealpath(const char *dir)
+static void
+prepare_rootids(const char *root)
 {
-	char *real;
+	char buf[MAXPATHLEN];
+	struct fileid id;
+	char *p;
 
-	if ((real = realpath(dir, NULL)) == NULL)
-		die("cannot get real path of '%s'.", trimpath(dir));
-	return real;
+	rootids = varray_open(sizeof(struct fileid), 32);
+	strlimcpy(buf, root, sizeof(buf));
+	for (;;) {
+		if (get_fileid(buf, &id) == 0)
+			*(struct fileid *)varray_append(rootids) = id;
+		if ((p = strrchr(buf + ROOT, '/')) == NULL)
+			break;
+		if (p == buf + ROOT) {
+			if (*(p + 1) == '\0')
+				break;
+			*(p + 1) = '\0';
+		} else
+			*p = '\0';
+	}
 }
 /**
- * has_symlinkloop: whether or not dir has a symbolic link loops.
+ * has_symlinkloop: whether or not the directory has a symbolic link loop.
  *
- *	@param[in]	dir	directory (should end by "/")
+ *	@param[in]	scan	directory
  *	@return		1: has a loop, 0: don't have a loop
+ *
+ * The directory makes a loop if it is the root directory, an ancestor of
+ * the root directory or an ancestor of itself.
  */
 static int
-has_symlinkloop(const char *dir)
+has_symlinkloop(const struct dirscan *scan)
 {
-	struct stack_entry *sp;
-	char *real, *p;
-	int i, ret = 0;
+	struct fileid *id;
+	int i;
 
-	if (!strcmp(dir, "./"))
+	if (scan->depth == 0)
 		return 0;
-	if ((real = realpath(dir, NULL)) == NULL)
-		die("cannot get real path of '%s'.", trimpath(dir));
-#ifdef SLOOPDEBUG
-	fprintf(stderr, "======== has_symlinkloop ======\n");
-	fprintf(stderr, "dir = '%s', real path = '%s'\n", dir, real);
-	fprintf(stderr, "TEST-1\n");
-	fprintf(stderr, "\tcheck '%s' < '%s'\n", real, rootdir);
-#endif
-	p = locatestring(rootdir, real, MATCH_AT_FIRST);
-	if (p && (*p == '/' || *p == '\0' || !strcmp(real, "/"))) {
-		ret = 1;
-		goto out;
-	}
-	sp = varray_assign(stack, 0, 0);
-#ifdef SLOOPDEBUG
-	fprintf(stderr, "TEST-2\n");
-#endif
-	for (i = current_entry; i >= 0; i--) {
-#ifdef SLOOPDEBUG
-		fprintf(stderr, "%d:\tcheck '%s' == '%s'\n", i, real, sp[i].real);
-#endif
-		if (!strcmp(sp[i].real, real)) {
-			ret = 1;
-			goto out;
-		}
-	}
-#ifdef SLOOPDEBUG
-	fprintf(stderr, "===============================\n");
-#endif
-out:
-	free(real);
-	return ret;
+	id = varray_assign(rootids, 0, 0);
+	for (i = 0; i < rootids->length; i++)
+		if (same_fileid(&scan->id, &id[i]))
+			return 1;
+	for (i = 0; i < scan->depth; i++)
+		if (same_fileid(&scan->id, &scan->ancestors[i]))
+			return 1;
+	return 0;
 }
 /**
  * skips '.', '..'.
@@ -578,86 +708,506 @@ ignore(const char *path)
 	return 0;
 }
 /**
- * getdirs: get directory list
+ * scan_open: make a dirscan structure.
  *
  *	@param[in]	dir	directory (should end by "/")
- *	@param[out]	sb	string buffer
- *	@return		-1: error, 0: normal
+ *	@param[in]	parent	parent directory, NULL: root directory
+ *	@return		dirscan structure
+ */
+static struct dirscan *
+scan_open(const char *dir, const struct dirscan *parent)
+{
+	struct dirscan *scan = (struct dirscan *)check_calloc(sizeof(struct dirscan), 1);
+
+	scan->path = check_strdup(dir);
+	if (parent) {
+		scan->depth = parent->depth + 1;
+		scan->ancestors = (struct fileid *)check_malloc(sizeof(struct fileid) * scan->depth);
+		memcpy(scan->ancestors, parent->ancestors, sizeof(struct fileid) * parent->depth);
+		scan->ancestors[parent->depth] = parent->id;
+	}
+	scan->list = strbuf_open(0);
+	scan->msg = strbuf_open(0);
+	return scan;
+}
+/**
+ * scan_close: free a dirscan structure.
+ */
+static void
+scan_close(struct dirscan *scan)
+{
+#ifdef USE_REALPATH_ID
+	if (scan->id.real)
+		free(scan->id.real);
+#endif
+	free(scan->path);
+	if (scan->ancestors)
+		free(scan->ancestors);
+	strbuf_close(scan->list);
+	strbuf_close(scan->msg);
+	if (scan->child)
+		varray_close(scan->child);
+	free(scan);
+}
+/**
+ * scan_message: keep a message to be printed later.
+ *
+ *	@param[in]	scan	dirscan structure
+ *	@param[in]	kind	'w': warning, 'e': explanation, 'd': fatal error
+ *	@param[in]	s	format, which has one '%s'
+ *	@param[in]	arg	argument
+ */
+static void
+scan_message(struct dirscan *scan, int kind, const char *s, const char *arg)
+{
+	strbuf_putc(scan->msg, kind);
+	strbuf_sprintf(scan->msg, s, arg);
+	strbuf_putc(scan->msg, '\0');
+}
+/**
+ * scan_report: print the messages of a directory.
+ */
+static void
+scan_report(struct dirscan *scan)
+{
+	const char *p = strbuf_value(scan->msg);
+	const char *end = p + strbuf_getlen(scan->msg);
+
+	for (; p < end; p += strlen(p) + 1) {
+		switch (*p) {
+		case 'w':
+			warning("%s", p + 1);
+			break;
+		case 'e':
+			fputs(p + 1, stderr);
+			break;
+		case 'd':
+			die("%s", p + 1);
+		}
+	}
+}
+/**
+ * stat_entry: stat(2) or lstat(2) for an entry of a directory.
+ */
+static int
+stat_entry(DIR *dirp, const char *dir, const char *name, int follow, struct stat *st)
+{
+#ifdef USE_AT_FUNCTIONS
+	return fstatat(dirfd(dirp), name, st, follow ? 0 : AT_SYMLINK_NOFOLLOW);
+#else
+	char path[MAXPATHLEN];
+
+	snprintf(path, sizeof(path), "%s%s", dir, name);
+#if defined(_WIN32) || defined(__DJGPP__)
+	return stat(path, st);
+#else
+	return follow ? stat(path, st) : lstat(path, st);
+#endif
+#endif
+}
+/**
+ * access_entry: access(2) for an entry of a directory.
+ */
+static int
+access_entry(DIR *dirp, const char *dir, const char *name)
+{
+#ifdef USE_AT_FUNCTIONS
+	return faccessat(dirfd(dirp), name, R_OK, 0);
+#else
+	char path[MAXPATHLEN];
+
+	snprintf(path, sizeof(path), "%s%s", dir, name);
+	return access(path, R_OK);
+#endif
+}
+/**
+ * scan_dir: get directory list
+ *
+ *	@param[in,out]	scan	dirscan structure
+ *		Output:	scan->list	directory list
+ *		Output:	scan->msg	messages
+ *		Output:	scan->status	-1: error, 0: normal
  *
  * format of directory list:
  * |ddir1\0ffile1\0|
  * means directory "dir1", file "file1".
+ *
+ * This function may be called by scanner threads. Messages are not printed
+ * here but kept in scan->msg.
  */
-static int
-getdirs(const char *dir, STRBUF *sb)
+static void
+scan_dir(struct dirscan *scan)
 {
 	DIR *dirp;
 	struct dirent *dp;
 	struct stat st;
 
-	if (check_looplink && has_symlinkloop(dir)) {
-		warning("symbolic link loop detected. '%s' is ignored.", trimpath(dir));
-		return -1;
+	scan->status = -1;
+	if (get_fileid(scan->path, &scan->id) < 0) {
+		scan_message(scan, 'd', "cannot get real path of '%s'.", trimpath(scan->path));
+		return;
 	}
-	if ((dirp = opendir(dir)) == NULL) {
-		warning("cannot open directory '%s'. ignored.", trimpath(dir));
-		return -1;
+	if (check_looplink && has_symlinkloop(scan)) {
+		scan_message(scan, 'w', "symbolic link loop detected. '%s' is ignored.", trimpath(scan->path));
+		return;
+	}
+	if ((dirp = opendir(scan->path)) == NULL) {
+		scan_message(scan, 'w', "cannot open directory '%s'. ignored.", trimpath(scan->path));
+		return;
 	}
 	while ((dp = readdir(dirp)) != NULL) {
+		int mode = 0;
+		int islink = -1;		/* -1: unknown */
+
 		if (ignore(dp->d_name))
 			continue;
-		if (stat(makepath(dir, dp->d_name, NULL), &st) < 0) {
-			warning("cannot stat '%s'. ignored.", trimpath(dp->d_name));
-			continue;
+		/*
+		 * The type in the directory entry saves a stat(2).
+		 */
+#if defined(HAVE_STRUCT_DIRENT_D_TYPE) && defined(DT_UNKNOWN)
+		switch (dp->d_type) {
+		case DT_REG:
+			mode = S_IFREG;
+			islink = 0;
+			break;
+		case DT_DIR:
+			mode = S_IFDIR;
+			islink = 0;
+			break;
+		case DT_LNK:
+			islink = 1;
+			break;
+		}
+#endif
+		if (mode == 0) {
+			if (stat_entry(dirp, scan->path, dp->d_name, 1, &st) < 0) {
+				scan_message(scan, 'w', "cannot stat '%s'. ignored.", trimpath(dp->d_name));
+				continue;
+			}
+			mode = st.st_mode;
 		}
-		if (S_ISSOCK(st.st_mode) || S_ISFIFO(st.st_mode) || S_ISCHR(st.st_mode) || S_ISBLK(st.st_mode)) {
-			warning("file is not regular file '%s'. ignored.", trimpath(dp->d_name));
+		if (S_ISSOCK(mode) || S_ISFIFO(mode) || S_ISCHR(mode) || S_ISBLK(mode)) {
+			scan_message(scan, 'w', "file is not regular file '%s'. ignored.", trimpath(dp->d_name));
 			continue;
 		}
-		if (access(makepath(dir, dp->d_name, NULL), R_OK) < 0) {
-			if (!skip_unreadable)
-				die("cannot read file '%s'.", trimpath(dp->d_name));
-			warning("cannot read '%s'. ignored.", trimpath(dp->d_name));
+		if (access_entry(dirp, scan->path, dp->d_name) < 0) {
+			if (!skip_unreadable) {
+				scan_message(scan, 'd', "cannot read file '%s'.", trimpath(dp->d_name));
+				break;
+			}
+			scan_message(scan, 'w', "cannot read '%s'. ignored.", trimpath(dp->d_name));
 			continue;
 		}
 #ifndef __DJGPP__
 		if (skip_symlink > 0) {
 #if defined(_WIN32) && !defined(__CYGWIN__)
-			DWORD attr = GetFileAttributes(makepath(dir, dp->d_name, NULL));
-			if (attr != -1 && (attr & FILE_ATTRIBUTE_REPARSE_POINT))
+			char path[MAXPATHLEN];
+			DWORD attr;
+
+			snprintf(path, sizeof(path), "%s%s", scan->path, dp->d_name);
+			attr = GetFileAttributes(path);
+			islink = (attr != -1 && (attr & FILE_ATTRIBUTE_REPARSE_POINT));
 #else
-			struct stat st2;
+			if (islink < 0) {
+				struct stat st2;
 
-			if (lstat(makepath(dir, dp->d_name, NULL), &st2) < 0) {
-				warning("cannot lstat '%s'. ignored.", trimpath(dp->d_name));
-				continue;
+				if (stat_entry(dirp, scan->path, dp->d_name, 0, &st2) < 0) {
+					scan_message(scan, 'w', "cannot lstat '%s'. ignored.", trimpath(dp->d_name));
+					continue;
+				}
+				islink = S_ISLNK(st2.st_mode);
 			}
-			if (S_ISLNK(st2.st_mode))
 #endif
-			{
-				if (((skip_symlink & SKIP_SYMLINK_FOR_DIR) && S_ISDIR(st.st_mode)) ||
-				    ((skip_symlink & SKIP_SYMLINK_FOR_FILE) && S_ISREG(st.st_mode)))
+			if (islink) {
+				if (((skip_symlink & SKIP_SYMLINK_FOR_DIR) && S_ISDIR(mode)) ||
+				    ((skip_symlink & SKIP_SYMLINK_FOR_FILE) && S_ISREG(mode)))
 				{
-					if (find_explain)
-						fprintf(stderr, " - Symbolic link '%s' is skipped.\n",
-							trimpath(makepath(dir, dp->d_name, NULL)));
+					if (find_explain) {
+						char path[MAXPATHLEN];
+
+						snprintf(path, sizeof(path), "%s%s", scan->path, dp->d_name);
+						scan_message(scan, 'e', " - Symbolic link '%s' is skipped.\n", trimpath(path));
+					}
 					continue;
 				}
 			}
 		}
 #endif
-		if (S_ISDIR(st.st_mode))
-			strbuf_putc(sb, 'd');
-		else if (S_ISREG(st.st_mode))
-			strbuf_putc(sb, 'f');
+		if (S_ISDIR(mode))
+			strbuf_putc(scan->list, 'd');
+		else if (S_ISREG(mode))
+			strbuf_putc(scan->list, 'f');
 		else
-			strbuf_putc(sb, ' ');
-		strbuf_puts(sb, dp->d_name);
-		strbuf_putc(sb, '\0');
+			strbuf_putc(scan->list, ' ');
+		strbuf_puts(scan->list, dp->d_name);
+		strbuf_putc(scan->list, '\0');
 	}
 	(void)closedir(dirp);
-	return 0;
+	scan->status = 0;
+}
+#ifdef USE_SCANNER_THREADS
+/*
+ * Job queue. These functions should be called with scan_lock held.
+ */
+static void
+queue_push(struct dirscan *scan)
+{
+	scan->state = SCAN_QUEUED;
+	scan->prev = NULL;
+	scan->next = queue;
+	if (queue)
+		queue->prev = scan;
+	queue = scan;
+}
+static void
+queue_unlink(struct dirscan *scan)
+{
+	if (scan->prev)
+		scan->prev->next = scan->next;
+	else
+		queue = scan->next;
+	if (scan->next)
+		scan->next->prev = scan->prev;
+	scan->prev = scan->next = NULL;
+}
+#endif
+/**
+ * scan_run: scan a directory and queue its subdirectories.
+ *
+ *	@param[in,out]	scan	dirscan structure
+ *
+ * The subdirectories which are not skipped are queued so that scanner
+ * threads read them ahead. They are pushed in reverse order, so the
+ * directory which will be visited first is taken first.
+ */
+static void
+scan_run(struct dirscan *scan)
+{
+#ifdef USE_SCANNER_THREADS
+	VARRAY *child;
+	struct dirscan **c;
+	const char *p, *end;
+	int i;
+
+	scan_dir(scan);
+	if (nscanners == 0) {
+		scan->state = SCAN_DONE;
+		return;
+	}
+	child = varray_open(sizeof(struct dirscan *), 32);
+	if (scan->status == 0) {
+		p = strbuf_value(scan->list);
+		end = p + strbuf_getlen(scan->list);
+		for (; p < end; p += strlen(p) + 1) {
+			char path[MAXPATHLEN];
+
+			if (*p != 'd')
+				continue;
+			c = varray_append(child);
+			*c = NULL;
+			if (snprintf(path, sizeof(path), "%s%s/", scan->path, p + 1) >= sizeof(path))
+				continue;
+			if (!pathmatch_exec(skip, path, NULL, NULL))
+				*c = scan_open(path, scan);
+		}
+	}
+	c = varray_assign(child, 0, 0);
+	pthread_mutex_lock(&scan_lock);
+	if (scan->orphan) {
+		pthread_mutex_unlock(&scan_lock);
+		for (i = 0; i < child->length; i++)
+			if (c[i])
+				scan_close(c[i]);
+		varray_close(child);
+		scan_close(scan);
+		return;
+	}
+	for (i = child->length - 1; i >= 0; i--) {
+		if (c[i] == NULL)
+			continue;
+		if (prefetched < MAXPREFETCH) {
+			queue_push(c[i]);
+			prefetched++;
+		} else {
+			scan_close(c[i]);
+			c[i] = NULL;
+		}
+	}
+	scan->child = child;
+	scan->state = SCAN_DONE;
+	pthread_cond_broadcast(&scan_done);
+	if (queue)
+		pthread_cond_broadcast(&scan_queued);
+	pthread_mutex_unlock(&scan_lock);
+#else
+	scan_dir(scan);
+	scan->state = SCAN_DONE;
+#endif
+}
+/**
+ * scan_take: take the result of scanning a subdirectory.
+ *
+ *	@param[in]	parent	parent directory
+ *	@param[in]	index	index of the subdirectory in the directories of parent
+ *	@param[in]	dir	subdirectory (should end by "/")
+ *	@return		dirscan structure
+ *
+ * If a scanner thread is reading the subdirectory, the result is waited for.
+ * If it is still in the queue or was not queued, it is scanned here.
+ */
+static struct dirscan *
+scan_take(struct dirscan *parent, int index, const char *dir)
+{
+	struct dirscan *scan = NULL;
+
+#ifdef USE_SCANNER_THREADS
+	if (parent->child && index < parent->child->length) {
+		struct dirscan **c = varray_assign(parent->child, index, 0);
+
+		pthread_mutex_lock(&scan_lock);
+		if ((scan = *c) != NULL) {
+			*c = NULL;
+			prefetched--;
+			if (scan->state == SCAN_QUEUED) {
+				queue_unlink(scan);
+				scan->state = SCAN_RUNNING;
+				pthread_mutex_unlock(&scan_lock);
+				scan_run(scan);
+				pthread_mutex_lock(&scan_lock);
+			}
+			while (scan->state != SCAN_DONE)
+				pthread_cond_wait(&scan_done, &scan_lock);
+		}
+		pthread_mutex_unlock(&scan_lock);
+	}
+#endif
+	if (scan == NULL) {
+		scan = scan_open(dir, parent);
+		scan_run(scan);
+	}
+	return scan;
+}
+/**
+ * scan_release: free a dirscan structure and the queued jobs under it.
+ */
+static void
+scan_release(struct dirscan *scan)
+{
+#ifdef USE_SCANNER_THREADS
+	if (scan->child) {
+		struct dirscan **c = varray_assign(scan->child, 0, 0);
+		int i;
+
+		for (i = 0; i < scan->child->length; i++) {
+			struct dirscan *sub = c[i];
+
+			if (sub == NULL)
+				continue;
+			c[i] = NULL;
+			pthread_mutex_lock(&scan_lock);
+			prefetched--;
+			if (sub->state == SCAN_RUNNING) {
+				/* The scanner thread frees it. */
+				sub->orphan = 1;
+				sub = NULL;
+			} else if (sub->state == SCAN_QUEUED) {
+				queue_unlink(sub);
+			}
+			pthread_mutex_unlock(&scan_lock);
+			if (sub)
+				scan_release(sub);
+		}
+	}
+#endif
+	scan_close(scan);
+}
+#ifdef USE_SCANNER_THREADS
+/**
+ * scanner_main: main loop of a scanner thread.
+ */
+static void *
+scanner_main(void *arg)
+{
+	struct dirscan *scan;
+
+	pthread_mutex_lock(&scan_lock);
+	for (;;) {
+		while (queue == NULL && !scan_quit)
+			pthread_cond_wait(&scan_queued, &scan_lock);
+		if (scan_quit)
+			break;
+		scan = queue;
+		queue_unlink(scan);
+		scan->state = SCAN_RUNNING;
+		pthread_mutex_unlock(&scan_lock);
+		scan_run(scan);
+		pthread_mutex_lock(&scan_lock);
+	}
+	pthread_mutex_unlock(&scan_lock);
+	return NULL;
+}
+#endif
+/**
+ * start_scanners: start scanner threads.
+ */
+static void
+start_scanners(void)
+{
+#ifdef USE_SCANNER_THREADS
+	int i;
+
+	if (find_jobs <= 1)
+		return;
+	scanners = (pthread_t *)check_calloc(sizeof(pthread_t), find_jobs);
+	scan_quit = 0;
+	prefetched = 0;
+	for (i = 0; i < find_jobs; i++) {
+		if (pthread_create(&scanners[i], NULL, scanner_main, NULL) != 0)
+			break;
+		nscanners++;
+	}
+	if (nscanners == 0) {
+		warning("cannot create threads for reading directories.");
+		free(scanners);
+		scanners = NULL;
+	}
+#endif
+}
+/**
+ * stop_scanners: stop scanner threads.
+ */
+static void
+stop_scanners(void)
+{
+#ifdef USE_SCANNER_THREADS
+	int i;
+
+	if (nscanners == 0)
+		return;
+	pthread_mutex_lock(&scan_lock);
+	scan_quit = 1;
+	pthread_cond_broadcast(&scan_queued);
+	pthread_mutex_unlock(&scan_lock);
+	for (i = 0; i < nscanners; i++)
+		pthread_join(scanners[i], NULL);
+	free(scanners);
+	scanners = NULL;
+	nscanners = 0;
+#endif
 }
+
+/*
+ * Directory Stack
+ */
+static char dir[MAXPATHLEN];			/**< directory path */
+static VARRAY *stack;				/**< dynamic allocated array */
+struct stack_entry {
+	struct dirscan *scan;
+	int index;				/**< index of the next directory */
+	char *dirp, *start, *end, *p;
+};
+static int current_entry;			/**< current entry of the stack */
+
 /**
  * set_accept_dotfiles: make find to accept dot files and dot directries.
  */
@@ -687,6 +1237,16 @@ set_skip_symlink(int mode)
 {
 	skip_symlink = mode;
 }
+/**
+ * set_find_jobs: set the number of threads which read directories.
+ *
+ *	@param[in]	jobs	number of threads, 1: don't use threads
+ */
+void
+set_find_jobs(int jobs)
+{
+	find_jobs = jobs;
+}
 /**
  * find_open: start iterator without GPATH.
  *
@@ -714,12 +1274,24 @@ find_open(const char *start, int explain)
 	curp = varray_assign(stack, current_entry, 1);
 	strlimcpy(dir, start, sizeof(dir));
 	curp->dirp = dir + strlen(dir);
-	curp->sb = strbuf_open(0);
-	curp->real = getrealpath(dir);
-	if (getdirs(dir, curp->sb) < 0)
+	prepare_rootids(rootdir);
+	/*
+	 * Scanner threads use the skip list.
+	 */
+	if (skip == NULL) {
+		skip = prepare_skip();
+		if (skip == NULL)
+			die("prepare_skip failed.");
+	}
+	start_scanners();
+	curp->scan = scan_open(dir, NULL);
+	scan_run(curp->scan);
+	scan_report(curp->scan);
+	if (curp->scan->status < 0)
 		die("Work is given up.");
-	curp->start = curp->p = strbuf_value(curp->sb);
-	curp->end   = curp->start + strbuf_getlen(curp->sb);
+	curp->index = 0;
+	curp->start = curp->p = strbuf_value(curp->scan->list);
+	curp->end   = curp->start + strbuf_getlen(curp->scan->list);
 	strlimcpy(cwddir, get_root(), sizeof(cwddir));
 }
 /**
@@ -862,6 +1434,7 @@ find_read_traverse(void)
 		while (curp->p < curp->end) {
 			char type = *(curp->p);
 			const char *unit = curp->p + 1;
+			int index = (type == 'd') ? curp->index++ : -1;
 
 			curp->p += strlen(curp->p) + 1;
 
@@ -876,18 +1449,10 @@ find_read_traverse(void)
 				continue;
 			if (type == 'f') {
 				/*
-				 * Skip the following:
-				 * o directory
-				 * o file which does not exist
-				 * o dead symbolic link
+				 * Type 'f' means a regular file, or a symbolic link
+				 * to a regular file. Directories, missing files and
+				 * dead symbolic links never come here.
 				 */
-				if (!test("f", path)) {
-					if (test("d", path))
-						warning("'%s' is a directory. ignored.", trimpath(path));
-					else
-						warning("'%s' not found. ignored.", trimpath(path));
-					continue;
-				}
 				/*
 				 * Now GLOBAL can treat the path which includes blanks.
 				 * This message is obsoleted.
@@ -911,30 +1476,29 @@ find_read_traverse(void)
 				return val;
 			}
 			if (type == 'd') {
-				STRBUF *sb = strbuf_open(0);
+				struct dirscan *scan = scan_take(curp->scan, index, path);
 				char *dirp = curp->dirp;
-				strcat(dirp, unit);
-				strcat(dirp, "/");
-				if (getdirs(dir, sb) < 0) {
-					strbuf_close(sb);
-					*(curp->dirp) = 0;
+
+				scan_report(scan);
+				if (scan->status < 0) {
+					scan_release(scan);
 					continue;
 				}
+				strcat(dirp, unit);
+				strcat(dirp, "/");
 				/*
 				 * Push stack.
 				 */
 				curp = varray_assign(stack, ++current_entry, 1);
 				curp->dirp = dirp + strlen(dirp);
-				curp->real = getrealpath(dir);
-				curp->sb = sb;
-				curp->start = curp->p = strbuf_value(sb);
-				curp->end   = curp->start + strbuf_getlen(sb);
+				curp->scan = scan;
+				curp->index = 0;
+				curp->start = curp->p = strbuf_value(scan->list);
+				curp->end   = curp->start + strbuf_getlen(scan->list);
 			}
 		}
-		strbuf_close(curp->sb);
-		curp->sb = NULL;
-		free(curp->real);
-		curp->real = NULL;
+		scan_release(curp->scan);
+		curp->scan = NULL;
 		if (current_entry == 0)
 			break;
 		/*
@@ -975,8 +1539,27 @@ find_close(void)
 {
 	assert(find_mode != 0);
 	if (find_mode == FIND_OPEN) {
-		if (stack)
+		if (stack) {
+			struct stack_entry *sp = varray_assign(stack, 0, 0);
+			int i;
+
+			for (i = 0; i < stack->length; i++)
+				if (sp[i].scan)
+					scan_release(sp[i].scan);
 			varray_close(stack);
+		}
+		stop_scanners();
+		if (rootids) {
+#ifdef USE_REALPATH_ID
+			struct fileid *id = varray_assign(rootids, 0, 0);
+			int i;
+
+			for (i = 0; i < rootids->length; i++)
+				free(id[i].real);
+#endif
+			varray_close(rootids);
+			rootids = NULL;
+		}
 	} else if (find_mode == FILELIST_OPEN) {
 		/*
 		 * The --file=- option is specified, we don't close file
@@ -989,9 +1572,13 @@ find_close(void)
 	}
 	if (rootdir)
 		free(rootdir);
-	if (suff)
-		regfree(suff);
-	if (skip)
-		regfree(skip);
+	if (suff) {
+		pathmatch_close(suff);
+		suff = NULL;
+	}
+	if (skip) {
+		pathmatch_close(skip);
+		skip = NULL;
+	}
 	find_eof = find_mode = 0;
 }
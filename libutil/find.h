@@ -28,6 +28,7 @@
 void set_accept_dotfiles(void);
 void set_skip_unreadable(void);
 void set_skip_symlink(int);
+void set_find_jobs(int);
 int skipthisfile(const char *);
 int issourcefile(const char *);
 void find_open(const char *, int);
@@ -62,9 +62,11 @@
 #include "tab.h"
 #include "test.h"
 #include "token.h"
+#include "trigram.h"
 #include "usable.h"
 #include "version.h"
 #include "varray.h"
+#include "workpool.h"
 #include "xargs.h"
 
 #endif /* ! _GLOBAL_H_ */
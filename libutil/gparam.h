@@ -59,5 +59,14 @@
 #define GTAGSCACHE	50000000
 		/** minimum cache size 500KB	*/
 #define GTAGSMINCACHE	500000
+/*
+ * The default memory size for sorted writing is 50MB.
+ * When records exceed it, they are spilled into temporary files.
+ * The minimum size is 100KB.
+ */
+		/** default sort buffer size 50MB	*/
+#define GTAGSSORTBUF	50000000
+		/** minimum sort buffer size 100KB	*/
+#define GTAGSMINSORTBUF	100000
 
 #endif /* ! _GPARAM_H_ */
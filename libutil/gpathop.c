@@ -21,7 +21,11 @@
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <assert.h>
+#include <stdio.h>
+#include <time.h>
 #ifdef STDC_HEADERS
 #include <stdlib.h>
 #endif
@@ -30,6 +34,9 @@
 #else
 #include <strings.h>
 #endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 #include "checkalloc.h"
 #include "die.h"
@@ -40,7 +47,9 @@
 #include "makepath.h"
 #include "nearsort.h"
 #include "strbuf.h"
+#include "strhash.h"
 #include "strlimcpy.h"
+#include "varray.h"
 
 static DBOP *dbop;
 static int _startkey;
@@ -48,6 +57,43 @@ static int _nextkey;
 static int _mode;
 static int opened;
 static int created;
+static int _generation;
+static char _dbpath[MAXPATHLEN];
+
+/*
+ * Cache of the mapping between file ids and path names.
+ * It is used only in read only mode, because GPATH is not changed then.
+ * The array is indexed by integer file id and filled lazily.
+ */
+struct fid_entry {
+	const char *path;		/**< path name, NULL: not looked up yet */
+	const char *fid;		/**< file id */
+	int type;			/**< GPATH_SOURCE, GPATH_OTHER, 0: not found */
+};
+static struct fid_entry *fid_cache;	/**< file id => struct fid_entry */
+static STRHASH *path_cache;		/**< path name => struct fid_entry */
+static struct fid_entry not_found;
+
+/*
+ * Stuff for making the full-text index (GREPKEY).
+ */
+struct grep_pair {
+	unsigned int trigram;		/**< trigram as a 24 bit number */
+	unsigned int fid;		/**< file id */
+};
+			/** maximum number of pairs in the memory */
+#define GREP_PAIRS	(GTAGSSORTBUF / sizeof(struct grep_pair) / 2)
+static VARRAY *grep_pairs;		/**< (trigram, file id) pairs */
+static unsigned char *grep_seen;	/**< bit map of the trigrams of a file */
+static VARRAY *grep_trigrams;		/**< the trigrams of a file (int) */
+static unsigned int grep_last;		/**< the last three bytes */
+static int grep_length;			/**< length of the current line (up to 3) */
+
+static void grep_open(void);
+static void grep_scan(const unsigned char *, size_t);
+static void grep_put(unsigned int);
+static void grep_flush(void);
+static void grep_close(void);
 
 int openflags;
 void
@@ -101,9 +147,51 @@ compare_nearpath(const void *s1, const void *s2)
  *      --------------------
  *      ./aaa.c\0       11\0
  *      ./README\0      12\0o\0         <=== 'o' means other files.
+ *
+ * In addition, GPATH has a meta record for each source file, which describes
+ * the state of the file at the time it was parsed. It consists of
+ * size, modification time, change time, inode number and content hash.
+ * Older GLOBAL ignores it, so the format version is not changed.
+ *
+ *      key             data
+ *      --------------------
+ *      " __.STAT 11"\0  " 1234 1514732400 1514732400 56789 8c9b7f0e1d2a3b4c"\0
+ *
+ * If GPATH is made by 'gtags --grep-index', it has also the full-text index
+ * of source files, which is used by 'global -g'. For each trigram (three
+ * successive bytes in a line whose upper case letters are converted into
+ * lower case) of the contents, meta records list the file ids of the source
+ * files which include it. The " __.GREP" option record shows that it is
+ * available.
+ *
+ *      key                     data
+ *      --------------------
+ *      " __.GREP"\0            " __.GREP"\0
+ *      " __.GREP _op 11"\0     " <11><3><40>"\0   <=== 11, 14, 54
+ *
+ * The file ids are sorted in a record, and each of them is written as the
+ * difference from the previous one in LEB128 (see GET_VARINT()). The last
+ * word of the key is the first file id of the record. A list consists of
+ * records of up to DBOP_PAGESIZE / 4 bytes, and gtags(1) may write a list in
+ * several times to save the memory. Incremental updating adds records
+ * for reparsed files, and the file ids of changed or deleted files are left
+ * in the list. They only make global(1) read the files needlessly, since it
+ * reads the files which were changed after the indexing anyway.
+ * Other files are not indexed.
  */
 static int support_version = 2;	/**< acceptable format version   */
 static int create_version = 2;	/**< format version of newly created tag file */
+/**
+ * stat_key: make the key of the stat record.
+ */
+static const char *
+stat_key(const char *fid)
+{
+	static char key[sizeof(STATKEY) + MAXFIDLEN];
+
+	snprintf(key, sizeof(key), "%s %s", STATKEY, fid);
+	return key;
+}
 /**
  * gpath_open: open gpath tag file
  *
@@ -127,6 +215,7 @@ gpath_open(const char *dbpath, int mode)
 	 * We create GPATH just first time.
 	 */
 	_mode = mode;
+	strlimcpy(_dbpath, dbpath, sizeof(_dbpath));
 	if (mode == 1 && created)
 		mode = 0;
 	dbop = dbop_open(makepath(dbpath, dbname(GPATH), NULL), mode, 0644, openflags);
@@ -142,11 +231,14 @@ gpath_open(const char *dbpath, int mode)
 		if (path == NULL)
 			die("nextkey not found in GPATH.");
 		_startkey = _nextkey = atoi(path);
+		_generation = dbop_getgeneration(dbop);
 		format_version = dbop_getversion(dbop);
 		if (format_version > support_version)
 			die("GPATH seems new format. Please install the latest GLOBAL.");
 		else if (format_version < support_version)
                         die("GPATH seems older format. Please remake tag files."); 
+		if (mode == 2 && dbop_getoption(dbop, GREPKEY) != NULL)
+			grep_open();
 	}
 	opened++;
 	return 0;
@@ -188,6 +280,87 @@ gpath_put(const char *path, int type)
 	dbop_put_path(dbop, sfid, strbuf_value(sb), type == GPATH_OTHER ? "o" : NULL);
 	return (const char *)sfid;
 }
+/**
+ * cache_open: prepare the cache.
+ */
+static void
+cache_open(void)
+{
+	fid_cache = (struct fid_entry *)check_calloc(sizeof(struct fid_entry), _nextkey);
+	path_cache = strhash_open(1024);
+}
+/**
+ * cache_lookup_fid: lookup file id using the cache.
+ *
+ *	@param[in]	fid	file id
+ *	@return		entry, NULL: fid is not a usual file id
+ */
+static struct fid_entry *
+cache_lookup_fid(const char *fid)
+{
+	struct fid_entry *entry;
+	const char *path, *p;
+	int n = 0;
+
+	if (*fid < '1' || *fid > '9')
+		return NULL;
+	for (p = fid; *p; p++) {
+		if (*p < '0' || *p > '9' || n >= _nextkey)
+			return NULL;
+		n = n * 10 + *p - '0';
+	}
+	if (n >= _nextkey)
+		return NULL;
+	if (fid_cache == NULL)
+		cache_open();
+	entry = &fid_cache[n];
+	if (entry->path != NULL)
+		return entry;
+	if ((path = dbop_get(dbop, fid)) != NULL) {
+		struct sh_entry *sh = strhash_assign(path_cache, path, 1);
+
+		entry->type = (*dbop_getflag(dbop) == 'o') ? GPATH_OTHER : GPATH_SOURCE;
+		entry->fid = strhash_strdup(path_cache, fid, 0);
+		entry->path = sh->name;
+		sh->value = entry;
+	} else {
+		entry->path = "";
+		entry->type = 0;
+	}
+	return entry;
+}
+/**
+ * cache_lookup_path: lookup path name using the cache.
+ *
+ *	@param[in]	path	path name
+ *	@return		entry
+ */
+static struct fid_entry *
+cache_lookup_path(const char *path)
+{
+	struct sh_entry *sh;
+	struct fid_entry *entry;
+	const char *fid;
+
+	if (fid_cache == NULL)
+		cache_open();
+	sh = strhash_assign(path_cache, path, 1);
+	if (sh->value != NULL)
+		return (struct fid_entry *)sh->value;
+	if ((fid = dbop_get(dbop, path)) == NULL)
+		entry = &not_found;
+	else if ((entry = cache_lookup_fid(fid)) == NULL || entry->type == 0) {
+		/*
+		 * Irregular file id. Use a private entry.
+		 */
+		entry = pool_malloc(path_cache->pool, sizeof(struct fid_entry));
+		entry->type = (*dbop_getflag(dbop) == 'o') ? GPATH_OTHER : GPATH_SOURCE;
+		entry->fid = strhash_strdup(path_cache, fid, 0);
+		entry->path = sh->name;
+	}
+	sh->value = entry;
+	return entry;
+}
 /**
  * gpath_path2fid: convert path into id
  *
@@ -200,8 +373,19 @@ gpath_put(const char *path, int type)
 const char *
 gpath_path2fid(const char *path, int *type)
 {
-	const char *fid = dbop_get(dbop, path);
+	const char *fid;
+
 	assert(opened > 0);
+	if (_mode == 0) {
+		struct fid_entry *entry = cache_lookup_path(path);
+
+		if (entry->type == 0)
+			return NULL;
+		if (type)
+			*type = entry->type;
+		return entry->fid;
+	}
+	fid = dbop_get(dbop, path);
 	if (fid && type) {
 		const char *flag = dbop_getflag(dbop);
 		*type = (*flag == 'o') ? GPATH_OTHER : GPATH_SOURCE;
@@ -221,8 +405,21 @@ gpath_path2fid(const char *path, int *type)
 const char *
 gpath_fid2path(const char *fid, int *type)
 {
-	const char *path = dbop_get(dbop, fid);
+	const char *path;
+
 	assert(opened > 0);
+	if (_mode == 0) {
+		struct fid_entry *entry = cache_lookup_fid(fid);
+
+		if (entry != NULL) {
+			if (entry->type == 0)
+				return NULL;
+			if (type)
+				*type = entry->type;
+			return entry->path;
+		}
+	}
+	path = dbop_get(dbop, fid);
 	if (path && type) {
 		const char *flag = dbop_getflag(dbop);
 		*type = (*flag == 'o') ? GPATH_OTHER : GPATH_SOURCE;
@@ -268,6 +465,7 @@ gpath_nfid2path(int nfid, int *type)
 void
 gpath_delete(const char *path)
 {
+	char key[sizeof(STATKEY) + MAXFIDLEN];
 	const char *fid;
 
 	assert(opened > 0);
@@ -276,8 +474,549 @@ gpath_delete(const char *path)
 	fid = dbop_get(dbop, path);
 	if (fid == NULL)
 		return;
+	strlimcpy(key, stat_key(fid), sizeof(key));
 	dbop_delete(dbop, fid);
 	dbop_delete(dbop, path);
+	dbop_delete(dbop, key);
+}
+/*
+ * Stuff for the full-text index.
+ */
+/**
+ * grep_open: prepare for making the full-text index.
+ */
+static void
+grep_open(void)
+{
+	grep_pairs = varray_open(sizeof(struct grep_pair), 100000);
+	grep_seen = (unsigned char *)check_calloc(1, (1 << 24) / 8);
+	grep_trigrams = varray_open(sizeof(int), 10000);
+	grep_last = grep_length = 0;
+}
+/**
+ * grep_scan: extract the trigrams from the contents of a file.
+ *
+ *	@param[in]	buf	a part of the contents
+ *	@param[in]	n	size of buf
+ *
+ * A trigram is kept as a 24 bit number. Trigrams which include a newline
+ * or a null character are ignored, since no line read by global(1)
+ * includes them. Each trigram is recorded once per file using grep_seen.
+ */
+static void
+grep_scan(const unsigned char *buf, size_t n)
+{
+	unsigned int last = grep_last;
+	int length = grep_length;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		unsigned int c = buf[i];
+
+		if (c == '\n' || c == '\0') {
+			length = 0;
+			continue;
+		}
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		last = ((last << 8) | c) & 0xffffff;
+		if (length < 3 && ++length < 3)
+			continue;
+		if (!(grep_seen[last >> 3] & (1 << (last & 7)))) {
+			grep_seen[last >> 3] |= 1 << (last & 7);
+			*(int *)varray_append(grep_trigrams) = last;
+		}
+	}
+	grep_last = last;
+	grep_length = length;
+}
+/**
+ * grep_put: add a file to the lists of its trigrams.
+ *
+ *	@param[in]	fid	file id, 0: discard the trigrams
+ *
+ * The pairs of a trigram and a file id are kept in the memory, and they are
+ * flushed when the number exceeds GREP_PAIRS.
+ */
+static void
+grep_put(unsigned int fid)
+{
+	int *trigrams = varray_assign(grep_trigrams, 0, 0);
+	int i;
+
+	for (i = 0; i < grep_trigrams->length; i++) {
+		unsigned int t = trigrams[i];
+
+		grep_seen[t >> 3] &= ~(1 << (t & 7));
+		if (fid > 0) {
+			struct grep_pair *pair = varray_append(grep_pairs);
+
+			pair->trigram = t;
+			pair->fid = fid;
+		}
+	}
+	varray_reset(grep_trigrams);
+	grep_last = grep_length = 0;
+	if (grep_pairs->length >= GREP_PAIRS)
+		grep_flush();
+}
+/**
+ * compare_fid: compare function for sorting file ids.
+ */
+static int
+compare_fid(const void *v1, const void *v2)
+{
+	unsigned int n1 = *(const unsigned int *)v1;
+	unsigned int n2 = *(const unsigned int *)v2;
+
+	return n1 < n2 ? -1 : n1 > n2 ? 1 : 0;
+}
+/**
+ * grep_decode: decode a record of the full-text index.
+ *
+ *	@param[in]	dat	data of the record
+ *	@param[out]	fids	VARRAY of file ids (unsigned int), appended
+ */
+static void
+grep_decode(const char *dat, VARRAY *fids)
+{
+	unsigned int n, fid = 0;
+
+	if (*dat++ != ' ')
+		die("GPATH is corrupted.(invalid full-text index)");
+	while (*dat) {
+		GET_VARINT(dat, n);
+		fid += n;
+		*(unsigned int *)varray_append(fids) = fid;
+	}
+}
+/**
+ * grep_write: write the list of a trigram.
+ *
+ *	@param[in]	trigram	trigram
+ *	@param[in]	fids	VARRAY of file ids (unsigned int)
+ *
+ * In modify mode, a record which has the same key is merged into the list.
+ */
+static void
+grep_write(const char *trigram, VARRAY *fids)
+{
+	STATIC_STRBUF(sb);
+	char key[sizeof(GREPKEY) + 5 + MAXFIDLEN];
+	unsigned int *list, last, prev = 0;
+	const char *dat;
+	int i = 0;
+
+	qsort(varray_assign(fids, 0, 0), fids->length, sizeof(unsigned int), compare_fid);
+	while (i < fids->length) {
+		list = varray_assign(fids, 0, 0);
+		if (list[i] == prev) {
+			i++;
+			continue;
+		}
+		snprintf(key, sizeof(key), "%s %s %u", GREPKEY, trigram, list[i]);
+		if (_mode == 2 && (dat = dbop_get(dbop, key)) != NULL) {
+			/* The file ids in the record are not less than list[i]. */
+			grep_decode(dat, fids);
+			list = varray_assign(fids, 0, 0);
+			qsort(list + i, fids->length - i, sizeof(unsigned int), compare_fid);
+			dbop_delete(dbop, key);
+		}
+		strbuf_reset(sb);
+		strbuf_putc(sb, ' ');
+		for (last = 0; i < fids->length && strbuf_getlen(sb) < DBOP_PAGESIZE / 4; i++) {
+			if (list[i] == prev)
+				continue;
+			put_varint(sb, list[i] - last);
+			last = prev = list[i];
+		}
+		dbop_put(dbop, key, strbuf_value(sb));
+	}
+}
+/**
+ * grep_flush: write the lists in the memory to GPATH.
+ */
+static void
+grep_flush(void)
+{
+	int count = grep_pairs->length;
+	struct grep_pair *pairs, *work, *buf;
+	VARRAY *fids;
+	int shift, i, j;
+
+	if (count == 0)
+		return;
+	pairs = varray_assign(grep_pairs, 0, 0);
+	work = buf = (struct grep_pair *)check_malloc(sizeof(struct grep_pair) * count);
+	/*
+	 * Sort the pairs by trigram using radix sort, which keeps the order
+	 * of file ids in each trigram.
+	 */
+	for (shift = 0; shift < 24; shift += 8) {
+		struct grep_pair *tmp;
+		int pos[256], sum = 0;
+
+		memset(pos, 0, sizeof(pos));
+		for (i = 0; i < count; i++)
+			pos[(pairs[i].trigram >> shift) & 0xff]++;
+		for (i = 0; i < 256; i++) {
+			int n = pos[i];
+
+			pos[i] = sum;
+			sum += n;
+		}
+		for (i = 0; i < count; i++)
+			work[pos[(pairs[i].trigram >> shift) & 0xff]++] = pairs[i];
+		tmp = pairs;
+		pairs = work;
+		work = tmp;
+	}
+	fids = varray_open(sizeof(unsigned int), 1000);
+	for (i = 0; i < count; i = j) {
+		unsigned int t = pairs[i].trigram;
+		char name[4];
+
+		varray_reset(fids);
+		for (j = i; j < count && pairs[j].trigram == t; j++)
+			*(unsigned int *)varray_append(fids) = pairs[j].fid;
+		name[0] = t >> 16;
+		name[1] = (t >> 8) & 0xff;
+		name[2] = t & 0xff;
+		name[3] = '\0';
+		grep_write(name, fids);
+	}
+	varray_close(fids);
+	free(buf);
+	varray_reset(grep_pairs);
+}
+/**
+ * grep_close: release the memory for making the full-text index.
+ */
+static void
+grep_close(void)
+{
+	varray_close(grep_pairs);
+	grep_pairs = NULL;
+	free(grep_seen);
+	grep_seen = NULL;
+	varray_close(grep_trigrams);
+	grep_trigrams = NULL;
+}
+/*
+ * Stuff for change detection of source files.
+ *
+ * The stat record of a file is written after the file is parsed, with
+ * the hash value computed by the tokenizer from the mapped contents (see
+ * tokenfilestat()). So, the file is read only once. Only the files which
+ * the tokenizer did not map are read again here.
+ *
+ *	gpath_putstat(path);		before parsing
+ *	parse_file(path, ...);
+ *	gpath_puthash(path, &st, &hash);	after parsing
+ */
+struct pending {
+	char *path;
+	char key[sizeof(STATKEY) + MAXFIDLEN];
+	struct stat st;			/**< stat before parsing */
+};
+static VARRAY *pending;			/**< files waiting for gpath_puthash() */
+static int pending_head;
+
+/**
+ * gpath_hash: compute the hash value of contents (FNV-1a, 64 bits).
+ *
+ *	@param[in]	h	GPATH_HASHINIT or the value for the preceding contents
+ *	@param[in]	buf	contents
+ *	@param[in]	size	size of the contents
+ *	@return		hash value
+ */
+unsigned long long
+gpath_hash(unsigned long long h, const void *buf, size_t size)
+{
+	const unsigned char *p = buf, *end = p + size;
+
+	while (p < end) {
+		h ^= *p++;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+/**
+ * hash_file: compute the hash value of the contents of a file.
+ *
+ *	@param[in]	path	path name
+ *	@param[out]	hash	hash value (gpath_hash())
+ *	@param[in]	scan	1: pass the contents to the full-text index
+ *	@return		0: normal, -1: cannot read the file
+ */
+static int
+hash_file(const char *path, unsigned long long *hash, int scan)
+{
+	static unsigned char buf[65536];
+	unsigned long long h = GPATH_HASHINIT;
+	size_t n;
+	FILE *ip;
+
+	if ((ip = fopen(path, "rb")) == NULL)
+		return -1;
+	while ((n = fread(buf, 1, sizeof(buf), ip)) > 0) {
+		h = gpath_hash(h, buf, n);
+		if (scan)
+			grep_scan(buf, n);
+	}
+	if (ferror(ip)) {
+		fclose(ip);
+		return -1;
+	}
+	fclose(ip);
+	*hash = h;
+	return 0;
+}
+/**
+ * put_stat: put the stat record of a file.
+ *
+ *	@param[in]	key	key of the stat record
+ *	@param[in]	st	stat of the file
+ *	@param[in]	hash	hash value of the contents
+ *
+ * If the file was modified in this second, it might be modified again
+ * without changing the time stamp. The modification time is recorded
+ * as -1 so that the contents are always compared next time.
+ */
+static void
+put_stat(const char *key, const struct stat *st, unsigned long long hash)
+{
+	char data[128];
+	long mtime = (long)st->st_mtime;
+
+	if (st->st_mtime >= time(NULL) || st->st_ctime >= time(NULL))
+		mtime = -1;
+	snprintf(data, sizeof(data), " %lld %ld %ld %lu %016llx",
+		(long long)st->st_size, mtime, (long)st->st_ctime,
+		(unsigned long)st->st_ino, hash);
+	if (dbop_get(dbop, key) != NULL)
+		dbop_update(dbop, key, data);
+	else
+		dbop_put(dbop, key, data);
+}
+/**
+ * same_stat: whether or not two stats are of the same contents.
+ */
+static int
+same_stat(const struct stat *a, const struct stat *b)
+{
+	return a->st_size == b->st_size && a->st_mtime == b->st_mtime
+		&& a->st_ctime == b->st_ctime && a->st_ino == b->st_ino;
+}
+/**
+ * gpath_putstat: record the state of a source file.
+ *
+ *	@param[in]	path	path name
+ *
+ * This should be called just before parsing the file, and then
+ * gpath_puthash() should be called after parsing it.
+ * When the full-text index is made, the file is read here for it,
+ * and the record is written at once.
+ */
+void
+gpath_putstat(const char *path)
+{
+	char key[sizeof(STATKEY) + MAXFIDLEN];
+	unsigned long long hash;
+	struct stat st;
+	struct pending *p;
+	const char *fid;
+	unsigned int id;
+
+	assert(opened > 0);
+	if (_mode == 1 && created)
+		return;
+	if ((fid = dbop_get(dbop, path)) == NULL)
+		die("GPATH is corrupted.('%s' not found)", path);
+	strlimcpy(key, stat_key(fid), sizeof(key));
+	id = atoi(fid);
+	if (stat(path, &st) < 0 || (grep_pairs && hash_file(path, &hash, 1) < 0)) {
+		/* The file will be compared by the time stamp. */
+		dbop_delete(dbop, key);
+		if (grep_pairs)
+			grep_put(0);
+		return;
+	}
+	if (grep_pairs) {
+		put_stat(key, &st, hash);
+		grep_put(id);
+		return;
+	}
+	if (pending == NULL)
+		pending = varray_open(sizeof(struct pending), 32);
+	p = varray_append(pending);
+	p->path = check_strdup(path);
+	strlimcpy(p->key, key, sizeof(p->key));
+	p->st = st;
+}
+/**
+ * gpath_puthash: record the hash value of a parsed source file.
+ *
+ *	@param[in]	path	path name given to gpath_putstat()
+ *	@param[in]	st	stat of the file when the parser read it, or NULL
+ *	@param[in]	hash	hash value of the contents the parser read, or NULL
+ *
+ * Files should be given in the same order as to gpath_putstat().
+ * If the parser did not read the file as it was before parsing, the file
+ * is read again. If it was changed meanwhile, the record is removed so
+ * that the file will be compared by the time stamp.
+ */
+void
+gpath_puthash(const char *path, const struct stat *st, const unsigned long long *hash)
+{
+	struct pending *p;
+	unsigned long long h;
+	struct stat now;
+
+	assert(opened > 0);
+	if (pending == NULL || pending_head >= pending->length)
+		return;
+	p = varray_assign(pending, pending_head, 0);
+	if (strcmp(p->path, path))
+		return;
+	if (st != NULL && same_stat(&p->st, st))
+		put_stat(p->key, &p->st, *hash);
+	else if (hash_file(path, &h, 0) == 0 && stat(path, &now) == 0 && same_stat(&p->st, &now))
+		put_stat(p->key, &p->st, h);
+	else
+		dbop_delete(dbop, p->key);
+	free(p->path);
+	if (++pending_head == pending->length) {
+		varray_reset(pending);
+		pending_head = 0;
+	}
+}
+/**
+ * gpath_checkstat: check whether or not a source file was changed.
+ *
+ *	@param[in]	path	path name
+ *	@param[in]	fid	file id
+ *	@param[in]	st	current stat of the file
+ *	@return		0: not changed, 1: changed, -1: unknown (no stat record)
+ *
+ * The contents are compared only when the stat differs from the record.
+ * If the contents are not changed, the record is updated by the new stat
+ * so as not to compare them again.
+ */
+int
+gpath_checkstat(const char *path, const char *fid, const struct stat *st)
+{
+	char key[sizeof(STATKEY) + MAXFIDLEN];
+	char record[128], current[128], hashstr[32];
+	unsigned long long hash;
+	const char *p;
+	int len;
+
+	assert(opened > 0);
+	strlimcpy(key, stat_key(fid), sizeof(key));
+	if ((p = dbop_get(dbop, key)) == NULL)
+		return -1;
+	strlimcpy(record, p, sizeof(record));
+	/*
+	 * Compare size, modification time, change time and inode number.
+	 */
+	len = snprintf(current, sizeof(current), " %lld %ld %ld %lu ",
+		(long long)st->st_size, (long)st->st_mtime, (long)st->st_ctime,
+		(unsigned long)st->st_ino);
+	if (!strncmp(record, current, len))
+		return 0;
+	if (strtoll(record, NULL, 10) != (long long)st->st_size)
+		return 1;
+	/*
+	 * Compare the contents.
+	 */
+	if ((p = strrchr(record, ' ')) == NULL)
+		die("GPATH is corrupted.(invalid stat record '%s')", key);
+	if (hash_file(path, &hash, 0) < 0)
+		return 1;
+	snprintf(hashstr, sizeof(hashstr), "%016llx", hash);
+	if (strcmp(p + 1, hashstr))
+		return 1;
+	if (_mode == 2)
+		put_stat(key, st, hash);
+	return 0;
+}
+/**
+ * gpath_grepindex: make the full-text index.
+ *
+ * This should be called just after GPATH is created.
+ * The contents of source files are indexed by gpath_putstat().
+ */
+void
+gpath_grepindex(void)
+{
+	assert(opened > 0);
+	assert(_mode == 1);
+	if (created || grep_pairs)
+		return;
+	dbop_putoption(dbop, GREPKEY, NULL);
+	grep_open();
+}
+/**
+ * gpath_grep: select the source files which may include trigrams
+ *		using the full-text index.
+ *
+ *	@param[in]	trigrams	STRHASH of trigrams (see trigram.c)
+ *	@return		IDSET of file ids, NULL: the full-text index is not available
+ *
+ * The files which are not in the result don't include some of the trigrams,
+ * as long as they have not been changed since they were indexed.
+ * The caller should check it using gpath_checkstat(), and close the IDSET.
+ */
+IDSET *
+gpath_grep(STRHASH *trigrams)
+{
+	char prefix[sizeof(GREPKEY) + 5];
+	VARRAY *fids;
+	IDSET *result = NULL;
+	struct sh_entry *entry;
+
+	assert(opened > 0);
+	if (dbop_getoption(dbop, GREPKEY) == NULL)
+		return NULL;
+	fids = varray_open(sizeof(unsigned int), 1000);
+	for (entry = strhash_first(trigrams); entry; entry = strhash_next(trigrams)) {
+		IDSET *set = idset_open(_nextkey);
+		const char *dat;
+		unsigned int *list, id;
+		int i;
+
+		snprintf(prefix, sizeof(prefix), "%s %s ", GREPKEY, entry->name);
+		varray_reset(fids);
+		for (dat = dbop_first(dbop, prefix, NULL, DBOP_PREFIX | DBOP_META);
+		     dat != NULL;
+		     dat = dbop_next(dbop))
+			grep_decode(dat, fids);
+		list = varray_assign(fids, 0, 0);
+		for (i = 0; i < fids->length; i++)
+			if (list[i] < _nextkey)
+				idset_add(set, list[i]);
+		/*
+		 * Intersect the lists.
+		 */
+		if (result != NULL) {
+			IDSET *both = idset_open(_nextkey);
+
+			for (id = idset_first(result); id != END_OF_ID; id = idset_next(result))
+				if (idset_contains(set, id))
+					idset_add(both, id);
+			idset_close(result);
+			idset_close(set);
+			set = both;
+		}
+		result = set;
+		if (idset_empty(result))
+			break;
+	}
+	varray_close(fids);
+	if (result == NULL)
+		result = idset_open(_nextkey);
+	return result;
 }
 /**
  * gpath_nextkey: return next key
@@ -290,6 +1029,94 @@ gpath_nextkey(void)
 	assert(_mode != 1);
 	return _nextkey;
 }
+/**
+ * gpath_generation: return the generation number of GPATH
+ *
+ *	@return		generation number (see dbop_getgeneration())
+ */
+int
+gpath_generation(void)
+{
+	assert(_mode != 1);
+	return _generation;
+}
+/**
+ * gpath_sync_wait: wait for the tag files to be replaced
+ *
+ *	@param[in]	retry	number of the retries so far
+ *	@return		1: try again, 0: give up
+ */
+int
+gpath_sync_wait(int retry)
+{
+#ifdef HAVE_USLEEP
+	int interval = 10;
+#else
+	int interval = 1000;
+#endif
+	if (retry == 0)
+		return 1;
+	if (retry * interval > GPATH_SYNC_TIMEOUT)
+		return 0;
+#ifdef HAVE_USLEEP
+	usleep(interval * 1000);
+#else
+	sleep(interval / 1000);
+#endif
+	return 1;
+}
+/**
+ * gpath_sync: make tag files agree with GPATH in the generation
+ *
+ *	@param[in,out]	tagfiles	tag files opened for reading
+ *	@param[in]	count	number of the tag files
+ *
+ * Snapshot updating (gtags --snapshot) replaces the tag files one by one
+ * with rename(2), GPATH last. A reader which opens them in the meantime
+ * may get files of different generations. Then the tag files and GPATH
+ * are opened again until they agree. Once they agree, the reader keeps
+ * a consistent snapshot, since the opened files stay readable after
+ * they are replaced.
+ */
+void
+gpath_sync(DBOP **tagfiles, int count)
+{
+	char path[MAXPATHLEN];
+	const char *p;
+	int i, flags, retry;
+
+	assert(opened > 0 && _mode == 0);
+	for (retry = 0; ; retry++) {
+		for (i = 0; i < count; i++)
+			if (dbop_getgeneration(tagfiles[i]) != _generation)
+				break;
+		if (i == count)
+			return;
+		if (!gpath_sync_wait(retry))
+			die("tag files are of different generations. Please update them again.");
+		for (i = 0; i < count; i++) {
+			strlimcpy(path, tagfiles[i]->dbname, sizeof(path));
+			flags = tagfiles[i]->openflags;
+			dbop_close(tagfiles[i]);
+			if ((tagfiles[i] = dbop_open(path, 0, 0, flags)) == NULL)
+				die("%s not found.", path);
+		}
+		dbop_close(dbop);
+		if (fid_cache) {
+			free(fid_cache);
+			fid_cache = NULL;
+			strhash_close(path_cache);
+			path_cache = NULL;
+		}
+		dbop = dbop_open(makepath(_dbpath, dbname(GPATH), NULL), 0, 0, openflags);
+		if (dbop == NULL)
+			die("GPATH not found.");
+		if ((p = dbop_get(dbop, NEXTKEY)) == NULL)
+			die("nextkey not found in GPATH.");
+		_startkey = _nextkey = atoi(p);
+		_generation = dbop_getgeneration(dbop);
+	}
+}
 /**
  * gpath_close: close gpath tag file
  */
@@ -305,7 +1132,18 @@ gpath_close(void)
 		dbop_close(dbop);
 		return;
 	}
+	if (pending) {
+		while (pending_head < pending->length)
+			free(((struct pending *)varray_assign(pending, pending_head++, 0))->path);
+		varray_close(pending);
+		pending = NULL;
+		pending_head = 0;
+	}
 	if (_mode == 1 || _mode == 2) {
+		if (grep_pairs) {
+			grep_flush();
+			grep_close();
+		}
 		if (_startkey < _nextkey) {
 			snprintf(fid, sizeof(fid), "%d", _nextkey);
 			dbop_update(dbop, NEXTKEY, fid);
@@ -314,6 +1152,12 @@ gpath_close(void)
 	dbop_close(dbop);
 	if (_mode == 1)
 		created = 1;
+	if (fid_cache) {
+		free(fid_cache);
+		fid_cache = NULL;
+		strhash_close(path_cache);
+		path_cache = NULL;
+	}
 }
 
 /**
@@ -20,14 +20,24 @@
 
 #ifndef _PATHOP_H_
 #define _PATHOP_H_
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <stdio.h>
 
 #include "gparam.h"
 #include "dbop.h"
+#include "idset.h"
 #include "pool.h"
+#include "strhash.h"
 #include "varray.h"
 
 #define NEXTKEY		" __.NEXTKEY"
+#define STATKEY		" __.STAT"
+#define GPATH_HASHINIT	14695981039346656037ULL	/**< initial value of gpath_hash() */
+#define GREPKEY		" __.GREP"
+
+/** milliseconds to wait for the tag files of one generation */
+#define GPATH_SYNC_TIMEOUT	5000
 
 /*
  * File type
@@ -67,6 +77,15 @@ int gpath_path2nfid(const char *, int *);
 const char *gpath_nfid2path(int, int *);
 const char *gpath_put(const char *, int);
 void gpath_delete(const char *);
+unsigned long long gpath_hash(unsigned long long, const void *, size_t);
+void gpath_putstat(const char *);
+void gpath_puthash(const char *, const struct stat *, const unsigned long long *);
+int gpath_checkstat(const char *, const char *, const struct stat *);
+void gpath_grepindex(void);
+IDSET *gpath_grep(STRHASH *);
+int gpath_generation(void);
+int gpath_sync_wait(int);
+void gpath_sync(DBOP **, int);
 void gpath_close(void);
 int gpath_nextkey(void);
 GFIND *gfind_open(const char *, const char *, int, int);
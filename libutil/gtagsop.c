@@ -58,9 +58,39 @@
 #include "strhash.h"
 #include "strlimcpy.h"
 #include "strmake.h"
+#include "trigram.h"
 #include "varray.h"
 
 #define HASHBUCKETS	2048
+#define FOLDBUCKETS	262144		/**< for all keys of a tag file */
+/*
+ * Marks of the keys written by this process (GTOP->index_keys).
+ */
+#define KEY_NEW		((void *)1)	/**< not registered in the indexes */
+#define KEY_OLD		((void *)2)	/**< already registered */
+
+/*
+ * Line number vector for compact format.
+ *
+ * Line numbers of a tag are stored in a list of chunks allocated from
+ * gtop->lno_pool. A chunk is never moved; when it is full, a chunk twice
+ * as large is appended. All vectors of a file are released at once by
+ * pool_reset() in gtags_flush().
+ */
+#define LNO_CHUNK_MIN	8
+#define LNO_CHUNK_MAX	1024
+
+struct lno_chunk {
+	struct lno_chunk *next;
+	int size;			/**< number of slots */
+	int used;			/**< number of used slots */
+	int lno[1];			/**< line numbers (actually 'size' slots) */
+};
+struct lno_vector {
+	int length;			/**< total number of line numbers */
+	struct lno_chunk *first;
+	struct lno_chunk *last;
+};
 
 static int compare_path(const void *, const void *);
 static int compare_lineno(const void *, const void *);
@@ -72,7 +102,11 @@ static int is_defined_in_GTAGS(GTOP *, const char *);
 static char *get_prefix(const char *, int);
 static int gtags_restart(GTOP *);
 static void flush_pool(GTOP *, const char *);
+static void flush_fid_index(GTOP *, const char *);
+static int delete_using_fid_index(GTOP *, IDSET *);
 static void segment_read(GTOP *);
+static struct lno_chunk *lno_chunk_new(POOL *, int);
+static void lno_append(POOL *, struct lno_vector *, int);
 
 /**
  * compare_path: compare function for sorting path names.
@@ -90,6 +124,47 @@ compare_lineno(const void *s1, const void *s2)
 {
 	return *(const int *)s1 - *(const int *)s2;
 }
+/**
+ * lno_chunk_new: allocate a chunk of line number vector.
+ *
+ *	@param[in]	pool	memory pool
+ *	@param[in]	size	number of slots
+ *	@return		chunk
+ */
+static struct lno_chunk *
+lno_chunk_new(POOL *pool, int size)
+{
+	struct lno_chunk *chunk;
+
+	chunk = pool_malloc(pool, sizeof(struct lno_chunk) + sizeof(int) * (size - 1));
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->used = 0;
+	return chunk;
+}
+/**
+ * lno_append: append a line number to line number vector.
+ *
+ *	@param[in]	pool	memory pool
+ *	@param[in]	vec	line number vector
+ *	@param[in]	lno	line number
+ */
+static void
+lno_append(POOL *pool, struct lno_vector *vec, int lno)
+{
+	struct lno_chunk *chunk = vec->last;
+
+	if (chunk->used == chunk->size) {
+		int size = chunk->size * 2;
+
+		if (size > LNO_CHUNK_MAX)
+			size = LNO_CHUNK_MAX;
+		chunk = chunk->next = lno_chunk_new(pool, size);
+		vec->last = chunk;
+	}
+	chunk->lno[chunk->used++] = lno;
+	vec->length++;
+}
 /**
  * compare_tags: compare function for sorting tags.
  */
@@ -197,6 +272,25 @@ seekto(const char *string, int n)
  *	   In addition,successive line numbers are expressed as a range.
  *           ex: 10-3 means '10 11 12 13'.
  *
+ * [Specification of format version 7]
+ *
+ *	Format version 7 is made only when gtags(1) is invoked with the
+ *	--binary-lineno option. It is the same as format version 6 except
+ *	that the line numbers of compact format are a byte string
+ *	(GTAGS_BINLINE) instead of decimal numbers.
+ *
+ *         <file id> <tag name> <line number list>
+ *
+ *	   The list is a sequence of entries. Each entry is a number
+ *	   (d << 1 | r) which may be followed by a number c. The line number
+ *	   is the previous one (0 at the head) plus d. If r is 1 then it is
+ *	   followed by c successive line numbers.
+ *           ex: 10,3-2 is written as the numbers 20,7,2.
+ *	   Each number is written in LEB128: seven bits are put in a byte
+ *	   from the lowest, and the highest bit of the byte is set except
+ *	   for the last byte. Since every number is larger than 0, the list
+ *	   never includes '\0'.
+ *
  * [Description]
  * 
  * - Standard format is applied to GTAGS, and compact format is applied
@@ -243,8 +337,11 @@ seekto(const char *string, int n)
                        if (format !=  4) then print error message.
   GLOBAL-5.4 - 5.8.2	support format version 4 and 5
                        if (format > 5 || format < 4) then print error message.
-  GLOBAL-5.9 -		support only format version 6
+  GLOBAL-5.9 - 6.6.2	support only format version 6
                        if (format > 6 || format < 6) then print error message.
+  GLOBAL-6.6.3 -	support format version 6 and 7 (7 is made only when
+			the --binary-lineno option of gtags(1) is specified)
+                       if (format > 7 || format < 6) then print error message.
  *
  * In GLOBAL-5.0, we threw away the compatibility with the past formats.
  * Though we could continue the support for older formats, it seemed
@@ -260,7 +357,7 @@ seekto(const char *string, int n)
  *       GTAGS seems older format. Please remake tag files.
  */
 static int new_format_version = 6;	/**< new format version */
-static int upper_bound_version = 6;	/**< acceptable format version (upper bound) */
+static int upper_bound_version = 7;	/**< acceptable format version (upper bound) */
 static int lower_bound_version = 6;	/**< acceptable format version (lower bound) */
 static const char *const tagslist[] = {"GPATH", "GTAGS", "GRTAGS", "GSYMS"};
 /**
@@ -369,6 +466,8 @@ gtags_open(const char *dbpath, const char *root, int db, int mode, int flags)
 	} else
 #endif
 		dbop_flags |= DBOP_SORTED_WRITE;
+	if (flags & GTAGS_DUPKEY)
+		dbop_flags |= DBOP_DUPKEY;
 	/*
 	 * GRTAGS and GSYMS are virtual tag file. They are included in a real GRTAGS file.
 	 * In fact, GSYMS doesn't exist now.
@@ -405,6 +504,8 @@ gtags_open(const char *dbpath, const char *root, int db, int mode, int flags)
 		 */
 		gtop->format = 0;
 		gtop->format_version = new_format_version;
+		if (gtop->openflags & GTAGS_BINLINE)
+			gtop->format_version = 7;
 		/*
 		 * GRTAGS and GSYSM always use compact format.
 		 * GTAGS uses compact format only when the -c option specified.
@@ -412,6 +513,8 @@ gtags_open(const char *dbpath, const char *root, int db, int mode, int flags)
 		if (gtop->db == GRTAGS || gtop->db == GSYMS || gtop->openflags & GTAGS_COMPACT) {
 			gtop->format |= GTAGS_COMPACT;
 			gtop->format |= GTAGS_COMPLINE;
+			if (gtop->openflags & GTAGS_BINLINE)
+				gtop->format |= GTAGS_BINLINE;
 		} else {
 			/* standard format */
 			gtop->format |= GTAGS_COMPRESS;
@@ -427,6 +530,39 @@ gtags_open(const char *dbpath, const char *root, int db, int mode, int flags)
 			dbop_putoption(gtop->dbop, COMPLINEKEY, NULL);
 		if (gtop->format & GTAGS_COMPNAME)
 			dbop_putoption(gtop->dbop, COMPNAMEKEY, NULL);
+		if (gtop->format & GTAGS_BINLINE)
+			dbop_putoption(gtop->dbop, BINLINEKEY, NULL);
+		/*
+		 * Sqlite3 database has an index of keys by itself.
+		 */
+		if (gtop->openflags & GTAGS_FOLDINDEX
+#ifdef USE_SQLITE3
+		    && !(gtop->dbop->openflags & DBOP_SQLITE3)
+#endif
+		) {
+			gtop->format |= GTAGS_FOLDINDEX;
+			dbop_putoption(gtop->dbop, FOLDKEY, NULL);
+		}
+		if (gtop->openflags & GTAGS_TRIGRAM
+#ifdef USE_SQLITE3
+		    && !(gtop->dbop->openflags & DBOP_SQLITE3)
+#endif
+		) {
+			gtop->format |= GTAGS_TRIGRAM;
+			dbop_putoption(gtop->dbop, TRIGRAMKEY, NULL);
+		}
+		/*
+		 * The layout is decided by dbop_open(). It is recorded so
+		 * that gtags(1) can tell it without looking into the B-tree.
+		 */
+		if (gtop->openflags & GTAGS_DUPKEY
+#ifdef USE_SQLITE3
+		    && !(gtop->dbop->openflags & DBOP_SQLITE3)
+#endif
+		) {
+			gtop->format |= GTAGS_DUPKEY;
+			dbop_putoption(gtop->dbop, DUPKEYKEY, NULL);
+		}
 		dbop_putversion(gtop->dbop, gtop->format_version); 
 	} else {
 		/*
@@ -455,6 +591,14 @@ gtags_open(const char *dbpath, const char *root, int db, int mode, int flags)
 			gtop->format |= GTAGS_COMPLINE;
 		if (dbop_getoption(gtop->dbop, COMPNAMEKEY) != NULL)
 			gtop->format |= GTAGS_COMPNAME;
+		if (gtop->format_version >= 7 && dbop_getoption(gtop->dbop, BINLINEKEY) != NULL)
+			gtop->format |= GTAGS_BINLINE;
+		if (dbop_getoption(gtop->dbop, FOLDKEY) != NULL)
+			gtop->format |= GTAGS_FOLDINDEX;
+		if (dbop_getoption(gtop->dbop, TRIGRAMKEY) != NULL)
+			gtop->format |= GTAGS_TRIGRAM;
+		if (dbop_getoption(gtop->dbop, DUPKEYKEY) != NULL)
+			gtop->format |= GTAGS_DUPKEY;
 	}
 	if (gpath_open(dbpath, dbmode) < 0) {
 		if (dbmode == 1)
@@ -462,20 +606,69 @@ gtags_open(const char *dbpath, const char *root, int db, int mode, int flags)
 		else
 			die("GPATH not found.");
 	}
-	if (gtop->mode != GTAGS_READ)
+	/*
+	 * The tag files should be of the same generation as GPATH.
+	 */
+	if (gtop->mode == GTAGS_READ) {
+		DBOP *tagfiles[2];
+		int count = 0;
+
+		tagfiles[count++] = gtop->dbop;
+		if (gtop->gtags)
+			tagfiles[count++] = gtop->gtags;
+		gpath_sync(tagfiles, count);
+		gtop->dbop = tagfiles[0];
+		if (gtop->gtags)
+			gtop->gtags = tagfiles[1];
+	}
+	if (gtop->mode != GTAGS_READ) {
 		gtop->sb = strbuf_open(0);	/* This buffer is used for working area. */
+		/*
+		 * Stuff for fid index. Sqlite3 database has an index of file id by itself.
+		 */
+#ifdef USE_SQLITE3
+		if (!(gtop->dbop->openflags & DBOP_SQLITE3))
+#endif
+			gtop->fid_keys = strhash_open(HASHBUCKETS);
+		if (gtop->format & (GTAGS_FOLDINDEX | GTAGS_TRIGRAM))
+			gtop->index_keys = strhash_open(FOLDBUCKETS);
+	}
 	/*
 	 * Stuff for compact format.
 	 */
 	if (gtop->format & GTAGS_COMPACT) {
 		assert(root != NULL);
 		strlimcpy(gtop->root, root, sizeof(gtop->root));
-		if (gtop->mode != GTAGS_READ)
+		if (gtop->mode != GTAGS_READ) {
 			gtop->path_hash = strhash_open(HASHBUCKETS);
+			gtop->lno_pool = pool_open();
+			gtop->lno_array = varray_open(sizeof(int), 1000);
+		}
 	}
 	gtop->sb_compress = strbuf_open(0);
 	return gtop;
 }
+/**
+ * register_key: register a key for the fold and trigram index.
+ *
+ *	@param[in]	gtop	descripter of GTOP
+ *	@param[in]	key	key which is going to be written
+ *
+ * When updating, a key which already has tag records is marked as KEY_OLD,
+ * since it has been registered in the indexes.
+ */
+static void
+register_key(GTOP *gtop, const char *key)
+{
+	struct sh_entry *entry = strhash_assign(gtop->index_keys, key, 1);
+
+	if (entry->value == NULL) {
+		if (gtop->mode == GTAGS_MODIFY && dbop_get(gtop->dbop, key) != NULL)
+			entry->value = KEY_OLD;
+		else
+			entry->value = KEY_NEW;
+	}
+}
 /**
  * gtags_put_using: put tag record with packing.
  *
@@ -505,9 +698,14 @@ gtags_put_using(GTOP *gtop, const char *tag, int lno, const char *fid, const cha
 		 * ...
 		 */
 		entry = strhash_assign(gtop->path_hash, tag, 1);
-		if (entry->value == NULL)
-			entry->value = varray_open(sizeof(int), 100);
-		*(int *)varray_append((VARRAY *)entry->value) = lno;
+		if (entry->value == NULL) {
+			struct lno_vector *vec = pool_malloc(gtop->lno_pool, sizeof(struct lno_vector));
+
+			vec->length = 0;
+			vec->first = vec->last = lno_chunk_new(gtop->lno_pool, LNO_CHUNK_MIN);
+			entry->value = vec;
+		}
+		lno_append(gtop->lno_pool, (struct lno_vector *)entry->value, lno);
 		return;
 	}
 	/*
@@ -536,7 +734,11 @@ gtags_put_using(GTOP *gtop, const char *tag, int lno, const char *fid, const cha
 	strbuf_putn(gtop->sb, lno);
 	strbuf_putc(gtop->sb, ' ');
 	strbuf_puts(gtop->sb, (gtop->format & GTAGS_COMPRESS) ? compress(img, key, gtop->sb_compress) : img);
+	if (gtop->index_keys)
+		register_key(gtop, key);
 	dbop_put_tag(gtop->dbop, key, strbuf_value(gtop->sb));
+	if (gtop->fid_keys)
+		strhash_assign(gtop->fid_keys, key, 1);
 }
 /**
  * gtags_flush: Flush the pool for compact format.
@@ -550,6 +752,11 @@ gtags_flush(GTOP *gtop, const char *fid)
 	if (gtop->format & GTAGS_COMPACT) {
 		flush_pool(gtop, fid);
 		strhash_reset(gtop->path_hash);
+		pool_reset(gtop->lno_pool);
+	}
+	if (gtop->fid_keys) {
+		flush_fid_index(gtop, fid);
+		strhash_reset(gtop->fid_keys);
 	}
 }
 /**
@@ -557,6 +764,10 @@ gtags_flush(GTOP *gtop, const char *fid)
  *
  *	@param[in]	gtop	GTOP structure
  *	@param[in]	deleteset bit array of fid
+ *
+ * If every fid in the set has a fid index record, only the records of the
+ * keys listed there are visited. Otherwise (the file was tagged by an older
+ * GLOBAL), the whole tag file is scanned.
  */
 void
 gtags_delete(GTOP *gtop, IDSET *deleteset)
@@ -580,16 +791,18 @@ gtags_delete(GTOP *gtop, IDSET *deleteset)
 		strbuf_close(where);
 	} else
 #endif
-	for (tagline = dbop_first(gtop->dbop, NULL, NULL, 0); tagline; tagline = dbop_next(gtop->dbop)) {
-		/*
-		 * Extract path from the tag line.
-		 */
-		fid = atoi(tagline);
-		/*
-		 * If the file id exists in the deleteset, delete the tagline.
-		 */
-		if (idset_contains(deleteset, fid))
-			dbop_delete(gtop->dbop, NULL);
+	if (!delete_using_fid_index(gtop, deleteset)) {
+		for (tagline = dbop_first(gtop->dbop, NULL, NULL, 0); tagline; tagline = dbop_next(gtop->dbop)) {
+			/*
+			 * Extract path from the tag line.
+			 */
+			fid = atoi(tagline);
+			/*
+			 * If the file id exists in the deleteset, delete the tagline.
+			 */
+			if (idset_contains(deleteset, fid))
+				dbop_delete(gtop->dbop, NULL);
+		}
 	}
 }
 /**
@@ -642,7 +855,8 @@ get_prefix(const char *pattern, int flags)
 	return prefix;
 }
 /**
- * gtags_restart: restart dbop iterator using lower case prefix.
+ * gtags_restart: restart dbop iterator using lower case prefix,
+ *		or the next key when the fold index is used.
  *
  *	@param[in]	gtop	GTOP structure
  *	@return		prepared or not
@@ -654,8 +868,16 @@ gtags_restart(GTOP *gtop)
 {
 	int upper, lower;
 
+	if (gtop->key_array && gtop->key_array->length > 0) {
+		if (gtop->key_index >= gtop->key_array->length)
+			return 0;
+		gtop->key = *(char **)varray_assign(gtop->key_array, gtop->key_index++, 0);
+		if (gtop->openflags & GTAGS_DEBUG)
+			fprintf(stderr, "Using key: %s\n", gtop->key);
+		return 1;
+	}
 	if (gtop->prefix == NULL)
-		die("gtags_restart: impossible.");
+		return 0;
 	upper = gtop->prefix[0];
 	lower = tolower(upper);
 	if (upper < lower) {
@@ -670,6 +892,386 @@ gtags_restart(GTOP *gtop)
 		fprintf(stderr, "gtags_restart: not prepared.\n");
 	return 0;
 }
+/**
+ * Fold index:
+ *
+ * For each tag name, a meta record is written to the same tag file.
+ * Its key is the tag name whose upper case letters are converted into
+ * lower case, and its data is the tag name.
+ *
+ * key			data
+ * ------------------------------------
+ * " __.FOLD dbop_open"	" DBOP_open"
+ * " __.FOLD dbop_open"	" dbop_open"
+ *
+ * It is made by 'gtags --icase-index', and the " __.FOLD" option record
+ * shows that it is available. Gtags_first() uses it with GTOP_IGNORECASE
+ * to read only the keys which match the pattern ignoring case, instead of
+ * scanning all keys which begin with the first letter in both cases.
+ * Since the records are never deleted by incremental updating, a key in
+ * the fold index may have no tag record any longer.
+ */
+static const char *
+fold_index_key(const char *name)
+{
+	static char key[MAXKEYLEN + 1];
+	char *q = key;
+	const char *p;
+
+	if (strlen(FOLDKEY) + 1 + strlen(name) > MAXKEYLEN)
+		return NULL;
+	for (p = FOLDKEY; *p; p++)
+		*q++ = *p;
+	*q++ = ' ';
+	for (p = name; *p; p++)
+		*q++ = tolower((unsigned char)*p);
+	*q = '\0';
+	return key;
+}
+/**
+ * flush_fold_index: add keys written by this process to the fold index.
+ *
+ *	@param[in]	gtop	descripter of GTOP
+ */
+static void
+flush_fold_index(GTOP *gtop)
+{
+	struct sh_entry *entry;
+	const char *key, *dat;
+
+	for (entry = strhash_first(gtop->index_keys); entry; entry = strhash_next(gtop->index_keys)) {
+		if (entry->value == KEY_OLD)
+			continue;
+		if ((key = fold_index_key(entry->name)) == NULL)
+			die("fold index: tag name too long.");
+		/*
+		 * When updating, the key may be already registered.
+		 */
+		if (gtop->mode == GTAGS_MODIFY) {
+			for (dat = dbop_first(gtop->dbop, key, NULL, DBOP_META); dat; dat = dbop_next(gtop->dbop))
+				if (!strcmp(dat + 1, entry->name))
+					break;
+			if (dat)
+				continue;
+		}
+		strbuf_reset(gtop->sb);
+		strbuf_putc(gtop->sb, ' ');
+		strbuf_puts(gtop->sb, entry->name);
+		dbop_put(gtop->dbop, key, strbuf_value(gtop->sb));
+	}
+}
+/**
+ * compare_key: compare function for sorting keys.
+ */
+static int
+compare_key(const void *v1, const void *v2)
+{
+	return strcmp(*(char **)v1, *(char **)v2);
+}
+/**
+ * sort_keys: sort an array of keys and remove duplicates.
+ *
+ *	@param[in]	vb	VARRAY of (char *)
+ */
+static void
+sort_keys(VARRAY *vb)
+{
+	char **keys = varray_assign(vb, 0, 0);
+	int i, n, count = vb->length;
+
+	qsort(keys, count, sizeof(char *), compare_key);
+	for (i = n = 0; i < count; i++)
+		if (n == 0 || strcmp(keys[n - 1], keys[i]))
+			keys[n++] = keys[i];
+	vb->length = n;
+}
+/**
+ * prepare_keys: prepare gtop->key_array to read keys one by one.
+ *
+ *	@param[in]	gtop	GTOP structure
+ */
+static void
+prepare_keys(GTOP *gtop)
+{
+	if (gtop->key_array == NULL) {
+		gtop->key_array = varray_open(sizeof(char *), 100);
+		gtop->key_pool = pool_open();
+	} else {
+		varray_reset(gtop->key_array);
+		pool_reset(gtop->key_pool);
+	}
+	gtop->key_index = 0;
+}
+/**
+ * fold_read: read the keys which match ignoring case from the fold index.
+ *
+ *	@param[in]	gtop	GTOP structure
+ *	@param[in]	literal	tag name or its prefix
+ *	@param[in]	prefixed	1: prefix read, 0: exact read
+ *	@return		0: cannot use the fold index, 1: gtop->key_array is prepared
+ *			(it may be empty)
+ *
+ * The keys are sorted so that they are read in the same order as the keys
+ * in the tag file. If gtop->preg is set, only the keys which match it are read.
+ */
+static int
+fold_read(GTOP *gtop, const char *literal, int prefixed)
+{
+	const char *key, *dat;
+
+	if ((key = fold_index_key(literal)) == NULL)
+		return 0;
+	prepare_keys(gtop);
+	for (dat = dbop_first(gtop->dbop, key, NULL, DBOP_META | (prefixed ? DBOP_PREFIX : 0));
+	     dat != NULL;
+	     dat = dbop_next(gtop->dbop))
+	{
+		if (gtop->preg && regexec(gtop->preg, dat + 1, 0, 0, 0) != 0)
+			continue;
+		*(char **)varray_append(gtop->key_array) = pool_strdup(gtop->key_pool, dat + 1, 0);
+	}
+	sort_keys(gtop->key_array);
+	return 1;
+}
+/**
+ * Trigram index:
+ *
+ * For each trigram (three successive bytes) of the tag names whose upper
+ * case letters are converted into lower case, a meta record lists the tag
+ * names which include it.
+ *
+ * key			data
+ * ------------------------------------
+ * " __.TRIGRAM _op"	" !dbop_open #en !gpath_open"
+ *
+ * Each tag name in the list is preceded by a blank and a byte which tells
+ * the length of the prefix shared with the previous tag name (0x21 means 0).
+ * The tag names are sorted in a record, and a long list is divided into
+ * records of DBOP_PAGESIZE / 4 bytes. Incremental updating adds records for
+ * new tag names, and the records are never deleted as the fold index.
+ *
+ * It is made by 'gtags --trigram-index', and the " __.TRIGRAM" option record
+ * shows that it is available. Gtags_first() uses it for a regular expression
+ * which has no prefix: it extracts literals which every matched tag name must
+ * include, intersects the lists of their trigrams, and applies the regular
+ * expression only to the tag names in the result, instead of every key.
+ */
+#define SHARED_BASE	0x21		/**< shared length 0 */
+#define SHARED_MAX	(0xff - SHARED_BASE)
+static const char *
+trigram_index_key(const char *trigram)
+{
+	static char key[sizeof(TRIGRAMKEY) + 4];
+
+	snprintf(key, sizeof(key), "%s %c%c%c", TRIGRAMKEY, trigram[0], trigram[1], trigram[2]);
+	return key;
+}
+/**
+ * read_posting: read the tag names which include a trigram.
+ *
+ *	@param[in]	gtop	GTOP structure
+ *	@param[in]	trigram	trigram
+ *	@param[out]	names	VARRAY of (char *), sorted without duplicates
+ *	@param[in]	pool	memory for the names
+ */
+static void
+read_posting(GTOP *gtop, const char *trigram, VARRAY *names, POOL *pool)
+{
+	char name[MAXKEYLEN + 1];
+	const char *dat, *p, *s;
+	int len, shared;
+
+	varray_reset(names);
+	for (dat = dbop_first(gtop->dbop, trigram_index_key(trigram), NULL, DBOP_META);
+	     dat != NULL;
+	     dat = dbop_next(gtop->dbop))
+	{
+		len = 0;
+		for (p = dat; *p == ' '; ) {
+			shared = (unsigned char)*++p - SHARED_BASE;
+			if (shared < 0 || shared > len)
+				die("trigram index is corrupted.");
+			for (s = ++p; *p && *p != ' '; p++)
+				;
+			if (shared + (p - s) > MAXKEYLEN)
+				die("trigram index is corrupted.");
+			memcpy(name + shared, s, p - s);
+			len = shared + (p - s);
+			name[len] = '\0';
+			*(char **)varray_append(names) = pool_strdup(pool, name, len);
+		}
+	}
+	sort_keys(names);
+}
+/**
+ * write_posting: write the tag names which include a trigram.
+ *
+ *	@param[in]	gtop	descripter of GTOP
+ *	@param[in]	trigram	trigram
+ *	@param[in]	names	tag names, sorted without duplicates
+ *	@param[in]	count	number of the names
+ */
+static void
+write_posting(GTOP *gtop, const char *trigram, char **names, int count)
+{
+	const char *key = trigram_index_key(trigram);
+	const char *prev = "";
+	int i, shared;
+
+	strbuf_reset(gtop->sb);
+	for (i = 0; i < count; i++) {
+		for (shared = 0; shared < SHARED_MAX && prev[shared] && prev[shared] == names[i][shared]; shared++)
+			;
+		strbuf_putc(gtop->sb, ' ');
+		strbuf_putc(gtop->sb, SHARED_BASE + shared);
+		strbuf_puts(gtop->sb, names[i] + shared);
+		prev = names[i];
+		if (strbuf_getlen(gtop->sb) > DBOP_PAGESIZE / 4) {
+			dbop_put(gtop->dbop, key, strbuf_value(gtop->sb));
+			strbuf_reset(gtop->sb);
+			prev = "";
+		}
+	}
+	if (strbuf_getlen(gtop->sb) > 0)
+		dbop_put(gtop->dbop, key, strbuf_value(gtop->sb));
+}
+/**
+ * flush_trigram_index: add keys written by this process to the trigram index.
+ *
+ *	@param[in]	gtop	descripter of GTOP
+ */
+static void
+flush_trigram_index(GTOP *gtop)
+{
+	STRHASH *trigrams = strhash_open(FOLDBUCKETS);
+	VARRAY *old = NULL;
+	POOL *pool = NULL;
+	struct sh_entry *entry, *sh;
+	char trigram[4], *name;
+	const char *p;
+	int i;
+
+	/*
+	 * Make the list of tag names for each trigram.
+	 */
+	trigram[3] = '\0';
+	for (entry = strhash_first(gtop->index_keys); entry; entry = strhash_next(gtop->index_keys)) {
+		if (entry->value == KEY_OLD)
+			continue;
+		name = entry->name;
+		for (p = name; p[0] && p[1] && p[2]; p++) {
+			for (i = 0; i < 3; i++)
+				trigram[i] = tolower((unsigned char)p[i]);
+			sh = strhash_assign(trigrams, trigram, 1);
+			if (sh->value == NULL)
+				sh->value = varray_open(sizeof(char *), 10);
+			*(char **)varray_append((VARRAY *)sh->value) = name;
+		}
+	}
+	if (gtop->mode == GTAGS_MODIFY) {
+		old = varray_open(sizeof(char *), 100);
+		pool = pool_open();
+	}
+	for (sh = strhash_first(trigrams); sh; sh = strhash_next(trigrams)) {
+		VARRAY *vb = (VARRAY *)sh->value;
+		char **names;
+		int count;
+
+		sort_keys(vb);
+		names = varray_assign(vb, 0, 0);
+		count = vb->length;
+		/*
+		 * When updating, remove the names already registered.
+		 */
+		if (old) {
+			char **olds;
+			int j, n;
+
+			pool_reset(pool);
+			read_posting(gtop, sh->name, old, pool);
+			olds = varray_assign(old, 0, 0);
+			for (i = j = n = 0; i < count; i++) {
+				while (j < old->length && strcmp(olds[j], names[i]) < 0)
+					j++;
+				if (j < old->length && !strcmp(olds[j], names[i]))
+					continue;
+				names[n++] = names[i];
+			}
+			count = n;
+		}
+		write_posting(gtop, sh->name, names, count);
+		varray_close(vb);
+	}
+	if (old) {
+		varray_close(old);
+		pool_close(pool);
+	}
+	strhash_close(trigrams);
+}
+/**
+ * trigram_read: read the keys which may match a regular expression
+ *		from the trigram index.
+ *
+ *	@param[in]	gtop	GTOP structure
+ *	@param[in]	pattern	regular expression
+ *	@param[in]	basic	1: basic regular expression, 0: extended
+ *	@return		0: cannot use the trigram index, 1: gtop->key_array is prepared
+ *			(it may be empty)
+ *
+ * The keys which match gtop->preg are sorted in gtop->key_array.
+ */
+static int
+trigram_read(GTOP *gtop, const char *pattern, int basic)
+{
+	STRHASH *trigrams = strhash_open(16);
+	VARRAY *posting, *result;
+	struct sh_entry *sh;
+	char **keys;
+	int i, n, used = 0;
+
+	if (!required_trigrams(pattern, basic, trigrams) || trigrams->entries == 0) {
+		strhash_close(trigrams);
+		return 0;
+	}
+	prepare_keys(gtop);
+	posting = varray_open(sizeof(char *), 1000);
+	result = gtop->key_array;
+	/*
+	 * Intersect the lists of the trigrams.
+	 */
+	for (sh = strhash_first(trigrams); sh; sh = strhash_next(trigrams)) {
+		char **names, **cur;
+		int j;
+
+		if (gtop->openflags & GTAGS_DEBUG)
+			fprintf(stderr, "Using trigram: %s\n", sh->name);
+		read_posting(gtop, sh->name, used ? posting : result, gtop->key_pool);
+		if (used++ == 0)
+			continue;
+		names = varray_assign(posting, 0, 0);
+		cur = varray_assign(result, 0, 0);
+		for (i = j = n = 0; i < result->length; i++) {
+			while (j < posting->length && strcmp(names[j], cur[i]) < 0)
+				j++;
+			if (j < posting->length && !strcmp(names[j], cur[i]))
+				cur[n++] = cur[i];
+		}
+		result->length = n;
+		if (n == 0)
+			break;
+	}
+	varray_close(posting);
+	strhash_close(trigrams);
+	/*
+	 * Apply the regular expression.
+	 */
+	keys = varray_assign(result, 0, 0);
+	for (i = n = 0; i < result->length; i++)
+		if (regexec(gtop->preg, keys[i], 0, 0, 0) == 0)
+			keys[n++] = keys[i];
+	result->length = n;
+	return 1;
+}
 /**
  * gtags_first: return first record
  *
@@ -714,6 +1316,8 @@ gtags_first(GTOP *gtop, const char *pattern, int flags)
 		free(gtop->path_array);
 		gtop->path_array = NULL;
 	}
+	if (gtop->key_array)
+		varray_reset(gtop->key_array);
 
 	if (flags & GTOP_KEY)
 		gtop->dbflags |= DBOP_KEY;
@@ -784,14 +1388,52 @@ gtags_first(GTOP *gtop, const char *pattern, int flags)
 		if (regcomp(gtop->preg, strbuf_value(regex), regflags) != 0)
 			die("invalid regular expression.");
 	}
+	/*
+	 * If the fold index is available, read the keys which match
+	 * ignoring case one by one instead of the prefix.
+	 */
+	if (gtop->prefix && gtop->format & GTAGS_FOLDINDEX) {
+		const char *literal;
+		int prefixed = 1;
+
+		if (flags & GTOP_NOREGEX || !isregex(pattern)) {
+			literal = pattern;
+			if (!(flags & GTOP_PREFIX))
+				prefixed = 0;
+		} else
+			literal = get_prefix(pattern, flags & ~GTOP_IGNORECASE);
+		if (literal && fold_read(gtop, literal, prefixed)) {
+			gtop->prefix = NULL;
+			gtop->preg = NULL;
+			gtop->dbflags &= ~DBOP_PREFIX;
+			if (!gtags_restart(gtop))
+				return NULL;
+		} else {
+			/* get_prefix() may have overwritten the prefix */
+			gtop->key = gtop->prefix = get_prefix(pattern, flags);
+		}
+	}
+	/*
+	 * If the trigram index is available, read the keys which include
+	 * the literals of the regular expression one by one instead of
+	 * applying it to all keys.
+	 */
+	if (gtop->key == NULL && gtop->preg && strbuf_getlen(regex) > 0
+	    && gtop->format & GTAGS_TRIGRAM) {
+		if (trigram_read(gtop, strbuf_value(regex), flags & GTOP_BASICREGEX)) {
+			gtop->preg = NULL;
+			if (!gtags_restart(gtop))
+				return NULL;
+		}
+	}
 	/*
 	 * If GTOP_PATH is set, at first, we collect all path names in a pool and
 	 * sort them. gtags_first() and gtags_next() returns one of the pool.
 	 */
 	if (gtop->flags & GTOP_PATH) {
 		struct sh_entry *entry;
-		char *p;
-		const char *cp;
+		char fid[MAXFIDLEN];
+		const char *p, *cp;
 		unsigned long i;
 
 		gtop->path_hash = strhash_open(HASHBUCKETS);
@@ -812,19 +1454,21 @@ again0:
 			VIRTUAL_GRTAGS_GSYMS_PROCESSING(gtop);
 			/* extract file id */
 			p = locatestring(tagline, " ", MATCH_FIRST);
-			if (p == NULL)
+			if (p == NULL || p - tagline >= sizeof(fid))
 				die("Invalid tag record. '%s'\n", tagline);
-			*p = '\0';
-			entry = strhash_assign(gtop->path_hash, tagline, 1);
+			/* The record may be in a read-only mapping. */
+			memcpy(fid, tagline, p - tagline);
+			fid[p - tagline] = '\0';
+			entry = strhash_assign(gtop->path_hash, fid, 1);
 			/* new entry: get path name and set. */
 			if (entry->value == NULL) {
-				cp = gpath_fid2path(tagline, NULL);
+				cp = gpath_fid2path(fid, NULL);
 				if (cp == NULL)
-					die("GPATH is corrupted.(file id '%s' not found)", tagline);
+					die("GPATH is corrupted.(file id '%s' not found)", fid);
 				entry->value = strhash_strdup(gtop->path_hash, cp, 0);
 			}
 		}
-		if (gtop->prefix && gtags_restart(gtop))
+		if (gtags_restart(gtop))
 			goto again0;
 		/*
 		 * Sort path names.
@@ -861,7 +1505,7 @@ again1:
 			break;
 		}
 		if (gtop->gtp.tag == NULL) {
-			if (gtop->prefix && gtags_restart(gtop))
+			if (gtags_restart(gtop))
 				goto again1;
 		}
 		return gtop->gtp.tag ? &gtop->gtp : NULL;
@@ -887,7 +1531,7 @@ again2:
 			break;
 		}
 		if (tagline == NULL) {
-			if (gtop->prefix && gtags_restart(gtop))
+			if (gtags_restart(gtop))
 				goto again2;
 			return NULL;
 		}
@@ -927,7 +1571,7 @@ again3:
 			break;
 		}
 		if (gtop->gtp.tag == NULL) {
-			if (gtop->prefix && gtags_restart(gtop)) {
+			if (gtags_restart(gtop)) {
 				gtop->gtp.tag = dbop_first(gtop->dbop, gtop->key, gtop->preg, gtop->dbflags);
 				goto again3;
 			}
@@ -944,15 +1588,14 @@ again3:
 			/* strhash_reset(gtop->path_hash); */
 			segment_read(gtop);
 		}
-		if (gtop->gtp_index >= gtop->gtp_count) {
-			if (gtop->prefix && gtags_restart(gtop)) {
-				gtop->gtp.tag = dbop_first(gtop->dbop, gtop->key, gtop->preg, gtop->dbflags);
-				if (gtop->gtp.tag == NULL)
-					return NULL;
-				dbop_unread(gtop->dbop);
-				segment_read(gtop);
-			} else
+		while (gtop->gtp_index >= gtop->gtp_count) {
+			if (!gtags_restart(gtop))
 				return NULL;
+			gtop->gtp.tag = dbop_first(gtop->dbop, gtop->key, gtop->preg, gtop->dbflags);
+			if (gtop->gtp.tag == NULL)
+				continue;
+			dbop_unread(gtop->dbop);
+			segment_read(gtop);
 		}
 		return &gtop->gtp_array[gtop->gtp_index++];
 	}
@@ -971,6 +1614,10 @@ gtags_show_statistics(GTOP *gtop)
 void
 gtags_close(GTOP *gtop)
 {
+	if (gtop->index_keys && gtop->format & GTAGS_FOLDINDEX)
+		flush_fold_index(gtop);
+	if (gtop->index_keys && gtop->format & GTAGS_TRIGRAM)
+		flush_trigram_index(gtop);
 	if (gtop->format & GTAGS_COMPRESS)
 		abbrev_close();
 	if (gtop->segment_pool)
@@ -985,12 +1632,41 @@ gtags_close(GTOP *gtop)
 		varray_close(gtop->vb);
 	if (gtop->path_hash)
 		strhash_close(gtop->path_hash);
+	if (gtop->lno_pool)
+		pool_close(gtop->lno_pool);
+	if (gtop->lno_array)
+		varray_close(gtop->lno_array);
+	if (gtop->fid_keys)
+		strhash_close(gtop->fid_keys);
+	if (gtop->index_keys)
+		strhash_close(gtop->index_keys);
+	if (gtop->key_array)
+		varray_close(gtop->key_array);
+	if (gtop->key_pool)
+		pool_close(gtop->key_pool);
 	gpath_close();
 	dbop_close(gtop->dbop);
 	if (gtop->gtags)
 		dbop_close(gtop->gtags);
 	free(gtop);
 }
+/**
+ * put_varint: put a number in LEB128 (GTAGS_BINLINE).
+ *
+ *	@param[in]	sb	string buffer
+ *	@param[in]	n	number (n > 0)
+ *
+ * It is read by GET_VARINT(). The full-text index of GPATH uses it too.
+ */
+void
+put_varint(STRBUF *sb, unsigned int n)
+{
+	while (n >= 0x80) {
+		strbuf_putc(sb, (n & 0x7f) | 0x80);
+		n >>= 7;
+	}
+	strbuf_putc(sb, n);
+}
 /**
  * flush_pool: flush and write the pool as compact format.
  *
@@ -1007,12 +1683,13 @@ flush_pool(GTOP *gtop, const char *s_fid)
 	if (s_fid == NULL)
 		die("flush_pool: impossible");
 	/*
-	 * Write records as compact format and free line number table
-	 * for each entry in the pool.
+	 * Write records as compact format for each entry in the pool.
+	 * Line number vectors are released by gtags_flush() at once.
 	 */
 	for (entry = strhash_first(gtop->path_hash); entry; entry = strhash_next(gtop->path_hash)) {
-		VARRAY *vb = (VARRAY *)entry->value;
-		int *lno_array = varray_assign(vb, 0, 0);
+		struct lno_vector *vec = (struct lno_vector *)entry->value;
+		struct lno_chunk *chunk;
+		int *lno_array;
 		const char *key = entry->name;
 
 		/*
@@ -1031,8 +1708,16 @@ flush_pool(GTOP *gtop, const char *s_fid)
 			else
 				key = entry->name;
 		}
-		/* Sort line number table */
-		qsort(lno_array, vb->length, sizeof(int), compare_lineno); 
+		if (gtop->index_keys)
+			register_key(gtop, key);
+		/* Gather line numbers into a table and sort it */
+		lno_array = varray_assign(gtop->lno_array, vec->length - 1, 1);
+		lno_array = varray_assign(gtop->lno_array, 0, 0);
+		for (i = 0, chunk = vec->first; chunk; chunk = chunk->next) {
+			memcpy(&lno_array[i], chunk->lno, sizeof(int) * chunk->used);
+			i += chunk->used;
+		}
+		qsort(lno_array, vec->length, sizeof(int), compare_lineno); 
 
 		strbuf_reset(gtop->sb);
 		strbuf_puts(gtop->sb, s_fid);
@@ -1044,16 +1729,45 @@ flush_pool(GTOP *gtop, const char *s_fid)
 		}
 		strbuf_putc(gtop->sb, ' ');
 		header_offset = strbuf_getlen(gtop->sb);
+		/*
+		 * If GTAGS_BINLINE flag is set, line numbers are written as
+		 * a byte string. Please see the specification of format version 7.
+		 */
+		if (gtop->format & GTAGS_BINLINE) {
+			last = 0;			/* line 0 doesn't exist */
+			for (i = 0; i < vec->length; ) {
+				int n = lno_array[i++];
+				int cont = 0;
+
+				if (n == last)
+					continue;
+				/*
+				 * Successive line numbers. ex: 10 11 12 -> (10, 2)
+				 */
+				for (; i < vec->length && lno_array[i] <= n + cont + 1; i++)
+					if (lno_array[i] == n + cont + 1)
+						cont++;
+				put_varint(gtop->sb, (n - last) << 1 | (cont > 0));
+				if (cont > 0)
+					put_varint(gtop->sb, cont);
+				last = n + cont;
+				if (strbuf_getlen(gtop->sb) > DBOP_PAGESIZE / 4) {
+					dbop_put_tag(gtop->dbop, key, strbuf_value(gtop->sb));
+					strbuf_setlen(gtop->sb, header_offset);
+					last = 0;
+				}
+			}
+		}
 		/*
 		 * If GTAGS_COMPLINE flag is set, each line number is expressed as the
 		 * difference from the previous line number except for the head.
 		 * GTAGS_COMPLINE is set by default in format version 5.
 		 */
-		if (gtop->format & GTAGS_COMPLINE) {
+		else if (gtop->format & GTAGS_COMPLINE) {
 			int cont = 0;
 
 			last = 0;			/* line 0 doesn't exist */
-			for (i = 0; i < vb->length; i++) {
+			for (i = 0; i < vec->length; i++) {
 				int n = lno_array[i];
 
 				if (n == last)
@@ -1099,7 +1813,7 @@ flush_pool(GTOP *gtop, const char *s_fid)
 			 * This code is to support older format (version 4).
 			 */
 			last = 0;			/* line 0 doesn't exist */
-			for (i = 0; i < vb->length; i++) {
+			for (i = 0; i < vec->length; i++) {
 				int n = lno_array[i];
 
 				if (n == last)
@@ -1117,10 +1831,114 @@ flush_pool(GTOP *gtop, const char *s_fid)
 		if (strbuf_getlen(gtop->sb) > header_offset) {
 			dbop_put_tag(gtop->dbop, key, strbuf_value(gtop->sb));
 		}
-		/* Free line number table */
-		varray_close(vb);
+		if (gtop->fid_keys)
+			strhash_assign(gtop->fid_keys, key, 1);
 	}
 }
+/**
+ * Fid index:
+ *
+ * For each file, a meta record which lists the keys of its tag records is
+ * written to the same tag file. Gtags_delete() uses it to visit only the
+ * records of those keys instead of scanning the whole tag file.
+ *
+ * key		data
+ * ------------------------------------
+ * " __.FID 12"	" funcA funcB ..."
+ *
+ * The data begins with a blank so that dbop_next() skips it as a meta record.
+ * A file which has no tag has an empty list, so a file which lacks this record
+ * was tagged by an older GLOBAL. Since a modified file keeps its file id, the
+ * record is deleted and written again with the tag records.
+ */
+static const char *
+fid_index_key(const char *s_fid)
+{
+	static char key[sizeof(FIDKEY) + MAXFIDLEN];
+
+	snprintf(key, sizeof(key), "%s %s", FIDKEY, s_fid);
+	return key;
+}
+/**
+ * flush_fid_index: write the fid index record of a file.
+ *
+ *	@param[in]	gtop	descripter of GTOP
+ *	@param[in]	s_fid	file id
+ */
+static void
+flush_fid_index(GTOP *gtop, const char *s_fid)
+{
+	struct sh_entry *entry;
+
+	if (s_fid == NULL)
+		die("flush_fid_index: impossible");
+	strbuf_reset(gtop->sb);
+	for (entry = strhash_first(gtop->fid_keys); entry; entry = strhash_next(gtop->fid_keys)) {
+		strbuf_putc(gtop->sb, ' ');
+		strbuf_puts(gtop->sb, entry->name);
+	}
+	if (strbuf_getlen(gtop->sb) == 0)
+		strbuf_putc(gtop->sb, ' ');
+	dbop_put(gtop->dbop, fid_index_key(s_fid), strbuf_value(gtop->sb));
+}
+/**
+ * delete_using_fid_index: delete records belong to set of fid using fid index.
+ *
+ *	@param[in]	gtop	GTOP structure
+ *	@param[in]	deleteset bit array of fid
+ *	@return		1: deleted, 0: fid index is not available
+ *
+ * The fid index records of the set are deleted in either case.
+ */
+static int
+delete_using_fid_index(GTOP *gtop, IDSET *deleteset)
+{
+	STRHASH *keys = strhash_open(HASHBUCKETS);
+	struct sh_entry *entry;
+	const char *list, *tagline;
+	char s_fid[MAXFIDLEN];
+	unsigned int id;
+	int available = 1;
+
+	/*
+	 * Collect the keys of all files, so that a key shared by many files
+	 * is visited only once.
+	 */
+	for (id = idset_first(deleteset); id != END_OF_ID; id = idset_next(deleteset)) {
+		snprintf(s_fid, sizeof(s_fid), "%d", id);
+		if ((list = dbop_get(gtop->dbop, fid_index_key(s_fid))) == NULL) {
+			available = 0;
+			continue;
+		}
+		while (*list) {
+			char key[MAXKEYLEN + 1];
+			const char *p;
+
+			for (; *list == ' '; list++)
+				;
+			for (p = list; *p && *p != ' '; p++)
+				;
+			if (p - list > MAXKEYLEN)
+				die("fid index is corrupted.");
+			if (p > list) {
+				memcpy(key, list, p - list);
+				key[p - list] = '\0';
+				strhash_assign(keys, key, 1);
+			}
+			list = p;
+		}
+		dbop_delete(gtop->dbop, fid_index_key(s_fid));
+	}
+	if (available) {
+		for (entry = strhash_first(keys); entry; entry = strhash_next(keys)) {
+			for (tagline = dbop_first(gtop->dbop, entry->name, NULL, 0); tagline; tagline = dbop_next(gtop->dbop))
+				if (idset_contains(deleteset, atoi(tagline)))
+					dbop_delete(gtop->dbop, NULL);
+		}
+	}
+	strhash_close(keys);
+	return available;
+}
 /**
  * Read a tag segment with sorting.
  *
@@ -1183,7 +2001,13 @@ segment_read(GTOP *gtop)
 		lineno = seekto(gtp->tagline, SEEKTO_LINENO);
 		if (lineno == NULL)
 			die("invalid tag record.\n%s", tagline);
-		gtp->lineno = atoi(lineno);
+		if (gtop->format & GTAGS_BINLINE) {
+			int n;
+
+			GET_VARINT(lineno, n);
+			gtp->lineno = n >> 1;
+		} else
+			gtp->lineno = atoi(lineno);
 	}
 	/*
 	 * Sort tag lines.
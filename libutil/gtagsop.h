@@ -35,6 +35,11 @@
 #define COMPRESSKEY	" __.COMPRESS"
 #define COMPLINEKEY	" __.COMPLINE"
 #define COMPNAMEKEY	" __.COMPNAME"
+#define BINLINEKEY	" __.BINLINE"
+#define FIDKEY		" __.FID"
+#define FOLDKEY		" __.FOLD"
+#define TRIGRAMKEY	" __.TRIGRAM"
+#define DUPKEYKEY	" __.DUPKEY"
 
 #define NOTAGS		-1
 #define GPATH		0
@@ -64,6 +69,14 @@
 #ifdef USE_SQLITE3
 #define GTAGS_SQLITE3	32
 #endif
+			/** binary line number list (format version 7) */
+#define GTAGS_BINLINE		64
+			/** index of case-folded tag names */
+#define GTAGS_FOLDINDEX		128
+			/** trigram index of tag names */
+#define GTAGS_TRIGRAM		256
+			/** store duplicate keys once on each leaf page */
+#define GTAGS_DUPKEY		512
 			/** print information for debug */
 #define GTAGS_DEBUG		65536
 
@@ -87,6 +100,22 @@
 			/** don't sort */
 #define GTOP_NOSORT		128
 
+/**
+ * Read a number from a binary line number list (GTAGS_BINLINE).
+ * Please see flush_pool() in libutil/gtagsop.c for the details.
+ */
+#define GET_VARINT(p, n) do {							\
+	int _shift = 0;								\
+	(n) = 0;								\
+	while (*(const unsigned char *)(p) & 0x80) {				\
+		(n) |= (*(const unsigned char *)(p) & 0x7f) << _shift;		\
+		(p)++;								\
+		_shift += 7;							\
+	}									\
+	(n) |= *(const unsigned char *)(p) << _shift;				\
+	(p)++;									\
+} while (0)
+
 /**
  * This entry corresponds to one raw record.
  */
@@ -134,6 +163,20 @@ typedef struct {
 
 	/** used for compact format and path name only read */
 	STRHASH *path_hash;
+	POOL *lno_pool;			/**< line number vectors of the current file */
+	VARRAY *lno_array;		/**< line numbers of a tag being flushed */
+
+	/** keys of the current file, written to the fid index */
+	STRHASH *fid_keys;
+	/** keys written by this process, added to the fold and trigram index */
+	STRHASH *index_keys;
+
+	/*
+	 * Stuff for reading keys one by one (fold index, trigram index).
+	 */
+	VARRAY *key_array;		/**< keys to be read */
+	POOL *key_pool;			/**< memory for key_array */
+	int key_index;			/**< index of the next key */
 
 	/*
 	 * Stuff for calling dbop
@@ -154,5 +197,6 @@ GTP *gtags_first(GTOP *, const char *, int);
 GTP *gtags_next(GTOP *);
 void gtags_show_statistics(GTOP *);
 void gtags_close(GTOP *);
+void put_varint(STRBUF *, unsigned int);
 
 #endif /* ! _GTOP_H_ */
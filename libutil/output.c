@@ -22,7 +22,9 @@
 #include <config.h>
 #endif
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <ctype.h>
+#include <fcntl.h>
 #include <stdio.h>
 #ifdef STDC_HEADERS
 #include <stdlib.h>
@@ -32,6 +34,13 @@
 #else
 #include <strings.h>
 #endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#include "checkalloc.h"
 #include "compress.h"
 #include "convert.h"
 #include "die.h"
@@ -41,17 +50,32 @@
 #include "output.h"
 #include "strbuf.h"
 #include "strlimcpy.h"
+#include "varray.h"
 
 /**
  * Stuff for the compact format
  */
 static char curpath[MAXPATHLEN];	/**< current path */
 static char curtag[IDENTLEN];		/**< current tag */
-static int cur_lineno;			/**< current line number */
 static int last_lineno;			/**< last line number */
-static FILE *fp;			/**< file descripter */
 static const char *src;			/**< source code */
 
+/**
+ * Source file of the compact format.
+ * The whole file is mapped (or read) into memory, and the offsets of lines
+ * are indexed as far as needed, so that any line is got without reading
+ * the file again.
+ */
+static int opened;			/**< 1: source file is opened */
+static char *srcbuf;			/**< contents of the source file */
+static long srcsize;			/**< size of the source file */
+static int mapped;			/**< 1: srcbuf is mapped */
+static VARRAY *lines;			/**< offsets of the lines indexed (long) */
+static long scanned;			/**< offset up to which lines are indexed */
+
+static int open_source(const char *);
+static const char *source_line(int);
+static void close_source(void);
 static int put_compact_format(CONVERT *, GTP *, const char *, int);
 static void put_standard_format(CONVERT *, GTP *, int);
 static int nosource;
@@ -73,8 +97,7 @@ start_output(int a_format, int a_nosource)
 	format = a_format;
 	nosource = a_nosource;
 	curpath[0] = curtag[0] = '\0';
-	cur_lineno = last_lineno = 0;
-	fp = NULL;
+	last_lineno = 0;
 	src = "";
 	sb_uncompress = strbuf_open(0);
 }
@@ -83,8 +106,113 @@ end_output(void)
 {
 	if (sb_uncompress)
 		strbuf_close(sb_uncompress);
-	if (fp)
-		fclose(fp);
+	close_source();
+	if (lines) {
+		varray_close(lines);
+		lines = NULL;
+	}
+}
+/**
+ * open_source: open source file.
+ *
+ *	@param[in]	path	path name
+ *	@return		0: normal, -1: cannot open file
+ */
+static int
+open_source(const char *path)
+{
+	struct stat st;
+	int fd;
+
+	close_source();
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return -1;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size != (long)st.st_size) {
+		close(fd);
+		return -1;
+	}
+	srcsize = st.st_size;
+	srcbuf = NULL;
+	mapped = 0;
+#ifdef HAVE_MMAP
+	if (srcsize > 0) {
+		void *map = mmap(NULL, srcsize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (map != MAP_FAILED) {
+			srcbuf = (char *)map;
+			mapped = 1;
+		}
+	}
+#endif
+	if (srcbuf == NULL) {
+		long n, total = 0;
+
+		srcbuf = check_malloc(srcsize + 1);
+		while (total < srcsize && (n = read(fd, srcbuf + total, srcsize - total)) > 0)
+			total += n;
+		srcsize = total;
+	}
+	close(fd);
+	if (lines == NULL)
+		lines = varray_open(sizeof(long), 1000);
+	varray_reset(lines);
+	scanned = 0;
+	opened = 1;
+	return 0;
+}
+/**
+ * source_line: get a line of the source file.
+ *
+ *	@param[in]	lineno	line number (>= 1)
+ *	@return		line image without newline, NULL: out of file
+ */
+static const char *
+source_line(int lineno)
+{
+	STATIC_STRBUF(ib);
+	const char *start, *end, *nl;
+
+	if (!opened || lineno < 1)
+		return NULL;
+	while (lines->length < lineno && scanned < srcsize) {
+		*(long *)varray_append(lines) = scanned;
+		nl = memchr(srcbuf + scanned, '\n', srcsize - scanned);
+		scanned = nl ? nl - srcbuf + 1 : srcsize;
+	}
+	if (lineno > lines->length)
+		return NULL;
+	start = srcbuf + *(long *)varray_assign(lines, lineno - 1, 0);
+	if (lineno < lines->length)
+		end = srcbuf + *(long *)varray_assign(lines, lineno, 0);
+	else
+		end = srcbuf + scanned;
+	/*
+	 * Remove the last '\n' and/or '\r' like strbuf_fgets(STRBUF_NOCRLF).
+	 */
+	if (end > start && end[-1] == '\n')
+		end--;
+	if (end > start && end[-1] == '\r')
+		end--;
+	strbuf_clear(ib);
+	strbuf_nputs(ib, start, end - start);
+	return strbuf_value(ib);
+}
+/**
+ * close_source: close source file.
+ */
+static void
+close_source(void)
+{
+	if (!opened)
+		return;
+#ifdef HAVE_MMAP
+	if (mapped)
+		munmap(srcbuf, srcsize);
+	else
+#endif
+		free(srcbuf);
+	srcbuf = NULL;
+	opened = 0;
 }
 /**
  * output_with_formatting: pass records to the convert filter.
@@ -117,13 +245,11 @@ output_with_formatting(CONVERT *cv, GTP *gtp, const char *root, int flags)
 static int
 put_compact_format(CONVERT *cv, GTP *gtp, const char *root, int flags)
 {
-	STATIC_STRBUF(ib);
 	int count = 0;
 	char *p = (char *)gtp->tagline;
 	const char *fid, *tagname;
 	int n = 0;
 
-	strbuf_clear(ib);
 	/*                    a          b
 	 * tagline = <file id> <tag name> <line no>,...
 	 */
@@ -136,39 +262,59 @@ put_compact_format(CONVERT *cv, GTP *gtp, const char *root, int flags)
 		p++;
 	*p++ = '\0';			/* b */
 	/*
-	 * Reopen or rewind source file.
+	 * Reopen source file. Since the lines are indexed, it need not be
+	 * rewound even if the line number goes backward.
 	 */
 	if (!nosource) {
 		if (strcmp(gtp->path, curpath) != 0) {
-			if (curpath[0] != '\0' && fp != NULL)
-				fclose(fp);
 			strlimcpy(curtag, tagname, sizeof(curtag));
 			strlimcpy(curpath, gtp->path, sizeof(curpath));
 			/*
 			 * Use absolute path name to support GTAGSROOT
 			 * environment variable.
 			 */
-			fp = fopen(makepath(root, curpath, NULL), "r");
-			if (fp == NULL)
+			if (open_source(makepath(root, curpath, NULL)) < 0) {
 				warning("source file '%s' is not available.", curpath);
-			last_lineno = cur_lineno = 0;
+				src = "";
+			}
+			last_lineno = 0;
 		} else if (strcmp(gtp->tag, curtag) != 0) {
 			strlimcpy(curtag, gtp->tag, sizeof(curtag));
-			if (atoi(p) < last_lineno && fp != NULL) {
-				rewind(fp);
-				cur_lineno = 0;
-			}
 			last_lineno = 0;
 		}
 	}
 	/*
 	 * Unfold compact format.
 	 */
-	if (!isdigit(*p))
+	if (flags & GTAGS_BINLINE ? *p == '\0' : !isdigit(*p))
 		die("invalid compact format.");
 	if (flags & GTAGS_COMPNAME)
 		tagname = (char *)uncompress(tagname, gtp->tag, sb_uncompress);
-	if (flags & GTAGS_COMPLINE) {
+	if (flags & GTAGS_BINLINE) {
+		/*
+		 * If GTAGS_BINLINE flag is set, each entry is a difference from
+		 * the previous line number followed by the count of successive
+		 * line numbers. Please see flush_pool() in libutil/gtagsop.c.
+		 */
+		int last = 0, d, cont;
+
+		while (*p) {
+			GET_VARINT(p, d);
+			cont = 0;
+			if (d & 1)
+				GET_VARINT(p, cont);
+			n = last + (d >> 1);
+			for (last = n + cont; n <= last; n++) {
+				if (last_lineno != n && opened) {
+					if ((src = source_line(n)) == NULL)
+						src = "";
+				}
+				convert_put_using(cv, tagname, gtp->path, n, src, fid);
+				count++;
+				last_lineno = n;
+			}
+		}
+	} else if (flags & GTAGS_COMPLINE) {
 		/*
 		 * If GTAGS_COMPLINE flag is set, each line number is expressed as
 		 * the difference from the previous line number except for the head.
@@ -193,16 +339,9 @@ put_compact_format(CONVERT *cv, GTP *gtp, const char *root, int flags)
 				GET_NEXT_NUMBER(p);
 				n += last;
 			}
-			if (last_lineno != n && fp) {
-				while (cur_lineno < n) {
-					if (!(src = strbuf_fgets(ib, fp, STRBUF_NOCRLF))) {
-						src = "";
-						fclose(fp);
-						fp = NULL;
-						break;
-					}
-					cur_lineno++;
-				}
+			if (last_lineno != n && opened) {
+				if ((src = source_line(n)) == NULL)
+					src = "";
 			}
 			convert_put_using(cv, tagname, gtp->path, n, src, fid);
 			count++;
@@ -221,16 +360,9 @@ put_compact_format(CONVERT *cv, GTP *gtp, const char *root, int flags)
 				p++;
 			if (last_lineno == n)
 				continue;
-			if (last_lineno != n && fp) {
-				while (cur_lineno < n) {
-					if (!(src = strbuf_fgets(ib, fp, STRBUF_NOCRLF))) {
-						src = "";
-						fclose(fp);
-						fp = NULL;
-						break;
-					}
-					cur_lineno++;
-				}
+			if (last_lineno != n && opened) {
+				if ((src = source_line(n)) == NULL)
+					src = "";
 			}
 			convert_put_using(cv, tagname, gtp->path, n, src, fid);
 			count++;
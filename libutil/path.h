@@ -36,6 +36,25 @@
 #define NULL_DEVICE "/dev/null"
 #endif
 
+/**
+ * STRCMP, STRNCMP - Compare path names as the file system does
+ * back2slash - Convert backslashes in a STRBUF into slashes
+ */
+#if defined(_WIN32) || defined(__DJGPP__)
+#define STRCMP stricmp
+#define STRNCMP strnicmp
+#define back2slash(sb) do {		\
+	char *p = strbuf_value(sb);	\
+	for (; *p; p++) 		\
+		if (*p == '\\')         \
+			*p = '/';       \
+} while (0)
+#else
+#define STRCMP strcmp
+#define STRNCMP strncmp
+#define back2slash(sb)
+#endif
+
 #define isdrivechar(x) (((x) >= 'A' && (x) <= 'Z') || ((x) >= 'a' && (x) <= 'z'))
 
 int isabspath(const char *);
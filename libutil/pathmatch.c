@@ -0,0 +1,488 @@
+/*
+ * Copyright (c) 2018 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <ctype.h>
+#include <stdio.h>
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+#include "checkalloc.h"
+#include "gparam.h"
+#include "pathmatch.h"
+#include "strbuf.h"
+
+/*
+
+Pathmatch: match a path name against a set of patterns.
+
+It takes the place of the large regular expressions which were made from
+the langmap and the skip list. A path name must start with "./".
+
+pm = pathmatch_open(0);
+pathmatch_suffix(pm, "c");			'/[^/]+\.c$'
+pathmatch_add(pm, "GTAGS", 0);			'/GTAGS$'
+pathmatch_add(pm, "tmp/", PATHMATCH_PREFIX);	'/tmp/'
+pathmatch_add(pm, "src/?.o", PATHMATCH_ROOT);	'^\./src/[^/]\.o$'
+if (pathmatch_exec(pm, "./src/a.o", &so, &eo))
+	...					so == 0, eo == 9
+pathmatch_close(pm);
+
+In a pattern, '*' matches any string which does not include '/', '?'
+matches any character except for '/', '[...]' ('[!...]') matches
+a character in (not in) the class, and '\' quotes the next character.
+Without PATHMATCH_ROOT, a pattern may match just after any '/'.
+The position of the match is the same as that of the regular expression:
+the leftmost one, and the longest one at that position.
+
+Patterns are sorted as follows, so that a path name is examined with
+a few hash lookups for each directory level.
+
+	suffix		hash of suffixes (after the last '.' of the last component)
+	'*<literal>'	hash of literals, looked up with the tails of the last component
+	literal		tries of path components (root, any), each of which is
+			a hash of 'a', 'a/b', 'a/b/c', ...
+	others		examined one by one with a small glob engine
+*/
+
+/*
+ * Flags of a trie node.
+ */
+#define NODE_END	1		/**< a pattern ends here */
+#define NODE_DIR	2		/**< a pattern ends here with '/' */
+
+struct pathmatch_glob {
+	char *pattern;
+	int flags;
+	int last;			/**< 1: can match only the last component */
+};
+
+#define FOLD(pm, c) ((pm)->icase ? tolower((unsigned char)(c)) : (unsigned char)(c))
+
+/**
+ * unquote: remove quotes from a literal pattern.
+ *
+ *	@param[in]	pm	PATHMATCH structure
+ *	@param[in]	pattern	pattern
+ *	@param[out]	sb	unquoted pattern (case folded)
+ *	@return		1: literal, 0: has wildcards
+ */
+static int
+unquote(PATHMATCH *pm, const char *pattern, STRBUF *sb)
+{
+	const char *p;
+
+	strbuf_reset(sb);
+	for (p = pattern; *p; p++) {
+		if (*p == '*' || *p == '?' || *p == '[')
+			return 0;
+		if (*p == '\\' && *(p + 1))
+			p++;
+		strbuf_putc(sb, FOLD(pm, *p));
+	}
+	return 1;
+}
+/**
+ * add_node: add a literal pattern to a trie.
+ *
+ *	@param[in]	trie	trie
+ *	@param[in]	key	path components 'a/b/c'
+ *	@param[in]	flag	NODE_END or NODE_DIR
+ */
+static void
+add_node(STRHASH *trie, char *key, int flag)
+{
+	struct sh_entry *entry;
+	char *p;
+
+	for (p = key; (p = strchr(p, '/')) != NULL; p++) {
+		*p = '\0';
+		strhash_assign(trie, key, 1);
+		*p = '/';
+	}
+	entry = strhash_assign(trie, key, 1);
+	entry->value = (void *)((long)entry->value | flag);
+}
+/**
+ * walk_trie: match literal patterns.
+ *
+ *	@param[in]	pm	PATHMATCH structure
+ *	@param[in]	trie	trie
+ *	@param[in]	path	path name
+ *	@param[in]	start	position of '/' from which the patterns are matched
+ *	@return		end of the longest match, -1: not matched
+ */
+static int
+walk_trie(PATHMATCH *pm, STRHASH *trie, const char *path, int start)
+{
+	char key[MAXPATHLEN];
+	const char *p = path + start + 1;
+	struct sh_entry *entry;
+	int n = 0, end = -1;
+
+	if (trie->entries == 0)
+		return -1;
+	for (;;) {
+		long flags;
+
+		for (; *p && *p != '/'; p++) {
+			if (n >= sizeof(key) - 2)
+				return end;
+			key[n++] = FOLD(pm, *p);
+		}
+		key[n] = '\0';
+		if ((entry = strhash_assign(trie, key, 0)) == NULL)
+			break;
+		flags = (long)entry->value;
+		if ((flags & NODE_END) && *p == '\0')
+			end = p - path;
+		else if ((flags & NODE_DIR) && *p == '/')
+			end = p + 1 - path;
+		if (*p == '\0')
+			break;
+		key[n++] = *p++;
+	}
+	return end;
+}
+/**
+ * match_class: match a character against a class.
+ *
+ *	@param[in]	pm	PATHMATCH structure
+ *	@param[in]	pattern	class which starts with '['
+ *	@param[in]	c	character
+ *	@param[out]	matched	1: matched, 0: not matched
+ *	@return		the next of the class
+ */
+static const char *
+match_class(PATHMATCH *pm, const char *pattern, int c, int *matched)
+{
+	const unsigned char *p = (const unsigned char *)pattern + 1;
+	int negate = 0, found = 0, first = 1;
+
+	if (*p == '!') {
+		negate = 1;
+		p++;
+	}
+	while (*p && (*p != ']' || first)) {
+		int lo = *p, hi = *p;
+
+		first = 0;
+		if (*(p + 1) == '-' && *(p + 2) && *(p + 2) != ']') {
+			hi = *(p + 2);
+			p += 3;
+		} else
+			p++;
+		if (lo <= c && c <= hi)
+			found = 1;
+		else if (pm->icase) {
+			int l = tolower(c), u = toupper(c);
+
+			if ((lo <= l && l <= hi) || (lo <= u && u <= hi))
+				found = 1;
+		}
+	}
+	if (*p == ']')
+		p++;
+	*matched = found ^ negate;
+	return (const char *)p;
+}
+/**
+ * glob_match: match a glob pattern.
+ *
+ *	@param[in]	pm	PATHMATCH structure
+ *	@param[in]	pattern	pattern
+ *	@param[in]	s	string
+ *	@param[in]	prefix	1: need not match up to the end
+ *	@return		length of the longest match, -1: not matched
+ */
+static int
+glob_match(PATHMATCH *pm, const char *pattern, const char *s, int prefix)
+{
+	int n = 0;
+
+	for (;;) {
+		switch (*pattern) {
+		case '\0':
+			return (prefix || s[n] == '\0') ? n : -1;
+		case '*':
+			{
+				int k, r, longest = -1;
+
+				pattern++;
+				for (k = n; ; k++) {
+					if ((r = glob_match(pm, pattern, s + k, prefix)) >= 0 && k + r > longest) {
+						longest = k + r;
+						if (!prefix)
+							break;
+					}
+					if (s[k] == '\0' || s[k] == '/')
+						break;
+				}
+				return longest;
+			}
+		case '?':
+			if (s[n] == '\0' || s[n] == '/')
+				return -1;
+			pattern++;
+			n++;
+			break;
+		case '[':
+			{
+				int matched;
+
+				if (s[n] == '\0')
+					return -1;
+				pattern = match_class(pm, pattern, (unsigned char)s[n], &matched);
+				if (!matched)
+					return -1;
+				n++;
+			}
+			break;
+		case '\\':
+			if (*(pattern + 1))
+				pattern++;
+			/* FALLTHROUGH */
+		default:
+			if (s[n] == '\0' || FOLD(pm, *pattern) != FOLD(pm, s[n]))
+				return -1;
+			pattern++;
+			n++;
+			break;
+		}
+	}
+}
+/**
+ * match_last: match the patterns for the last component.
+ *
+ *	@param[in]	pm	PATHMATCH structure
+ *	@param[in]	base	the last component
+ *	@return		1: matched, 0: not matched
+ */
+static int
+match_last(PATHMATCH *pm, const char *base)
+{
+	char key[MAXPATHLEN];
+	int i, len = strlen(base);
+
+	if (len >= sizeof(key))
+		return 0;
+	for (i = 0; i <= len; i++)
+		key[i] = FOLD(pm, base[i]);
+	if (pm->suffix->entries > 0) {
+		const char *dot = strrchr(key, '.');
+
+		if (dot && dot > key && strhash_assign(pm->suffix, dot + 1, 0))
+			return 1;
+	}
+	if (pm->tail->entries > 0) {
+		int *lengths = varray_assign(pm->tail_lengths, 0, 0);
+
+		for (i = 0; i < pm->tail_lengths->length; i++)
+			if (lengths[i] <= len && strhash_assign(pm->tail, key + len - lengths[i], 0))
+				return 1;
+	}
+	return 0;
+}
+/**
+ * pathmatch_open: open a set of patterns.
+ *
+ *	@param[in]	icase	1: ignore case
+ *	@return		PATHMATCH structure
+ */
+PATHMATCH *
+pathmatch_open(int icase)
+{
+	PATHMATCH *pm = (PATHMATCH *)check_calloc(sizeof(PATHMATCH), 1);
+
+	pm->icase = icase;
+	pm->suffix = strhash_open(64);
+	pm->tail = strhash_open(64);
+	pm->tail_lengths = varray_open(sizeof(int), 8);
+	pm->root = strhash_open(64);
+	pm->any = strhash_open(256);
+	pm->globs = varray_open(sizeof(struct pathmatch_glob), 16);
+	return pm;
+}
+/**
+ * pathmatch_suffix: add a suffix.
+ *
+ *	@param[in]	pm	PATHMATCH structure
+ *	@param[in]	suffix	suffix without '.'
+ *
+ * It matches the last component which has one or more characters,
+ * '.' and the suffix.
+ */
+void
+pathmatch_suffix(PATHMATCH *pm, const char *suffix)
+{
+	STRBUF *sb = strbuf_open(0);
+	const char *p;
+
+	for (p = suffix; *p; p++)
+		strbuf_putc(sb, FOLD(pm, *p));
+	strhash_assign(pm->suffix, strbuf_value(sb), 1);
+	strbuf_close(sb);
+}
+/**
+ * pathmatch_add: add a pattern.
+ *
+ *	@param[in]	pm	PATHMATCH structure
+ *	@param[in]	pattern	pattern
+ *	@param[in]	flags	PATHMATCH_ROOT: match at the root only,
+ *				PATHMATCH_PREFIX: need not match up to the end
+ */
+void
+pathmatch_add(PATHMATCH *pm, const char *pattern, int flags)
+{
+	STRBUF *sb = strbuf_open(0);
+	struct pathmatch_glob *glob;
+
+	if (unquote(pm, pattern, sb)) {
+		char *key = strbuf_value(sb);
+		int len = strbuf_getlen(sb);
+		int flag = NODE_END;
+
+		if (flags & PATHMATCH_PREFIX) {
+			/*
+			 * 'a/b/' -> node 'a/b' which must be followed by '/'.
+			 */
+			if (len > 0 && key[len - 1] == '/') {
+				key[--len] = '\0';
+				flag = NODE_DIR;
+			} else
+				len = 0;
+		}
+		if (len > 0 && key[0] != '/' && key[len - 1] != '/' && !strstr(key, "//")) {
+			add_node((flags & PATHMATCH_ROOT) ? pm->root : pm->any, key, flag);
+			goto end;
+		}
+	} else if (flags == 0 && *pattern == '*' && unquote(pm, pattern + 1, sb)
+		&& strbuf_getlen(sb) > 0 && !strchr(strbuf_value(sb), '/')) {
+		int *lengths = varray_assign(pm->tail_lengths, 0, 0);
+		int i, len = strbuf_getlen(sb);
+
+		strhash_assign(pm->tail, strbuf_value(sb), 1);
+		for (i = 0; i < pm->tail_lengths->length; i++)
+			if (lengths[i] == len)
+				break;
+		if (i == pm->tail_lengths->length)
+			*(int *)varray_append(pm->tail_lengths) = len;
+		goto end;
+	}
+	glob = varray_append(pm->globs);
+	glob->pattern = check_strdup(pattern);
+	glob->flags = flags;
+	/*
+	 * '*' and '?' never match '/', but a class may.
+	 */
+	glob->last = !(flags & PATHMATCH_PREFIX) && !strchr(pattern, '/') && !strchr(pattern, '[');
+end:
+	strbuf_close(sb);
+}
+/**
+ * pathmatch_exec: match a path name.
+ *
+ *	@param[in]	pm	PATHMATCH structure
+ *	@param[in]	path	path name (must start with "./")
+ *	@param[out]	so	start of the match (may be NULL)
+ *	@param[out]	eo	end of the match (may be NULL)
+ *	@return		1: matched, 0: not matched
+ *
+ * Since the structure is not changed, this can be called by threads.
+ */
+int
+pathmatch_exec(PATHMATCH *pm, const char *path, int *so, int *eo)
+{
+	struct pathmatch_glob *globs = varray_assign(pm->globs, 0, 0);
+	int i, k, end, r, last;
+
+	for (last = strlen(path) - 1; last >= 0; last--)
+		if (path[last] == '/')
+			break;
+	/*
+	 * Patterns from the root.
+	 */
+	if (path[0] == '.' && path[1] == '/') {
+		end = walk_trie(pm, pm->root, path, 1);
+		for (k = 0; k < pm->globs->length; k++)
+			if ((globs[k].flags & PATHMATCH_ROOT)
+			    && (r = glob_match(pm, globs[k].pattern, path + 2, globs[k].flags & PATHMATCH_PREFIX)) >= 0
+			    && r + 2 > end)
+				end = r + 2;
+		if (end >= 0) {
+			i = 0;
+			goto matched;
+		}
+	}
+	/*
+	 * Patterns from any directory.
+	 */
+	for (i = 0; i <= last; i++) {
+		if (path[i] != '/')
+			continue;
+		end = walk_trie(pm, pm->any, path, i);
+		if (i == last && match_last(pm, path + i + 1))
+			end = strlen(path);
+		for (k = 0; k < pm->globs->length; k++) {
+			if ((globs[k].flags & PATHMATCH_ROOT) || (globs[k].last && i != last))
+				continue;
+			if ((r = glob_match(pm, globs[k].pattern, path + i + 1, globs[k].flags & PATHMATCH_PREFIX)) >= 0
+			    && i + 1 + r > end)
+				end = i + 1 + r;
+		}
+		if (end >= 0)
+			goto matched;
+	}
+	return 0;
+matched:
+	if (so)
+		*so = i;
+	if (eo)
+		*eo = end;
+	return 1;
+}
+/**
+ * pathmatch_close: close a set of patterns.
+ *
+ *	@param[in]	pm	PATHMATCH structure
+ */
+void
+pathmatch_close(PATHMATCH *pm)
+{
+	struct pathmatch_glob *globs = varray_assign(pm->globs, 0, 0);
+	int i;
+
+	for (i = 0; i < pm->globs->length; i++)
+		free(globs[i].pattern);
+	varray_close(pm->globs);
+	strhash_close(pm->any);
+	strhash_close(pm->root);
+	varray_close(pm->tail_lengths);
+	strhash_close(pm->tail);
+	strhash_close(pm->suffix);
+	free(pm);
+}
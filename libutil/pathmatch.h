@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2018 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _PATHMATCH_H_
+#define _PATHMATCH_H_
+
+#include "strhash.h"
+#include "varray.h"
+
+/*
+ * Flags for pathmatch_add().
+ */
+#define PATHMATCH_ROOT		1	/**< match only at the project root */
+#define PATHMATCH_PREFIX	2	/**< need not match up to the end */
+
+typedef struct {
+	int icase;			/**< 1: ignore case */
+	STRHASH *suffix;		/**< suffixes of file names */
+	STRHASH *tail;			/**< literal tails of '*<tail>' patterns */
+	VARRAY *tail_lengths;		/**< distinct lengths of tails (int) */
+	STRHASH *root;			/**< literal patterns from the root */
+	STRHASH *any;			/**< literal patterns from any directory */
+	VARRAY *globs;			/**< other patterns (struct pathmatch_glob) */
+} PATHMATCH;
+
+PATHMATCH *pathmatch_open(int);
+void pathmatch_suffix(PATHMATCH *, const char *);
+void pathmatch_add(PATHMATCH *, const char *, int);
+int pathmatch_exec(PATHMATCH *, const char *, int *, int *);
+void pathmatch_close(PATHMATCH *);
+
+#endif /* ! _PATHMATCH_H_ */
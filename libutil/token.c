@@ -21,73 +21,196 @@
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <ctype.h>
 #include <stdio.h>
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
 #ifdef HAVE_STRING_H
 #include <string.h>
 #else
 #include <strings.h>
 #endif
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
 
+#include "checkalloc.h"
 #include "die.h"
 #include "gparam.h"
+#include "gpathop.h"
 #include "strlimcpy.h"
 #include "token.h"
 
 /*
  * File input method.
  */
-int lineno;
-const char *sp, *cp, *lp;
-int crflag;			/* 1: return '\n', 0: doesn't return */
-int cmode;			/* allow token which start with '#' */
-int cppmode;			/* allow '::' as a token */
-int ymode;			/* allow token which start with '%' */
-char token[MAXTOKEN];
-char curfile[MAXPATHLEN];
-int continued_line;		/* previous line ends with '\' */
+#define tlen	(p - &t->token[0])
+static void pushbackchar(TOKEN *);
 
-static char ptok[MAXTOKEN];
-static int lasttok;
-static FILE *ip;
-static STRBUF *ib;
+/*
+ * The file last mapped by opentoken().
+ * Gtags(1) records its hash value in GPATH without reading it again.
+ */
+static struct {
+	char path[MAXPATHLEN];
+	struct stat st;
+	unsigned long long hash;
+} mapped;
 
-#define tlen	(p - &token[0])
-static void pushbackchar(void);
+#ifdef HAVE_MMAP
+/**
+ * map_file: map the file into memory.
+ *
+ *	@param[in]	t	tokenizer context
+ *
+ * If the file cannot be mapped, it is read through t->ip.
+ * A file which includes '\0' is also read through t->ip,
+ * because strbuf_fgets() treats it in its own way.
+ */
+static void
+map_file(TOKEN *t)
+{
+	struct stat st;
+	void *map;
 
+	if (fstat(fileno(t->ip), &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+		return;
+	if (st.st_size != (size_t)st.st_size)
+		return;
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(t->ip), 0);
+	if (map == MAP_FAILED)
+		return;
+	if (memchr(map, '\0', st.st_size) != NULL) {
+		munmap(map, st.st_size);
+		return;
+	}
+#ifdef MADV_SEQUENTIAL
+	(void)madvise(map, st.st_size, MADV_SEQUENTIAL);
+#endif
+	t->map = t->next = (const char *)map;
+	t->mapend = t->map + st.st_size;
+	strlimcpy(mapped.path, t->curfile, sizeof(mapped.path));
+	mapped.st = st;
+	mapped.hash = gpath_hash(GPATH_HASHINIT, map, st.st_size);
+}
+#endif
 /**
  * opentoken:
  *
  *	@param[in]	file
+ *	@return		tokenizer context, NULL: cannot open
  */
-int
+TOKEN *
 opentoken(const char *file)
 {
+	TOKEN *t;
+	FILE *ip;
+
 	/*
 	 * b flag is needed for WIN32 environment. Almost unix ignore it.
 	 */
 	if ((ip = fopen(file, "rb")) == NULL)
-		return 0;
-	ib = strbuf_open(MAXBUFLEN);
-	strlimcpy(curfile, file, sizeof(curfile));
-	sp = cp = lp = NULL; ptok[0] = '\0'; lineno = 0;
-	crflag = cmode = cppmode = ymode = 0;
-	continued_line = 0;
-	return 1;
+		return NULL;
+	t = (TOKEN *)check_calloc(sizeof(TOKEN), 1);
+	t->ip = ip;
+	t->ib = strbuf_open(MAXBUFLEN);
+	strlimcpy(t->curfile, file, sizeof(t->curfile));
+	mapped.path[0] = '\0';
+#ifdef HAVE_MMAP
+	map_file(t);
+#endif
+	return t;
 }
 /**
  * closetoken:
+ *
+ *	@param[in]	t	tokenizer context
  */
 void
-closetoken(void)
+closetoken(TOKEN *t)
 {
-	strbuf_close(ib);
-	fclose(ip);
+#ifdef HAVE_MMAP
+	if (t->map)
+		munmap((void *)t->map, t->mapend - t->map);
+#endif
+	strbuf_close(t->ib);
+	fclose(t->ip);
+	free(t);
+}
+/**
+ * tokenfilestat: get the state of the file last mapped by opentoken().
+ *
+ *	@param[in]	file	path of the file
+ *	@param[out]	st	stat of the file when it was mapped
+ *	@param[out]	hash	hash value of the contents (gpath_hash())
+ *	@return		0: got, -1: the file was not mapped
+ */
+int
+tokenfilestat(const char *file, struct stat *st, unsigned long long *hash)
+{
+	if (strcmp(mapped.path, file))
+		return -1;
+	*st = mapped.st;
+	*hash = mapped.hash;
+	return 0;
+}
+/**
+ * nextline: read the next line (for nextchar()).
+ *
+ *	@param[in]	t	tokenizer context
+ *	@return		the line, NULL: end of file
+ *
+ * The end of the line, without newline, is set to t->ep.
+ * A line of the mapped file is not copied.
+ */
+const char *
+nextline(TOKEN *t)
+{
+	const char *p, *nl;
+
+	if (t->map == NULL) {
+		if ((p = strbuf_fgets(t->ib, t->ip, STRBUF_NOCRLF)) != NULL)
+			t->ep = p + strlen(p);		/* '\0' ends the line */
+		return p;
+	}
+	if ((p = t->next) >= t->mapend)
+		return NULL;
+	if ((nl = memchr(p, '\n', t->mapend - p)) == NULL)
+		t->ep = t->next = t->mapend;
+	else {
+		t->ep = nl;
+		t->next = nl + 1;
+	}
+	if (t->ep > p && *(t->ep - 1) == '\r')
+		t->ep--;
+	return p;
+}
+/**
+ * lineimage: get the current line as a string.
+ *
+ *	@param[in]	t	tokenizer context
+ *	@return		line image
+ */
+const char *
+lineimage(TOKEN *t)
+{
+	if (t->map == NULL || t->sp == NULL)
+		return t->sp;
+	if (t->imgsp != t->sp) {
+		strbuf_reset(t->ib);
+		strbuf_nputs(t->ib, t->sp, t->ep - t->sp);
+		t->imgsp = t->sp;
+	}
+	return strbuf_value(t->ib);
 }
 
 /*
  * nexttoken: get next token
  *
+ *	@param[in]	t	tokenizer context
  *	@param[in]	interested	interested special character
  *				if NULL then all character.
  *	@param[in]	reserved	converter from token to token number
@@ -106,7 +229,7 @@ closetoken(void)
  */
 
 int
-nexttoken(const char *interested, int (*reserved)(const char *, int))
+nexttoken(TOKEN *t, const char *interested, int (*reserved)(const char *, int))
 {
 	int c;
 	char *p;
@@ -114,19 +237,19 @@ nexttoken(const char *interested, int (*reserved)(const char *, int))
 	int percent = 0;
 
 	/* check push back buffer */
-	if (ptok[0]) {
-		strlimcpy(token, ptok, sizeof(token));
-		ptok[0] = '\0';
-		return lasttok;
+	if (t->ptok[0]) {
+		strlimcpy(t->token, t->ptok, sizeof(t->token));
+		t->ptok[0] = '\0';
+		return t->lasttok;
 	}
 
 	for (;;) {
 		/* skip spaces */
-		if (!crflag)
-			while ((c = nextchar()) != EOF && isspace(c))
+		if (!t->crflag)
+			while ((c = nextchar(t)) != EOF && isspace(c))
 				;
 		else
-			while ((c = nextchar()) != EOF && isspace(c) && c != '\n')
+			while ((c = nextchar(t)) != EOF && isspace(c) && c != '\n')
 				;
 		if (c == EOF || c == '\n')
 			break;
@@ -134,67 +257,67 @@ nexttoken(const char *interested, int (*reserved)(const char *, int))
 		if (c == '"' || c == '\'') {	/* quoted string */
 			int quote = c;
 
-			while ((c = nextchar()) != EOF) {
+			while ((c = nextchar(t)) != EOF) {
 				if (c == quote)
 					break;
 				if (quote == '\'' && c == '\n')
 					break;
-				if (c == '\\' && (c = nextchar()) == EOF)
+				if (c == '\\' && (c = nextchar(t)) == EOF)
 					break;
 			}
 		} else if (c == '/') {			/* comment */
-			if ((c = nextchar()) == '/') {
-				while ((c = nextchar()) != EOF)
+			if ((c = nextchar(t)) == '/') {
+				while ((c = nextchar(t)) != EOF)
 					if (c == '\n') {
-						pushbackchar();
+						pushbackchar(t);
 						break;
 					}
 			} else if (c == '*') {
-				while ((c = nextchar()) != EOF) {
+				while ((c = nextchar(t)) != EOF) {
 					if (c == '*') {
-						if ((c = nextchar()) == '/')
+						if ((c = nextchar(t)) == '/')
 							break;
-						pushbackchar();
+						pushbackchar(t);
 					}
 				}
 			} else
-				pushbackchar();
+				pushbackchar(t);
 		} else if (c == '\\') {
-			if (nextchar() == '\n')
-				continued_line = 1;
+			if (nextchar(t) == '\n')
+				t->continued_line = 1;
 		} else if (isdigit(c)) {		/* digit */
-			while ((c = nextchar()) != EOF && (c == '.' || isalnum(c)))
+			while ((c = nextchar(t)) != EOF && (c == '.' || isalnum(c)))
 				;
-			pushbackchar();
-		} else if (c == '#' && cmode) {
+			pushbackchar(t);
+		} else if (c == '#' && t->cmode) {
 			/* recognize '##' as a token if it is reserved word. */
-			if (peekc(1) == '#') {
-				p = token;
+			if (peekc(t, 1) == '#') {
+				p = t->token;
 				*p++ = c;
-				*p++ = nextchar();
+				*p++ = nextchar(t);
 				*p   = 0;
-				if (reserved && (c = (*reserved)(token, tlen)) == 0)
+				if (reserved && (c = (*reserved)(t->token, tlen)) == 0)
 					break;
-			} else if (!continued_line && atfirst_exceptspace()) {
+			} else if (!t->continued_line && atfirst_exceptspace(t)) {
 				sharp = 1;
 				continue;
 			}
-		} else if (c == ':' && cppmode && peekc(1) == ':') {
-			p = token;
+		} else if (c == ':' && t->cppmode && peekc(t, 1) == ':') {
+			p = t->token;
 			*p++ = c;
-			*p++ = nextchar();
+			*p++ = nextchar(t);
 			*p   = 0;
-			if (reserved && (c = (*reserved)(token, tlen)) == 0)
+			if (reserved && (c = (*reserved)(t->token, tlen)) == 0)
 				break;
-		} else if (c == '%' && ymode) {
+		} else if (c == '%' && t->ymode) {
 			/* recognize '%%' as a token if it is reserved word. */
-			if (atfirst) {
-				p = token;
+			if (atfirst(t)) {
+				p = t->token;
 				*p++ = c;
-				if ((c = peekc(1)) == '%' || c == '{' || c == '}') {
-					*p++ = nextchar();
+				if ((c = peekc(t, 1)) == '%' || c == '{' || c == '}') {
+					*p++ = nextchar(t);
 					*p   = 0;
-					if (reserved && (c = (*reserved)(token, tlen)) != 0)
+					if (reserved && (c = (*reserved)(t->token, tlen)) != 0)
 						break;
 				} else if (!isspace(c)) {
 					percent = 1;
@@ -202,7 +325,7 @@ nexttoken(const char *interested, int (*reserved)(const char *, int))
 				}
 			}
 		} else if (c & 0x80 || isalpha(c) || c == '_') {/* symbol */
-			p = token;
+			p = t->token;
 			if (sharp) {
 				sharp = 0;
 				*p++ = '#';
@@ -210,28 +333,28 @@ nexttoken(const char *interested, int (*reserved)(const char *, int))
 				percent = 0;
 				*p++ = '%';
 			} else if (c == 'L') {
-				int tmp = peekc(1);
+				int tmp = peekc(t, 1);
 
 				if (tmp == '\"' || tmp == '\'')
 					continue;
 			}
-			for (*p++ = c; (c = nextchar()) != EOF && (c & 0x80 || isalnum(c) || c == '_');) {
-				if (tlen < sizeof(token))
+			for (*p++ = c; (c = nextchar(t)) != EOF && (c & 0x80 || isalnum(c) || c == '_');) {
+				if (tlen < sizeof(t->token))
 					*p++ = c;
 			}
-			if (tlen == sizeof(token)) {
-				warning("symbol name is too long. (Ignored) [+%d %s]", lineno, curfile);
-				token[0] = '\0';
+			if (tlen == sizeof(t->token)) {
+				warning("symbol name is too long. (Ignored) [+%d %s]", t->lineno, t->curfile);
+				t->token[0] = '\0';
 				continue;
 			}
 			*p = 0;
 	
 			if (c != EOF)
-				pushbackchar();
+				pushbackchar(t);
 			/* convert token string into token number */
 			c = SYMBOL;
 			if (reserved)
-				c = (*reserved)(token, tlen);
+				c = (*reserved)(t->token, tlen);
 			break;
 		} else {				/* special char */
 			if (interested == NULL || strchr(interested, c))
@@ -240,7 +363,7 @@ nexttoken(const char *interested, int (*reserved)(const char *, int))
 		}
 		sharp = percent = 0;
 	}
-	return lasttok = c;
+	return t->lasttok = c;
 }
 /**
  * pushbacktoken: push back token
@@ -248,41 +371,47 @@ nexttoken(const char *interested, int (*reserved)(const char *, int))
  *	following nexttoken() return same token again.
  */
 void
-pushbacktoken(void)
+pushbacktoken(TOKEN *t)
 {
-	strlimcpy(ptok, token, sizeof(ptok));
+	strlimcpy(t->ptok, t->token, sizeof(t->ptok));
 }
+/*
+ * Read a character following the current line, without moving.
+ */
+#define rawgetc() (t->map ? (q < t->mapend ? (unsigned char)*q++ : EOF) : getc(t->ip))
 /**
  * peekc: peek next char
  *
+ *	@param[in]	t	tokenizer context
  *	@param[in]	immediate	0: ignore blank, 1: include blank
  *
  * peekc() read ahead following blanks but doesn't change line.
  */
 int
-peekc(int immediate)
+peekc(TOKEN *t, int immediate)
 {
 	int c;
-	long pos;
+	long pos = 0;
+	const char *q = NULL;
     int comment = 0;
 
-	if (cp != NULL) {
+	if (t->cp != NULL) {
 		if (immediate)
-			c = nextchar();
+			c = nextchar(t);
 		else
-            while ((c = nextchar()) != EOF && c != '\n') {
+            while ((c = nextchar(t)) != EOF && c != '\n') {
                 if (c == '/') {			/* comment */
-                    if ((c = nextchar()) == '/') {
-                        while ((c = nextchar()) != EOF)
+                    if ((c = nextchar(t)) == '/') {
+                        while ((c = nextchar(t)) != EOF)
                             if (c == '\n') {
-                                pushbackchar();
+                                pushbackchar(t);
                                 break;
                             }
                     } else if (c == '*') {
                         comment = 1;
-                        while ((c = nextchar()) != EOF) {
+                        while ((c = nextchar(t)) != EOF) {
                             if (c == '*') {
-                                if ((c = nextchar()) == '/')
+                                if ((c = nextchar(t)) == '/')
                                 {
                                     comment = 0;
                                     break;
@@ -290,30 +419,33 @@ peekc(int immediate)
                             }
                             else if (c == '\n')
                             {
-                                pushbackchar();
+                                pushbackchar(t);
                                 break;
                             }
                         }
                     } else
-                        pushbackchar();
+                        pushbackchar(t);
                 }
                 else if (!isspace(c))
                     break;
             }
 		if (c != EOF)
-			pushbackchar();
+			pushbackchar(t);
 		if (c != '\n' || immediate)
 			return c;
 	}
-	pos = ftell(ip);
+	if (t->map)
+		q = t->next;
+	else
+		pos = ftell(t->ip);
 	if (immediate)
-		c = getc(ip);
+		c = rawgetc();
 	else
-        while ((c = getc(ip)) != EOF) {
+        while ((c = rawgetc()) != EOF) {
             if (comment) {
-                while ((c = getc(ip)) != EOF) {
+                while ((c = rawgetc()) != EOF) {
                     if (c == '*') {
-                        if ((c = getc(ip)) == '/')
+                        if ((c = rawgetc()) == '/')
                         {
                             comment = 0;
                             break;
@@ -322,15 +454,15 @@ peekc(int immediate)
                 }
             }
             else if (c == '/') {			/* comment */
-                if ((c = getc(ip)) == '/') {
-                    while ((c = getc(ip)) != EOF)
+                if ((c = rawgetc()) == '/') {
+                    while ((c = rawgetc()) != EOF)
                         if (c == '\n') {
                             break;
                         }
                 } else if (c == '*') {
-                    while ((c = getc(ip)) != EOF) {
+                    while ((c = rawgetc()) != EOF) {
                         if (c == '*') {
-                            if ((c = getc(ip)) == '/')
+                            if ((c = rawgetc()) == '/')
                                 break;
                         }
                     }
@@ -341,7 +473,8 @@ peekc(int immediate)
                 break;
         }
 
-	(void)fseek(ip, pos, SEEK_SET);
+	if (!t->map)
+		(void)fseek(t->ip, pos, SEEK_SET);
 
 	return c;
 }
@@ -349,9 +482,9 @@ peekc(int immediate)
  * throwaway_nextchar: throw away next character
  */
 void
-throwaway_nextchar(void)
+throwaway_nextchar(TOKEN *t)
 {
-	nextchar();
+	nextchar(t);
 }
 /**
  * atfirst_exceptspace: return if current position is the first column
@@ -361,10 +494,10 @@ throwaway_nextchar(void)
  *	|      # define
  */
 int
-atfirst_exceptspace(void)
+atfirst_exceptspace(TOKEN *t)
 {
-	const char *start = sp;
-	const char *end = cp ? cp - 1 : lp;
+	const char *start = t->sp;
+	const char *end = t->cp ? t->cp - 1 : t->lp;
 
 	while (start < end && *start && isspace(*start))
 		start++;
@@ -377,12 +510,12 @@ atfirst_exceptspace(void)
  * 
  */
 static void
-pushbackchar(void)
+pushbackchar(TOKEN *t)
 {
-        if (sp == NULL)
+        if (t->sp == NULL)
                 return;         /* nothing to do */
-        if (cp == NULL)
-                cp = lp;
+        if (t->cp == NULL)
+                t->cp = t->lp;
         else
-                --cp;
+                --t->cp;
 }
@@ -21,39 +21,68 @@
 #ifndef _TOKEN_H_
 #define _TOKEN_H_
 
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+
 #include "gparam.h"
 #include "strbuf.h"
 
 #define SYMBOL		0
 
-extern const char *sp, *cp, *lp;
-extern int lineno;
-extern int crflag;
-extern int cmode;
-extern int cppmode;
-extern int ymode;
-extern char token[MAXTOKEN];
-extern char curfile[MAXPATHLEN];
-extern int continued_line;
-
-#define nextchar() \
-	(cp == NULL ? \
-		((sp = cp = strbuf_fgets(ib, ip, STRBUF_NOCRLF)) == NULL ? \
+/**
+ * Tokenizer context.
+ * Each file being parsed has its own, so that several files can be
+ * parsed at the same time.
+ *
+ * The file is mapped into memory if possible, and then lines are not
+ * terminated by '\0'. Use lineimage() to get the current line as a string.
+ */
+typedef struct {
+	const char *sp, *cp, *lp;	/**< start, current and last of the line */
+	const char *ep;			/**< end of the line */
+	int lineno;			/**< line number */
+	int crflag;			/**< 1: return '\n', 0: doesn't return */
+	int cmode;			/**< allow token which start with '#' */
+	int cppmode;			/**< allow '::' as a token */
+	int ymode;			/**< allow token which start with '%' */
+	char token[MAXTOKEN];		/**< current token */
+	char curfile[MAXPATHLEN];	/**< path of the file */
+	int continued_line;		/**< previous line ends with '\' */
+	/*
+	 * private
+	 */
+	char ptok[MAXTOKEN];		/**< push back buffer */
+	int lasttok;
+	FILE *ip;
+	STRBUF *ib;			/**< line buffer or line image */
+	const char *map;		/**< mapped file, NULL: read from ip */
+	const char *mapend;		/**< end of the mapped file */
+	const char *next;		/**< next line in the mapped file */
+	const char *imgsp;		/**< line whose image is in ib */
+} TOKEN;
+
+#define nextchar(t) \
+	((t)->cp == NULL ? \
+		(((t)->sp = (t)->cp = nextline(t)) == NULL ? \
 			EOF : \
-			(lineno++, *cp == 0 ? \
-				(lp = cp, cp = NULL, continued_line = 0, '\n') : \
-				(unsigned char)*cp++)) : \
-		(*cp == 0 ? \
-			(lp = cp, cp = NULL, continued_line = 0, '\n') : \
-			(unsigned char)*cp++))
-#define atfirst (sp && sp == (cp ? cp - 1 : lp))
-
-int opentoken(const char *);
-void closetoken(void);
-int nexttoken(const char *, int (*)(const char *, int));
-void pushbacktoken(void);
-int peekc(int);
-void throwaway_nextchar(void);
-int atfirst_exceptspace(void);
+			((t)->lineno++, (t)->cp == (t)->ep ? \
+				((t)->lp = (t)->cp, (t)->cp = NULL, (t)->continued_line = 0, '\n') : \
+				(unsigned char)*(t)->cp++)) : \
+		((t)->cp == (t)->ep ? \
+			((t)->lp = (t)->cp, (t)->cp = NULL, (t)->continued_line = 0, '\n') : \
+			(unsigned char)*(t)->cp++))
+#define atfirst(t) ((t)->sp && (t)->sp == ((t)->cp ? (t)->cp - 1 : (t)->lp))
+
+TOKEN *opentoken(const char *);
+void closetoken(TOKEN *);
+int tokenfilestat(const char *, struct stat *, unsigned long long *);
+const char *nextline(TOKEN *);
+const char *lineimage(TOKEN *);
+int nexttoken(TOKEN *, const char *, int (*)(const char *, int));
+void pushbacktoken(TOKEN *);
+int peekc(TOKEN *, int);
+void throwaway_nextchar(TOKEN *);
+int atfirst_exceptspace(TOKEN *);
 
 #endif /* ! _TOKEN_H_ */
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2018 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <ctype.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+#include "gparam.h"
+#include "strhash.h"
+#include "trigram.h"
+
+/*
+ * Trigrams are three successive bytes whose upper case letters are
+ * converted into lower case. They are used by the trigram index of tag
+ * names (gtagsop.c) and the full-text index of source files (gpathop.c).
+ */
+/**
+ * add_trigrams: add the trigrams of a literal string.
+ *
+ *	@param[in]	trigrams	STRHASH of trigrams
+ *	@param[in]	s	literal string
+ *	@param[in]	len	length of the string
+ */
+void
+add_trigrams(STRHASH *trigrams, const char *s, int len)
+{
+	char trigram[4];
+	int i, j;
+
+	trigram[3] = '\0';
+	for (i = 0; i + 3 <= len; i++) {
+		for (j = 0; j < 3; j++)
+			trigram[j] = tolower((unsigned char)s[i + j]);
+		strhash_assign(trigrams, trigram, 1);
+	}
+}
+/**
+ * required_trigrams: extract the trigrams which every matched string includes.
+ *
+ *	@param[in]	pattern	regular expression
+ *	@param[in]	basic	1: basic regular expression, 0: extended
+ *	@param[out]	trigrams	STRHASH of trigrams
+ *	@return		0: cannot extract, 1: extracted (may be none)
+ *
+ * This is conservative: literals in a group, and a character followed by
+ * a quantifier which allows zero times are ignored. An alternation at the
+ * top level gives up the extraction.
+ */
+int
+required_trigrams(const char *pattern, int basic, STRHASH *trigrams)
+{
+	char literal[IDENTLEN];
+	const char *p = pattern;
+	int len = 0, depth = 0;
+	int c;
+
+	while (*p) {
+		c = *p++;
+		/*
+		 * Decide whether c is a special character.
+		 */
+		if (c == '\\') {
+			if (*p == '\0')
+				return 0;
+			c = *p++;
+			if (basic && strchr("(){}|+?", c))
+				;		/* special character in basic regex */
+			else if (isalnum(c) || strchr("<>`'", c)) {
+				/* back reference or GNU extension */
+				add_trigrams(trigrams, literal, len);
+				len = 0;
+				continue;
+			} else
+				goto literal;
+		} else if (basic ? !strchr(".[*^$", c) : !strchr(".[()|*+?{^$", c)) {
+			goto literal;
+		}
+		/*
+		 * Special characters.
+		 */
+		switch (c) {
+		case '|':
+			if (depth == 0)
+				return 0;
+			break;
+		case '(':
+			depth++;
+			break;
+		case ')':
+			if (depth > 0)
+				depth--;
+			break;
+		case '*':
+		case '?':
+			if (len > 0)
+				len--;		/* the last character may not appear */
+			break;
+		case '{':
+			if (len > 0)
+				len--;
+			while (*p && *p != '}')
+				p++;
+			if (*p)
+				p++;
+			break;
+		case '[':
+			if (*p == '^')
+				p++;
+			if (*p == ']')
+				p++;
+			while (*p && *p != ']') {
+				if (*p == '[' && (p[1] == ':' || p[1] == '.' || p[1] == '=')) {
+					const char *q = p + 2;
+
+					while (*q && !(*q == p[1] && q[1] == ']'))
+						q++;
+					if (*q == '\0')
+						return 0;
+					p = q + 2;
+				} else
+					p++;
+			}
+			if (*p == '\0')
+				return 0;
+			p++;
+			break;
+		default:
+			break;
+		}
+		add_trigrams(trigrams, literal, len);
+		len = 0;
+		continue;
+literal:
+		if (depth > 0)
+			continue;
+		if (len >= sizeof(literal)) {
+			add_trigrams(trigrams, literal, len);
+			len = 0;
+		}
+		literal[len++] = c;
+	}
+	add_trigrams(trigrams, literal, len);
+	return 1;
+}
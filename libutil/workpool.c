@@ -0,0 +1,356 @@
+/*
+ * Copyright (c) 2018 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <sys/types.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "checkalloc.h"
+#include "die.h"
+#include "strbuf.h"
+#include "workpool.h"
+
+/*
+ * Ordered worker pool (gtags --jobs, global -g --jobs).
+ *
+ * The parent process sends requests to worker processes, each of which
+ * runs the job procedure and sends the results back through a pipe.
+ *
+ *	Parent					Worker
+ *	---------------------------------------------------
+ *	jobout  =====> '<request>\0' =====> job procedure
+ *	result  <===== results, end mark <== workpool_send()
+ *
+ * Requests are dealt to the workers in round robin, and the results are
+ * given to the result procedure strictly in the order of the requests.
+ * So, the output of the parent is identical to that of serial processing
+ * regardless of the number of workers.
+ */
+
+/**
+ * Number of jobs which may be outstanding per worker.
+ * Requests are small enough not to fill up a pipe.
+ */
+#define QUEUE_DEPTH	4
+
+/**
+ * Header of a result sent from a worker.
+ * A record whose type is 0 is the end mark of a job.
+ */
+struct record {
+	int type;
+	int value;
+	int len;
+};
+
+#if defined(__DJGPP__) || defined(_WIN32)
+/*
+ * Not supported. The caller works in serial mode.
+ */
+int
+workpool_open(const char *name, int jobs, WORKPOOL_JOB job, WORKPOOL_RESULT result, void *arg)
+{
+	warning("--jobs is not supported on this platform. (ignored)");
+	return 0;
+}
+void
+workpool_request(const char *request, const char *note)
+{
+	die("workpool_request: impossible.");
+}
+void
+workpool_send(int type, int value, const void *buf, int len)
+{
+	die("workpool_send: impossible.");
+}
+void
+workpool_close(void)
+{
+	return;
+}
+#else
+#include <sys/wait.h>
+
+struct worker {
+	int pid;
+	FILE *jobout;			/**< write requests to worker */
+	FILE *result;			/**< read results from worker */
+};
+struct job {
+	struct worker *worker;
+	char *request;
+	char *note;			/**< NULL: no note */
+};
+static const char *pool_name;
+static struct worker *workers;
+static int nworkers;
+static struct job *queue;
+static int queue_size, queue_head, queue_count;
+static int seqno;
+static WORKPOOL_JOB job_proc;
+static WORKPOOL_RESULT result_proc;
+static void *proc_arg;
+static FILE *worker_out;		/**< output of this worker process */
+
+/**
+ * read_string: read a '\0' terminated string.
+ *
+ *	@param[in]	ip	input
+ *	@param[out]	sb	string
+ *	@return		0: EOF, 1: read
+ */
+static int
+read_string(FILE *ip, STRBUF *sb)
+{
+	int c;
+
+	strbuf_reset(sb);
+	while ((c = getc(ip)) != EOF && c != '\0')
+		strbuf_putc(sb, c);
+	return c == '\0';
+}
+/**
+ * worker_loop: main loop of a worker process.
+ *
+ *	@param[in]	ip	requests
+ */
+static void
+worker_loop(FILE *ip)
+{
+	STRBUF *request = strbuf_open(0);
+	struct record end;
+
+	memset(&end, 0, sizeof(end));
+	while (read_string(ip, request)) {
+		(*job_proc)(proc_arg, strbuf_value(request));
+		if (fwrite(&end, sizeof(end), 1, worker_out) != 1 || fflush(worker_out) == EOF)
+			die("cannot write to the parent process.");
+	}
+	(*job_proc)(proc_arg, NULL);
+	strbuf_close(request);
+}
+/**
+ * consume_job: receive the results of the oldest job and pass them to the result procedure.
+ */
+static void
+consume_job(void)
+{
+	static char *buf;
+	static int bufsize;
+	struct job *job = &queue[queue_head];
+	FILE *ip = job->worker->result;
+	struct record rec;
+
+	for (;;) {
+		if (fread(&rec, sizeof(rec), 1, ip) != 1)
+			die("%s process terminated abnormally.", pool_name);
+		if (rec.type == 0)
+			break;
+		if (rec.len < 0)
+			die("invalid record from %s process.", pool_name);
+		if (bufsize < rec.len + 1) {
+			bufsize = rec.len + 1;
+			buf = check_realloc(buf, bufsize);
+		}
+		if (rec.len > 0 && fread(buf, 1, rec.len, ip) != rec.len)
+			die("%s process terminated abnormally.", pool_name);
+		buf[rec.len] = '\0';
+		(*result_proc)(proc_arg, job->request, job->note, rec.type, rec.value, buf, rec.len);
+	}
+	(*result_proc)(proc_arg, job->request, job->note, 0, 0, NULL, 0);
+	free(job->request);
+	if (job->note)
+		free(job->note);
+	job->request = job->note = NULL;
+	queue_head = (queue_head + 1) % queue_size;
+	queue_count--;
+}
+/**
+ * workpool_open: start worker processes.
+ *
+ *	@param[in]	name	name of the workers for messages (e.g. "parser")
+ *	@param[in]	jobs	number of worker processes
+ *	@param[in]	job	job procedure
+ *	@param[in]	result	result procedure
+ *	@param[in]	arg	argument for the procedures
+ *	@return		1: started, 0: not supported
+ *
+ * The result procedure is invoked in the parent process, in the order in
+ * which requests were given to workpool_request().
+ */
+int
+workpool_open(const char *name, int jobs, WORKPOOL_JOB job, WORKPOOL_RESULT result, void *arg)
+{
+	int i, k;
+
+	pool_name = name;
+	job_proc = job;
+	result_proc = result;
+	proc_arg = arg;
+	nworkers = jobs;
+	workers = (struct worker *)check_calloc(sizeof(struct worker), nworkers);
+	queue_size = nworkers * QUEUE_DEPTH;
+	queue = (struct job *)check_calloc(sizeof(struct job), queue_size);
+	queue_head = queue_count = seqno = 0;
+	/*
+	 * A worker must not write out stdio buffers inherited from the parent.
+	 */
+	fflush(NULL);
+	for (i = 0; i < nworkers; i++) {
+		int opipe[2], ipipe[2];
+
+		if (pipe(opipe) < 0 || pipe(ipipe) < 0)
+			die("pipe(2) failed.");
+		workers[i].pid = fork();
+		if (workers[i].pid == 0) {
+			/* worker process */
+			FILE *ip;
+
+			/*
+			 * Close the pipes of the other workers. Otherwise they
+			 * would never see EOF of their requests.
+			 */
+			for (k = 0; k < i; k++) {
+				close(fileno(workers[k].jobout));
+				close(fileno(workers[k].result));
+			}
+			close(opipe[1]);
+			close(ipipe[0]);
+			ip = fdopen(opipe[0], "r");
+			worker_out = fdopen(ipipe[1], "w");
+			if (ip == NULL || worker_out == NULL)
+				die("fdopen(3) failed.");
+			worker_loop(ip);
+			fclose(worker_out);
+			_exit(0);
+		} else if (workers[i].pid < 0)
+			die("fork(2) failed.");
+		/* parent process */
+		close(opipe[0]);
+		close(ipipe[1]);
+		fcntl(opipe[1], F_SETFD, FD_CLOEXEC);
+		fcntl(ipipe[0], F_SETFD, FD_CLOEXEC);
+		workers[i].jobout = fdopen(opipe[1], "w");
+		workers[i].result = fdopen(ipipe[0], "r");
+		if (workers[i].jobout == NULL || workers[i].result == NULL)
+			die("fdopen(3) failed.");
+	}
+	return 1;
+}
+/**
+ * workpool_request: request a job.
+ *
+ *	@param[in]	request	request for the job procedure
+ *	@param[in]	note	string kept for the result procedure, NULL: none
+ *
+ * The result procedure of earlier jobs may be invoked in this function.
+ */
+void
+workpool_request(const char *request, const char *note)
+{
+	struct job *job;
+	char *r, *n;
+
+	/*
+	 * The arguments are copied first, since they may be invalidated by
+	 * the result procedure (e.g. a buffer of dbop_get()).
+	 */
+	r = check_strdup(request);
+	n = note ? check_strdup(note) : NULL;
+	/*
+	 * The oldest job always belongs to the worker to be used next,
+	 * because jobs are dealt in round robin.
+	 */
+	if (queue_count == queue_size)
+		consume_job();
+	job = &queue[(queue_head + queue_count) % queue_size];
+	job->worker = &workers[seqno++ % nworkers];
+	job->request = r;
+	job->note = n;
+	fputs(r, job->worker->jobout);
+	putc('\0', job->worker->jobout);
+	if (fflush(job->worker->jobout) == EOF)
+		die("%s process terminated abnormally.", pool_name);
+	queue_count++;
+}
+/**
+ * workpool_send: send a result to the parent process (in a worker process).
+ *
+ *	@param[in]	type	type of the result, must not be 0
+ *	@param[in]	value	integer value
+ *	@param[in]	buf	data
+ *	@param[in]	len	length of the data
+ */
+void
+workpool_send(int type, int value, const void *buf, int len)
+{
+	struct record rec;
+
+	if (worker_out == NULL || type == 0)
+		die("workpool_send: impossible.");
+	rec.type = type;
+	rec.value = value;
+	rec.len = len;
+	if (fwrite(&rec, sizeof(rec), 1, worker_out) != 1
+	    || (len > 0 && fwrite(buf, 1, len, worker_out) != len))
+		die("cannot write to the parent process.");
+}
+/**
+ * workpool_close: wait for all jobs and terminate worker processes.
+ */
+void
+workpool_close(void)
+{
+	int i, ret, status;
+
+	while (queue_count > 0)
+		consume_job();
+	for (i = 0; i < nworkers; i++)
+		fclose(workers[i].jobout);
+	for (i = 0; i < nworkers; i++) {
+		fclose(workers[i].result);
+		while ((ret = waitpid(workers[i].pid, &status, 0)) < 0 && errno == EINTR)
+			;
+		if (ret < 0)
+			die("waitpid(2) failed.");
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			die("%s process terminated abnormally.", pool_name);
+	}
+	free(workers);
+	free(queue);
+	workers = NULL;
+	queue = NULL;
+	nworkers = 0;
+}
+#endif
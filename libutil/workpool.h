@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2018 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _WORKPOOL_H_
+#define _WORKPOOL_H_
+
+/**
+ * Job procedure, which is called in a worker process.
+ * It sends the results by workpool_send().
+ *
+ *	@param[in]	arg	argument given to workpool_open()
+ *	@param[in]	request	request given to workpool_request(),
+ *				NULL: the worker is exiting
+ */
+typedef void (*WORKPOOL_JOB)(void *, const char *);
+
+/**
+ * Result procedure, which is called in the parent process for each result
+ * of a job, and then with type 0 at the end of the job.
+ *
+ *	@param[in]	arg	argument given to workpool_open()
+ *	@param[in]	request	request given to workpool_request()
+ *	@param[in]	note	note given to workpool_request()
+ *	@param[in]	type	type given to workpool_send(), 0: end of the job
+ *	@param[in]	value	value given to workpool_send()
+ *	@param[in]	buf	data given to workpool_send() with '\0' appended
+ *	@param[in]	len	length of the data
+ */
+typedef void (*WORKPOOL_RESULT)(void *, const char *, const char *, int, int, const char *, int);
+
+int workpool_open(const char *, int, WORKPOOL_JOB, WORKPOOL_RESULT, void *);
+void workpool_request(const char *, const char *);
+void workpool_send(int, int, const void *, int);
+void workpool_close(void);
+
+#endif /* ! _WORKPOOL_H_ */